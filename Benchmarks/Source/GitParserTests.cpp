@@ -0,0 +1,386 @@
+/*
+  ==============================================================================
+
+    GitParserTests.cpp
+    ParseArena, GitTokenizer and GitParser against the output git really
+    produces, including the awkward cases: subjects that look like headers,
+    octopus merges, signed commits, missing objects, valueless config keys
+    and peeled refs.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/GitParser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const std::string treeOid = "4b825dc642cb6eb9a060e54bf8d69288fbee4904";
+    const std::string parentOids[] = { "1111111111111111111111111111111111111111",
+                                       "2222222222222222222222222222222222222222",
+                                       "3333333333333333333333333333333333333333" };
+
+    std::string makeCommit(int numParents, const std::string& extraHeaders, const std::string& message)
+    {
+        std::string content = "tree " + treeOid + "\n";
+
+        for (int i = 0; i < numParents; ++i)
+            content += "parent " + parentOids[i] + "\n";
+
+        content += "author Jo <jo@example.com> 1700000000 +0100\n"
+                   "committer Jo <jo@example.com> 1700000060 +0100\n";
+        content += extraHeaders;
+        return content + "\n" + message;
+    }
+
+    juce::String toString(std::string_view text)
+    {
+        return GitParser::toString(text);
+    }
+}
+
+//==============================================================================
+class ParseArenaTests : public juce::UnitTest
+{
+public:
+    ParseArenaTests() : juce::UnitTest("ParseArena", "SnapTrack") {}
+
+    void runTest() override
+    {
+        beginTest("Allocations are aligned and don't overlap");
+        {
+            ParseArena arena;
+            char* first = arena.allocate<char>(3);
+            auto* views = arena.allocate<std::string_view>(4);
+            auto* numbers = arena.allocate<juce::int64>(2);
+
+            expect(reinterpret_cast<std::uintptr_t>(views) % alignof(std::string_view) == 0);
+            expect(reinterpret_cast<std::uintptr_t>(numbers) % alignof(juce::int64) == 0);
+            expect((char*) views >= first + 3);
+            expect((char*) numbers >= (char*) (views + 4));
+        }
+
+        beginTest("copy() outlives the text it copied");
+        {
+            ParseArena arena;
+            std::string_view copied;
+
+            {
+                std::string text = "refs/heads/main";
+                copied = arena.copy(text);
+                text.assign(text.size(), 'x');
+            }
+
+            expectEquals(toString(copied), juce::String("refs/heads/main"));
+            expect(arena.copy({}).empty());
+        }
+
+        beginTest("reset() reuses the blocks it has");
+        {
+            ParseArena arena;
+            char* before = arena.allocate<char>(100);
+            expect(arena.getNumBytesUsed() >= 100);
+
+            arena.reset();
+            expectEquals((int) arena.getNumBytesUsed(), 0);
+            expect(arena.allocate<char>(100) == before);
+        }
+
+        beginTest("Allocations bigger than a block");
+        {
+            ParseArena arena;
+            arena.allocate<char>(10);
+            char* big = arena.allocate<char>(ParseArena::blockSize * 2);
+            big[ParseArena::blockSize * 2 - 1] = 1;
+            char* after = arena.allocate<char>(10);
+
+            expect(after < big || after >= big + ParseArena::blockSize * 2);
+        }
+    }
+};
+
+//==============================================================================
+class GitTokenizerTests : public juce::UnitTest
+{
+public:
+    GitTokenizerTests() : juce::UnitTest("GitTokenizer", "SnapTrack") {}
+
+    void runTest() override
+    {
+        beginTest("Empty tokens in the middle, none after a trailing delimiter");
+        {
+            GitTokenizer tokens(std::string_view("a\0\0b\0", 5), '\0');
+            std::vector<std::string> found;
+            std::string_view token;
+
+            while (tokens.next(token))
+                found.emplace_back(token);
+
+            expectEquals((int) found.size(), 3);
+            expect(found[0] == "a" && found[1].empty() && found[2] == "b");
+        }
+
+        beginTest("No trailing delimiter, and nothing at all");
+        {
+            GitTokenizer tokens("one\ntwo", '\n');
+            std::string_view token;
+
+            expect(tokens.next(token) && token == "one");
+            expect(toString(tokens.getRemainder()) == "two");
+            expect(tokens.next(token) && token == "two");
+            expect(!tokens.next(token));
+
+            GitTokenizer empty({}, '\n');
+            expect(!empty.next(token));
+        }
+    }
+};
+
+//==============================================================================
+class GitParserTests : public juce::UnitTest
+{
+public:
+    GitParserTests() : juce::UnitTest("GitParser", "SnapTrack") {}
+
+    void runTest() override
+    {
+        testObjectHeaders();
+        testCommits();
+        testBatchStream();
+        testPackedRefs();
+        testConfig();
+        testDecimals();
+    }
+
+private:
+    void testObjectHeaders()
+    {
+        beginTest("cat-file --batch headers");
+        {
+            // Parsed records point into the text, so it has to outlive them
+            const std::string line = parentOids[0] + " commit 212";
+            GitParser::ObjectHeader header;
+            expect(GitParser::parseObjectHeader(line, header));
+            expect(header.oid == parentOids[0] && header.type == "commit" && header.size == 212 && !header.missing);
+        }
+
+        beginTest("missing and ambiguous names, which may contain spaces");
+        {
+            GitParser::ObjectHeader header;
+            expect(GitParser::parseObjectHeader("HEAD:Samples/Kick 01.wav missing", header));
+            expect(header.missing && header.oid == "HEAD:Samples/Kick 01.wav" && header.type.empty());
+
+            expect(GitParser::parseObjectHeader("abc12 ambiguous", header));
+            expect(header.missing && header.oid == "abc12");
+        }
+
+        beginTest("Malformed headers are refused");
+        {
+            GitParser::ObjectHeader header;
+            expect(!GitParser::parseObjectHeader("", header));
+            expect(!GitParser::parseObjectHeader(parentOids[0], header));
+            expect(!GitParser::parseObjectHeader("commit 12", header));
+            expect(!GitParser::parseObjectHeader(parentOids[0] + " commit 12x", header));
+            expect(!GitParser::parseObjectHeader(parentOids[0] + " commit -12", header));
+        }
+    }
+
+    void testCommits()
+    {
+        beginTest("A plain commit");
+        {
+            ParseArena arena;
+            GitParser::CommitInfo commit;
+            const std::string content = makeCommit(1, {}, "Mixed the drums\n\nLonger description\n");
+
+            expect(GitParser::parseCommit(content, arena, commit));
+            expect(commit.tree == treeOid);
+            expectEquals(commit.numParents, 1);
+            expect(commit.parents[0] == parentOids[0]);
+            expectEquals(commit.committerTime, (juce::int64) 1700000060);
+            expectEquals(toString(commit.subject), juce::String("Mixed the drums"));
+        }
+
+        beginTest("Root commits and octopus merges");
+        {
+            ParseArena arena;
+            GitParser::CommitInfo commit;
+            const std::string root = makeCommit(0, {}, "First\n");
+
+            expect(GitParser::parseCommit(root, arena, commit));
+            expectEquals(commit.numParents, 0);
+            expect(commit.parents == nullptr);
+
+            const std::string octopus = makeCommit(3, {}, "Merge three takes\n");
+            expect(GitParser::parseCommit(octopus, arena, commit));
+            expectEquals(commit.numParents, 3);
+
+            for (int i = 0; i < 3; ++i)
+                expect(commit.parents[i] == parentOids[i]);
+        }
+
+        beginTest("Signed commits: gpgsig continuation lines aren't headers");
+        {
+            // Git indents continuation lines by a space, blank ones included
+            const std::string signature = "gpgsig -----BEGIN PGP SIGNATURE-----\n"
+                                          " \n"
+                                          " committer Mallory <m@example.com> 1 +0000\n"
+                                          " parent " + parentOids[2] + "\n"
+                                          " -----END PGP SIGNATURE-----\n";
+            const std::string content = makeCommit(2, signature, "Signed\n");
+            ParseArena arena;
+            GitParser::CommitInfo commit;
+
+            expect(GitParser::parseCommit(content, arena, commit));
+            expectEquals(commit.numParents, 2);
+            expect(commit.parents[1] == parentOids[1]);
+            expectEquals(commit.committerTime, (juce::int64) 1700000060);
+            expectEquals(GitParser::toSubjectLine(commit.subject), juce::String("Signed"));
+        }
+
+        beginTest("Subjects: several lines, empty, or looking like git output");
+        {
+            ParseArena arena;
+            GitParser::CommitInfo commit;
+
+            const std::string twoLines = makeCommit(1, {}, "Bass line\nand the pad\n\nBody\n");
+            expect(GitParser::parseCommit(twoLines, arena, commit));
+            expectEquals(GitParser::toSubjectLine(commit.subject), juce::String("Bass line and the pad"));
+
+            const std::string hashLike = parentOids[1] + " commit 212";
+            const std::string hashLikeCommit = makeCommit(1, {}, hashLike + "\n");
+            expect(GitParser::parseCommit(hashLikeCommit, arena, commit));
+            expectEquals(toString(commit.subject).trim(), juce::String(hashLike));
+            expect(commit.parents[0] == parentOids[0]);
+
+            // No message at all
+            const std::string headersOnly = "tree " + treeOid + "\ncommitter Jo <jo@example.com> 5 +0000";
+            expect(GitParser::parseCommit(headersOnly, arena, commit));
+            expect(commit.subject.empty());
+            expectEquals(commit.committerTime, (juce::int64) 5);
+        }
+
+        beginTest("Names with '>' and objects that aren't commits");
+        {
+            ParseArena arena;
+            GitParser::CommitInfo commit;
+            const std::string odd = "tree " + treeOid + "\ncommitter Jo <j>o> <jo@example.com>   42 +0000\n\nx\n";
+
+            expect(GitParser::parseCommit(odd, arena, commit));
+            expectEquals(commit.committerTime, (juce::int64) 42);
+
+            expect(!GitParser::parseCommit("100644 blob " + treeOid + "\tKick.wav\n", arena, commit));
+            expect(!GitParser::parseCommit({}, arena, commit));
+        }
+    }
+
+    void testBatchStream()
+    {
+        beginTest("A batch stream is split by sizes, not by what the content looks like");
+        {
+            // The first commit's subject is a valid header line of its own
+            const std::string first = makeCommit(1, {}, parentOids[2] + " commit 9999\n");
+            const std::string second = makeCommit(0, {}, "Second\n");
+            const std::string stream = parentOids[1] + " commit " + std::to_string(first.size()) + "\n" + first + "\n"
+                                     + "deadbeef missing\n"
+                                     + parentOids[0] + " commit " + std::to_string(second.size()) + "\n" + second + "\n";
+
+            const std::string_view text(stream);
+            ParseArena arena;
+            std::vector<juce::String> subjects;
+            int numMissing = 0;
+
+            for (size_t at = 0; at < text.size();)
+            {
+                const size_t headerEnd = text.find('\n', at);
+                GitParser::ObjectHeader header;
+
+                const bool parsed = GitParser::parseObjectHeader(text.substr(at, headerEnd - at), header);
+                expect(parsed);
+
+                if (!parsed)
+                    break;
+
+                if (header.missing)
+                {
+                    ++numMissing;
+                    at = headerEnd + 1;
+                    continue;
+                }
+
+                GitParser::CommitInfo commit;
+                expect(GitParser::parseCommit(text.substr(headerEnd + 1, header.size), arena, commit));
+                subjects.push_back(GitParser::toSubjectLine(commit.subject));
+                at = headerEnd + 1 + header.size + 1;
+            }
+
+            expectEquals((int) subjects.size(), 2);
+            expectEquals(numMissing, 1);
+            expectEquals(subjects[0], juce::String(parentOids[2] + " commit 9999"));
+            expectEquals(subjects[1], juce::String("Second"));
+        }
+    }
+
+    void testPackedRefs()
+    {
+        beginTest("packed-refs: headers and peeled lines skipped, CRLF tolerated");
+        {
+            const std::string text = "# pack-refs with: peeled fully-peeled sorted \n"
+                                   + parentOids[0] + " refs/heads/main\n"
+                                   + parentOids[1] + " refs/tags/v1\n"
+                                   + "^" + parentOids[2] + "\n"
+                                   + parentOids[2] + " refs/heads/take-2\r\n"
+                                   + "\n"
+                                   + "garbage-without-a-name\n";
+            std::vector<GitParser::RefInfo> refs;
+            GitParser::parsePackedRefs(text, refs);
+
+            expectEquals((int) refs.size(), 3);
+            expect(refs[0].name == "refs/heads/main" && refs[0].oid == parentOids[0]);
+            expect(refs[1].name == "refs/tags/v1" && refs[1].oid == parentOids[1]);
+            expect(refs[2].name == "refs/heads/take-2" && refs[2].oid == parentOids[2]);
+        }
+    }
+
+    void testConfig()
+    {
+        beginTest("config -z: keys without values, values with newlines");
+        {
+            const std::string text("core.bare\nfalse\0snaptrack.chunkaudio\0user.name\nJo\nDoe\0core.editor\n\0", 67);
+            std::vector<GitParser::ConfigEntry> entries;
+            GitParser::parseConfig(text, entries);
+
+            expectEquals((int) entries.size(), 4);
+            expect(entries[0].key == "core.bare" && entries[0].value == "false");
+            expect(entries[1].key == "snaptrack.chunkaudio" && entries[1].value.empty());
+            expect(entries[2].key == "user.name" && entries[2].value == "Jo\nDoe");
+            expect(entries[3].key == "core.editor" && entries[3].value.empty());
+        }
+    }
+
+    void testDecimals()
+    {
+        beginTest("Decimals");
+        {
+            juce::int64 value = -1;
+            expect(GitParser::parseDecimal("0", value) && value == 0);
+            expect(GitParser::parseDecimal("1700000000", value) && value == 1700000000);
+            expect(GitParser::parseDecimal("999999999999999999", value) && value == 999999999999999999LL);
+
+            value = 7;
+            expect(!GitParser::parseDecimal("", value));
+            expect(!GitParser::parseDecimal("-1", value));
+            expect(!GitParser::parseDecimal("+1", value));
+            expect(!GitParser::parseDecimal("12 ", value));
+            expect(!GitParser::parseDecimal("1000000000000000000", value));
+            expectEquals(value, (juce::int64) 7);
+        }
+    }
+};
+
+static ParseArenaTests parseArenaTests;
+static GitTokenizerTests gitTokenizerTests;
+static GitParserTests gitParserTests;
@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    GraphBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "GraphBenchmark.h"
+#include "../../Source/CommitGraphLayout.h"
+#include "../../Source/CommitRowPainter.h"
+#include <cstdio>
+#include <set>
+#include <vector>
+
+namespace
+{
+    using Commit = GitRepositoryWorker::Commit;
+
+    // Newest first, like a history walk: a main line with feature branches of a few
+    // commits each forking off and merging back, several of them open at once
+    juce::Array<Commit> makeHistory(int numCommits)
+    {
+        juce::Random random(20240611);
+        std::vector<Commit> oldestFirst;
+        oldestFirst.reserve((size_t) numCommits);
+
+        juce::String mainTip;
+        juce::StringArray branchTips;
+
+        for (int i = 0; i < numCommits; ++i)
+        {
+            Commit commit;
+            commit.oid = juce::String::toHexString((juce::int64) i).paddedLeft('0', 40);
+            commit.subject = "Snapshot " + juce::String(i);
+            commit.committerTime = 1700000000 + i * 60;
+
+            const int choice = random.nextInt(10);
+
+            if (choice < 2 && branchTips.size() < 6 && mainTip.isNotEmpty())
+            {
+                commit.parents.add(mainTip);
+                branchTips.add(commit.oid);
+            }
+            else if (choice < 5 && branchTips.size() > 0)
+            {
+                const int branch = random.nextInt(branchTips.size());
+                commit.parents.add(branchTips[branch]);
+                branchTips.set(branch, commit.oid);
+            }
+            else if (choice < 6 && branchTips.size() > 0)
+            {
+                const int branch = random.nextInt(branchTips.size());
+                commit.parents.add(mainTip);
+                commit.parents.add(branchTips[branch]);
+                branchTips.remove(branch);
+                mainTip = commit.oid;
+            }
+            else
+            {
+                if (mainTip.isNotEmpty())
+                    commit.parents.add(mainTip);
+
+                mainTip = commit.oid;
+            }
+
+            oldestFirst.push_back(commit);
+        }
+
+        // Only what the main line reaches is in its history; open branches stay out of it
+        juce::Array<Commit> history;
+        std::set<juce::String> reachable { mainTip };
+
+        for (auto it = oldestFirst.rbegin(); it != oldestFirst.rend(); ++it)
+        {
+            if (reachable.count(it->oid) == 0)
+                continue;
+
+            for (const auto& parent : it->parents)
+                reachable.insert(parent);
+
+            history.add(*it);
+        }
+
+        return history;
+    }
+
+    double millisecondsSince(juce::int64 start)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0;
+    }
+}
+
+void runGraphBenchmark(int numCommits, int visibleRows)
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+
+    const juce::Array<Commit> history = makeHistory(numCommits);
+    std::printf("Commit graph, %d commits in HEAD's history, %d rows on screen\n", history.size(), visibleRows);
+
+    CommitGraphLayout layout;
+    auto start = juce::Time::getHighResolutionTicks();
+    layout.rebuild(history);
+    std::printf("  %-34s %10.3f ms   %d columns\n", "full layout", millisecondsSince(start), layout.getMaxColumns());
+
+    // A new snapshot on top of the tip: only its row is laid out
+    Commit snapshot;
+    snapshot.oid = juce::String("f").paddedLeft('f', 40);
+    snapshot.parents.add(history.getReference(0).oid);
+
+    juce::Array<Commit> newer;
+    newer.add(snapshot);
+
+    start = juce::Time::getHighResolutionTicks();
+    const bool fitted = layout.prepend(newer, history.getReference(0).oid);
+    std::printf("  %-34s %10.3f ms   %s\n", "new snapshot", millisecondsSince(start), fitted ? "fitted" : "rebuilt");
+
+    // Scroll through the whole list a screenful at a time, then back over the last stretch
+    const int rowHeight = 22, width = 600;
+    juce::Image screen(juce::Image::ARGB, width, rowHeight * visibleRows, true);
+    CommitRowPainter painter;
+
+    auto paintFrame = [&](int firstRow)
+    {
+        juce::Graphics g(screen);
+
+        for (int i = 0; i < visibleRows; ++i)
+        {
+            const int index = firstRow + i;
+
+            if (index >= layout.getNumRows())
+                break;
+
+            const juce::String oid = index == 0 ? snapshot.oid : history.getReference(index - 1).oid;
+
+            g.saveState();
+            g.setOrigin(0, i * rowHeight);
+            g.reduceClipRegion(0, 0, width, rowHeight);
+            painter.paint(g, oid, layout.getRow(index), layout.getMaxColumns(), "Snapshot", width, rowHeight, index == 3);
+            g.restoreState();
+        }
+    };
+
+    double coldWorst = 0.0, coldTotal = 0.0;
+    int coldFrames = 0;
+
+    for (int first = 0; first < layout.getNumRows(); first += visibleRows / 2, ++coldFrames)
+    {
+        start = juce::Time::getHighResolutionTicks();
+        paintFrame(first);
+        const double ms = millisecondsSince(start);
+        coldWorst = juce::jmax(coldWorst, ms);
+        coldTotal += ms;
+    }
+
+    double warmWorst = 0.0, warmTotal = 0.0;
+    int warmFrames = 0;
+    const int lastFirst = juce::jmax(0, layout.getNumRows() - visibleRows);
+
+    for (int first = lastFirst; first >= juce::jmax(0, lastFirst - CommitRowPainter::maxCachedRows + visibleRows); --first, ++warmFrames)
+    {
+        start = juce::Time::getHighResolutionTicks();
+        paintFrame(first);
+        const double ms = millisecondsSince(start);
+        warmWorst = juce::jmax(warmWorst, ms);
+        warmTotal += ms;
+    }
+
+    std::printf("  %-34s mean %8.3f ms   worst %8.3f ms   (%d frames)\n", "frame, rows painted",
+                coldTotal / juce::jmax(1, coldFrames), coldWorst, coldFrames);
+    std::printf("  %-34s mean %8.3f ms   worst %8.3f ms   (%d frames)\n", "frame, rows from cache",
+                warmTotal / juce::jmax(1, warmFrames), warmWorst, warmFrames);
+    std::printf("  %-34s %lld rendered, %lld from cache\n", "row images",
+                (long long) painter.getStatistics().numRendered, (long long) painter.getStatistics().numHits);
+}
@@ -0,0 +1,15 @@
+/*
+  ==============================================================================
+
+    GraphBenchmark.h
+    Lane layout and row painting of the commit graph over a synthetic
+    history, against the 16 ms a frame has at 60 fps.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+void runGraphBenchmark(int numCommits, int visibleRows);
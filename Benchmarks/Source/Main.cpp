@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    Command line benchmarks for SnapTrack's repository code.
+
+    Usage: SnapTrackBenchmarks [--iterations N] [--repo PATH]
+           SnapTrackBenchmarks --project-files [--snapshots N] [--work-dir PATH]
+           SnapTrackBenchmarks --repository [--files N] [--file-size BYTES] [--history N]
+                               [--branches N] [--changed N] [--iterations N]
+                               [--work-dir PATH] [--output FILE]
+           SnapTrackBenchmarks --graph [--commits N] [--rows N]
+           SnapTrackBenchmarks --overview [--seconds N]
+           SnapTrackBenchmarks --parse [--commits N]
+           SnapTrackBenchmarks --test [--category NAME]
+
+    --repository prints its results as JSON (to stdout, or to --output).
+    --test runs the unit tests (category "SnapTrack" unless given) and exits
+    with 1 if any of them failed, as does --parse if the parsers disagree.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "SpawnBenchmark.h"
+#include "ProjectFileBenchmark.h"
+#include "RepositoryBenchmark.h"
+#include "GraphBenchmark.h"
+#include "OverviewBenchmark.h"
+#include "ParseBenchmark.h"
+#include <cstdio>
+
+//==============================================================================
+static int getIntOption (const juce::ArgumentList& args, const juce::String& option, int defaultValue)
+{
+    return args.containsOption (option) ? args.getValueForOption (option).getIntValue() : defaultValue;
+}
+
+static juce::File getWorkDirectory (const juce::ArgumentList& args)
+{
+    return args.containsOption ("--work-dir") ? juce::File (args.getValueForOption ("--work-dir"))
+                                              : juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile ("SnapTrackBenchmarks");
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--project-files"))
+    {
+        const juce::File workDirectory = getWorkDirectory (args);
+        workDirectory.createDirectory();
+        runProjectFileBenchmark (juce::jmax (1, getIntOption (args, "--snapshots", 1000)), workDirectory);
+        return 0;
+    }
+
+    if (args.containsOption ("--graph"))
+    {
+        runGraphBenchmark (juce::jmax (1, getIntOption (args, "--commits", 100000)),
+                           juce::jmax (1, getIntOption (args, "--rows", 40)));
+        return 0;
+    }
+
+    if (args.containsOption ("--overview"))
+    {
+        runOverviewBenchmark (juce::jmax (1, getIntOption (args, "--seconds", 300)));
+        return 0;
+    }
+
+    if (args.containsOption ("--parse"))
+        return runParseBenchmark (juce::jmax (1, getIntOption (args, "--commits", 100000))) ? 0 : 1;
+
+    if (args.containsOption ("--test"))
+    {
+        juce::UnitTestRunner runner;
+        runner.setAssertOnFailure (false);
+        runner.runTestsInCategory (args.containsOption ("--category") ? args.getValueForOption ("--category") : juce::String ("SnapTrack"));
+
+        int numFailures = 0;
+        for (int i = 0; i < runner.getNumResults(); ++i)
+            numFailures += runner.getResult (i)->failures;
+
+        return numFailures > 0 || runner.getNumResults() == 0 ? 1 : 0;
+    }
+
+    if (args.containsOption ("--repository"))
+    {
+        RepositoryBenchmarkSettings settings;
+        settings.numFiles = juce::jmax (2, getIntOption (args, "--files", settings.numFiles));
+        settings.fileSize = juce::jmax (1, getIntOption (args, "--file-size", settings.fileSize));
+        settings.historyDepth = juce::jmax (1, getIntOption (args, "--history", settings.historyDepth));
+        settings.numBranches = juce::jmax (0, getIntOption (args, "--branches", settings.numBranches));
+        settings.changedFilesPerSnapshot = juce::jmax (1, getIntOption (args, "--changed", settings.changedFilesPerSnapshot));
+        settings.iterations = juce::jmax (1, getIntOption (args, "--iterations", settings.iterations));
+
+        const juce::File workDirectory = getWorkDirectory (args);
+        workDirectory.createDirectory();
+
+        const juce::String json = juce::JSON::toString (runRepositoryBenchmark (settings, workDirectory));
+
+        if (args.containsOption ("--output"))
+            juce::File (args.getValueForOption ("--output")).replaceWithText (json + "\n");
+        else
+            std::printf ("%s\n", json.toRawUTF8());
+
+        return 0;
+    }
+
+    const int iterations = getIntOption (args, "--iterations", 50);
+    const juce::File repository = args.containsOption ("--repo") ? args.getExistingFolderForOption ("--repo")
+                                                                 : juce::File::getCurrentWorkingDirectory();
+
+    runSpawnBenchmark (juce::jmax (1, iterations), repository);
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+  ==============================================================================
+
+    OverviewBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "OverviewBenchmark.h"
+#include "../../Source/AudioOverview.h"
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numChannels = 2;
+
+    double millisecondsSince(juce::int64 start)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0;
+    }
+
+    // A decaying tone every half second over a little noise, so buckets differ
+    juce::AudioBuffer<float> makeRecording(int seconds)
+    {
+        juce::AudioBuffer<float> buffer(numChannels, (int) (sampleRate * seconds));
+        juce::Random random(20240612);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* samples = buffer.getWritePointer(channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                const double t = (double) (i % 24000) / sampleRate;
+                samples[i] = (float) (0.6 * std::exp(-t * 6.0) * std::sin(2.0 * juce::MathConstants<double>::pi * 110.0 * (channel + 1) * t))
+                           + (random.nextFloat() - 0.5f) * 0.01f;
+            }
+        }
+
+        return buffer;
+    }
+
+    juce::MemoryBlock writeWav(const juce::AudioBuffer<float>& buffer, int bitsPerSample, const juce::StringPairArray& metadata)
+    {
+        juce::MemoryBlock data;
+        juce::WavAudioFormat wav;
+
+        {
+            std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(new juce::MemoryOutputStream(data, false), sampleRate,
+                                                                                (unsigned int) numChannels, bitsPerSample, metadata, 0));
+            if (writer != nullptr)
+                writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+        }
+
+        return data;
+    }
+
+    bool analyseWav(const juce::MemoryBlock& data, AudioOverview& overview)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(new juce::MemoryInputStream(data, false), true));
+        return reader != nullptr && AudioOverview::analyse(*reader, overview, nullptr);
+    }
+}
+
+void runOverviewBenchmark(int seconds)
+{
+    const juce::AudioBuffer<float> recording = makeRecording(seconds);
+    const int numSamples = recording.getNumSamples();
+    std::printf("Audio overviews, %d s of %d-channel audio at %.0f Hz\n", seconds, numChannels, sampleRate);
+
+    // The kernel alone, over buckets of the size a file this long gets
+    const int bucketSize = (int) juce::jmax((juce::int64) AudioOverview::minSamplesPerBucket,
+                                            ((juce::int64) numSamples + AudioOverview::maxBuckets - 1) / AudioOverview::maxBuckets);
+    double checksum = 0.0;
+
+    auto start = juce::Time::getHighResolutionTicks();
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int at = 0; at < numSamples; at += bucketSize)
+        {
+            float low = std::numeric_limits<float>::max(), high = std::numeric_limits<float>::lowest();
+            double sum = 0.0;
+            AudioOverview::analyseBlock(recording.getReadPointer(channel, at), juce::jmin(bucketSize, numSamples - at), low, high, sum);
+            checksum += sum + high - low;
+        }
+    }
+
+    const double kernelMs = millisecondsSince(start);
+    start = juce::Time::getHighResolutionTicks();
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* samples = recording.getReadPointer(channel);
+
+        for (int at = 0; at < numSamples; at += bucketSize)
+        {
+            float low = std::numeric_limits<float>::max(), high = std::numeric_limits<float>::lowest();
+            double sum = 0.0;
+
+            for (int i = at; i < juce::jmin(at + bucketSize, numSamples); ++i)
+            {
+                low = juce::jmin(low, samples[i]);
+                high = juce::jmax(high, samples[i]);
+                sum += (double) samples[i] * (double) samples[i];
+            }
+
+            checksum -= sum + high - low;
+        }
+    }
+
+    const double scalarMs = millisecondsSince(start);
+    const double megasamples = (double) numSamples * numChannels / 1.0e6;
+    std::printf("  %-34s %10.3f ms   %8.1f Msamples/s\n", "peak/RMS kernel", kernelMs, megasamples / (kernelMs / 1000.0));
+    std::printf("  %-34s %10.3f ms   %8.1f Msamples/s   (difference %.3g)\n", "scalar reference", scalarMs,
+                megasamples / (scalarMs / 1000.0), checksum);
+
+    // Decoding included, and the cost of the same audio written out again
+    juce::StringPairArray firstBounce, secondBounce;
+    firstBounce.set(juce::WavAudioFormat::bwavOriginationDate, "2024-06-12");
+    secondBounce.set(juce::WavAudioFormat::bwavOriginationDate, "2024-06-13");
+
+    const juce::MemoryBlock first = writeWav(recording, 24, firstBounce);
+    const juce::MemoryBlock second = writeWav(recording, 24, secondBounce);
+    const juce::MemoryBlock sixteenBit = writeWav(recording, 16, firstBounce);
+
+    AudioOverview a, b, c;
+    start = juce::Time::getHighResolutionTicks();
+    const bool ok = analyseWav(first, a);
+    const double analyseMs = millisecondsSince(start);
+
+    analyseWav(second, b);
+    analyseWav(sixteenBit, c);
+
+    std::printf("  %-34s %10.3f ms   %d buckets   %s\n", "decode and analyse", analyseMs, a.getNumBuckets(), ok ? "" : "FAILED");
+    std::printf("  %-34s %s, %s\n", "bounced again (new bytes)", first == second ? "same bytes" : "different bytes",
+                a.soundsLike(b) ? "same render" : "DIFFERENT render");
+    std::printf("  %-34s %s\n", "bounced at 16 bits", a.soundsLike(c) ? "same render" : "DIFFERENT render");
+
+    juce::MemoryOutputStream out;
+    a.writeTo(out);
+    juce::MemoryInputStream in(out.getData(), out.getDataSize(), false);
+
+    start = juce::Time::getHighResolutionTicks();
+    AudioOverview cached;
+    const bool read = cached.readFrom(in);
+    std::printf("  %-34s %10.3f ms   %d bytes   %s\n", "from the cache file", millisecondsSince(start), (int) out.getDataSize(),
+                read && cached.fingerprint == a.fingerprint ? "" : "MISMATCH");
+}
@@ -0,0 +1,15 @@
+/*
+  ==============================================================================
+
+    OverviewBenchmark.h
+    Waveform overviews of a synthetic recording: the peak/RMS kernel against
+    plain scalar code, a whole analysis, and the same file bounced again.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+void runOverviewBenchmark(int seconds);
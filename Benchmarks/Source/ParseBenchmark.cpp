@@ -0,0 +1,208 @@
+/*
+  ==============================================================================
+
+    ParseBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "ParseBenchmark.h"
+#include "../../Source/GitParser.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double millisecondsSince(juce::int64 start)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0;
+    }
+
+    std::string makeOid(juce::Random& random)
+    {
+        static const char* digits = "0123456789abcdef";
+        std::string oid(40, '0');
+
+        for (auto& c : oid)
+            c = digits[random.nextInt(16)];
+
+        return oid;
+    }
+
+    // What "git cat-file --batch" prints for numCommits commits: a merge every tenth one, and
+    // subjects that look like the output they're embedded in
+    std::string makeBatchOutput(int numCommits)
+    {
+        juce::Random random(20240613);
+        std::string output;
+        std::string previous = makeOid(random);
+
+        for (int i = 0; i < numCommits; ++i)
+        {
+            std::string content = "tree " + makeOid(random) + "\nparent " + previous + "\n";
+
+            if (i % 10 == 0)
+                content += "parent " + makeOid(random) + "\n";
+
+            content += "author SnapTrack <snaptrack@example.com> " + std::to_string(1700000000 + i * 60) + " +0100\n";
+            content += "committer SnapTrack <snaptrack@example.com> " + std::to_string(1700000000 + i * 60) + " +0100\n\n";
+            content += i % 7 == 0 ? makeOid(random) + " commit 212\n\nMixed the drums again\n"
+                                  : "Snapshot " + std::to_string(i) + "\n";
+
+            const std::string oid = makeOid(random);
+            output += oid + " commit " + std::to_string(content.size()) + "\n" + content + "\n";
+            previous = oid;
+        }
+
+        return output;
+    }
+
+    std::string makePackedRefs(int numRefs)
+    {
+        juce::Random random(20240614);
+        std::string text = "# pack-refs with: peeled fully-peeled sorted \n";
+
+        for (int i = 0; i < numRefs; ++i)
+            text += makeOid(random) + " refs/heads/take-" + std::to_string(i) + "\n";
+
+        return text;
+    }
+
+    // The way history used to be read: every header split into a StringArray, every line copied
+    juce::int64 parseWithStrings(const std::string& output)
+    {
+        juce::int64 checksum = 0;
+
+        for (size_t at = 0; at < output.size();)
+        {
+            const size_t headerEnd = output.find('\n', at);
+            const juce::StringArray fields = juce::StringArray::fromTokens(juce::String(output.substr(at, headerEnd - at)), " ", "");
+            const size_t size = (size_t) fields[2].getLargeIntValue();
+            const std::string content = output.substr(headerEnd + 1, size);
+            at = headerEnd + 1 + size + 1;
+
+            juce::StringArray parents;
+            juce::int64 committerTime = 0;
+            const size_t messageStart = content.find("\n\n");
+
+            for (size_t lineStart = 0; lineStart < messageStart;)
+            {
+                const size_t lineEnd = juce::jmin(content.find('\n', lineStart), messageStart);
+                const std::string line = content.substr(lineStart, lineEnd - lineStart);
+
+                if (line.compare(0, 7, "parent ") == 0)
+                    parents.add(juce::String(line.substr(7)));
+                else if (line.compare(0, 10, "committer ") == 0)
+                    committerTime = juce::String(line.substr(line.rfind('>') + 1)).trim().getLargeIntValue();
+
+                lineStart = lineEnd + 1;
+            }
+
+            const size_t paragraphEnd = content.find("\n\n", messageStart + 2);
+            const juce::String subject = juce::String::fromUTF8(content.data() + messageStart + 2,
+                                                                (int) ((paragraphEnd == std::string::npos ? content.size() : paragraphEnd) - messageStart - 2));
+            checksum += committerTime + parents.size() + subject.trim().length() + fields[0].length();
+        }
+
+        return checksum;
+    }
+
+    juce::int64 parseWithViews(const std::string& output, ParseArena& arena, bool makeStrings)
+    {
+        juce::int64 checksum = 0;
+        const std::string_view text(output);
+        arena.reset();
+
+        for (size_t at = 0; at < text.size();)
+        {
+            const size_t headerEnd = text.find('\n', at);
+            GitParser::ObjectHeader header;
+
+            if (!GitParser::parseObjectHeader(text.substr(at, headerEnd - at), header))
+                break;
+
+            GitParser::CommitInfo commit;
+            GitParser::parseCommit(text.substr(headerEnd + 1, header.size), arena, commit);
+            at = headerEnd + 1 + header.size + 1;
+
+            // What GitRepositoryWorker keeps of it, or nothing for the bare parse
+            if (makeStrings)
+            {
+                juce::StringArray parents;
+                for (int i = 0; i < commit.numParents; ++i)
+                    parents.add(GitParser::toString(commit.parents[i]));
+
+                checksum += GitParser::toSubjectLine(commit.subject).length() + GitParser::toString(header.oid).length() + parents.size();
+            }
+            else
+            {
+                checksum += (juce::int64) commit.subject.size() + (juce::int64) header.oid.size() + commit.numParents;
+            }
+
+            checksum += commit.committerTime;
+        }
+
+        return checksum;
+    }
+
+    void report(const char* name, double ms, size_t numBytes, int numRecords)
+    {
+        std::printf("  %-34s %10.3f ms   %8.1f MB/s   %8.3f us per record\n", name, ms,
+                    (double) numBytes / (1024.0 * 1024.0) / juce::jmax(1.0e-9, ms / 1000.0), ms * 1000.0 / juce::jmax(1, numRecords));
+    }
+}
+
+bool runParseBenchmark(int numCommits)
+{
+    const std::string output = makeBatchOutput(numCommits);
+    std::printf("Git output parsing, %d commits (%.1f MB of cat-file --batch output)\n", numCommits,
+                (double) output.size() / (1024.0 * 1024.0));
+
+    auto start = juce::Time::getHighResolutionTicks();
+    const juce::int64 legacy = parseWithStrings(output);
+    report("juce::String splitting", millisecondsSince(start), output.size(), numCommits);
+
+    ParseArena arena;
+
+    // The second run reuses the arena's blocks, as every refresh after the first does
+    for (int run = 0; run < 2; ++run)
+    {
+        start = juce::Time::getHighResolutionTicks();
+        parseWithViews(output, arena, false);
+        report(run == 0 ? "GitParser, views, cold arena" : "GitParser, views, warm arena", millisecondsSince(start), output.size(), numCommits);
+    }
+
+    start = juce::Time::getHighResolutionTicks();
+    const juce::int64 typed = parseWithViews(output, arena, true);
+    report("GitParser, then Commit strings", millisecondsSince(start), output.size(), numCommits);
+
+    std::printf("  %-34s %10.1f KB   %s\n", "arena in use", (double) arena.getNumBytesUsed() / 1024.0,
+                legacy == typed ? "results match" : "RESULTS DIFFER");
+
+    const int numRefs = juce::jmax(1, numCommits / 10);
+    const std::string packedRefs = makePackedRefs(numRefs);
+    std::vector<GitParser::RefInfo> refs;
+
+    start = juce::Time::getHighResolutionTicks();
+    juce::StringArray lines;
+    lines.addLines(juce::String(packedRefs));
+    std::map<juce::String, juce::String> byName;
+    for (const auto& line : lines)
+        if (line.isNotEmpty() && !line.startsWithChar('#'))
+            byName[line.fromFirstOccurrenceOf(" ", false, false).trim()] = line.upToFirstOccurrenceOf(" ", false, false);
+    report("packed-refs, juce::String lines", millisecondsSince(start), packedRefs.size(), numRefs);
+
+    start = juce::Time::getHighResolutionTicks();
+    GitParser::parsePackedRefs(packedRefs, refs);
+    report("packed-refs, GitParser", millisecondsSince(start), packedRefs.size(), numRefs);
+
+    if ((int) refs.size() != numRefs || (int) byName.size() != numRefs)
+    {
+        std::printf("  packed-refs: expected %d refs, got %d and %d\n", numRefs, (int) refs.size(), (int) byName.size());
+        return false;
+    }
+
+    return legacy == typed;
+}
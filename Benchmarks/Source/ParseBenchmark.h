@@ -0,0 +1,17 @@
+/*
+  ==============================================================================
+
+    ParseBenchmark.h
+    Parsing a history's worth of cat-file --batch output and a large
+    packed-refs file: GitParser against the juce::String splitting it
+    replaced.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// False if the two parsers don't agree
+bool runParseBenchmark(int numCommits);
@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+    ProjectFileBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "ProjectFileBenchmark.h"
+#include "../../Source/ProcessRunner.h"
+#include "../../Source/ProjectFileStore.h"
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    constexpr int numTracks = 40;
+    constexpr int clipsPerTrack = 30;
+    constexpr int paramsPerClip = 8;
+
+    // Roughly the shape of a Live set: tracks of clips, each with a handful of values,
+    // CRLF line endings, tab indents. One snapshot changes one value, like a small edit.
+    struct SyntheticSet
+    {
+        SyntheticSet() : random(1)
+        {
+            values.resize((size_t) (numTracks * clipsPerTrack * paramsPerClip));
+            for (auto& value : values)
+                value = random.nextFloat();
+        }
+
+        void edit()
+        {
+            values[(size_t) random.nextInt((int) values.size())] = random.nextFloat();
+        }
+
+        juce::String toXml() const
+        {
+            juce::String xml;
+            xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n<Ableton MajorVersion=\"5\" Creator=\"Ableton Live 11.3\">\r\n\t<LiveSet>\r\n";
+
+            for (int t = 0; t < numTracks; ++t)
+            {
+                xml << "\t\t<AudioTrack Id=\"" << t << "\">\r\n\t\t\t<Name><EffectiveName Value=\"Track " << t << "\" /></Name>\r\n";
+
+                for (int c = 0; c < clipsPerTrack; ++c)
+                {
+                    xml << "\t\t\t<AudioClip Id=\"" << c << "\" Time=\"" << c * 4 << "\">\r\n";
+
+                    for (int p = 0; p < paramsPerClip; ++p)
+                        xml << "\t\t\t\t<Param" << p << " Value=\""
+                            << juce::String(values[(size_t) ((t * clipsPerTrack + c) * paramsPerClip + p)], 6) << "\" />\r\n";
+
+                    xml << "\t\t\t\t<WarpMarkers>";
+                    for (int m = 0; m < 6; ++m)
+                        xml << "<WarpMarker Id=\"" << m << "\" SecTime=\"" << m * 0.5 << "\" BeatTime=\"" << m << "\" />";
+                    xml << "</WarpMarkers>\r\n\t\t\t</AudioClip>\r\n";
+                }
+
+                xml << "\t\t</AudioTrack>\r\n";
+            }
+
+            xml << "\t</LiveSet>\r\n</Ableton>\r\n";
+            return xml;
+        }
+
+        juce::Random random;
+        std::vector<float> values;
+    };
+
+    bool writeGzipped(const juce::String& text, const juce::File& file)
+    {
+        file.deleteFile();
+        juce::FileOutputStream out(file);
+        if (!out.openedOk())
+            return false;
+
+        juce::GZIPCompressorOutputStream gzip(out, 6, juce::GZIPCompressorOutputStream::windowBitsGZip);
+        return gzip.writeText(text, false, false, nullptr);
+    }
+
+    bool git(const juce::File& repository, std::vector<std::string> arguments)
+    {
+        arguments.insert(arguments.begin(), { "git", "-C", repository.getFullPathName().toStdString() });
+        return ProcessRunner::run(arguments).succeeded();
+    }
+
+    juce::int64 directorySize(const juce::File& directory)
+    {
+        juce::int64 total = 0;
+        for (const auto& entry : juce::RangedDirectoryIterator(directory, true, "*", juce::File::findFiles))
+            total += entry.getFileSize();
+        return total;
+    }
+
+    double secondsSince(juce::int64 startTicks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    }
+
+    void runCase(const char* name, bool canonical, int snapshots, const juce::File& workDirectory)
+    {
+        const juce::File repository = workDirectory.getChildFile(name);
+        repository.deleteRecursively();
+        repository.createDirectory();
+
+        git(repository, { "init", "-q" });
+        git(repository, { "config", "user.name", "SnapTrack benchmark" });
+        git(repository, { "config", "user.email", "benchmark@snaptrack.invalid" });
+        git(repository, { "config", "gc.auto", "0" });
+
+        const juce::File projectFile = repository.getChildFile("Song.als");
+        const juce::File shadowFile = repository.getChildFile(ProjectFileStore::shadowDirectoryName).getChildFile("Song.als.xml");
+        const std::string stagedPath = canonical ? std::string(ProjectFileStore::shadowDirectoryName) : "Song.als";
+
+        SyntheticSet set;
+        juce::int64 xmlSize = 0;
+        const juce::int64 snapshotStart = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < snapshots; ++i)
+        {
+            set.edit();
+            const juce::String xml = set.toXml();
+            xmlSize = (juce::int64) xml.getNumBytesAsUTF8();
+
+            writeGzipped(xml, projectFile);
+
+            if (canonical)
+                ProjectFileStore::decompressToCanonical(projectFile, shadowFile, nullptr);
+
+            git(repository, { "add", "--", stagedPath });
+            git(repository, { "commit", "-q", "-m", "Snapshot " + std::to_string(i) });
+        }
+
+        const double snapshotSeconds = secondsSince(snapshotStart);
+        const juce::File objects = repository.getChildFile(".git").getChildFile("objects");
+        const juce::int64 looseSize = directorySize(objects);
+
+        const juce::int64 repackStart = juce::Time::getHighResolutionTicks();
+        git(repository, { "repack", "-a", "-d", "-f", "-q" });
+        const double repackSeconds = secondsSince(repackStart);
+
+        std::printf("  %-22s %6.1f s to snapshot   loose %8.1f MB   repack %6.2f s   packed %8.2f MB\n",
+                    name, snapshotSeconds, (double) looseSize / 1.0e6, repackSeconds,
+                    (double) directorySize(objects) / 1.0e6);
+        std::printf("  %-22s (%lld bytes of XML per snapshot)\n", "", (long long) xmlSize);
+    }
+}
+
+void runProjectFileBenchmark(int snapshots, const juce::File& workDirectory)
+{
+    std::printf("Project file storage, %d snapshots of a synthetic Live set\n", snapshots);
+
+    runCase("gzipped-als", false, snapshots, workDirectory);
+    runCase("decompressed-shadow", true, snapshots, workDirectory);
+}
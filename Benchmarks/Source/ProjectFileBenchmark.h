@@ -0,0 +1,15 @@
+/*
+  ==============================================================================
+
+    ProjectFileBenchmark.h
+    Repository growth and repack time with .als files stored gzipped, as the
+    DAW writes them, against ProjectFileStore's decompressed shadows.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+void runProjectFileBenchmark(int snapshots, const juce::File& workDirectory);
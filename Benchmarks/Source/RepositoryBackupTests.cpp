@@ -0,0 +1,260 @@
+/*
+  ==============================================================================
+
+    RepositoryBackupTests.cpp
+    RepositoryBackup against a real repository and a bare mirror next to
+    it: a first pass, a push and a chunk copy that are interrupted and
+    picked up again, and branches deleted from the project.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/RepositoryBackup.h"
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    ProcessResult runGitIn(const juce::File& directory, const juce::StringArray& arguments,
+                           const std::atomic<bool>* cancelFlag = nullptr, int timeoutMs = -1)
+    {
+        std::vector<std::string> argv { "git" };
+
+        for (const auto& argument : arguments)
+            argv.push_back(argument.toStdString());
+
+        ProcessRunner::Options options;
+        options.workingDirectory = directory.getFullPathName().toStdString();
+        options.cancelFlag = cancelFlag;
+        options.timeoutMs = timeoutMs;
+        return ProcessRunner::run(argv, options);
+    }
+
+    // Bytes no two chunks share, so a copy from the wrong place shows
+    void writeChunk(const juce::File& file, int size, juce::int64 seed)
+    {
+        juce::MemoryBlock data((size_t) size);
+        juce::Random random(seed);
+
+        for (size_t i = 0; i < data.getSize(); ++i)
+            data[i] = (char) random.nextInt(256);
+
+        file.getParentDirectory().createDirectory();
+        file.replaceWithData(data.getData(), data.getSize());
+    }
+}
+
+//==============================================================================
+class RepositoryBackupTests : public juce::UnitTest
+{
+public:
+    RepositoryBackupTests() : juce::UnitTest("RepositoryBackup", "SnapTrack") {}
+
+    void runTest() override
+    {
+        const juce::File root = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                    .getNonexistentChildFile("SnapTrackBackupTests", {}, false);
+        project = root.getChildFile("project");
+        mirror = root.getChildFile("mirror.git");
+
+        beginTest("Creating the project");
+        {
+            project.createDirectory();
+            expect(git({ "init", "--quiet" }));
+            expect(git({ "symbolic-ref", "HEAD", "refs/heads/master" }));
+
+            for (int i = 0; i < 3; ++i)
+                expect(commit());
+        }
+
+        runBackupTests();
+        root.deleteRecursively();
+    }
+
+private:
+    void runBackupTests()
+    {
+        auto worker = std::make_shared<GitRepositoryWorker>(project);
+        const juce::File chunks = worker->getCommonDirectory().getChildFile("snaptrack").getChildFile("chunks");
+        const juce::File mirrorChunks = mirror.getChildFile("snaptrack").getChildFile("chunks");
+        const int chunkSize = RepositoryBackup::copyBlockSize * 5 / 2;
+
+        HostTransportState transport;
+        RepositoryBackup backup(transport, [worker] { return worker; },
+                                [this](const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)
+                                {
+                                    // A push that fails here is one whose connection dropped
+                                    if (arguments[0] == "push" && pushesBeforeFailure >= 0 && pushesBeforeFailure-- == 0)
+                                    {
+                                        ProcessResult dropped;
+                                        dropped.launched = true;
+                                        dropped.exitCode = 128;
+                                        return dropped;
+                                    }
+
+                                    return runGitIn(project, arguments, cancelFlag, timeoutMs);
+                                });
+
+        RepositoryBackup::Settings settings;
+        settings.mirror = mirror;
+        settings.maxBytesPerSecond = 0;
+        settings.commitsPerStep = 2;
+        backup.setSettings(settings);
+
+        beginTest("A first pass creates the mirror with the branches and chunks");
+        {
+            writeChunk(chunks.getChildFile("3f").getChildFile("9a11"), chunkSize, 1);
+
+            expect(backup.backUpNow());
+            expect(mirror.getChildFile("HEAD").existsAsFile());
+            expectEquals(mirrorRef("refs/heads/master"), localRef("refs/heads/master"));
+            expectEquals(listMirrorRefs("refs/snaptrack-backup"), juce::String());
+            expect(mirrorChunks.getChildFile("3f").getChildFile("9a11").hasIdenticalContentTo(chunks.getChildFile("3f").getChildFile("9a11")));
+
+            // Three commits: one step of two, and the last push with the branch
+            const RepositoryBackup::Status status = backup.getStatus();
+            expectEquals(status.stepsTotal, 2);
+            expectEquals(status.stepsDone, 2);
+            expect(status.error.isEmpty());
+            expect(status.lastBackupTime > 0);
+        }
+
+        beginTest("An interrupted push leaves a progress ref the next pass carries on from");
+        {
+            const juce::String backedUp = localRef("refs/heads/master");
+
+            for (int i = 0; i < 7; ++i)
+                expect(commit());
+
+            juce::StringArray newCommits;
+            newCommits.addTokens(juce::String(runGitIn(project, { "rev-list", "--reverse", "--first-parent", "master", "^" + backedUp }).output), "\n", "");
+            newCommits.removeEmptyStrings();
+            expectEquals(newCommits.size(), 7);
+
+            // Seven commits go in steps of two ending at the 2nd, 4th and 6th, then the last push:
+            // the third push fails, after the steps to the 2nd and 4th went through
+            pushesBeforeFailure = 2;
+            expect(!backup.backUpNow());
+
+            RepositoryBackup::Status status = backup.getStatus();
+            expectEquals(status.stepsTotal, 4);
+            expectEquals(status.stepsDone, 2);
+            expect(status.error.isNotEmpty());
+            expectEquals(mirrorRef("refs/snaptrack-backup/heads/master"), newCommits[3]);
+            expectEquals(mirrorRef("refs/heads/master"), backedUp);
+
+            // Only the three commits past the progress ref are left: one step and the last push
+            pushesBeforeFailure = -1;
+            expect(backup.backUpNow());
+
+            status = backup.getStatus();
+            expectEquals(status.stepsTotal, 2);
+            expectEquals(status.stepsDone, 2);
+            expect(status.error.isEmpty());
+            expectEquals(mirrorRef("refs/heads/master"), localRef("refs/heads/master"));
+            expectEquals(listMirrorRefs("refs/snaptrack-backup"), juce::String());
+        }
+
+        beginTest("An interrupted chunk copy is kept as .partial and finished by the next pass");
+        {
+            const juce::File chunk = chunks.getChildFile("c4").getChildFile("07e2");
+            const juce::File copy = mirrorChunks.getChildFile("c4").getChildFile("07e2");
+            const juce::File partial = copy.getSiblingFile(copy.getFileName() + ".partial");
+            writeChunk(chunk, chunkSize, 2);
+
+            // A block a second: the copy waits after its first block, and is cancelled then
+            settings.maxBytesPerSecond = RepositoryBackup::copyBlockSize;
+            backup.setSettings(settings);
+
+            std::thread canceller([&backup, &partial]
+            {
+                for (int i = 0; i < 1000 && !partial.existsAsFile(); ++i)
+                    juce::Thread::sleep(10);
+
+                backup.cancel();
+            });
+
+            const bool finished = backup.backUpNow();
+            canceller.join();
+
+            expect(!finished);
+            expectEquals(backup.getStatus().error, juce::String("stopped, carries on next time"));
+            expect(!copy.exists());
+            expect(partial.existsAsFile());
+            expect(partial.getSize() > 0 && partial.getSize() < chunk.getSize());
+
+            // Mark what was copied: if the next pass starts over, the mark is gone
+            juce::MemoryBlock copied;
+            expect(partial.loadFileAsData(copied));
+            copied[0] = (char) ~copied[0];
+            partial.replaceWithData(copied.getData(), copied.getSize());
+
+            settings.maxBytesPerSecond = 0;
+            backup.setSettings(settings);
+            expect(backup.backUpNow());
+
+            juce::MemoryBlock original, backedUp;
+            expect(chunk.loadFileAsData(original));
+            expect(copy.loadFileAsData(backedUp));
+            expect(!partial.exists());
+            expectEquals((int) backedUp.getSize(), (int) original.getSize());
+            expect(backedUp[0] == copied[0]);
+            expect(backedUp.getSize() == original.getSize()
+                   && memcmp(backedUp.begin() + 1, original.begin() + 1, original.getSize() - 1) == 0);
+        }
+
+        beginTest("Branches deleted from the project stay in the mirror");
+        {
+            expect(git({ "branch", "take2" }));
+            expect(backup.backUpNow());
+            const juce::String take2 = mirrorRef("refs/heads/take2");
+            expectEquals(take2, localRef("refs/heads/take2"));
+
+            expect(git({ "branch", "-D", "take2" }));
+            expect(commit());
+            expect(backup.backUpNow());
+
+            expectEquals(mirrorRef("refs/heads/take2"), take2);
+            expectEquals(mirrorRef("refs/heads/master"), localRef("refs/heads/master"));
+        }
+    }
+
+    bool git(const juce::StringArray& arguments)
+    {
+        return runGitIn(project, arguments).succeeded();
+    }
+
+    bool commit()
+    {
+        ++numCommits;
+        project.getChildFile("Song.als").replaceWithText("take " + juce::String(numCommits));
+
+        return git({ "add", "-A" })
+            && git({ "-c", "user.name=SnapTrack", "-c", "user.email=tests@snaptrack", "commit", "--quiet", "-m", "Snapshot " + juce::String(numCommits) });
+    }
+
+    juce::String localRef(const juce::String& ref)
+    {
+        return juce::String(runGitIn(project, { "rev-parse", "--verify", "--quiet", ref }).output).trim();
+    }
+
+    juce::String mirrorRef(const juce::String& ref)
+    {
+        return juce::String(runGitIn(project, { "--git-dir=" + mirror.getFullPathName(), "rev-parse", "--verify", "--quiet", ref }).output).trim();
+    }
+
+    juce::String listMirrorRefs(const juce::String& prefix)
+    {
+        return juce::String(runGitIn(project, { "--git-dir=" + mirror.getFullPathName(), "for-each-ref", prefix }).output).trim();
+    }
+
+    juce::File project, mirror;
+    int numCommits = 0;
+    std::atomic<int> pushesBeforeFailure { -1 };   // pushes that go through before one fails, -1 for all
+};
+
+static RepositoryBackupTests repositoryBackupTests;
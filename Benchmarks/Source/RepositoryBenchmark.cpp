@@ -0,0 +1,334 @@
+/*
+  ==============================================================================
+
+    RepositoryBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "RepositoryBenchmark.h"
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/PluginEditor.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    bool git(const juce::File& repository, std::vector<std::string> arguments)
+    {
+        arguments.insert(arguments.begin(), { "git", "-C", repository.getFullPathName().toStdString() });
+        return ProcessRunner::run(arguments).succeeded();
+    }
+
+    juce::String gitOutput(const juce::File& repository, std::vector<std::string> arguments)
+    {
+        arguments.insert(arguments.begin(), { "git", "-C", repository.getFullPathName().toStdString() });
+        ProcessResult result = ProcessRunner::run(arguments);
+        return juce::String::fromUTF8(result.output.data(), (int) result.output.size()).trim();
+    }
+
+    double millisecondsSince(juce::int64 startTicks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1000.0;
+    }
+
+    // Timings of one operation, in milliseconds
+    struct Samples
+    {
+        void add(double ms, bool succeeded)
+        {
+            values.push_back(ms);
+            if (!succeeded)
+                ++failures;
+        }
+
+        juce::var toVar() const
+        {
+            juce::DynamicObject::Ptr object = new juce::DynamicObject();
+            object->setProperty("iterations", (int) values.size());
+            object->setProperty("failures", failures);
+
+            if (!values.empty())
+            {
+                std::vector<double> sorted = values;
+                std::sort(sorted.begin(), sorted.end());
+
+                double total = 0.0;
+                for (auto value : sorted)
+                    total += value;
+
+                object->setProperty("median_ms", sorted[sorted.size() / 2]);
+                object->setProperty("p95_ms", sorted[juce::jmin(sorted.size() - 1, (size_t) ((double) sorted.size() * 0.95))]);
+                object->setProperty("mean_ms", total / (double) sorted.size());
+                object->setProperty("min_ms", sorted.front());
+                object->setProperty("max_ms", sorted.back());
+            }
+
+            return object.get();
+        }
+
+        std::vector<double> values;
+        int failures = 0;
+    };
+
+    // Laid out like a project's recordings: a folder per track, a hundred clips each
+    juce::String pathForFile(int index)
+    {
+        return "Samples/Recorded/Track " + juce::String(index / 100 + 1) + "/Clip " + juce::String(index % 100 + 1) + ".wav";
+    }
+
+    void writeRandomFile(const juce::File& file, int size, juce::Random& random)
+    {
+        juce::MemoryBlock data((size_t) size);
+        random.fillBitsRandomly(data.getData(), data.getSize());
+
+        file.getParentDirectory().createDirectory();
+        file.replaceWithData(data.getData(), data.getSize());
+    }
+
+    // Everything submitted to the job queue before this has finished when it returns
+    void waitForJobQueue(DAWVSCAudioProcessor& processor)
+    {
+        juce::WaitableEvent done;
+
+        processor.getJobQueue().submit("Benchmark marker", [&done](GitJobQueue::Context&)
+        {
+            done.signal();
+            GitJobQueue::Result result;
+            result.succeeded = true;
+            return result;
+        });
+
+        done.wait();
+    }
+
+    void progress(const juce::String& message)
+    {
+        std::fprintf(stderr, "%s\n", message.toRawUTF8());
+    }
+}
+
+juce::var runRepositoryBenchmark(const RepositoryBenchmarkSettings& settings, const juce::File& workDirectory)
+{
+    // Job completions and change messages need a message manager, even without a window
+    juce::ScopedJuceInitialiser_GUI messageManager;
+
+    const juce::File repository = workDirectory.getChildFile("repository");
+    repository.deleteRecursively();
+    repository.createDirectory();
+
+    const juce::int64 setupStart = juce::Time::getHighResolutionTicks();
+    progress("Generating " + juce::String(settings.numFiles) + " files");
+
+    git(repository, { "init", "-q" });
+    git(repository, { "symbolic-ref", "HEAD", "refs/heads/master" });
+    git(repository, { "config", "user.name", "SnapTrack benchmark" });
+    git(repository, { "config", "user.email", "benchmark@snaptrack.invalid" });
+    git(repository, { "config", "gc.auto", "0" });
+
+    juce::Random random(1);
+    for (int i = 0; i < settings.numFiles; ++i)
+        writeRandomFile(repository.getChildFile(pathForFile(i)), settings.fileSize, random);
+
+    DAWVSCAudioProcessor processor;
+    processor.setProjectPath(repository.getFullPathName(), false);
+
+    // Only the pass started below, never one in the middle of the timed runs
+    RepositoryMaintenance::Budget budget;
+    budget.enabled = false;
+    processor.getMaintenance().setBudget(budget);
+    processor.snapshotChangedFiles({}, nullptr, "Initial snapshot");
+
+    // Rewrites some files in [first, last) and returns their paths, like a save would
+    auto touchFiles = [&](int first, int last)
+    {
+        juce::StringArray paths;
+        for (int i = 0; i < settings.changedFilesPerSnapshot; ++i)
+        {
+            const juce::String path = pathForFile(first + random.nextInt(juce::jmax(1, last - first)));
+            writeRandomFile(repository.getChildFile(path), settings.fileSize, random);
+            paths.addIfNotAlreadyThere(path);
+        }
+        return paths;
+    };
+
+    progress("Writing " + juce::String(settings.historyDepth) + " commits of history");
+
+    for (int i = 1; i < settings.historyDepth; ++i)
+        processor.snapshotChangedFiles(touchFiles(0, settings.numFiles), nullptr, "History " + juce::String(i));
+
+    for (int i = 0; i < settings.numBranches; ++i)
+    {
+        const int back = i * (settings.historyDepth - 1) / settings.numBranches;
+        git(repository, { "branch", "branch-" + std::to_string(i + 1), "HEAD~" + std::to_string(back) });
+    }
+
+    const double setupSeconds = millisecondsSince(setupStart) / 1000.0;
+
+    //==============================================================================
+    Samples snapshot, fullSnapshot, commitHistory, branches, checkout, merge;
+    progress("Timing snapshots and queries");
+
+    for (int i = 0; i < settings.iterations; ++i)
+    {
+        const juce::StringArray changed = touchFiles(0, settings.numFiles);
+        juce::int64 start = juce::Time::getHighResolutionTicks();
+        bool ok = processor.snapshotChangedFiles(changed);
+        snapshot.add(millisecondsSince(start), ok);
+
+        // The same kind of change, but found by scanning the whole project
+        touchFiles(0, settings.numFiles);
+        start = juce::Time::getHighResolutionTicks();
+        ok = processor.snapshotChangedFiles({});
+        fullSnapshot.add(millisecondsSince(start), ok);
+
+        start = juce::Time::getHighResolutionTicks();
+        ok = !processor.getCommitHistory().isEmpty();
+        commitHistory.add(millisecondsSince(start), ok);
+
+        start = juce::Time::getHighResolutionTicks();
+        ok = processor.getBranches().size() == settings.numBranches + 1;
+        branches.add(millisecondsSince(start), ok);
+    }
+
+    // Checkout: out to an older branch and back, as two samples. Both go through the job
+    // queue like the editor's, so they include restoring managed project files.
+    progress("Timing checkouts");
+
+    for (int i = 0; i < settings.iterations && settings.numBranches > 0; ++i)
+    {
+        const juce::String target = "branch-" + juce::String(i % settings.numBranches + 1);
+
+        for (const auto& branch : { target, juce::String("master") })
+        {
+            const juce::int64 start = juce::Time::getHighResolutionTicks();
+            processor.runGitJob("Benchmark checkout", { juce::StringArray { "checkout", "-q", branch } });
+            waitForJobQueue(processor);
+            checkout.add(millisecondsSince(start), processor.getCurrentBranch() == branch);
+        }
+    }
+
+    // Merge: a side branch and master both move on (in different halves of the project,
+    // so they never conflict), then the side branch is merged back
+    progress("Timing merges");
+    const int half = settings.numFiles / 2;
+
+    for (int i = 0; i < settings.iterations; ++i)
+    {
+        const std::string side = "merge-" + std::to_string(i + 1);
+        git(repository, { "checkout", "-q", "-b", side });
+        processor.snapshotChangedFiles(touchFiles(0, half), nullptr, "Side change");
+        git(repository, { "checkout", "-q", "master" });
+        processor.snapshotChangedFiles(touchFiles(half, settings.numFiles), nullptr, "Master change");
+
+        const juce::int64 start = juce::Time::getHighResolutionTicks();
+        processor.runGitJob("Benchmark merge", { juce::StringArray { "merge", "-q", "--no-edit", side } });
+        waitForJobQueue(processor);
+
+        // A real merge commit has two parents
+        juce::StringArray parents;
+        parents.addTokens(gitOutput(repository, { "rev-list", "--parents", "-n", "1", "HEAD" }), " ", {});
+        merge.add(millisecondsSince(start), parents.size() == 3);
+    }
+
+    // Maintenance: one full pass over everything the runs above left loose, then history again
+    progress("Timing maintenance");
+    Samples maintenance, commitHistoryAfterMaintenance;
+    const RepositoryMaintenance::Metrics beforeMaintenance = RepositoryMaintenance::measure(repository.getChildFile(".git"));
+
+    {
+        // Polled rather than waited for with a marker job, which would make the pass give way
+        const int passesBefore = processor.getMaintenance().getStatistics().numPasses;
+        const juce::int64 start = juce::Time::getHighResolutionTicks();
+        processor.getMaintenance().runNow();
+
+        while (processor.getMaintenance().getStatistics().numPasses == passesBefore && millisecondsSince(start) < 10 * 60 * 1000)
+            juce::Thread::sleep(5);
+
+        maintenance.add(millisecondsSince(start), processor.getMaintenance().getStatistics().numInterrupted == 0);
+    }
+
+    const RepositoryMaintenance::Metrics afterMaintenance = RepositoryMaintenance::measure(repository.getChildFile(".git"));
+
+    for (int i = 0; i < settings.iterations; ++i)
+    {
+        const juce::int64 start = juce::Time::getHighResolutionTicks();
+        const bool ok = !processor.getCommitHistory().isEmpty();
+        commitHistoryAfterMaintenance.add(millisecondsSince(start), ok);
+    }
+
+    // Opening the editor: what it reads at once from the caches prefetch() warmed, against the
+    // synchronous summary and history reads it used to make
+    progress("Timing editor open");
+    Samples editorOpen, editorOpenUncached;
+    std::shared_ptr<RepositoryService> service = processor.getRepository();
+
+    {
+        service->refreshSummary(nullptr);
+        service->refreshHistory(nullptr);
+        const juce::int64 start = juce::Time::getHighResolutionTicks();
+
+        while ((!service->getState()->hasSummary || service->getState()->history == nullptr)
+               && millisecondsSince(start) < 60 * 1000)
+            juce::Thread::sleep(5);
+    }
+
+    for (int i = 0; i < settings.iterations; ++i)
+    {
+        juce::int64 start = juce::Time::getHighResolutionTicks();
+        std::shared_ptr<const RepositoryState> state = processor.getRepositoryState();
+        bool ok = processor.getGitVersion().contains("git version") && state->hasSummary && state->history != nullptr;
+        editorOpen.add(millisecondsSince(start), ok);
+
+        start = juce::Time::getHighResolutionTicks();
+        ok = !processor.getRepositorySummary(0).branches.isEmpty() && !processor.getCommitHistory().isEmpty();
+        editorOpenUncached.add(millisecondsSince(start), ok);
+    }
+
+    auto metricsToVar = [](const RepositoryMaintenance::Metrics& metrics)
+    {
+        juce::DynamicObject::Ptr object = new juce::DynamicObject();
+        object->setProperty("looseObjects", metrics.looseObjects);
+        object->setProperty("looseBytes", metrics.looseBytes);
+        object->setProperty("packs", metrics.packs);
+        object->setProperty("packedObjects", metrics.packedObjects);
+        object->setProperty("packedBytes", metrics.packedBytes);
+        object->setProperty("commitGraph", metrics.hasCommitGraph);
+        return juce::var(object.get());
+    };
+
+    //==============================================================================
+    juce::DynamicObject::Ptr settingsObject = new juce::DynamicObject();
+    settingsObject->setProperty("files", settings.numFiles);
+    settingsObject->setProperty("fileSize", settings.fileSize);
+    settingsObject->setProperty("historyDepth", settings.historyDepth);
+    settingsObject->setProperty("branches", settings.numBranches);
+    settingsObject->setProperty("changedFilesPerSnapshot", settings.changedFilesPerSnapshot);
+    settingsObject->setProperty("iterations", settings.iterations);
+
+    juce::DynamicObject::Ptr results = new juce::DynamicObject();
+    results->setProperty("snapshot", snapshot.toVar());
+    results->setProperty("snapshotFullScan", fullSnapshot.toVar());
+    results->setProperty("getCommitHistory", commitHistory.toVar());
+    results->setProperty("getBranches", branches.toVar());
+    results->setProperty("checkout", checkout.toVar());
+    results->setProperty("merge", merge.toVar());
+    results->setProperty("maintenance", maintenance.toVar());
+    results->setProperty("getCommitHistoryAfterMaintenance", commitHistoryAfterMaintenance.toVar());
+    results->setProperty("editorOpen", editorOpen.toVar());
+    results->setProperty("editorOpenUncached", editorOpenUncached.toVar());
+
+    juce::DynamicObject::Ptr root = new juce::DynamicObject();
+    root->setProperty("benchmark", "repository");
+    root->setProperty("gitVersion", processor.getGitVersion().trim());
+    root->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    root->setProperty("settings", settingsObject.get());
+    root->setProperty("setupSeconds", setupSeconds);
+    root->setProperty("results", results.get());
+    root->setProperty("editorOpenBudgetMs", DAWVSCAudioProcessorEditor::openBudgetMs);
+    root->setProperty("objectsBeforeMaintenance", metricsToVar(beforeMaintenance));
+    root->setProperty("objectsAfterMaintenance", metricsToVar(afterMaintenance));
+
+    return root.get();
+}
@@ -0,0 +1,29 @@
+/*
+  ==============================================================================
+
+    RepositoryBenchmark.h
+    Snapshot, history, branch, checkout, merge, maintenance and editor open
+    latency through DAWVSCAudioProcessor, on a synthetic project of a chosen
+    shape.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+struct RepositoryBenchmarkSettings
+{
+    int numFiles = 2000;
+    int fileSize = 16 * 1024;           // bytes per file
+    int historyDepth = 200;             // commits before the timed runs start
+    int numBranches = 10;               // spread evenly over the history
+    int changedFilesPerSnapshot = 3;
+    int iterations = 20;
+};
+
+/** Builds the project under workDirectory, runs every case and returns the results,
+    ready for juce::JSON::toString(). Progress goes to stderr.
+*/
+juce::var runRepositoryBenchmark(const RepositoryBenchmarkSettings& settings, const juce::File& workDirectory);
@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    SpawnBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "SpawnBenchmark.h"
+#include "../../Source/ProcessRunner.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // What DAWVSCAudioProcessor::executeCommand used to do outside Windows:
+    // a shell per call and 128-byte fgets reads.
+    std::string runThroughPopen(const std::string& command)
+    {
+        std::array<char, 128> buffer;
+        std::string cmd = command + " 2>&1";
+       #if JUCE_WINDOWS
+        std::unique_ptr<FILE, decltype(&_pclose)> pipe(_popen(cmd.c_str(), "r"), _pclose);
+       #else
+        std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
+       #endif
+        std::string result;
+
+        if (!pipe)
+            return result;
+
+        while (fgets(buffer.data(), (int) buffer.size(), pipe.get()) != nullptr)
+            result.append(buffer.data(), std::strlen(buffer.data()));
+
+        return result;
+    }
+
+    struct Stats
+    {
+        double median = 0.0;
+        double p95 = 0.0;
+        double mean = 0.0;
+        size_t bytes = 0;
+    };
+
+    template <typename Fn>
+    Stats measure(int iterations, Fn&& fn)
+    {
+        std::vector<double> samples;
+        samples.reserve((size_t) iterations);
+        Stats stats;
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            stats.bytes = fn();
+            samples.push_back(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0);
+        }
+
+        std::sort(samples.begin(), samples.end());
+        stats.median = samples[samples.size() / 2];
+        stats.p95 = samples[juce::jmin(samples.size() - 1, (size_t) (samples.size() * 0.95))];
+
+        for (auto s : samples)
+            stats.mean += s;
+        stats.mean /= (double) samples.size();
+
+        return stats;
+    }
+
+    void printRow(const juce::String& name, const Stats& stats)
+    {
+        std::printf("  %-34s median %8.3f ms   p95 %8.3f ms   mean %8.3f ms   %zu bytes\n",
+                    name.toRawUTF8(), stats.median, stats.p95, stats.mean, stats.bytes);
+    }
+}
+
+void runSpawnBenchmark(int iterations, const juce::File& repository)
+{
+    const std::string cwd = repository.getFullPathName().toStdString();
+
+    struct Case
+    {
+        const char* name;
+        std::vector<std::string> argv;
+    };
+
+    const Case cases[] = {
+        { "git --version", { "git", "--version" } },
+        { "git log (full)", { "git", "-C", cwd, "log", "--pretty=format:%h %s %ar" } },
+    };
+
+    std::printf("Spawn-to-result latency, %d iterations\n", iterations);
+
+    for (const auto& c : cases)
+    {
+        std::string commandLine;
+        for (const auto& arg : c.argv)
+            commandLine += (commandLine.empty() ? "" : " ") + ("\"" + arg + "\"");
+
+        std::printf("%s\n", c.name);
+
+        printRow("popen + shell, 128 B reads", measure(iterations, [&] { return runThroughPopen(commandLine).size(); }));
+
+        printRow("ProcessRunner::run", measure(iterations, [&]
+        {
+            return ProcessRunner::run(c.argv).output.size();
+        }));
+    }
+}
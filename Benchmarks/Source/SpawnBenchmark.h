@@ -0,0 +1,14 @@
+/*
+  ==============================================================================
+
+    SpawnBenchmark.h
+    Spawn-to-result latency of ProcessRunner against the old popen path.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+void runSpawnBenchmark(int iterations, const juce::File& repository);
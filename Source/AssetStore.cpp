@@ -0,0 +1,795 @@
+/*
+  ==============================================================================
+
+    AssetStore.cpp
+
+  ==============================================================================
+*/
+
+#include "AssetStore.h"
+#include "ProjectWatcher.h"
+#include "Sha1.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const char* const pointerHeader = "snaptrack asset 1";
+
+    // 256 fixed pseudo-random values, one per byte value. They must never change:
+    // chunk boundaries, and so deduplication against older snapshots, depend on them.
+    struct GearTable
+    {
+        GearTable()
+        {
+            uint64_t seed = 0x536e617054726b31ull;
+
+            for (auto& value : values)
+            {
+                // splitmix64
+                uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                value = z ^ (z >> 31);
+            }
+        }
+
+        uint64_t values[256];
+    };
+
+    const GearTable gear;
+
+    // Normalised chunking: a harder mask before the average size, an easier one after,
+    // keeps most chunks close to the average. The gear hash shifts left, so its top bits
+    // depend on the last 64 bytes, which is the window we want to test.
+    constexpr uint64_t topBits(int n) { return ((uint64_t(1) << n) - 1) << (64 - n); }
+    constexpr uint64_t hardMask = topBits(22);
+    constexpr uint64_t easyMask = topBits(18);
+
+    size_t findChunkBoundary(const uint8_t* data, size_t size)
+    {
+        if (size <= AssetStore::minChunkSize)
+            return size;
+
+        const size_t normalEnd = juce::jmin(AssetStore::averageChunkSize, size);
+        const size_t end = juce::jmin(AssetStore::maxChunkSize, size);
+        uint64_t hash = 0;
+        size_t i = AssetStore::minChunkSize;
+
+        for (; i < normalEnd; ++i)
+        {
+            hash = (hash << 1) + gear.values[data[i]];
+            if ((hash & hardMask) == 0)
+                return i + 1;
+        }
+
+        for (; i < end; ++i)
+        {
+            hash = (hash << 1) + gear.values[data[i]];
+            if ((hash & easyMask) == 0)
+                return i + 1;
+        }
+
+        return end;
+    }
+
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    juce::String hashFile(const juce::File& file, const std::atomic<bool>* cancelFlag)
+    {
+        juce::FileInputStream in(file);
+        if (!in.openedOk())
+            return {};
+
+        Sha1 sha;
+        std::vector<uint8_t> buffer(1024 * 1024);
+
+        for (;;)
+        {
+            if (isCancelled(cancelFlag))
+                return {};
+
+            const int numRead = in.read(buffer.data(), (int) buffer.size());
+            if (numRead <= 0)
+                break;
+
+            sha.update(buffer.data(), (size_t) numRead);
+        }
+
+        return Sha1::toHex(sha.finish());
+    }
+
+    juce::String escapeIgnorePattern(const juce::String& path)
+    {
+        juce::String escaped;
+
+        for (auto c : path)
+        {
+            if (c == '*' || c == '?' || c == '[' || c == '\\')
+                escaped << '\\';
+            escaped << juce::String::charToString(c);
+        }
+
+        return escaped;
+    }
+
+    // A pointer's file, read across its chunk files without putting it back together
+    class ChunkInputStream : public juce::InputStream
+    {
+    public:
+        struct Part
+        {
+            juce::File file;
+            juce::int64 start = 0;
+            juce::int64 size = 0;
+        };
+
+        ChunkInputStream(std::vector<Part> chunkParts, juce::int64 length)
+            : parts(std::move(chunkParts)), totalLength(length) {}
+
+        juce::int64 getTotalLength() override { return totalLength; }
+        bool isExhausted() override { return position >= totalLength; }
+        juce::int64 getPosition() override { return position; }
+
+        bool setPosition(juce::int64 newPosition) override
+        {
+            position = juce::jlimit((juce::int64) 0, totalLength, newPosition);
+            return true;
+        }
+
+        int read(void* destination, int maxBytesToRead) override
+        {
+            int numRead = 0;
+
+            while (numRead < maxBytesToRead && position < totalLength)
+            {
+                const Part& part = findPart();
+
+                if (current == nullptr || currentPart != &part)
+                {
+                    current = std::make_unique<juce::FileInputStream>(part.file);
+                    currentPart = &part;
+
+                    if (!current->openedOk())
+                        break;
+                }
+
+                const juce::int64 offset = position - part.start;
+                const int wanted = (int) juce::jmin((juce::int64) (maxBytesToRead - numRead), part.size - offset);
+
+                if (current->getPosition() != offset)
+                    current->setPosition(offset);
+
+                const int got = current->read(static_cast<char*>(destination) + numRead, wanted);
+
+                if (got <= 0)
+                    break;
+
+                numRead += got;
+                position += got;
+            }
+
+            return numRead;
+        }
+
+    private:
+        const Part& findPart() const
+        {
+            auto next = std::upper_bound(parts.begin(), parts.end(), position,
+                                         [](juce::int64 at, const Part& part) { return at < part.start; });
+            return *(next - 1);
+        }
+
+        std::vector<Part> parts;
+        juce::int64 totalLength = 0;
+        juce::int64 position = 0;
+        std::unique_ptr<juce::FileInputStream> current;
+        const Part* currentPart = nullptr;
+    };
+}
+
+//==============================================================================
+juce::String AssetStore::Pointer::toString() const
+{
+    juce::String text;
+    text << pointerHeader << "\n"
+         << "oid " << oid << "\n"
+         << "size " << size << "\n";
+
+    for (const auto& chunk : chunks)
+        text << "chunk " << chunk.hash << " " << chunk.size << "\n";
+
+    return text;
+}
+
+bool AssetStore::Pointer::parse(const juce::String& text, Pointer& pointer)
+{
+    juce::StringArray lines;
+    lines.addLines(text);
+
+    if (lines.isEmpty() || lines[0] != pointerHeader)
+        return false;
+
+    pointer = Pointer();
+
+    for (int i = 1; i < lines.size(); ++i)
+    {
+        juce::StringArray fields;
+        fields.addTokens(lines[i], " ", "");
+
+        if (fields[0] == "oid" && fields.size() == 2)
+            pointer.oid = fields[1];
+        else if (fields[0] == "size" && fields.size() == 2)
+            pointer.size = fields[1].getLargeIntValue();
+        else if (fields[0] == "chunk" && fields.size() == 3)
+            pointer.chunks.add({ fields[1], fields[2].getLargeIntValue() });
+    }
+
+    return pointer.oid.length() == 40;
+}
+
+//==============================================================================
+AssetStore::AssetStore(const juce::File& project, const juce::File& gitDirectory, const juce::File& commonDirectory)
+    : projectDirectory(project),
+      pointerDirectory(project.getChildFile(pointerDirectoryName)),
+      chunkDirectory(commonDirectory.getChildFile("snaptrack").getChildFile("chunks")),
+      cacheFile(gitDirectory.getChildFile("snaptrack").getChildFile("asset-cache")),
+      excludeFile(commonDirectory.getChildFile("info").getChildFile("exclude")),
+      cloneCache(gitDirectory.getChildFile("snaptrack").getChildFile("asset-clones"), maxCloneCacheBytes)
+{
+}
+
+bool AssetStore::isEnabled() const
+{
+    return pointerDirectory.isDirectory();
+}
+
+void AssetStore::setEnabled(bool shouldBeEnabled)
+{
+    if (shouldBeEnabled)
+    {
+        // Git doesn't track empty directories, so leave something in it
+        pointerDirectory.createDirectory();
+        juce::File marker = pointerDirectory.getChildFile("store");
+        if (!marker.existsAsFile())
+            marker.replaceWithText("SnapTrack keeps large audio files here as lists of chunks.\n");
+    }
+    else
+    {
+        // The audio files themselves stay, the next snapshot hands them back to git
+        pointerDirectory.deleteRecursively();
+        cache.clear();
+        cacheDirty = false;
+        cacheFile.deleteFile();
+        updateExcludes();
+    }
+}
+
+bool AssetStore::isLargeAudioFile(const juce::File& file)
+{
+    return file.hasFileExtension("wav;wave;aif;aiff;w64;caf")
+        && file.existsAsFile()
+        && file.getSize() >= minimumAssetSize;
+}
+
+//==============================================================================
+AssetStore::PreparedSnapshot AssetStore::prepareSnapshot(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag)
+{
+    PreparedSnapshot prepared;
+
+    if (!isEnabled())
+    {
+        prepared.pathsToStage = changedPaths;
+        return prepared;
+    }
+
+    loadCache();
+
+    const std::map<juce::String, juce::File> pointers = findPointers();
+    const juce::String pointerPrefix = juce::String(pointerDirectoryName) + "/";
+    juce::StringArray assets;
+
+    if (changedPaths.isEmpty())
+    {
+        findLargeAudioFiles(projectDirectory, {}, assets);
+
+        // Recordings that were deleted (or shrank below the threshold) lose their pointer
+        for (const auto& pointer : pointers)
+        {
+            if (!assets.contains(pointer.first))
+            {
+                pointer.second.deleteFile();
+                cache.erase(pointer.first);
+                cacheDirty = true;
+            }
+        }
+    }
+    else
+    {
+        for (const auto& path : changedPaths)
+        {
+            if (isLargeAudioFile(projectDirectory.getChildFile(path)))
+            {
+                assets.add(path);
+                prepared.pathsToStage.add(pointerPrefix + path + ".asset");
+            }
+            else if (pointers.count(path) > 0)
+            {
+                pointers.at(path).deleteFile();
+                cache.erase(path);
+                cacheDirty = true;
+                prepared.pathsToStage.add(pointerPrefix + path + ".asset");
+
+                if (projectDirectory.getChildFile(path).existsAsFile())
+                    prepared.pathsToStage.add(path);
+            }
+            else
+            {
+                prepared.pathsToStage.add(path);
+            }
+        }
+    }
+
+    for (const auto& path : assets)
+    {
+        if (isCancelled(cancelFlag))
+            break;
+
+        // On failure the old pointer stays, so the snapshot keeps the last good version
+        if (storeAsset(path, cancelFlag) && pointers.count(path) == 0)
+            prepared.newlyManaged.add(path);
+    }
+
+    updateExcludes();
+    saveCache();
+    return prepared;
+}
+
+int AssetStore::restoreAssets(const std::atomic<bool>* cancelFlag, const juce::StringArray& priorityOrder)
+{
+    if (!isEnabled())
+        return 0;
+
+    loadCache();
+
+    int numWritten = 0;
+    bool failed = false;
+
+    // Files the project loads first are rebuilt first, the rest in path order
+    std::vector<std::pair<juce::String, juce::File>> pointers;
+    for (const auto& pointer : findPointers())
+        pointers.push_back(pointer);
+
+    auto rank = [&priorityOrder](const juce::String& path)
+    {
+        const int index = priorityOrder.indexOf(path);
+        return index < 0 ? priorityOrder.size() : index;
+    };
+
+    std::stable_sort(pointers.begin(), pointers.end(), [&rank](const auto& a, const auto& b) { return rank(a.first) < rank(b.first); });
+
+    for (const auto& entry : pointers)
+    {
+        if (isCancelled(cancelFlag))
+            break;
+
+        Pointer pointer;
+        if (!Pointer::parse(entry.second.loadFileAsString(), pointer))
+        {
+            failed = true;
+            continue;
+        }
+
+        const juce::File target = projectDirectory.getChildFile(entry.first);
+
+        // The pointer hasn't moved since we last synced this file, so whatever is on disk
+        // is the user's (possibly a recording that hasn't been snapshotted yet): leave it
+        auto cached = cache.find(entry.first);
+        if (target.existsAsFile() && cached != cache.end() && cached->second.oid == pointer.oid)
+            continue;
+
+        if (target.existsAsFile() && target.getSize() == pointer.size)
+        {
+
+            // Not a version we've seen (e.g. a fresh clone that already has the file): reading is cheaper than rewriting
+            const juce::int64 modified = target.getLastModificationTime().toMilliseconds();
+            if (hashFile(target, cancelFlag) == pointer.oid)
+            {
+                remember(entry.first, pointer.size, modified, pointer.oid);
+                continue;
+            }
+        }
+
+        // The version being replaced is one we synced: keep a free copy of it for switching back
+        if (cached != cache.end() && matchesCache(entry.first, target, cached->second.oid))
+        {
+            cloneCache.remember("asset-" + cached->second.oid, target);
+        }
+        else if (target.existsAsFile())
+        {
+            // Changed since we last synced it (a recording edited after the last snapshot), or never
+            // ours. Git ignores it, so nothing else would keep it: move it aside, never overwrite it.
+            const juce::File aside = target.getParentDirectory().getNonexistentChildFile(
+                target.getFileNameWithoutExtension() + ".snaptrack-conflict", target.getFileExtension(), false);
+
+            if (!target.moveFileTo(aside))
+            {
+                DBG("Couldn't move " + entry.first + " aside, so it wasn't restored");
+                failed = true;
+                continue;
+            }
+        }
+
+        if (cloneCache.materialise("asset-" + pointer.oid, target) || reassemble(pointer, target, cancelFlag))
+        {
+            remember(entry.first, target.getSize(), target.getLastModificationTime().toMilliseconds(), pointer.oid);
+            cloneCache.remember("asset-" + pointer.oid, target);
+            ++numWritten;
+        }
+        else if (!isCancelled(cancelFlag))
+        {
+            DBG("Couldn't rebuild " + entry.first + " from the asset store");
+            failed = true;
+        }
+    }
+
+    updateExcludes();
+    saveCache();
+    return failed ? -1 : numWritten;
+}
+
+void AssetStore::updateExcludes()
+{
+    juce::StringArray paths;
+
+    if (isEnabled())
+        for (const auto& pointer : findPointers())
+            paths.add(pointer.first);
+
+    writeExcludeBlock(excludeFile, "asset store", paths);
+}
+
+void AssetStore::writeExcludeBlock(const juce::File& excludeFile, const juce::String& blockName, const juce::StringArray& paths)
+{
+    juce::StringArray patterns;
+
+    for (const auto& path : paths)
+        patterns.add("/" + escapeIgnorePattern(path));
+
+    writeManagedBlock(excludeFile, blockName, patterns);
+}
+
+void AssetStore::writeManagedBlock(const juce::File& file, const juce::String& blockName, const juce::StringArray& blockLines)
+{
+    const juce::String blockBegin = "# >>> SnapTrack " + blockName + " (managed, do not edit)";
+    const juce::String blockEnd = "# <<< SnapTrack " + blockName;
+
+    juce::StringArray lines;
+    lines.addLines(file.loadFileAsString());
+
+    // Drop our old block, keep whatever else is in there
+    const int begin = lines.indexOf(blockBegin);
+    const int end = lines.indexOf(blockEnd);
+    if (begin >= 0)
+        lines.removeRange(begin, (end > begin ? end : lines.size() - 1) - begin + 1);
+
+    while (!lines.isEmpty() && lines[lines.size() - 1].trim().isEmpty())
+        lines.remove(lines.size() - 1);
+
+    if (!blockLines.isEmpty())
+    {
+        lines.add(blockBegin);
+        lines.addArray(blockLines);
+        lines.add(blockEnd);
+    }
+
+    const juce::String text = lines.isEmpty() ? juce::String() : lines.joinIntoString("\n") + "\n";
+
+    if (text != file.loadFileAsString())
+    {
+        file.getParentDirectory().createDirectory();
+        file.replaceWithText(text);
+    }
+}
+
+//==============================================================================
+bool AssetStore::storeAsset(const juce::String& relativePath, const std::atomic<bool>* cancelFlag)
+{
+    const juce::File file = projectDirectory.getChildFile(relativePath);
+    const juce::File pointerFile = getPointerFile(relativePath);
+    const juce::String existingText = pointerFile.loadFileAsString();
+
+    Pointer existing;
+    if (Pointer::parse(existingText, existing) && matchesCache(relativePath, file, existing.oid))
+        return true;
+
+    const juce::int64 size = file.getSize();
+    const juce::int64 modified = file.getLastModificationTime().toMilliseconds();
+
+    Pointer pointer;
+    if (!chunkFile(file, pointer, cancelFlag))
+        return false;
+
+    // Only trust the stat info if the DAW didn't write to the file while we read it
+    if (file.getSize() == size && file.getLastModificationTime().toMilliseconds() == modified)
+        remember(relativePath, size, modified, pointer.oid);
+
+    const juce::String text = pointer.toString();
+    if (text != existingText)
+    {
+        pointerFile.getParentDirectory().createDirectory();
+        if (!pointerFile.replaceWithText(text))
+            return false;
+    }
+
+    return true;
+}
+
+bool AssetStore::chunkFile(const juce::File& file, Pointer& pointer, const std::atomic<bool>* cancelFlag)
+{
+    juce::FileInputStream in(file);
+    if (!in.openedOk())
+        return false;
+
+    // Room for two maximum-size chunks, so a boundary search never runs off the end
+    // of the buffer before the end of the file. Memory stays bounded whatever the file size.
+    std::vector<uint8_t> buffer(maxChunkSize * 2);
+    size_t start = 0;
+    size_t filled = 0;
+    bool endOfFile = false;
+    Sha1 whole;
+
+    for (;;)
+    {
+        if (!endOfFile && filled - start < maxChunkSize)
+        {
+            std::memmove(buffer.data(), buffer.data() + start, filled - start);
+            filled -= start;
+            start = 0;
+
+            while (filled < buffer.size())
+            {
+                const int numRead = in.read(buffer.data() + filled, (int) (buffer.size() - filled));
+                if (numRead <= 0)
+                {
+                    endOfFile = true;
+                    break;
+                }
+
+                filled += (size_t) numRead;
+            }
+        }
+
+        if (start == filled)
+            break;
+
+        if (isCancelled(cancelFlag))
+            return false;
+
+        const size_t length = findChunkBoundary(buffer.data() + start, filled - start);
+
+        Chunk chunk;
+        if (!writeChunk(buffer.data() + start, length, chunk))
+            return false;
+
+        whole.update(buffer.data() + start, length);
+        pointer.chunks.add(chunk);
+        pointer.size += (juce::int64) length;
+        start += length;
+    }
+
+    pointer.oid = Sha1::toHex(whole.finish());
+    return true;
+}
+
+bool AssetStore::writeChunk(const uint8_t* data, size_t size, Chunk& chunk)
+{
+    chunk.hash = Sha1::toHex(Sha1::hash(data, size));
+    chunk.size = (juce::int64) size;
+
+    const juce::File chunkFile = getChunkFile(chunk.hash);
+
+    // Already stored by an earlier snapshot, or by another file with the same audio
+    if (chunkFile.existsAsFile() && chunkFile.getSize() == chunk.size)
+        return true;
+
+    chunkFile.getParentDirectory().createDirectory();
+    const juce::File temp = chunkFile.getSiblingFile(chunkFile.getFileName() + ".tmp");
+
+    {
+        juce::FileOutputStream out(temp);
+        if (!out.openedOk())
+            return false;
+
+        out.setPosition(0);
+        out.truncate();
+
+        if (!out.write(data, size))
+            return false;
+
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return temp.moveFileTo(chunkFile);
+}
+
+bool AssetStore::reassemble(const Pointer& pointer, const juce::File& target, const std::atomic<bool>* cancelFlag)
+{
+    target.getParentDirectory().createDirectory();
+
+    // Written next to the target and renamed over it, so the DAW never sees half a file.
+    // The .tmp suffix keeps the project watcher from reporting it.
+    const juce::File temp = target.getSiblingFile(target.getFileName() + ".snaptrack.tmp");
+    bool ok = true;
+
+    {
+        juce::FileOutputStream out(temp);
+        if (!out.openedOk())
+            return false;
+
+        out.setPosition(0);
+        out.truncate();
+
+        Sha1 whole;
+        std::vector<uint8_t> data;
+
+        for (const auto& chunk : pointer.chunks)
+        {
+            const juce::File chunkFile = getChunkFile(chunk.hash);
+
+            if (isCancelled(cancelFlag) || chunkFile.getSize() != chunk.size)
+            {
+                ok = false;
+                break;
+            }
+
+            data.resize((size_t) chunk.size);
+            juce::FileInputStream in(chunkFile);
+
+            if (!in.openedOk() || in.read(data.data(), (int) data.size()) != (int) data.size()
+                || !out.write(data.data(), data.size()))
+            {
+                ok = false;
+                break;
+            }
+
+            whole.update(data.data(), data.size());
+        }
+
+        out.flush();
+        ok = ok && !out.getStatus().failed() && Sha1::toHex(whole.finish()) == pointer.oid;
+    }
+
+    if (!ok || !temp.moveFileTo(target))
+    {
+        temp.deleteFile();
+        return false;
+    }
+
+    return true;
+}
+
+bool AssetStore::matchesCache(const juce::String& relativePath, const juce::File& file, const juce::String& oid) const
+{
+    auto entry = cache.find(relativePath);
+
+    return entry != cache.end()
+        && entry->second.oid == oid
+        && entry->second.size == file.getSize()
+        && entry->second.modified == file.getLastModificationTime().toMilliseconds();
+}
+
+void AssetStore::remember(const juce::String& relativePath, juce::int64 size, juce::int64 modified, const juce::String& oid)
+{
+    cache[relativePath] = { size, modified, oid };
+    cacheDirty = true;
+}
+
+//==============================================================================
+juce::File AssetStore::getPointerFile(const juce::String& relativePath) const
+{
+    return pointerDirectory.getChildFile(relativePath + ".asset");
+}
+
+std::unique_ptr<juce::InputStream> AssetStore::createInputStream(const Pointer& pointer) const
+{
+    std::vector<ChunkInputStream::Part> parts;
+    juce::int64 start = 0;
+
+    for (const auto& chunk : pointer.chunks)
+    {
+        ChunkInputStream::Part part { getChunkFile(chunk.hash), start, chunk.size };
+
+        if (chunk.size <= 0 || part.file.getSize() != chunk.size)
+            return nullptr;
+
+        parts.push_back(part);
+        start += chunk.size;
+    }
+
+    if (parts.empty() || start != pointer.size)
+        return nullptr;
+
+    return std::make_unique<ChunkInputStream>(std::move(parts), start);
+}
+
+juce::File AssetStore::getChunkFile(const juce::String& hash) const
+{
+    return chunkDirectory.getChildFile(hash.substring(0, 2)).getChildFile(hash.substring(2));
+}
+
+std::map<juce::String, juce::File> AssetStore::findPointers() const
+{
+    std::map<juce::String, juce::File> pointers;
+
+    if (!pointerDirectory.isDirectory())
+        return pointers;
+
+    for (const auto& entry : juce::RangedDirectoryIterator(pointerDirectory, true, "*.asset", juce::File::findFiles))
+    {
+        const juce::File file = entry.getFile();
+        const juce::String relativePath = file.getRelativePathFrom(pointerDirectory).replaceCharacter('\\', '/');
+        pointers[relativePath.dropLastCharacters(6)] = file;
+    }
+
+    return pointers;
+}
+
+void AssetStore::findLargeAudioFiles(const juce::File& directory, const juce::String& relativePath, juce::StringArray& found) const
+{
+    for (const auto& entry : juce::RangedDirectoryIterator(directory, false, "*", juce::File::findFilesAndDirectories))
+    {
+        const juce::File file = entry.getFile();
+        const juce::String path = relativePath.isEmpty() ? file.getFileName() : relativePath + "/" + file.getFileName();
+
+        if (ProjectWatcher::shouldIgnore(path) || path == pointerDirectoryName)
+            continue;
+
+        if (entry.isDirectory())
+            findLargeAudioFiles(file, path, found);
+        else if (isLargeAudioFile(file))
+            found.add(path);
+    }
+}
+
+//==============================================================================
+void AssetStore::loadCache()
+{
+    if (cacheLoaded)
+        return;
+
+    cacheLoaded = true;
+
+    juce::StringArray lines;
+    lines.addLines(cacheFile.loadFileAsString());
+
+    // size \t modified \t oid \t path
+    for (const auto& line : lines)
+    {
+        juce::StringArray fields;
+        fields.addTokens(line, "\t", "");
+
+        if (fields.size() == 4)
+            cache[fields[3]] = { fields[0].getLargeIntValue(), fields[1].getLargeIntValue(), fields[2] };
+    }
+}
+
+void AssetStore::saveCache()
+{
+    if (!cacheDirty)
+        return;
+
+    juce::String text;
+    for (const auto& entry : cache)
+        text << entry.second.size << "\t" << entry.second.modified << "\t" << entry.second.oid << "\t" << entry.first << "\n";
+
+    cacheFile.getParentDirectory().createDirectory();
+    if (cacheFile.replaceWithText(text))
+        cacheDirty = false;
+}
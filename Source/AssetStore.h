@@ -0,0 +1,140 @@
+/*
+  ==============================================================================
+
+    AssetStore.h
+    Keeps large audio recordings out of git's object database: they are split
+    into content-defined chunks and git only sees a small pointer file.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CloneCache.h"
+#include <atomic>
+#include <map>
+#include <memory>
+
+//==============================================================================
+/**
+    An optional, per-repository store for big WAV/AIFF files.
+
+    Each large audio file is cut into chunks where a rolling hash of its content
+    hits a boundary (FastCDC-style gear hash), so trimming or re-rendering part
+    of a take only produces new chunks around the edit. Chunks are named by
+    their SHA-1 and shared between every snapshot and every file, under
+    .git/snaptrack/chunks.
+
+    In the working tree the audio file stays where the DAW expects it, but git
+    ignores it (through a managed block in .git/info/exclude) and tracks
+    .snaptrack-assets/<path>.asset instead, which lists the file's chunks.
+    After a checkout, restoreAssets() rebuilds every file whose pointer changed,
+    from a CloneCache when an earlier switch left that version there.
+
+    The store is on for a repository when its .snaptrack-assets directory exists,
+    so the setting travels with the project. Not thread safe: call it from the
+    job queue.
+*/
+class AssetStore
+{
+public:
+    struct Chunk
+    {
+        juce::String hash;
+        juce::int64 size = 0;
+    };
+
+    /** The contents of a pointer file. */
+    struct Pointer
+    {
+        juce::String oid;       // SHA-1 of the whole file
+        juce::int64 size = 0;
+        juce::Array<Chunk> chunks;
+
+        juce::String toString() const;
+        static bool parse(const juce::String& text, Pointer& pointer);
+    };
+
+    struct PreparedSnapshot
+    {
+        juce::StringArray pathsToStage;     // empty means stage everything
+        juce::StringArray newlyManaged;     // audio files git may still track directly
+    };
+
+    AssetStore(const juce::File& projectDirectory, const juce::File& gitDirectory, const juce::File& commonDirectory);
+
+    bool isEnabled() const;
+    void setEnabled(bool shouldBeEnabled);
+
+    /** Chunks the large audio files among changedPaths (the whole project if empty)
+        and swaps them for their pointer files in the list of paths to stage.
+    */
+    PreparedSnapshot prepareSnapshot(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag);
+
+    /** Rebuilds audio files that don't match their pointers, e.g. after a checkout or a clone,
+        those in priorityOrder first. A file on disk that isn't a version we synced is kept as
+        "<name>.snaptrack-conflict.<ext>" next to it. Returns the number of files written, or -1
+        if a chunk was missing or the rebuild failed.
+    */
+    int restoreAssets(const std::atomic<bool>* cancelFlag, const juce::StringArray& priorityOrder = {});
+
+    /** The file a pointer stands for, read straight from its chunks. Seekable, and usable from any
+        thread since chunks never change. Returns nullptr if a chunk is missing.
+    */
+    std::unique_ptr<juce::InputStream> createInputStream(const Pointer& pointer) const;
+
+    /** Brings the ignore rules in line with the pointer files in the working tree. */
+    void updateExcludes();
+
+    /** Replaces the named block of root-anchored paths in a git exclude file, leaving the rest alone. */
+    static void writeExcludeBlock(const juce::File& excludeFile, const juce::String& blockName, const juce::StringArray& paths);
+
+    /** Replaces the named block of lines in a git info file (exclude, attributes), leaving the rest alone. */
+    static void writeManagedBlock(const juce::File& file, const juce::String& blockName, const juce::StringArray& blockLines);
+
+    static bool isLargeAudioFile(const juce::File& file);
+
+    static constexpr const char* pointerDirectoryName = ".snaptrack-assets";
+    static constexpr juce::int64 minimumAssetSize = 8 * 1024 * 1024;
+    static constexpr size_t minChunkSize = 256 * 1024;
+    static constexpr size_t averageChunkSize = 1024 * 1024;
+    static constexpr size_t maxChunkSize = 4 * 1024 * 1024;
+    static constexpr juce::int64 maxCloneCacheBytes = (juce::int64) 4 * 1024 * 1024 * 1024;
+
+private:
+    struct CacheEntry
+    {
+        juce::int64 size = 0;
+        juce::int64 modified = 0;
+        juce::String oid;
+    };
+
+    bool storeAsset(const juce::String& relativePath, const std::atomic<bool>* cancelFlag);
+    bool chunkFile(const juce::File& file, Pointer& pointer, const std::atomic<bool>* cancelFlag);
+    bool writeChunk(const uint8_t* data, size_t size, Chunk& chunk);
+    bool reassemble(const Pointer& pointer, const juce::File& target, const std::atomic<bool>* cancelFlag);
+    bool matchesCache(const juce::String& relativePath, const juce::File& file, const juce::String& oid) const;
+    void remember(const juce::String& relativePath, juce::int64 size, juce::int64 modified, const juce::String& oid);
+
+    juce::File getPointerFile(const juce::String& relativePath) const;
+    juce::File getChunkFile(const juce::String& hash) const;
+    std::map<juce::String, juce::File> findPointers() const; // relative asset path -> pointer file
+    void findLargeAudioFiles(const juce::File& directory, const juce::String& relativePath, juce::StringArray& found) const;
+
+    void loadCache();
+    void saveCache();
+
+    juce::File projectDirectory;
+    juce::File pointerDirectory;
+    juce::File chunkDirectory;
+    juce::File cacheFile;
+    juce::File excludeFile;
+
+    CloneCache cloneCache; // earlier versions of rebuilt files, see restoreAssets()
+    std::map<juce::String, CacheEntry> cache; // stat info of files we chunked or rebuilt
+    bool cacheLoaded = false;
+    bool cacheDirty = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AssetStore)
+};
@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+    AudioChangesView.cpp
+
+  ==============================================================================
+*/
+
+#include "AudioChangesView.h"
+
+//==============================================================================
+AudioChangesView::AudioChangesView(juce::Colour background, juce::Colour waveform, juce::Colour text)
+    : backgroundColour(background), waveformColour(waveform), textColour(text)
+{
+}
+
+void AudioChangesView::setComparisons(std::vector<AudioOverviewCache::Comparison> newComparisons)
+{
+    comparisons = std::move(newComparisons);
+
+    juce::StringArray lines;
+    for (const auto& comparison : comparisons)
+        lines.add(comparison.change.path + (comparison.isSameRender() ? "  (same render)" : ""));
+
+    setTooltip(lines.joinIntoString("\n"));
+    repaint();
+}
+
+void AudioChangesView::clear()
+{
+    setComparisons({});
+}
+
+void AudioChangesView::paint(juce::Graphics& g)
+{
+    g.fillAll(backgroundColour);
+    g.setColour(waveformColour);
+    g.drawRect(getLocalBounds());
+
+    g.setFont(9.0f);
+    const int numRows = juce::jmin((int) comparisons.size(), juce::jmax(1, (getHeight() - 2) / rowHeight));
+
+    for (int i = 0; i < numRows; ++i)
+    {
+        const AudioOverviewCache::Comparison& comparison = comparisons[(size_t) i];
+        const juce::Rectangle<float> area(1.0f, 1.0f + (float) (i * rowHeight), (float) getWidth() - 2.0f, (float) rowHeight);
+
+        if (comparison.before != nullptr)
+            paintOverview(g, *comparison.before, area, textColour.withAlpha(0.35f), false);
+
+        if (comparison.after != nullptr)
+            paintOverview(g, *comparison.after, area, waveformColour, true);
+
+        g.setColour(textColour);
+        g.drawText(comparison.change.path.fromLastOccurrenceOf("/", false, false), area.reduced(2.0f, 0.0f),
+                   juce::Justification::topLeft, true);
+
+        if (comparison.isSameRender())
+            g.drawText("same", area.reduced(2.0f, 0.0f), juce::Justification::bottomRight, false);
+        else if (comparison.change.kind != ProjectDiff::Kind::modified)
+            g.drawText(comparison.change.kind == ProjectDiff::Kind::added ? "new" : "gone", area.reduced(2.0f, 0.0f),
+                       juce::Justification::bottomRight, false);
+    }
+
+    if (comparisons.size() > (size_t) numRows)
+    {
+        g.setColour(textColour);
+        g.drawText("+" + juce::String((int) comparisons.size() - numRows), getLocalBounds().reduced(2),
+                   juce::Justification::bottomLeft, false);
+    }
+}
+
+void AudioChangesView::paintOverview(juce::Graphics& g, const AudioOverview& overview, juce::Rectangle<float> area,
+                                     juce::Colour colour, bool filled)
+{
+    const int numBuckets = overview.getNumBuckets();
+    const int width = (int) area.getWidth();
+
+    if (numBuckets <= 0 || width <= 0)
+        return;
+
+    const float centre = area.getCentreY();
+    const float halfHeight = area.getHeight() * 0.5f;
+    juce::Path top, bottom;
+
+    g.setColour(colour);
+
+    // Every channel folded into one envelope, one column per pixel
+    for (int x = 0; x < width; ++x)
+    {
+        const int first = x * numBuckets / width;
+        const int last = juce::jmax(first + 1, (x + 1) * numBuckets / width);
+        float low = 0.0f, high = 0.0f;
+
+        for (int bucket = first; bucket < last; ++bucket)
+        {
+            for (int channel = 0; channel < overview.numChannels; ++channel)
+            {
+                const size_t index = (size_t) bucket * (size_t) overview.numChannels + (size_t) channel;
+                low = juce::jmin(low, overview.minimum[index]);
+                high = juce::jmax(high, overview.maximum[index]);
+            }
+        }
+
+        const float px = area.getX() + (float) x;
+        const float y1 = centre - juce::jlimit(0.0f, 1.0f, high) * halfHeight;
+        const float y2 = centre - juce::jlimit(-1.0f, 0.0f, low) * halfHeight;
+
+        if (filled)
+        {
+            g.drawVerticalLine((int) px, y1, juce::jmax(y1 + 1.0f, y2));
+        }
+        else if (x == 0)
+        {
+            top.startNewSubPath(px, y1);
+            bottom.startNewSubPath(px, y2);
+        }
+        else
+        {
+            top.lineTo(px, y1);
+            bottom.lineTo(px, y2);
+        }
+    }
+
+    if (!filled)
+    {
+        g.strokePath(top, juce::PathStrokeType(1.0f));
+        g.strokePath(bottom, juce::PathStrokeType(1.0f));
+    }
+}
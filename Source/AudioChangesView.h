@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    AudioChangesView.h
+    Waveform thumbnails of the audio files the selected snapshot changed,
+    each drawn over its previous version.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioOverviewCache.h"
+#include <vector>
+
+//==============================================================================
+/**
+    One row per changed file, as many as fit. The new version is drawn
+    solid over a faint outline of the old one, so a trim or a louder take
+    shows at a glance. A file that was bounced again without sounding any
+    different is marked "same". Paints from overviews only and never decodes
+    anything itself.
+*/
+class AudioChangesView : public juce::Component,
+                         public juce::SettableTooltipClient
+{
+public:
+    AudioChangesView(juce::Colour background, juce::Colour waveform, juce::Colour text);
+
+    void setComparisons(std::vector<AudioOverviewCache::Comparison> newComparisons);
+    void clear();
+
+    bool isEmpty() const { return comparisons.empty(); }
+
+    void paint(juce::Graphics&) override;
+
+    static constexpr int rowHeight = 18;
+
+private:
+    void paintOverview(juce::Graphics& g, const AudioOverview& overview, juce::Rectangle<float> area, juce::Colour colour, bool filled);
+
+    std::vector<AudioOverviewCache::Comparison> comparisons;
+    juce::Colour backgroundColour, waveformColour, textColour;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioChangesView)
+};
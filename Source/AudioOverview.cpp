@@ -0,0 +1,287 @@
+/*
+  ==============================================================================
+
+    AudioOverview.cpp
+
+  ==============================================================================
+*/
+
+#include "AudioOverview.h"
+#include <cmath>
+#include <limits>
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+namespace
+{
+    constexpr int fileMagic = 0x53564f57;   // "WOVS"
+    constexpr int fileVersion = 1;
+    constexpr int maxChannels = 64;
+    constexpr float fingerprintSteps = 1.0f / AudioOverview::maxRenderDifference;
+
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    juce::uint64 hashValue(juce::uint64 hash, juce::int64 value)
+    {
+        // FNV-1a over the value's bytes, least significant first so it's the same on every platform
+        for (int i = 0; i < 8; ++i)
+            hash = (hash ^ (juce::uint8) (value >> (i * 8))) * 0x100000001b3ULL;
+
+        return hash;
+    }
+
+    juce::int64 quantise(float value)
+    {
+        return (juce::int64) std::lround(juce::jlimit(-4.0f, 4.0f, value) * fingerprintSteps);
+    }
+}
+
+//==============================================================================
+void AudioOverview::analyseBlock(const float* samples, int numSamples, float& minimum, float& maximum, double& sumOfSquares)
+{
+    float low = minimum;
+    float high = maximum;
+    double sum = 0.0;
+    int i = 0;
+
+   #if JUCE_USE_SSE_INTRINSICS
+    if (numSamples >= 8)
+    {
+        // Two sets of accumulators, so consecutive iterations don't wait on each other
+        __m128 low0 = _mm_set1_ps(low), low1 = low0;
+        __m128 high0 = _mm_set1_ps(high), high1 = high0;
+        __m128 squares0 = _mm_setzero_ps(), squares1 = squares0;
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m128 a = _mm_loadu_ps(samples + i);
+            const __m128 b = _mm_loadu_ps(samples + i + 4);
+
+            low0 = _mm_min_ps(low0, a);
+            low1 = _mm_min_ps(low1, b);
+            high0 = _mm_max_ps(high0, a);
+            high1 = _mm_max_ps(high1, b);
+            squares0 = _mm_add_ps(squares0, _mm_mul_ps(a, a));
+            squares1 = _mm_add_ps(squares1, _mm_mul_ps(b, b));
+        }
+
+        float lows[4], highs[4], squares[4];
+        _mm_storeu_ps(lows, _mm_min_ps(low0, low1));
+        _mm_storeu_ps(highs, _mm_max_ps(high0, high1));
+        _mm_storeu_ps(squares, _mm_add_ps(squares0, squares1));
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            low = juce::jmin(low, lows[lane]);
+            high = juce::jmax(high, highs[lane]);
+            sum += squares[lane];
+        }
+    }
+   #elif JUCE_USE_ARM_NEON
+    if (numSamples >= 8)
+    {
+        float32x4_t low0 = vdupq_n_f32(low), low1 = low0;
+        float32x4_t high0 = vdupq_n_f32(high), high1 = high0;
+        float32x4_t squares0 = vdupq_n_f32(0.0f), squares1 = squares0;
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const float32x4_t a = vld1q_f32(samples + i);
+            const float32x4_t b = vld1q_f32(samples + i + 4);
+
+            low0 = vminq_f32(low0, a);
+            low1 = vminq_f32(low1, b);
+            high0 = vmaxq_f32(high0, a);
+            high1 = vmaxq_f32(high1, b);
+            squares0 = vmlaq_f32(squares0, a, a);
+            squares1 = vmlaq_f32(squares1, b, b);
+        }
+
+        float lows[4], highs[4], squares[4];
+        vst1q_f32(lows, vminq_f32(low0, low1));
+        vst1q_f32(highs, vmaxq_f32(high0, high1));
+        vst1q_f32(squares, vaddq_f32(squares0, squares1));
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            low = juce::jmin(low, lows[lane]);
+            high = juce::jmax(high, highs[lane]);
+            sum += squares[lane];
+        }
+    }
+   #endif
+
+    for (; i < numSamples; ++i)
+    {
+        const float sample = samples[i];
+        low = juce::jmin(low, sample);
+        high = juce::jmax(high, sample);
+        sum += (double) sample * (double) sample;
+    }
+
+    minimum = low;
+    maximum = high;
+    sumOfSquares += sum;
+}
+
+//==============================================================================
+bool AudioOverview::analyse(juce::AudioFormatReader& reader, AudioOverview& overview, const std::atomic<bool>* cancelFlag)
+{
+    overview = AudioOverview();
+
+    if (reader.numChannels <= 0 || (int) reader.numChannels > maxChannels || reader.lengthInSamples <= 0)
+        return false;
+
+    overview.numChannels = (int) reader.numChannels;
+    overview.sampleRate = reader.sampleRate;
+    overview.lengthInSamples = reader.lengthInSamples;
+    overview.samplesPerBucket = (int) juce::jmax((juce::int64) minSamplesPerBucket,
+                                                 (reader.lengthInSamples + maxBuckets - 1) / maxBuckets);
+
+    const juce::int64 bucketSize = overview.samplesPerBucket;
+    const int numBuckets = (int) ((reader.lengthInSamples + bucketSize - 1) / bucketSize);
+    const size_t numValues = (size_t) numBuckets * (size_t) overview.numChannels;
+
+    overview.minimum.assign(numValues, std::numeric_limits<float>::max());
+    overview.maximum.assign(numValues, std::numeric_limits<float>::lowest());
+    overview.rms.assign(numValues, 0.0f);
+    std::vector<double> sums(numValues, 0.0);
+
+    juce::AudioBuffer<float> buffer(overview.numChannels, blockSize);
+
+    for (juce::int64 position = 0; position < reader.lengthInSamples; position += blockSize)
+    {
+        if (isCancelled(cancelFlag))
+            return false;
+
+        const int numSamples = (int) juce::jmin((juce::int64) blockSize, reader.lengthInSamples - position);
+
+        if (!reader.read(&buffer, 0, numSamples, position, true, true))
+            return false;
+
+        // A block can end part way through a bucket: the next block carries on with it
+        for (int offset = 0; offset < numSamples;)
+        {
+            const juce::int64 at = position + offset;
+            const int bucket = (int) (at / bucketSize);
+            const int count = (int) juce::jmin((juce::int64) (numSamples - offset), (bucket + 1) * bucketSize - at);
+
+            for (int channel = 0; channel < overview.numChannels; ++channel)
+            {
+                const size_t index = (size_t) bucket * (size_t) overview.numChannels + (size_t) channel;
+                analyseBlock(buffer.getReadPointer(channel, offset), count, overview.minimum[index], overview.maximum[index], sums[index]);
+            }
+
+            offset += count;
+        }
+    }
+
+    juce::uint64 hash = 0xcbf29ce484222325ULL;
+    hash = hashValue(hash, overview.numChannels);
+    hash = hashValue(hash, overview.lengthInSamples);
+    hash = hashValue(hash, juce::roundToInt(overview.sampleRate));
+
+    for (int bucket = 0; bucket < numBuckets; ++bucket)
+    {
+        const juce::int64 count = juce::jmin(bucketSize, reader.lengthInSamples - bucket * bucketSize);
+
+        for (int channel = 0; channel < overview.numChannels; ++channel)
+        {
+            const size_t index = (size_t) bucket * (size_t) overview.numChannels + (size_t) channel;
+            overview.rms[index] = (float) std::sqrt(sums[index] / (double) count);
+
+            hash = hashValue(hash, quantise(overview.minimum[index]));
+            hash = hashValue(hash, quantise(overview.maximum[index]));
+            hash = hashValue(hash, quantise(overview.rms[index]));
+        }
+    }
+
+    overview.fingerprint = hash;
+    return true;
+}
+
+//==============================================================================
+bool AudioOverview::soundsLike(const AudioOverview& other) const
+{
+    if (numChannels != other.numChannels || lengthInSamples != other.lengthInSamples
+        || juce::roundToInt(sampleRate) != juce::roundToInt(other.sampleRate)
+        || samplesPerBucket != other.samplesPerBucket || rms.size() != other.rms.size())
+        return false;
+
+    if (fingerprint == other.fingerprint)
+        return true;
+
+    for (size_t i = 0; i < rms.size(); ++i)
+    {
+        if (std::abs(minimum[i] - other.minimum[i]) > maxRenderDifference
+            || std::abs(maximum[i] - other.maximum[i]) > maxRenderDifference
+            || std::abs(rms[i] - other.rms[i]) > maxRenderDifference)
+            return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool AudioOverview::writeTo(juce::OutputStream& out) const
+{
+    const int numBuckets = getNumBuckets();
+    bool ok = out.writeInt(fileMagic) && out.writeInt(fileVersion)
+           && out.writeInt(numChannels) && out.writeDouble(sampleRate) && out.writeInt64(lengthInSamples)
+           && out.writeInt(samplesPerBucket) && out.writeInt(numBuckets) && out.writeInt64((juce::int64) fingerprint);
+
+    for (const auto* values : { &minimum, &maximum, &rms })
+        for (size_t i = 0; ok && i < values->size(); ++i)
+            ok = out.writeFloat((*values)[i]);
+
+    return ok;
+}
+
+bool AudioOverview::readFrom(juce::InputStream& in)
+{
+    *this = AudioOverview();
+
+    if (in.readInt() != fileMagic || in.readInt() != fileVersion)
+        return false;
+
+    numChannels = in.readInt();
+    sampleRate = in.readDouble();
+    lengthInSamples = in.readInt64();
+    samplesPerBucket = in.readInt();
+    const int numBuckets = in.readInt();
+    fingerprint = (juce::uint64) in.readInt64();
+
+    if (numChannels <= 0 || numChannels > maxChannels || numBuckets <= 0 || numBuckets > maxBuckets
+        || samplesPerBucket <= 0 || lengthInSamples <= 0)
+    {
+        *this = AudioOverview();
+        return false;
+    }
+
+    const size_t numValues = (size_t) numBuckets * (size_t) numChannels;
+
+    // Cut short by a crash while it was written
+    if (in.getNumBytesRemaining() < (juce::int64) (numValues * 3 * sizeof(float)))
+    {
+        *this = AudioOverview();
+        return false;
+    }
+
+    for (auto* values : { &minimum, &maximum, &rms })
+    {
+        values->resize(numValues);
+
+        for (auto& value : *values)
+            value = in.readFloat();
+    }
+
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    AudioOverview.h
+    Peak and RMS overview of an audio file, small enough to keep on disk for
+    every version of every file, and a fingerprint of how it sounds.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+//==============================================================================
+/**
+    The file is cut into at most maxBuckets buckets of samplesPerBucket
+    samples, and each bucket keeps the minimum, maximum and RMS of every
+    channel. Analysis decodes through an AudioFormatReader in blocks, so
+    memory stays flat whatever the file's length, and runs each block through
+    analyseBlock(), a single pass with SSE2 or NEON where JUCE enables them.
+
+    soundsLike() tells a bounce that renders the same audio into a new file
+    (new timestamps in its chunks, another bit depth, a fresh dither) from an
+    edit: every bucket's minimum, maximum and RMS have to agree to within
+    maxRenderDifference, about -54 dBFS. The fingerprint hashes the overview
+    quantised to those steps. Equal fingerprints settle it without the walk,
+    but values close to a step can round apart, so different ones don't.
+*/
+struct AudioOverview
+{
+    int numChannels = 0;
+    double sampleRate = 0.0;
+    juce::int64 lengthInSamples = 0;
+    int samplesPerBucket = 0;
+
+    // Bucket-major, channel-minor: [bucket * numChannels + channel]
+    std::vector<float> minimum, maximum, rms;
+
+    juce::uint64 fingerprint = 0;
+
+    int getNumBuckets() const { return numChannels > 0 ? (int) (rms.size() / (size_t) numChannels) : 0; }
+
+    /** Decodes everything reader has. Returns false if it was cancelled or the read failed. */
+    static bool analyse(juce::AudioFormatReader& reader, AudioOverview& overview, const std::atomic<bool>* cancelFlag);
+
+    /** Minimum, maximum and sum of squares of numSamples samples, folded into what the three hold already. */
+    static void analyseBlock(const float* samples, int numSamples, float& minimum, float& maximum, double& sumOfSquares);
+
+    /** Same format and length, and no bucket further than maxRenderDifference from other's. */
+    bool soundsLike(const AudioOverview& other) const;
+
+    bool writeTo(juce::OutputStream& out) const;
+    bool readFrom(juce::InputStream& in);
+
+    static constexpr int maxBuckets = 2048;
+    static constexpr int minSamplesPerBucket = 256;
+    static constexpr int blockSize = 65536;     // samples per channel decoded at a time
+    static constexpr float maxRenderDifference = 1.0f / 512.0f;    // ~ -54 dBFS: below any audible edit, above dither
+};
@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    AudioOverviewCache.cpp
+
+  ==============================================================================
+*/
+
+#include "AudioOverviewCache.h"
+#include <string>
+
+//==============================================================================
+namespace
+{
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    struct BlobContent
+    {
+        std::string content;
+    };
+
+    // A blob read out of git, owned by the stream over it so the reader can keep it
+    class BlobStream : private BlobContent,
+                       public juce::MemoryInputStream
+    {
+    public:
+        explicit BlobStream(std::string&& blob)
+            : BlobContent { std::move(blob) },
+              juce::MemoryInputStream(content.data(), content.size(), false) {}
+    };
+}
+
+//==============================================================================
+bool AudioOverviewCache::Comparison::isSameRender() const
+{
+    return change.kind == ProjectDiff::Kind::modified && before != nullptr && after != nullptr
+        && before->soundsLike(*after);
+}
+
+//==============================================================================
+AudioOverviewCache::AudioOverviewCache(const juce::File& gitDirectory)
+    : directory(gitDirectory.getChildFile("snaptrack").getChildFile("overviews"))
+{
+    formats.registerBasicFormats();
+}
+
+std::shared_ptr<const AudioOverview> AudioOverviewCache::getOverview(GitRepositoryWorker& worker, AssetStore* assets,
+                                                                     const ProjectDiff::AudioBlob& blob, const juce::String& path,
+                                                                     const std::atomic<bool>* cancelFlag)
+{
+    if (blob.oid.isEmpty())
+        return nullptr;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        for (auto it = overviews.begin(); it != overviews.end(); ++it)
+        {
+            if (it->first == blob.oid)
+            {
+                overviews.splice(overviews.begin(), overviews, it);
+                return overviews.front().second;
+            }
+        }
+    }
+
+    const juce::File cacheFile = getCacheFile(blob.oid);
+
+    {
+        juce::FileInputStream in(cacheFile);
+        auto overview = std::make_shared<AudioOverview>();
+
+        if (in.openedOk() && overview->readFrom(in))
+        {
+            remember(blob.oid, overview);
+            return overview;
+        }
+    }
+
+    std::unique_ptr<juce::InputStream> source = openBlob(worker, assets, blob);
+
+    if (source == nullptr || isCancelled(cancelFlag))
+        return nullptr;
+
+    // The extension picks the format where it can; otherwise every format gets a look at the header
+    std::unique_ptr<juce::AudioFormatReader> reader;
+
+    if (juce::AudioFormat* format = formats.findFormatForFileExtension(path.fromLastOccurrenceOf(".", true, false)))
+    {
+        reader.reset(format->createReaderFor(source.get(), false));
+
+        if (reader != nullptr)
+            source.release();
+        else
+            source->setPosition(0);
+    }
+
+    if (reader == nullptr && source != nullptr)
+        reader.reset(formats.createReaderFor(std::move(source)));
+
+    auto overview = std::make_shared<AudioOverview>();
+
+    if (reader == nullptr || !AudioOverview::analyse(*reader, *overview, cancelFlag))
+        return nullptr;
+
+    juce::TemporaryFile temp(cacheFile);
+
+    if (cacheFile.getParentDirectory().createDirectory())
+    {
+        bool written = false;
+
+        {
+            juce::FileOutputStream out(temp.getFile());
+            written = out.openedOk() && overview->writeTo(out);
+            out.flush();
+            written = written && !out.getStatus().failed();
+        }
+
+        if (written)
+            temp.overwriteTargetFileWithTemporary();
+    }
+
+    remember(blob.oid, overview);
+    return overview;
+}
+
+std::vector<AudioOverviewCache::Comparison> AudioOverviewCache::compare(GitRepositoryWorker& worker, AssetStore* assets,
+                                                                        const juce::Array<ProjectDiff::AudioChange>& changes,
+                                                                        const std::atomic<bool>* cancelFlag)
+{
+    std::vector<Comparison> comparisons;
+
+    for (const auto& change : changes)
+    {
+        if (isCancelled(cancelFlag))
+            break;
+
+        Comparison comparison;
+        comparison.change = change;
+        comparison.before = getOverview(worker, assets, change.oldBlob, change.path, cancelFlag);
+        comparison.after = getOverview(worker, assets, change.newBlob, change.path, cancelFlag);
+        comparisons.push_back(std::move(comparison));
+    }
+
+    return comparisons;
+}
+
+//==============================================================================
+std::unique_ptr<juce::InputStream> AudioOverviewCache::openBlob(GitRepositoryWorker& worker, AssetStore* assets,
+                                                                const ProjectDiff::AudioBlob& blob)
+{
+    juce::String type;
+    std::string content;
+
+    if (!worker.readObject(blob.oid, type, content) || type != "blob")
+        return nullptr;
+
+    if (!blob.isPointer)
+        return std::make_unique<BlobStream>(std::move(content));
+
+    AssetStore::Pointer pointer;
+
+    if (assets == nullptr || !AssetStore::Pointer::parse(juce::String::fromUTF8(content.data(), (int) content.size()), pointer))
+        return nullptr;
+
+    return assets->createInputStream(pointer);
+}
+
+juce::File AudioOverviewCache::getCacheFile(const juce::String& oid) const
+{
+    return directory.getChildFile(oid.substring(0, 2)).getChildFile(oid.substring(2));
+}
+
+void AudioOverviewCache::remember(const juce::String& oid, std::shared_ptr<const AudioOverview> overview)
+{
+    const juce::ScopedLock sl(lock);
+
+    for (auto it = overviews.begin(); it != overviews.end(); ++it)
+    {
+        if (it->first == oid)
+        {
+            overviews.erase(it);
+            break;
+        }
+    }
+
+    overviews.emplace_front(oid, std::move(overview));
+
+    while ((int) overviews.size() > maxCachedOverviews)
+        overviews.pop_back();
+}
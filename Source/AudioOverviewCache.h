@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    AudioOverviewCache.h
+    Overviews of every version of the audio files snapshots changed, analysed
+    once per blob and kept under .git/snaptrack/overviews.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioOverview.h"
+#include "AssetStore.h"
+#include "GitRepositoryWorker.h"
+#include "ProjectDiff.h"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/**
+    A version of an audio file is named by its git blob: the file's own blob,
+    or the blob of its AssetStore pointer, which is just as unique. So an
+    overview never goes stale and is worked out once, whichever snapshot,
+    branch or instance asks for it first.
+
+    A lookup tries the most recently used overviews in memory, then the
+    cache directory, and only then decodes the audio. Plain blobs are read
+    whole out of git; pointers are read straight from the chunk store without
+    rebuilding the file. Decoding goes through the formats
+    AudioFormatManager::registerBasicFormats() knows.
+
+    Thread safe. compare() does its work on the calling thread, so call it
+    from a background queue.
+*/
+class AudioOverviewCache
+{
+public:
+    struct Comparison
+    {
+        ProjectDiff::AudioChange change;
+        std::shared_ptr<const AudioOverview> before, after;    // null where there's no version or it can't be decoded
+
+        /** New bytes, same audio: a re-bounce that changed nothing you can hear. */
+        bool isSameRender() const;
+    };
+
+    explicit AudioOverviewCache(const juce::File& gitDirectory);
+
+    /** The overview of one version of a file, or nullptr if it couldn't be decoded or was cancelled. */
+    std::shared_ptr<const AudioOverview> getOverview(GitRepositoryWorker& worker, AssetStore* assets,
+                                                     const ProjectDiff::AudioBlob& blob, const juce::String& path,
+                                                     const std::atomic<bool>* cancelFlag);
+
+    /** Both sides of every audio change, as far as cancelFlag lets it get. */
+    std::vector<Comparison> compare(GitRepositoryWorker& worker, AssetStore* assets,
+                                    const juce::Array<ProjectDiff::AudioChange>& changes, const std::atomic<bool>* cancelFlag);
+
+    static constexpr int maxCachedOverviews = 32;
+
+private:
+    std::unique_ptr<juce::InputStream> openBlob(GitRepositoryWorker& worker, AssetStore* assets, const ProjectDiff::AudioBlob& blob);
+    juce::File getCacheFile(const juce::String& oid) const;
+    void remember(const juce::String& oid, std::shared_ptr<const AudioOverview> overview);
+
+    const juce::File directory;
+
+    juce::CriticalSection lock;
+    std::list<std::pair<juce::String, std::shared_ptr<const AudioOverview>>> overviews; // most recently used first
+
+    juce::AudioFormatManager formats;   // only read after the constructor, so no lock
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioOverviewCache)
+};
@@ -0,0 +1,666 @@
+/*
+  ==============================================================================
+
+    CheckoutEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "CheckoutEngine.h"
+#include "ProcessRunner.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <set>
+
+#if ! JUCE_WINDOWS
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    constexpr uint32_t modeExecutable = 0100755;
+    constexpr uint32_t modeSymlink = 0120000;
+    constexpr uint32_t modeGitlink = 0160000;
+    constexpr uint32_t modeTree = 040000;
+
+    constexpr int readTimeoutMs = 30000;
+    constexpr size_t writeBlockSize = 256 * 1024;
+
+    juce::String toHex(const std::string& raw)
+    {
+        return juce::String::toHexString(raw.data(), (int) raw.size(), 0);
+    }
+
+    std::string fromHex(const juce::String& hex)
+    {
+        if (hex.length() != 40 || !hex.containsOnly("0123456789abcdefABCDEF"))
+            return {};
+
+        std::string raw(20, '\0');
+        for (int i = 0; i < 20; ++i)
+            raw[(size_t) i] = (char) hex.substring(i * 2, i * 2 + 2).getHexValue32();
+
+        return raw;
+    }
+
+    struct TreeItem
+    {
+        std::string key;    // the name, with a '/' after directories: git's tree order
+        std::string name;
+        uint32_t mode = 0;
+        std::string oid;
+    };
+
+    bool parseTree(const std::string& content, std::vector<TreeItem>& items)
+    {
+        size_t at = 0;
+
+        while (at < content.size())
+        {
+            const size_t space = content.find(' ', at);
+            const size_t nul = content.find('\0', space == std::string::npos ? at : space);
+            if (space == std::string::npos || nul == std::string::npos || nul + 21 > content.size())
+                return false;
+
+            TreeItem item;
+            item.mode = (uint32_t) std::strtoul(content.substr(at, space - at).c_str(), nullptr, 8);
+            item.name = content.substr(space + 1, nul - space - 1);
+            item.key = item.mode == modeTree ? item.name + "/" : item.name;
+            item.oid = content.substr(nul + 1, 20);
+            items.push_back(std::move(item));
+            at = nul + 21;
+        }
+
+        return true;
+    }
+
+    std::string readCommitTree(GitRepositoryWorker& worker, const juce::String& commitOid)
+    {
+        juce::String type;
+        std::string content;
+
+        if (!worker.readObject(commitOid, type, content) || type != "commit" || content.compare(0, 5, "tree ") != 0 || content.size() < 45)
+            return {};
+
+        return fromHex(juce::String(content.substr(5, 40)));
+    }
+}
+
+//==============================================================================
+CheckoutEngine::CheckoutEngine(const juce::File& project, const juce::File& git)
+    : projectDirectory(project),
+      gitDirectory(git),
+      pendingFile(git.getChildFile("snaptrack").getChildFile("pending-checkout")),
+      cloneCache(git.getChildFile("snaptrack").getChildFile("checkout-cache"), maxCacheBytes)
+{
+}
+
+juce::File CheckoutEngine::getFile(const std::string& path) const
+{
+    return projectDirectory.getChildFile(juce::String::fromUTF8(path.c_str()));
+}
+
+CheckoutEngine::Outcome CheckoutEngine::checkout(GitRepositoryWorker& worker, SnapshotBuilder& builder, const juce::String& target,
+                                                 const std::atomic<bool>* cancelFlag, bool deferSamples)
+{
+    const auto start = Clock::now();
+    statistics = Statistics();
+    lastError.clear();
+
+    // The rest of an earlier checkout has to land before this one can be compared against HEAD
+    if (target.isEmpty() || target.startsWithChar('-') || hasPendingFiles())
+        return Outcome::unsupported;
+
+    const juce::String headOid = worker.resolveRef("HEAD");
+    const juce::String head = gitDirectory.getChildFile("HEAD").loadFileAsString().trim();
+    const juce::String currentBranch = head.startsWith("ref: refs/heads/") ? head.fromFirstOccurrenceOf("ref: refs/heads/", false, false)
+                                                                           : juce::String();
+
+    // A local branch, or a full commit id. Tags, short ids and remote names are left to git.
+    juce::String targetOid = worker.resolveRef("refs/heads/" + target);
+    const bool isBranch = targetOid.isNotEmpty();
+
+    if (!isBranch && fromHex(target).size() == 20)
+        targetOid = target.toLowerCase();
+
+    if (headOid.isEmpty() || targetOid.isEmpty())
+        return Outcome::unsupported;
+
+    const std::string headTree = readCommitTree(worker, headOid);
+    const std::string targetTree = readCommitTree(worker, targetOid);
+
+    if (headTree.empty() || targetTree.empty())
+        return Outcome::unsupported;
+
+    // Already there, the way "git checkout" would leave it
+    if ((isBranch && currentBranch == target) || (!isBranch && currentBranch.isEmpty() && headOid == targetOid))
+        return Outcome::done;
+
+    //==============================================================================
+    const auto diffStart = Clock::now();
+    std::vector<SnapshotBuilder::CheckoutChange> changes;
+
+    if (!diffTrees(worker, headTree, targetTree, {}, changes))
+        return Outcome::unsupported;
+
+    statistics.diffMs = millisecondsSince(diffStart);
+    statistics.numChanged = (int) changes.size();
+
+    std::set<std::string> removed;
+    for (const auto& change : changes)
+    {
+        if (change.oldMode == modeGitlink || change.newMode == modeGitlink)
+            return Outcome::unsupported;
+
+       #if JUCE_WINDOWS
+        if (change.oldMode == modeSymlink || change.newMode == modeSymlink)
+            return Outcome::unsupported;
+       #endif
+
+        if (change.newOid.empty())
+            removed.insert(change.path);
+    }
+
+    // A file the target has, where something untracked is in the way of it or of its directory
+    for (const auto& change : changes)
+    {
+        if (change.newOid.empty())
+            continue;
+
+        const juce::File file = getFile(change.path);
+
+        if (change.oldOid.empty() && file.isDirectory() && !file.isSymbolicLink())
+        {
+            for (const auto& item : juce::RangedDirectoryIterator(file, true, "*", juce::File::findFiles))
+                if (removed.count(item.getFile().getRelativePathFrom(projectDirectory).replaceCharacter('\\', '/').toStdString()) == 0)
+                    return Outcome::unsupported;
+        }
+
+        for (size_t slash = change.path.find('/'); slash != std::string::npos; slash = change.path.find('/', slash + 1))
+        {
+            const std::string parent = change.path.substr(0, slash);
+            const juce::File parentFile = getFile(parent);
+
+            if (!parentFile.isDirectory() && (parentFile.existsAsFile() || parentFile.isSymbolicLink()) && removed.count(parent) == 0)
+                return Outcome::unsupported;
+        }
+    }
+
+    if (!builder.canCheckout(worker, changes, headTree, cancelFlag))
+        return isCancelled(cancelFlag) ? Outcome::cancelled : Outcome::unsupported;
+
+    //==============================================================================
+    // Removals first, deepest first, so a file can take the place of a directory that went
+    std::sort(changes.begin(), changes.end(), [](const SnapshotBuilder::CheckoutChange& a, const SnapshotBuilder::CheckoutChange& b)
+    {
+        if (a.newOid.empty() != b.newOid.empty())
+            return a.newOid.empty();
+
+        return a.newOid.empty() ? a.path > b.path : a.path < b.path;
+    });
+
+    std::vector<bool> deferred(changes.size(), false);
+
+    // Files already there untracked (and identical) stay if the checkout has to be undone
+    std::vector<bool> keepOnUndo(changes.size(), false);
+    for (size_t i = 0; i < changes.size(); ++i)
+        keepOnUndo[i] = changes[i].oldOid.empty() && getFile(changes[i].path).existsAsFile();
+
+    // After a write fails: put back what was written, so HEAD still describes the working tree
+    auto fail = [&](size_t numApplied, const juce::String& error)
+    {
+        std::vector<bool> skip(changes.size(), false);
+        for (size_t i = 0; i < changes.size(); ++i)
+            skip[i] = deferred[i] || keepOnUndo[i];
+
+        lastError = undoChanges(worker, changes, numApplied, skip)
+                        ? error + ". Nothing was changed."
+                        : error + ", and the files already written couldn't all be put back. Check the working tree before you snapshot it.";
+        DBG("Checkout: " + lastError);
+        return Outcome::failed;
+    };
+
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        const auto& change = changes[i];
+
+        // Samples the clone cache can't hand back for free wait for finishCheckout()
+        if (deferSamples && !change.newOid.empty() && change.newMode != modeSymlink
+            && juce::File::createFileWithoutCheckingPath(juce::String::fromUTF8(change.path.c_str())).hasFileExtension(sampleExtensions)
+            && !cloneCache.contains(toHex(change.newOid)))
+        {
+            deferred[i] = true;
+            continue;
+        }
+
+        // Half a checkout is worse than a slow one: once writing has started, finish it
+        const bool ok = change.newOid.empty() ? removeFile(worker, change) : writeFile(worker, change);
+
+        if (!ok)
+            return fail(i, "The checkout couldn't write " + juce::String::fromUTF8(change.path.c_str()));
+    }
+
+    //==============================================================================
+    ProcessRunner::Options options;
+    options.workingDirectory = projectDirectory.getFullPathName().toStdString();
+    options.timeoutMs = 10000;
+
+    const std::string reflogMessage = ("checkout: moving from " + (currentBranch.isNotEmpty() ? currentBranch : headOid)
+                                       + " to " + target).toStdString();
+
+    const ProcessResult moved = isBranch
+        ? ProcessRunner::run({ "git", "symbolic-ref", "-m", reflogMessage, "HEAD", ("refs/heads/" + target).toStdString() }, options)
+        : ProcessRunner::run({ "git", "update-ref", "--no-deref", "-m", reflogMessage, "HEAD", targetOid.toStdString() }, options);
+
+    if (!moved.succeeded())
+        return fail(changes.size(), "The checkout couldn't move HEAD to " + target);
+
+    statistics.numDeferred = (int) std::count(deferred.begin(), deferred.end(), true);
+
+    if (statistics.numDeferred > 0)
+    {
+        // The index follows once every file is in place, so nothing half restored gets snapshotted
+        pending.previousTree = headTree;
+        pending.targetTree = targetTree;
+        pending.changes = changes;
+        pending.deferred = deferred;
+        pendingLoaded = true;
+        savePending();
+
+        statistics.totalMs = millisecondsSince(start);
+        return Outcome::done;
+    }
+
+    // If this fails the next snapshot rescans the project instead, which is slower but just as right
+    if (!builder.recordCheckout(worker, changes, headTree, targetTree))
+        DBG("Checkout couldn't update the index");
+
+    statistics.totalMs = millisecondsSince(start);
+    return Outcome::done;
+}
+
+//==============================================================================
+bool CheckoutEngine::hasPendingFiles()
+{
+    loadPending();
+    return !pending.changes.empty();
+}
+
+int CheckoutEngine::getNumPendingFiles()
+{
+    loadPending();
+    return (int) std::count(pending.deferred.begin(), pending.deferred.end(), true);
+}
+
+CheckoutEngine::Outcome CheckoutEngine::finishCheckout(GitRepositoryWorker& worker, SnapshotBuilder& builder, const juce::StringArray& priorityOrder,
+                                                       const std::atomic<bool>* cancelFlag, std::function<void(int, int)> progress,
+                                                       int maxFiles)
+{
+    if (!hasPendingFiles())
+        return Outcome::done;
+
+    // The project file's own order: what it loads first arrives first, everything unreferenced last
+    std::vector<size_t> order;
+    for (size_t i = 0; i < pending.changes.size(); ++i)
+        if (pending.deferred[i])
+            order.push_back(i);
+
+    auto rank = [&priorityOrder](const std::string& path)
+    {
+        const int index = priorityOrder.indexOf(juce::String::fromUTF8(path.c_str()));
+        return index < 0 ? priorityOrder.size() : index;
+    };
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return rank(pending.changes[a].path) < rank(pending.changes[b].path);
+    });
+
+    for (size_t done = 0; done < order.size(); ++done)
+    {
+        if (isCancelled(cancelFlag))
+        {
+            savePending();
+            return Outcome::cancelled;
+        }
+
+        if (maxFiles >= 0 && done >= (size_t) maxFiles)
+        {
+            savePending();
+            return Outcome::done;
+        }
+
+        if (progress != nullptr)
+            progress((int) done, (int) order.size());
+
+        if (!writeFile(worker, pending.changes[order[done]]))
+        {
+            DBG("Checkout couldn't write " + juce::String::fromUTF8(pending.changes[order[done]].path.c_str()));
+            savePending();
+            return Outcome::failed;
+        }
+
+        pending.deferred[order[done]] = false;
+    }
+
+    if (!builder.recordCheckout(worker, pending.changes, pending.previousTree, pending.targetTree))
+        DBG("Checkout couldn't update the index");
+
+    pending = Pending();
+    savePending();
+    return Outcome::done;
+}
+
+void CheckoutEngine::loadPending()
+{
+    if (pendingLoaded)
+        return;
+
+    pendingLoaded = true;
+
+    juce::StringArray lines;
+    lines.addLines(pendingFile.loadFileAsString());
+
+    // "<previous tree> <target tree>", then "<old mode> <new mode> <old id|-> <new id|-> <deferred>\t<path>"
+    if (lines.isEmpty())
+        return;
+
+    pending.previousTree = fromHex(lines[0].upToFirstOccurrenceOf(" ", false, false));
+    pending.targetTree = fromHex(lines[0].fromFirstOccurrenceOf(" ", false, false));
+
+    for (int i = 1; i < lines.size(); ++i)
+    {
+        juce::StringArray fields;
+        fields.addTokens(lines[i].upToFirstOccurrenceOf("\t", false, false), " ", "");
+
+        if (fields.size() != 5)
+            continue;
+
+        SnapshotBuilder::CheckoutChange change;
+        change.oldMode = (uint32_t) fields[0].getLargeIntValue();
+        change.newMode = (uint32_t) fields[1].getLargeIntValue();
+        change.oldOid = fromHex(fields[2]);
+        change.newOid = fromHex(fields[3]);
+        change.path = lines[i].fromFirstOccurrenceOf("\t", false, false).toStdString();
+
+        pending.changes.push_back(std::move(change));
+        pending.deferred.push_back(fields[4] == "1");
+    }
+
+    if (pending.previousTree.empty() || pending.targetTree.empty())
+        pending = Pending();
+}
+
+void CheckoutEngine::savePending()
+{
+    if (pending.changes.empty())
+    {
+        pendingFile.deleteFile();
+        return;
+    }
+
+    juce::String text;
+    text << toHex(pending.previousTree) << " " << toHex(pending.targetTree) << "\n";
+
+    for (size_t i = 0; i < pending.changes.size(); ++i)
+    {
+        const auto& change = pending.changes[i];
+        text << (int) change.oldMode << " " << (int) change.newMode << " "
+             << (change.oldOid.empty() ? juce::String("-") : toHex(change.oldOid)) << " "
+             << (change.newOid.empty() ? juce::String("-") : toHex(change.newOid)) << " "
+             << (pending.deferred[i] ? "1" : "0") << "\t" << juce::String::fromUTF8(change.path.c_str()) << "\n";
+    }
+
+    pendingFile.getParentDirectory().createDirectory();
+    pendingFile.replaceWithText(text);
+}
+
+//==============================================================================
+bool CheckoutEngine::diffTrees(GitRepositoryWorker& worker, const std::string& oldTree, const std::string& newTree,
+                               const std::string& prefix, std::vector<SnapshotBuilder::CheckoutChange>& changes)
+{
+    std::vector<TreeItem> oldItems, newItems;
+
+    for (const auto* tree : { &oldTree, &newTree })
+    {
+        if (tree->empty())
+            continue;
+
+        juce::String type;
+        std::string content;
+        if (!worker.readObject(toHex(*tree), type, content) || type != "tree"
+            || !parseTree(content, tree == &oldTree ? oldItems : newItems))
+            return false;
+    }
+
+    auto oldItem = oldItems.begin();
+    auto newItem = newItems.begin();
+
+    // Both lists are in tree order: walk them side by side
+    while (oldItem != oldItems.end() || newItem != newItems.end())
+    {
+        const int order = oldItem == oldItems.end() ? 1
+                        : newItem == newItems.end() ? -1
+                        : oldItem->key.compare(newItem->key);
+
+        const TreeItem* before = order <= 0 ? &*oldItem : nullptr;
+        const TreeItem* after = order >= 0 ? &*newItem : nullptr;
+
+        if (before != nullptr)
+            ++oldItem;
+        if (after != nullptr)
+            ++newItem;
+
+        if (before != nullptr && after != nullptr && before->oid == after->oid && before->mode == after->mode)
+            continue;
+
+        const std::string path = prefix + (before != nullptr ? before->name : after->name);
+
+        if ((before != nullptr ? before->mode : after->mode) == modeTree)
+        {
+            if (!diffTrees(worker, before != nullptr ? before->oid : std::string(), after != nullptr ? after->oid : std::string(),
+                           path + "/", changes))
+                return false;
+
+            continue;
+        }
+
+        SnapshotBuilder::CheckoutChange change;
+        change.path = path;
+
+        if (before != nullptr)
+        {
+            change.oldOid = before->oid;
+            change.oldMode = before->mode;
+        }
+
+        if (after != nullptr)
+        {
+            change.newOid = after->oid;
+            change.newMode = after->mode;
+        }
+
+        changes.push_back(std::move(change));
+    }
+
+    return true;
+}
+
+bool CheckoutEngine::removeFile(GitRepositoryWorker&, const SnapshotBuilder::CheckoutChange& change)
+{
+    const juce::File file = getFile(change.path);
+
+    // Kept for free, for when the user switches back
+    if (change.oldMode != modeSymlink && file.getSize() >= cloneThreshold)
+        cloneCache.remember(toHex(change.oldOid), file);
+
+    if ((file.existsAsFile() || file.isSymbolicLink()) && !file.deleteFile())
+        return false;
+
+    ++statistics.numRemoved;
+
+    // Like git, don't leave empty directories behind
+    for (juce::File parent = file.getParentDirectory(); parent != projectDirectory && parent.isAChildOf(projectDirectory);
+         parent = parent.getParentDirectory())
+    {
+        if (parent.getNumberOfChildFiles(juce::File::findFilesAndDirectories) > 0 || !parent.deleteFile())
+            break;
+    }
+
+    return true;
+}
+
+bool CheckoutEngine::undoChanges(GitRepositoryWorker& worker, const std::vector<SnapshotBuilder::CheckoutChange>& changes, size_t numApplied,
+                                 const std::vector<bool>& skip)
+{
+    bool undone = true;
+
+    for (size_t i = numApplied; i-- > 0;)
+    {
+        if (skip[i])
+            continue;
+
+        // The same change the other way round; the objects of both sides are in the repository
+        SnapshotBuilder::CheckoutChange reverse = changes[i];
+        std::swap(reverse.oldOid, reverse.newOid);
+        std::swap(reverse.oldMode, reverse.newMode);
+
+        if (!(reverse.newOid.empty() ? removeFile(worker, reverse) : writeFile(worker, reverse)))
+            undone = false;
+    }
+
+    return undone;
+}
+
+bool CheckoutEngine::writeFile(GitRepositoryWorker& worker, const SnapshotBuilder::CheckoutChange& change)
+{
+    const juce::File file = getFile(change.path);
+    const juce::File temp = file.getSiblingFile(file.getFileName() + CloneCache::temporarySuffix);
+    const juce::String key = toHex(change.newOid);
+    file.getParentDirectory().createDirectory();
+
+    if (!change.oldOid.empty() && change.oldMode != modeSymlink && file.getSize() >= cloneThreshold)
+        cloneCache.remember(toHex(change.oldOid), file);
+
+    // An untracked copy that canCheckout() found identical
+    if (change.oldOid.empty() && file.existsAsFile())
+        return file.setExecutePermission(change.newMode == modeExecutable);
+
+    if (change.newMode != modeSymlink && cloneCache.materialise(key, file))
+    {
+        ++statistics.numFromCache;
+        return file.setExecutePermission(change.newMode == modeExecutable);
+    }
+
+    temp.deleteFile();
+    juce::int64 size = 0;
+
+    if (change.newMode == modeSymlink)
+    {
+       #if JUCE_WINDOWS
+        return false;
+       #else
+        std::string target;
+        if (!readBlob(worker, key, size, [&target](const std::string& block) { target += block; return true; })
+            || ::symlink(target.c_str(), temp.getFullPathName().toRawUTF8()) != 0)
+            return false;
+       #endif
+    }
+    else
+    {
+        // Written next to the file and renamed over it: the DAW never sees half a file, and
+        // the inode the clone cache may share with the old version is left alone
+        bool written = false;
+        {
+            juce::FileOutputStream out(temp);
+            written = out.openedOk()
+                   && readBlob(worker, key, size, [&out](const std::string& block) { return out.write(block.data(), block.size()); });
+            out.flush();
+            written = written && out.getStatus().wasOk();
+        }
+
+        if (!written || !temp.setExecutePermission(change.newMode == modeExecutable))
+        {
+            temp.deleteFile();
+            return false;
+        }
+    }
+
+    if (!temp.moveFileTo(file))
+    {
+        temp.deleteFile();
+        return false;
+    }
+
+    ++statistics.numWritten;
+    statistics.bytesWritten += size;
+
+    if (change.newMode != modeSymlink && size >= cloneThreshold)
+        cloneCache.remember(key, file);
+
+    return true;
+}
+
+bool CheckoutEngine::readBlob(GitRepositoryWorker& worker, const juce::String& oid, juce::int64& size,
+                              const std::function<bool(const std::string&)>& consume)
+{
+    if (!blobReader.isRunning()
+        && !blobReader.start({ "git", "--git-dir=" + worker.getGitDirectory().getFullPathName().toStdString(), "cat-file", "--batch" }, {}))
+        return false;
+
+    // "<oid> blob <size>", or "<oid> missing"
+    std::string header;
+    if (!blobReader.write(oid.toStdString() + "\n") || !blobReader.readLine(header, readTimeoutMs))
+    {
+        blobReader.stop();
+        return false;
+    }
+
+    const juce::StringArray fields = juce::StringArray::fromTokens(juce::String(header), " ", "");
+    if (fields.size() != 3 || fields[1] != "blob")
+    {
+        // Whatever else came back may still be on its way: start afresh next time
+        blobReader.stop();
+        return false;
+    }
+
+    size = fields[2].getLargeIntValue();
+    std::string block;
+
+    for (juce::int64 remaining = size; remaining > 0;)
+    {
+        const size_t count = (size_t) juce::jmin(remaining, (juce::int64) writeBlockSize);
+        block.clear();
+
+        if (!blobReader.readBytes(count, block, readTimeoutMs) || !consume(block))
+        {
+            blobReader.stop();
+            return false;
+        }
+
+        remaining -= (juce::int64) count;
+    }
+
+    // The newline after the content
+    block.clear();
+    if (!blobReader.readBytes(1, block, readTimeoutMs))
+    {
+        blobReader.stop();
+        return false;
+    }
+
+    return true;
+}
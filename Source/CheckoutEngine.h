@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    CheckoutEngine.h
+    Switches the working tree to another snapshot by writing only the files
+    that differ, with big ones coming out of a clone cache.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CloneCache.h"
+#include "GitRepositoryWorker.h"
+#include "ProcessRunner.h"
+#include "SnapshotBuilder.h"
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+//==============================================================================
+/**
+    A native "git checkout <branch or commit>".
+
+    The two commits' trees are compared first, descending only into
+    subtrees whose ids differ, so the cost follows the size of the change.
+    Before anything is written, every file the checkout replaces is checked
+    against HEAD (stat data first, content if that's unsure), so unsnapshotted
+    work is never overwritten. Then only the changed files are written.
+
+    Files of cloneThreshold bytes or more go through a CloneCache. The version
+    being replaced is kept as a reflink or hardlink, and the version being
+    checked out comes from the cache if an earlier switch left it there.
+    Switching back and forth between two snapshots of a big project then
+    costs a rename per file instead of hundreds of megabytes of writes.
+
+    A checkout can also be staged: the project file and small files first,
+    then the samples in the order the project references them, so the DAW
+    can reopen before the whole tree is in place (see finishCheckout()).
+
+    Anything it doesn't handle (submodules, tags or short ids, symlinks on
+    Windows, a staging area with something in it, files in the way) is
+    reported as unsupported before the working tree is touched, and the
+    caller runs git instead. A write that fails once writing has started puts
+    back what was already written, so HEAD and the working tree never
+    disagree; running git over the result is never right. Not thread safe:
+    use it from the job queue.
+*/
+class CheckoutEngine
+{
+public:
+    enum class Outcome
+    {
+        done,
+        unsupported,    // nothing was written; the caller should use git instead
+        failed,         // see getLastError(); the caller must not run git over the working tree
+        cancelled
+    };
+
+    struct Statistics
+    {
+        int numChanged = 0;
+        int numWritten = 0;
+        int numRemoved = 0;
+        int numFromCache = 0;
+        int numDeferred = 0;
+        juce::int64 bytesWritten = 0;
+        double diffMs = 0.0;
+        double totalMs = 0.0;
+    };
+
+    CheckoutEngine(const juce::File& projectDirectory, const juce::File& gitDirectory);
+
+    /** Checks out target, a local branch name or a full commit id, and moves HEAD to it.
+
+        With deferSamples, audio files that aren't in the clone cache are left for
+        finishCheckout(): the project file and everything small are in place when this returns,
+        so the DAW can be reopened while the samples are still being written.
+    */
+    Outcome checkout(GitRepositoryWorker& worker, SnapshotBuilder& builder, const juce::String& target,
+                     const std::atomic<bool>* cancelFlag, bool deferSamples = false);
+
+    /** True while files of a deferred checkout are still to be written, also after a restart. */
+    bool hasPendingFiles();
+    int getNumPendingFiles();
+
+    /** Writes the deferred files, those named in priorityOrder first and in that order, then
+        brings the index up to date. progress is called with (files done, files in total).
+        With maxFiles of 0 or more only that many are written and the rest stay pending.
+    */
+    Outcome finishCheckout(GitRepositoryWorker& worker, SnapshotBuilder& builder, const juce::StringArray& priorityOrder,
+                           const std::atomic<bool>* cancelFlag, std::function<void(int, int)> progress = nullptr,
+                           int maxFiles = -1);
+
+    const Statistics& getLastStatistics() const { return statistics; }
+
+    /** Why the last call failed, and whether the working tree was put back. */
+    const juce::String& getLastError() const { return lastError; }
+
+    /** Every file that differs between two trees (raw ids, empty for no tree), descending only
+        into subtrees whose ids differ. Submodules that changed come back with a gitlink mode.
+    */
+    static bool diffTrees(GitRepositoryWorker& worker, const std::string& oldTree, const std::string& newTree,
+                          const std::string& prefix, std::vector<SnapshotBuilder::CheckoutChange>& changes);
+
+    static constexpr juce::int64 cloneThreshold = 1024 * 1024;
+    static constexpr const char* sampleExtensions = "wav;wave;aif;aiff;w64;caf;flac;mp3;ogg;m4a";
+    static constexpr juce::int64 maxCacheBytes = (juce::int64) 4 * 1024 * 1024 * 1024;
+
+private:
+    bool removeFile(GitRepositoryWorker& worker, const SnapshotBuilder::CheckoutChange& change);
+    bool writeFile(GitRepositoryWorker& worker, const SnapshotBuilder::CheckoutChange& change);
+    // Streams a blob a block at a time through blobReader, so a long stem holds neither the
+    // worker's lock nor its size in memory
+    bool readBlob(GitRepositoryWorker& worker, const juce::String& oid, juce::int64& size,
+                  const std::function<bool(const std::string&)>& consume);
+    // Reverses the first numApplied changes (all of which succeeded), newest first, except those marked in skip
+    bool undoChanges(GitRepositoryWorker& worker, const std::vector<SnapshotBuilder::CheckoutChange>& changes, size_t numApplied,
+                     const std::vector<bool>& skip);
+    juce::File getFile(const std::string& path) const;
+    void loadPending();
+    void savePending();
+
+    // A checkout whose deferred files are still to come, kept in .git/snaptrack/pending-checkout
+    struct Pending
+    {
+        std::string previousTree, targetTree;
+        std::vector<SnapshotBuilder::CheckoutChange> changes;
+        std::vector<bool> deferred;
+    };
+
+    juce::File projectDirectory;
+    juce::File gitDirectory;
+    juce::File pendingFile;
+    CloneCache cloneCache;
+    CoProcess blobReader;   // the engine's own "git cat-file --batch", see readBlob()
+
+    Pending pending;
+    bool pendingLoaded = false;
+
+    Statistics statistics;
+    juce::String lastError;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CheckoutEngine)
+};
@@ -0,0 +1,213 @@
+/*
+  ==============================================================================
+
+    CloneCache.cpp
+
+  ==============================================================================
+*/
+
+#include "CloneCache.h"
+
+#if JUCE_WINDOWS
+ #include <Windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/ioctl.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+
+ #if JUCE_LINUX
+  #include <linux/fs.h>
+ #elif JUCE_MAC
+  #include <sys/clonefile.h>
+ #endif
+#endif
+
+//==============================================================================
+CloneCache::CloneCache(const juce::File& cacheDirectory, juce::int64 maximumBytes)
+    : directory(cacheDirectory),
+      manifestFile(cacheDirectory.getChildFile("manifest")),
+      maxBytes(maximumBytes)
+{
+}
+
+CloneCache::Method CloneCache::cloneOrLink(const juce::File& source, const juce::File& target)
+{
+   #if JUCE_WINDOWS
+    // ReFS block cloning needs a volume we can't count on; NTFS hardlinks are everywhere
+    if (CreateHardLinkW(target.getFullPathName().toWideCharPointer(), source.getFullPathName().toWideCharPointer(), nullptr))
+        return Method::hardlink;
+   #else
+    const juce::String sourceName = source.getFullPathName();
+    const juce::String targetName = target.getFullPathName();
+    const char* sourcePath = sourceName.toRawUTF8();
+    const char* targetPath = targetName.toRawUTF8();
+
+    #if JUCE_MAC
+     if (::clonefile(sourcePath, targetPath, 0) == 0)
+         return Method::clone;
+    #elif defined (FICLONE)
+     struct stat info;
+     const int in = ::open(sourcePath, O_RDONLY);
+
+     if (in >= 0 && ::fstat(in, &info) == 0)
+     {
+         const int out = ::open(targetPath, O_WRONLY | O_CREAT | O_EXCL, info.st_mode & 0777);
+
+         if (out >= 0)
+         {
+             const bool cloned = ::ioctl(out, FICLONE, in) == 0;
+             ::close(out);
+
+             if (cloned)
+             {
+                 ::close(in);
+                 return Method::clone;
+             }
+
+             ::unlink(targetPath);
+         }
+     }
+
+     if (in >= 0)
+         ::close(in);
+    #endif
+
+    if (::link(sourcePath, targetPath) == 0)
+        return Method::hardlink;
+   #endif
+
+    return Method::none;
+}
+
+//==============================================================================
+bool CloneCache::remember(const juce::String& key, const juce::File& file)
+{
+    load();
+
+    const juce::File cached = getFile(key);
+    auto item = items.find(key);
+
+    if (item != items.end() && cached.getSize() == item->second.size
+        && cached.getLastModificationTime().toMilliseconds() == item->second.modified)
+    {
+        item->second.lastUsed = juce::Time::currentTimeMillis();
+        save();
+        return true;
+    }
+
+    directory.createDirectory();
+    const juce::File temp = cached.getSiblingFile(cached.getFileName() + temporarySuffix);
+    temp.deleteFile();
+
+    if (cloneOrLink(file, temp) == Method::none)
+        return false;
+
+    if (!temp.moveFileTo(cached))
+    {
+        temp.deleteFile();
+        return false;
+    }
+
+    items[key] = { cached.getSize(), cached.getLastModificationTime().toMilliseconds(), juce::Time::currentTimeMillis() };
+    trim();
+    save();
+    return true;
+}
+
+bool CloneCache::contains(const juce::String& key)
+{
+    load();
+    return items.count(key) != 0;
+}
+
+bool CloneCache::materialise(const juce::String& key, const juce::File& target)
+{
+    load();
+
+    auto item = items.find(key);
+    if (item == items.end())
+        return false;
+
+    const juce::File cached = getFile(key);
+
+    // Written to in place through a hardlink since we kept it: no longer the version it's named after
+    if (cached.getSize() != item->second.size || cached.getLastModificationTime().toMilliseconds() != item->second.modified)
+    {
+        cached.deleteFile();
+        items.erase(item);
+        save();
+        return false;
+    }
+
+    target.getParentDirectory().createDirectory();
+    const juce::File temp = target.getSiblingFile(target.getFileName() + temporarySuffix);
+    temp.deleteFile();
+
+    if (cloneOrLink(cached, temp) == Method::none || !temp.moveFileTo(target))
+    {
+        temp.deleteFile();
+        return false;
+    }
+
+    item->second.lastUsed = juce::Time::currentTimeMillis();
+    save();
+    return true;
+}
+
+//==============================================================================
+juce::File CloneCache::getFile(const juce::String& key) const
+{
+    return directory.getChildFile(key);
+}
+
+void CloneCache::trim()
+{
+    juce::int64 total = 0;
+    for (const auto& item : items)
+        total += item.second.size;
+
+    // Least recently used first
+    while (total > maxBytes && !items.empty())
+    {
+        auto oldest = items.begin();
+        for (auto it = items.begin(); it != items.end(); ++it)
+            if (it->second.lastUsed < oldest->second.lastUsed)
+                oldest = it;
+
+        total -= oldest->second.size;
+        getFile(oldest->first).deleteFile();
+        items.erase(oldest);
+    }
+}
+
+void CloneCache::load()
+{
+    if (loaded)
+        return;
+
+    loaded = true;
+
+    juce::StringArray lines;
+    lines.addLines(manifestFile.loadFileAsString());
+
+    // size \t modified \t last used \t key
+    for (const auto& line : lines)
+    {
+        juce::StringArray fields;
+        fields.addTokens(line, "\t", "");
+
+        if (fields.size() == 4)
+            items[fields[3]] = { fields[0].getLargeIntValue(), fields[1].getLargeIntValue(), fields[2].getLargeIntValue() };
+    }
+}
+
+void CloneCache::save()
+{
+    juce::String text;
+    for (const auto& item : items)
+        text << item.second.size << "\t" << item.second.modified << "\t" << item.second.lastUsed << "\t" << item.first << "\n";
+
+    directory.createDirectory();
+    manifestFile.replaceWithText(text);
+}
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    CloneCache.h
+    Keeps earlier versions of big files as copy-on-write clones or hardlinks,
+    so switching back to them doesn't mean writing them out again.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+
+//==============================================================================
+/**
+    A directory of file versions named by a content key (a blob id, an asset's
+    SHA-1), shared with the working tree wherever the filesystem allows it.
+
+    Files enter and leave the cache as reflinks (FICLONE on Linux, clonefile()
+    on macOS) when the volume supports them, otherwise as hardlinks. Either
+    way no data is copied, so remembering the version a checkout is about to
+    replace is free, and putting it back later is a metadata operation.
+
+    A hardlink shares its inode with the working tree. Files are only ever
+    replaced through a rename, which leaves the cached inode alone, but a
+    program that writes into the file in place would change the cached copy
+    too. So each entry's size and modification time are recorded, and an
+    entry that no longer matches them is thrown away instead of used.
+
+    Where the filesystem can do neither, nothing is cached. The oldest entries
+    go once the cache holds more than maxBytes. Not thread safe: call it from
+    the job queue.
+*/
+class CloneCache
+{
+public:
+    enum class Method
+    {
+        none,
+        clone,
+        hardlink
+    };
+
+    CloneCache(const juce::File& directory, juce::int64 maxBytes);
+
+    /** Keeps file's current content under key. Returns false if it couldn't be shared for free. */
+    bool remember(const juce::String& key, const juce::File& file);
+
+    /** True if key is cached, as far as the manifest knows. */
+    bool contains(const juce::String& key);
+
+    /** Puts the content cached under key at target, through a rename so target's old inode
+        isn't touched. Returns false if nothing usable is cached.
+    */
+    bool materialise(const juce::String& key, const juce::File& target);
+
+    /** Writes target as a clone of source, or a hardlink to it, whichever the filesystem offers. */
+    static Method cloneOrLink(const juce::File& source, const juce::File& target);
+
+    static constexpr const char* temporarySuffix = ".snaptrack.tmp";
+
+private:
+    struct Item
+    {
+        juce::int64 size = 0;
+        juce::int64 modified = 0;
+        juce::int64 lastUsed = 0;
+    };
+
+    juce::File getFile(const juce::String& key) const;
+    void trim();
+    void load();
+    void save();
+
+    juce::File directory;
+    juce::File manifestFile;
+    juce::int64 maxBytes;
+
+    std::map<juce::String, Item> items;
+    bool loaded = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CloneCache)
+};
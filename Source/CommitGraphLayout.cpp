@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    CommitGraphLayout.cpp
+
+  ==============================================================================
+*/
+
+#include "CommitGraphLayout.h"
+#include <atomic>
+
+//==============================================================================
+juce::uint32 CommitGraphLayout::nextGeneration()
+{
+    // Shared by every layout, so a rebuilt row never looks like one painted before
+    static std::atomic<juce::uint32> counter { 1 };
+    return ++counter;
+}
+
+void CommitGraphLayout::clear()
+{
+    rows.clear();
+    lanes.clear();
+    maxColumns = 0;
+    generation = nextGeneration();
+}
+
+void CommitGraphLayout::append(const GitRepositoryWorker::Commit& commit)
+{
+    Row row;
+    row.generation = generation;
+    row.isMerge = commit.parents.size() > 1;
+
+    const int lanesAbove = (int) lanes.size();
+    row.column = -1;
+
+    // Every lane waiting for this commit ends at its node
+    for (int j = 0; j < lanesAbove; ++j)
+    {
+        if (lanes[(size_t) j].isEmpty())
+            continue;
+
+        if (lanes[(size_t) j] == commit.oid)
+        {
+            if (row.column < 0)
+                row.column = j;
+
+            row.segments.push_back({ (juce::uint16) j, (juce::uint16) row.column, true });
+            lanes[(size_t) j] = {};
+        }
+        else
+        {
+            row.segments.push_back({ (juce::uint16) j, (juce::uint16) j, true });
+        }
+    }
+
+    auto freeColumn = [this](int excluding)
+    {
+        for (int j = 0; j < (int) lanes.size(); ++j)
+            if (j != excluding && lanes[(size_t) j].isEmpty())
+                return j;
+
+        lanes.emplace_back();
+        return (int) lanes.size() - 1;
+    };
+
+    // Nothing was waiting: a branch tip, which starts a lane of its own
+    if (row.column < 0)
+        row.column = freeColumn(-1);
+
+    std::vector<bool> continues(lanes.size(), false);
+    for (int j = 0; j < lanesAbove; ++j)
+        continues[(size_t) j] = lanes[(size_t) j].isNotEmpty();
+
+    for (int p = 0; p < commit.parents.size(); ++p)
+    {
+        const juce::String& parent = commit.parents[p];
+        int target = -1;
+
+        if (p == 0)
+        {
+            // The first parent carries on straight down
+            target = row.column;
+            lanes[(size_t) target] = parent;
+        }
+        else
+        {
+            // Another lane is already on its way to this parent: join it instead of opening one
+            for (int j = 0; j < (int) lanes.size() && target < 0; ++j)
+                if (lanes[(size_t) j] == parent)
+                    target = j;
+
+            if (target < 0)
+            {
+                target = freeColumn(row.column);
+                lanes[(size_t) target] = parent;
+            }
+        }
+
+        row.segments.push_back({ (juce::uint16) row.column, (juce::uint16) target, false });
+    }
+
+    for (int j = 0; j < (int) continues.size(); ++j)
+        if (continues[(size_t) j])
+            row.segments.push_back({ (juce::uint16) j, (juce::uint16) j, false });
+
+    row.numColumns = juce::jmax((int) lanes.size(), row.column + 1);
+
+    while (!lanes.empty() && lanes.back().isEmpty())
+        lanes.pop_back();
+
+    maxColumns = juce::jmax(maxColumns, row.numColumns);
+    rows.push_back(std::move(row));
+}
+
+bool CommitGraphLayout::prepend(const juce::Array<GitRepositoryWorker::Commit>& newer, const juce::String& firstRowOid)
+{
+    if (newer.isEmpty())
+        return true;
+
+    if (rows.empty())
+    {
+        for (const auto& commit : newer)
+            append(commit);
+
+        return true;
+    }
+
+    CommitGraphLayout top;
+    top.generation = generation;
+
+    for (const auto& commit : newer)
+        top.append(commit);
+
+    // The old top row started with nothing open; it still fits if every lane left open leads to it
+    for (const auto& lane : top.lanes)
+        if (lane.isNotEmpty() && lane != firstRowOid)
+            return false;
+
+    Row& first = rows.front();
+
+    for (int j = 0; j < (int) top.lanes.size(); ++j)
+        if (top.lanes[(size_t) j].isNotEmpty())
+            first.segments.push_back({ (juce::uint16) j, (juce::uint16) first.column, true });
+
+    first.numColumns = juce::jmax(first.numColumns, (int) top.lanes.size());
+    first.generation = nextGeneration();
+    maxColumns = juce::jmax(maxColumns, top.maxColumns, first.numColumns);
+
+    // Inserting can move the rows, first along with them
+    rows.insert(rows.begin(), std::make_move_iterator(top.rows.begin()), std::make_move_iterator(top.rows.end()));
+    return true;
+}
+
+void CommitGraphLayout::rebuild(const juce::Array<GitRepositoryWorker::Commit>& commits)
+{
+    clear();
+    rows.reserve((size_t) commits.size());
+
+    for (const auto& commit : commits)
+        append(commit);
+}
+
+const CommitGraphLayout::Row* CommitGraphLayout::getRow(int index) const
+{
+    return juce::isPositiveAndBelow(index, (int) rows.size()) ? &rows[(size_t) index] : nullptr;
+}
@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    CommitGraphLayout.h
+    Branch lanes for the commit list, laid out one row at a time from the
+    parent links, so more history or a new snapshot only costs its own rows.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include <vector>
+
+//==============================================================================
+/**
+    Assigns every commit of a newest-first history a column, and works out
+    the line segments each row draws. Rows are independent of each other
+    once laid out, so a view paints a row from nothing but its Row.
+
+    Layout runs top down. A lane is a column waiting for a particular commit:
+    the first parent of a commit continues its lane, every other parent gets
+    a free column, and all lanes waiting for the same commit join at its node.
+    Columns don't move once taken, so a lane is a straight line for as long
+    as it stays open.
+
+    - append() lays out an older commit below the existing rows, using the
+      lanes the last row left open. Loading another page costs that page.
+    - prepend() lays out newer commits above. Because the first row of a
+      layout always starts with no lanes open, new commits that lead only
+      into the old top row fit on without touching anything but that row.
+      Anything else (a merge of an old branch, say) returns false and the
+      caller rebuilds.
+
+    Not thread safe: CommitHistoryCache guards it.
+*/
+class CommitGraphLayout
+{
+public:
+    /** A line within one row. Upper segments run from the top edge to the node's height,
+        lower ones from there to the bottom edge. Columns are lane indexes.
+    */
+    struct Segment
+    {
+        juce::uint16 from = 0;
+        juce::uint16 to = 0;
+        bool upper = false;
+    };
+
+    struct Row
+    {
+        int column = 0;             // where the commit's node sits
+        int numColumns = 0;         // lanes this row touches, node included
+        bool isMerge = false;
+        juce::uint32 generation = 0; // changes whenever the row's segments do, for caching what was painted
+        std::vector<Segment> segments;
+    };
+
+    CommitGraphLayout() = default;
+
+    void clear();
+
+    /** Lays out commit as the row below the last one. */
+    void append(const GitRepositoryWorker::Commit& commit);
+
+    /** Lays out newer commits (newest first) above the existing rows. Returns false, leaving
+        the layout as it was, if they can't be fitted on without redoing the rows below.
+    */
+    bool prepend(const juce::Array<GitRepositoryWorker::Commit>& newer, const juce::String& firstRowOid);
+
+    /** Lays out a whole history from scratch. */
+    void rebuild(const juce::Array<GitRepositoryWorker::Commit>& commits);
+
+    int getNumRows() const { return (int) rows.size(); }
+    const Row* getRow(int index) const;
+
+    /** The most columns any row uses, for lining up what comes after the graph. */
+    int getMaxColumns() const { return maxColumns; }
+
+private:
+    std::vector<Row> rows;
+    std::vector<juce::String> lanes;    // open after the last row: the commit each column waits for, empty if free
+    int maxColumns = 0;
+    juce::uint32 generation = 1;
+
+    static juce::uint32 nextGeneration();
+};
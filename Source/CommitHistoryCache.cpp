@@ -0,0 +1,264 @@
+/*
+  ==============================================================================
+
+    CommitHistoryCache.cpp
+
+  ==============================================================================
+*/
+
+#include "CommitHistoryCache.h"
+
+//==============================================================================
+bool CommitHistoryCache::update(GitRepositoryWorker& worker, const juce::String& tipOid)
+{
+    History* previous = nullptr;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (tipOid.isEmpty())
+        {
+            const bool changed = active != nullptr;
+            active = nullptr;
+            return changed;
+        }
+
+        if (active != nullptr && active->tip == tipOid)
+        {
+            active->lastUsed = juce::Time::getMillisecondCounter();
+            return false;
+        }
+
+        if (History* cached = findHistory(tipOid))
+        {
+            cached->lastUsed = juce::Time::getMillisecondCounter();
+            active = cached;
+            return true;
+        }
+
+        previous = active;
+    }
+
+    // Only this thread changes the histories, so reading previous without the lock is fine
+    if (previous != nullptr && !previous->commits.isEmpty())
+    {
+        GitRepositoryWorker::HistoryCursor deltaCursor(tipOid);
+        juce::Array<GitRepositoryWorker::Commit> delta = worker.readHistory(deltaCursor, maxDeltaCommits, &previous->oids);
+
+        // The new tip leads back to the old one, so everything we have is history of it too: only
+        // the delta is new. Running into some other loaded commit says nothing of the kind. An
+        // older snapshot checked out, or a branch forked from one, gets a history of its own.
+        if (deltaCursor.isExhausted() && deltaCursor.hasReachedStop(previous->tip))
+        {
+            bool fitted = false;
+
+            {
+                const juce::ScopedLock sl(lock);
+
+                for (int i = delta.size(); --i >= 0;)
+                    if (previous->oids.count(delta.getReference(i).oid) > 0)
+                        delta.remove(i);
+
+                for (const auto& commit : delta)
+                    previous->oids.insert(commit.oid);
+
+                // A snapshot on top of the tip lays out its own row and touches the old top row only
+                const juce::String firstOid = previous->commits.isEmpty() ? juce::String() : previous->commits.getReference(0).oid;
+                fitted = previous->layout.prepend(delta, firstOid);
+
+                // Rows that no longer line up with the commits would draw the wrong lanes
+                if (!fitted)
+                    previous->layout.clear();
+
+                previous->commits.insertArray(0, delta.getRawDataPointer(), delta.size());
+
+                if (fitted)
+                    prependBlocks(*previous, delta.size());
+
+                previous->tip = tipOid;
+                previous->lastUsed = juce::Time::getMillisecondCounter();
+                active = previous;
+            }
+
+            // Lanes the old rows left no room for (a merge of an old branch): lay it all out
+            // again, off the lock. Nothing is published from the cache until update() returns.
+            if (!fitted)
+            {
+                CommitGraphLayout layout;
+                layout.rebuild(previous->commits);
+                Blocks blocks = makeBlocks(previous->commits, layout, 0, previous->commits.size());
+
+                const juce::ScopedLock sl(lock);
+                previous->layout = std::move(layout);
+                previous->blocks = std::move(blocks);
+            }
+
+            return true;
+        }
+    }
+
+    auto history = std::make_unique<History>();
+    history->tip = tipOid;
+    history->cursor = std::make_unique<GitRepositoryWorker::HistoryCursor>(tipOid);
+    history->commits = worker.readHistory(*history->cursor, pageSize);
+    history->lastUsed = juce::Time::getMillisecondCounter();
+
+    for (const auto& commit : history->commits)
+        history->oids.insert(commit.oid);
+
+    history->layout.rebuild(history->commits);
+    history->blocks = makeBlocks(history->commits, history->layout, 0, history->commits.size());
+
+    const juce::ScopedLock sl(lock);
+    active = history.get();
+    histories.push_back(std::move(history));
+    evictOldHistories();
+    return true;
+}
+
+int CommitHistoryCache::loadNextPage(GitRepositoryWorker& worker)
+{
+    History* history = nullptr;
+
+    {
+        const juce::ScopedLock sl(lock);
+        history = active;
+    }
+
+    if (history == nullptr || history->cursor == nullptr || history->cursor->isExhausted())
+        return 0;
+
+    juce::Array<GitRepositoryWorker::Commit> page = worker.readHistory(*history->cursor, pageSize);
+
+    const juce::ScopedLock sl(lock);
+    int added = 0;
+
+    for (const auto& commit : page)
+    {
+        // A delta walk can already have picked up commits from behind a merge
+        if (history->oids.insert(commit.oid).second)
+        {
+            history->commits.add(commit);
+            history->layout.append(commit);
+            ++added;
+        }
+    }
+
+    if (added > 0)
+        appendBlocks(*history);
+
+    return added;
+}
+
+//==============================================================================
+std::shared_ptr<const RepositoryState::History> CommitHistoryCache::getSnapshot() const
+{
+    const juce::ScopedLock sl(lock);
+
+    if (active == nullptr)
+        return nullptr;
+
+    auto snapshot = std::make_shared<RepositoryState::History>();
+    snapshot->tip = active->tip;
+    snapshot->blocks = active->blocks;
+    snapshot->blockStarts.reserve(active->blocks.size());
+
+    for (const auto& block : active->blocks)
+    {
+        snapshot->blockStarts.push_back(snapshot->numCommits);
+        snapshot->numCommits += block->commits.size();
+    }
+
+    snapshot->graphColumns = active->layout.getMaxColumns();
+    snapshot->complete = active->cursor == nullptr || active->cursor->isExhausted();
+    return snapshot;
+}
+
+//==============================================================================
+CommitHistoryCache::Blocks CommitHistoryCache::makeBlocks(const juce::Array<GitRepositoryWorker::Commit>& commits,
+                                                          const CommitGraphLayout& layout, int start, int end)
+{
+    Blocks blocks;
+
+    for (int first = start; first < end; first += blockSize)
+    {
+        const int last = juce::jmin(end, first + blockSize);
+
+        auto block = std::make_shared<Block>();
+        block->commits.addArray(commits, first, last - first);
+        block->rows.reserve((size_t) (last - first));
+
+        for (int i = first; i < last; ++i)
+            if (const CommitGraphLayout::Row* row = layout.getRow(i))
+                block->rows.push_back(*row);
+
+        blocks.push_back(std::move(block));
+    }
+
+    return blocks;
+}
+
+void CommitHistoryCache::prependBlocks(History& history, int numNewer)
+{
+    if (numNewer <= 0)
+        return;
+
+    // The old first block goes too: its top row now has the lanes of the new commits running into it
+    const int end = numNewer + (history.blocks.empty() ? 0 : history.blocks.front()->commits.size());
+
+    if (!history.blocks.empty())
+        history.blocks.erase(history.blocks.begin());
+
+    // The part block goes first, so the next snapshot tops it up instead of leaving small blocks in the middle
+    const int partSize = end % blockSize;
+    Blocks front = makeBlocks(history.commits, history.layout, 0, partSize);
+    Blocks full = makeBlocks(history.commits, history.layout, partSize, end);
+    front.insert(front.end(), std::make_move_iterator(full.begin()), std::make_move_iterator(full.end()));
+    history.blocks.insert(history.blocks.begin(), std::make_move_iterator(front.begin()), std::make_move_iterator(front.end()));
+}
+
+void CommitHistoryCache::appendBlocks(History& history)
+{
+    // The new commits start where the blocks end
+    int start = 0;
+
+    for (const auto& block : history.blocks)
+        start += block->commits.size();
+
+    // A last block with room left is replaced by a full one
+    if (!history.blocks.empty() && history.blocks.back()->commits.size() < blockSize)
+    {
+        start -= history.blocks.back()->commits.size();
+        history.blocks.pop_back();
+    }
+
+    Blocks back = makeBlocks(history.commits, history.layout, start, history.commits.size());
+    history.blocks.insert(history.blocks.end(), std::make_move_iterator(back.begin()), std::make_move_iterator(back.end()));
+}
+
+//==============================================================================
+CommitHistoryCache::History* CommitHistoryCache::findHistory(const juce::String& tipOid) const
+{
+    for (const auto& history : histories)
+        if (history->tip == tipOid)
+            return history.get();
+
+    return nullptr;
+}
+
+void CommitHistoryCache::evictOldHistories()
+{
+    while ((int) histories.size() > maxCachedTips)
+    {
+        auto oldest = histories.end();
+
+        for (auto it = histories.begin(); it != histories.end(); ++it)
+            if (it->get() != active && (oldest == histories.end() || (*it)->lastUsed < (*oldest)->lastUsed))
+                oldest = it;
+
+        if (oldest == histories.end())
+            return;
+
+        histories.erase(oldest);
+    }
+}
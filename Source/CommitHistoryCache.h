@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    CommitHistoryCache.h
+    Commit history loaded a page at a time and cached per branch tip.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include "CommitGraphLayout.h"
+#include "RepositoryState.h"
+
+//==============================================================================
+/**
+    Holds the history the commit list shows, keyed by the OID of the tip it was
+    walked from.
+
+    - An unchanged tip costs nothing.
+    - A tip that moved forward (a new snapshot) only walks the new commits and
+      puts them in front of what is already loaded.
+    - Going back to a recently shown tip (switching branches) reuses its pages.
+
+    Each history keeps its branch lanes (see CommitGraphLayout) in step with
+    its commits, laying out only the rows that were added.
+
+    update() and loadNextPage() do the walking and are meant to be called from
+    one background thread at a time. Views don't read the cache: they paint
+    the snapshot getSnapshot() takes, which RepositoryService publishes. Each
+    history keeps its commits and rows in step as immutable blocks too (see
+    RepositoryState::History), rebuilding only the blocks a change touched,
+    so a snapshot shares them and costs no more than the change did.
+*/
+class CommitHistoryCache
+{
+public:
+    static constexpr int pageSize = 100;
+
+    CommitHistoryCache() = default;
+
+    /** Points the cache at tipOid, loading the first page or the new commits as needed.
+        Returns true if the rows the list shows have changed.
+    */
+    bool update(GitRepositoryWorker& worker, const juce::String& tipOid);
+
+    /** Loads the next page of older commits. Returns how many were added. */
+    int loadNextPage(GitRepositoryWorker& worker);
+
+    /** The history the list shows, null if there is none. Shares its blocks with the cache. */
+    std::shared_ptr<const RepositoryState::History> getSnapshot() const;
+
+private:
+    using Block = RepositoryState::History::Block;
+    using Blocks = std::vector<std::shared_ptr<const Block>>;
+    static constexpr int blockSize = RepositoryState::History::blockSize;
+
+    struct History
+    {
+        juce::String tip;
+        juce::Array<GitRepositoryWorker::Commit> commits;   // newest first
+        std::set<juce::String> oids;                        // everything in commits
+        CommitGraphLayout layout;                           // a row per commit, once it's caught up
+        Blocks blocks;                                      // commits and rows, as getSnapshot() shares them
+        std::unique_ptr<GitRepositoryWorker::HistoryCursor> cursor;
+        juce::uint32 lastUsed = 0;
+    };
+
+    History* findHistory(const juce::String& tipOid) const;
+
+    // Blocks of the commits from start to end and their rows
+    static Blocks makeBlocks(const juce::Array<GitRepositoryWorker::Commit>& commits, const CommitGraphLayout& layout, int start, int end);
+    // After numNewer commits went on top: new blocks for them, and the old first block, whose top row changed
+    static void prependBlocks(History& history, int numNewer);
+    // After older commits were added at the end: fills up the last block and adds more
+    static void appendBlocks(History& history);
+
+    void evictOldHistories();
+
+    static constexpr int maxCachedTips = 4;
+    static constexpr int maxDeltaCommits = 1000; // beyond this, a moved tip is treated as a new history
+
+    mutable juce::CriticalSection lock; // guards everything the getters read
+    std::vector<std::unique_ptr<History>> histories;
+    History* active = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CommitHistoryCache)
+};
@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    CommitRowPainter.cpp
+
+  ==============================================================================
+*/
+
+#include "CommitRowPainter.h"
+
+//==============================================================================
+namespace
+{
+    const juce::Colour selectedColour(212, 163, 115);
+    const juce::Colour textColour(6, 6, 5);
+
+    juce::Colour getLaneColour(int column)
+    {
+        static const juce::Colour palette[] = {
+            juce::Colour(58, 90, 64), juce::Colour(188, 108, 37), juce::Colour(76, 110, 155), juce::Colour(155, 64, 84),
+            juce::Colour(110, 92, 150), juce::Colour(96, 108, 56), juce::Colour(40, 120, 128), juce::Colour(140, 100, 60)
+        };
+
+        return palette[column % (int) juce::numElementsInArray(palette)];
+    }
+
+    float getLaneX(int column)
+    {
+        return (float) column * (float) CommitRowPainter::laneWidth + (float) CommitRowPainter::laneWidth * 0.5f + 2.0f;
+    }
+}
+
+//==============================================================================
+void CommitRowPainter::paint(juce::Graphics& g, const juce::String& oid, const CommitGraphLayout::Row* row, int graphColumns,
+                             const juce::String& text, int width, int height, bool selected)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    juce::String key;
+    key << oid << ':' << (row != nullptr ? (int) row->generation : 0) << ':' << graphColumns << ':'
+        << width << 'x' << height << '@' << scale << (selected ? ":s:" : ":-:") << text;
+
+    auto found = index.find(key);
+
+    if (found != index.end())
+    {
+        entries.splice(entries.begin(), entries, found->second);
+        ++statistics.numHits;
+    }
+    else
+    {
+        juce::Image image(juce::Image::ARGB, juce::roundToInt((float) width * scale), juce::roundToInt((float) height * scale), true);
+
+        {
+            juce::Graphics ig(image);
+            ig.addTransform(juce::AffineTransform::scale(scale));
+            render(ig, row, graphColumns, text, width, height, selected);
+        }
+
+        entries.push_front({ key, image });
+        index[key] = entries.begin();
+        ++statistics.numRendered;
+
+        while ((int) entries.size() > maxCachedRows)
+        {
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+
+    const juce::Image& image = entries.front().image;
+
+    if (image.getWidth() == width && image.getHeight() == height)
+        g.drawImageAt(image, 0, 0);
+    else
+        g.drawImage(image, juce::Rectangle<float>(0.0f, 0.0f, (float) width, (float) height));
+}
+
+void CommitRowPainter::clear()
+{
+    entries.clear();
+    index.clear();
+}
+
+void CommitRowPainter::render(juce::Graphics& g, const CommitGraphLayout::Row* row, int graphColumns,
+                              const juce::String& text, int width, int height, bool selected)
+{
+    if (selected)
+        g.fillAll(selectedColour);
+
+    const int columns = juce::jlimit(0, maxGraphColumns, graphColumns);
+    const float middle = (float) height * 0.5f;
+
+    if (row != nullptr && columns > 0)
+    {
+        g.saveState();
+        g.reduceClipRegion(0, 0, columns * laneWidth + 4, height);
+
+        for (const auto& segment : row->segments)
+        {
+            // Lanes that bend run from the node (or into it) to their own column
+            const float fromX = getLaneX(segment.from);
+            const float toX = getLaneX(segment.to);
+            const int colourColumn = segment.upper ? segment.from : juce::jmax((int) segment.from, (int) segment.to);
+
+            juce::Path path;
+
+            if (segment.upper)
+            {
+                path.startNewSubPath(fromX, 0.0f);
+                path.cubicTo(fromX, middle * 0.6f, toX, middle * 0.4f, toX, middle);
+            }
+            else
+            {
+                path.startNewSubPath(fromX, middle);
+                path.cubicTo(fromX, middle * 1.6f, toX, middle * 1.4f, toX, (float) height);
+            }
+
+            g.setColour(getLaneColour(colourColumn));
+            g.strokePath(path, juce::PathStrokeType(1.5f));
+        }
+
+        const float radius = 3.0f;
+        const float x = getLaneX(row->column);
+        const juce::Rectangle<float> node(x - radius, middle - radius, radius * 2.0f, radius * 2.0f);
+
+        g.setColour(getLaneColour(row->column));
+
+        if (row->isMerge)
+        {
+            // Merges drawn hollow, so snapshots stand out from the joins
+            g.setColour(selected ? selectedColour : juce::Colours::white);
+            g.fillEllipse(node);
+            g.setColour(getLaneColour(row->column));
+            g.drawEllipse(node, 1.5f);
+        }
+        else
+        {
+            g.fillEllipse(node);
+        }
+
+        g.restoreState();
+    }
+
+    const int textX = (columns > 0 ? columns * laneWidth + 4 : 0) + textGap;
+
+    g.setColour(textColour);
+    g.setFont(height * 0.5f);
+    g.drawText(text, textX, 0, width - textX, height, juce::Justification::centredLeft, true);
+}
@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    CommitRowPainter.h
+    Paints a commit list row (graph lanes, node, subject) into an image once
+    and blits it from then on.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CommitGraphLayout.h"
+#include <list>
+#include <map>
+
+//==============================================================================
+/**
+    The ListBox only asks for the rows it shows, and this keeps the last
+    maxCachedRows of them as images at the display's pixel scale. Scrolling
+    back and forth over the same part of a long history then costs a
+    drawImageAt per row rather than paths and text layout.
+
+    An image is reused as long as everything it was drawn from is the same:
+    the commit, its row's generation (see CommitGraphLayout::Row), the text,
+    the size and selection. Message thread only.
+*/
+class CommitRowPainter
+{
+public:
+    CommitRowPainter() = default;
+
+    void paint(juce::Graphics& g, const juce::String& oid, const CommitGraphLayout::Row* row, int graphColumns,
+               const juce::String& text, int width, int height, bool selected);
+
+    void clear();
+
+    struct Statistics
+    {
+        juce::int64 numHits = 0;
+        juce::int64 numRendered = 0;
+    };
+
+    const Statistics& getStatistics() const { return statistics; }
+
+    static constexpr int maxCachedRows = 256;
+    static constexpr int laneWidth = 10;
+    static constexpr int maxGraphColumns = 12;  // wider graphs are cut off rather than pushing the text away
+    static constexpr int textGap = 5;
+
+    /** Draws a row straight into g, as paint() does into its images. */
+    static void render(juce::Graphics& g, const CommitGraphLayout::Row* row, int graphColumns,
+                       const juce::String& text, int width, int height, bool selected);
+
+private:
+    struct Entry
+    {
+        juce::String key;
+        juce::Image image;
+    };
+
+    std::list<Entry> entries;   // most recently painted first
+    std::map<juce::String, std::list<Entry>::iterator> index;
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CommitRowPainter)
+};
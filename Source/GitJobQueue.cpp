@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    GitJobQueue.cpp
+
+  ==============================================================================
+*/
+
+#include "GitJobQueue.h"
+
+//==============================================================================
+void GitJobQueue::Context::setProgress(float progress, const juce::String& detail)
+{
+    {
+        const juce::ScopedLock sl(queue.lock);
+        queue.currentProgress = progress;
+        queue.currentDetail = detail;
+    }
+
+    queue.sendChangeMessage();
+}
+
+//==============================================================================
+GitJobQueue::GitJobQueue()
+    : juce::Thread("SnapTrack git jobs")
+{
+    startThread();
+}
+
+GitJobQueue::~GitJobQueue()
+{
+    stop();
+    cancelAll();    // anything submitted since the owner stopped us
+}
+
+void GitJobQueue::stop()
+{
+    *alive = false;
+    cancelAll();
+    signalThreadShouldExit();
+    jobAvailable.signal();
+    stopThread(10000);
+}
+
+GitJobQueue::JobId GitJobQueue::submit(const juce::String& description, Work work, Completion onComplete)
+{
+    auto job = std::make_shared<Job>();
+    job->description = description;
+    job->work = std::move(work);
+    job->onComplete = std::move(onComplete);
+
+    {
+        const juce::ScopedLock sl(lock);
+        job->id = nextId++;
+        pending.push_back(job);
+    }
+
+    jobAvailable.signal();
+    sendChangeMessage();
+    return job->id;
+}
+
+bool GitJobQueue::cancel(JobId id)
+{
+    std::shared_ptr<Job> removed;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (current != nullptr && current->id == id)
+        {
+            current->cancelled = true;
+            return true;
+        }
+
+        for (auto it = pending.begin(); it != pending.end(); ++it)
+        {
+            if ((*it)->id == id)
+            {
+                removed = *it;
+                pending.erase(it);
+                break;
+            }
+        }
+    }
+
+    if (removed == nullptr)
+        return false;
+
+    Result result;
+    result.cancelled = true;
+    finish(removed, result);
+    return true;
+}
+
+void GitJobQueue::cancelAll()
+{
+    std::deque<std::shared_ptr<Job>> removed;
+
+    {
+        const juce::ScopedLock sl(lock);
+        removed.swap(pending);
+
+        if (current != nullptr)
+            current->cancelled = true;
+    }
+
+    Result result;
+    result.cancelled = true;
+
+    for (auto& job : removed)
+        finish(job, result);
+}
+
+GitJobQueue::Status GitJobQueue::getStatus() const
+{
+    const juce::ScopedLock sl(lock);
+    Status status;
+    status.busy = current != nullptr;
+    status.numPending = (int) pending.size();
+
+    if (current != nullptr)
+    {
+        status.description = current->description;
+        status.detail = currentDetail;
+        status.progress = currentProgress;
+    }
+
+    return status;
+}
+
+bool GitJobQueue::isBusy() const
+{
+    const juce::ScopedLock sl(lock);
+    return current != nullptr || !pending.empty();
+}
+
+//==============================================================================
+void GitJobQueue::run()
+{
+    while (!threadShouldExit())
+    {
+        std::shared_ptr<Job> job;
+
+        {
+            const juce::ScopedLock sl(lock);
+
+            if (!pending.empty())
+            {
+                job = pending.front();
+                pending.pop_front();
+                current = job;
+                currentProgress = -1.0f;
+                currentDetail.clear();
+            }
+        }
+
+        if (job == nullptr)
+        {
+            jobAvailable.wait(-1);
+            continue;
+        }
+
+        sendChangeMessage();
+
+        Context context(*this, job->cancelled);
+        Result result = job->work ? job->work(context) : Result();
+        result.cancelled = result.cancelled || job->cancelled.load();
+
+        {
+            const juce::ScopedLock sl(lock);
+            current = nullptr;
+        }
+
+        finish(job, result);
+    }
+}
+
+void GitJobQueue::finish(const std::shared_ptr<Job>& job, const Result& result)
+{
+    if (job->onComplete)
+    {
+        Completion onComplete = job->onComplete;
+        std::shared_ptr<bool> stillAlive = alive;
+        juce::MessageManager::callAsync([onComplete, result, stillAlive]
+        {
+            if (*stillAlive)
+                onComplete(result);
+        });
+    }
+
+    sendChangeMessage();
+}
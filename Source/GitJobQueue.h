@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    GitJobQueue.h
+    Runs repository work on a background thread, one job at a time, so the
+    message thread never waits on git.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+
+//==============================================================================
+/**
+    A serial queue of repository jobs.
+
+    Jobs run in submission order on a single worker thread, because git itself
+    can't run two writers against one repository. Completion callbacks are
+    posted to the message thread. Listeners are told (asynchronously, on the
+    message thread) whenever a job starts, reports progress or finishes.
+*/
+class GitJobQueue : public juce::ChangeBroadcaster,
+                    private juce::Thread
+{
+public:
+    using JobId = int;
+
+    struct Result
+    {
+        bool succeeded = false;
+        bool cancelled = false;
+        juce::String output;
+    };
+
+    /** Handed to a running job so it can report progress and notice cancellation. */
+    class Context
+    {
+    public:
+        bool shouldCancel() const { return cancelFlag.load(); }
+
+        /** Pass this on to ProcessRunner::Options::cancelFlag so git is killed on cancel. */
+        const std::atomic<bool>* getCancelFlag() const { return &cancelFlag; }
+
+        /** progress is 0..1, or negative if unknown. */
+        void setProgress(float progress, const juce::String& detail);
+
+    private:
+        friend class GitJobQueue;
+        Context(GitJobQueue& q, std::atomic<bool>& flag) : queue(q), cancelFlag(flag) {}
+
+        GitJobQueue& queue;
+        std::atomic<bool>& cancelFlag;
+    };
+
+    using Work = std::function<Result(Context&)>;
+    using Completion = std::function<void(const Result&)>;
+
+    struct Status
+    {
+        bool busy = false;
+        juce::String description;   // of the running job
+        juce::String detail;
+        float progress = -1.0f;
+        int numPending = 0;         // not counting the running job
+    };
+
+    GitJobQueue();
+    ~GitJobQueue() override;
+
+    /** Queues a job. onComplete is called on the message thread, also when the job was cancelled. */
+    JobId submit(const juce::String& description, Work work, Completion onComplete = nullptr);
+
+    /** Cancels a pending job, or kills the running one. */
+    bool cancel(JobId id);
+    void cancelAll();
+
+    /** Cancels everything and waits for the running job to return. Jobs submitted after this
+        never run, and no completion is called any more. The owner calls it before it destroys
+        anything the jobs use.
+    */
+    void stop();
+
+    Status getStatus() const;
+    bool isBusy() const;
+
+private:
+    struct Job
+    {
+        JobId id = 0;
+        juce::String description;
+        Work work;
+        Completion onComplete;
+        std::atomic<bool> cancelled { false };
+    };
+
+    void run() override;
+    void finish(const std::shared_ptr<Job>& job, const Result& result);
+
+    mutable juce::CriticalSection lock;
+    std::deque<std::shared_ptr<Job>> pending;
+    std::shared_ptr<Job> current;
+    float currentProgress = -1.0f;
+    juce::String currentDetail;
+    JobId nextId = 1;
+    juce::WaitableEvent jobAvailable;
+
+    // Completions are posted to the message thread; this stops them running after we're gone
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GitJobQueue)
+};
@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+    GitParser.cpp
+
+  ==============================================================================
+*/
+
+#include "GitParser.h"
+#include <cstdint>
+#include <cstring>
+
+//==============================================================================
+void* ParseArena::allocateBytes(size_t numBytes, size_t alignment)
+{
+    numBytes = juce::jmax((size_t) 1, numBytes);
+
+    while (current < blocks.size())
+    {
+        Block& block = blocks[current];
+        const auto address = reinterpret_cast<std::uintptr_t>(block.data.get()) + position;
+        const size_t padding = (alignment - address % alignment) % alignment;
+
+        if (position + padding + numBytes <= block.size)
+        {
+            position += padding + numBytes;
+            used += numBytes;
+            return block.data.get() + position - numBytes;
+        }
+
+        // Full, or too small for this: carry on in the next one
+        ++current;
+        position = 0;
+    }
+
+    Block block;
+    block.size = juce::jmax(blockSize, numBytes + alignment);
+    block.data.reset(new char[block.size]);
+    blocks.push_back(std::move(block));
+    current = blocks.size() - 1;
+    position = 0;
+
+    return allocateBytes(numBytes, alignment);
+}
+
+std::string_view ParseArena::copy(std::string_view text)
+{
+    if (text.empty())
+        return {};
+
+    char* destination = allocate<char>(text.size());
+    std::memcpy(destination, text.data(), text.size());
+    return { destination, text.size() };
+}
+
+void ParseArena::reset()
+{
+    current = 0;
+    position = 0;
+    used = 0;
+}
+
+//==============================================================================
+bool GitTokenizer::next(std::string_view& token)
+{
+    if (text.empty())
+        return false;
+
+    const size_t end = text.find(delimiter);
+
+    if (end == std::string_view::npos)
+    {
+        token = text;
+        text = {};
+    }
+    else
+    {
+        token = text.substr(0, end);
+        text.remove_prefix(end + 1);
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GitParser::parseDecimal(std::string_view text, juce::int64& value)
+{
+    if (text.empty() || text.size() > 18)
+        return false;
+
+    juce::int64 result = 0;
+
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+            return false;
+
+        result = result * 10 + (c - '0');
+    }
+
+    value = result;
+    return true;
+}
+
+bool GitParser::parseObjectHeader(std::string_view line, ObjectHeader& header)
+{
+    header = ObjectHeader();
+
+    // The name asked for comes back first, and a ref name can't contain a space, so split from the right
+    const size_t last = line.rfind(' ');
+
+    if (last == std::string_view::npos)
+        return false;
+
+    if (line.substr(last + 1) == "missing" || line.substr(last + 1) == "ambiguous")
+    {
+        header.oid = line.substr(0, last);
+        header.missing = true;
+        return true;
+    }
+
+    const size_t middle = line.rfind(' ', last - 1);
+    juce::int64 size = 0;
+
+    if (last == 0 || middle == std::string_view::npos || !parseDecimal(line.substr(last + 1), size))
+        return false;
+
+    header.oid = line.substr(0, middle);
+    header.type = line.substr(middle + 1, last - middle - 1);
+    header.size = (size_t) size;
+    return true;
+}
+
+bool GitParser::parseCommit(std::string_view content, ParseArena& arena, CommitInfo& commit)
+{
+    commit = CommitInfo();
+
+    const size_t headerEnd = content.find("\n\n");
+    const std::string_view header = content.substr(0, headerEnd);
+
+    // Merges have two parents, octopus merges more: count them before taking room for them
+    int numParents = 0;
+    for (size_t at = header.find("\nparent "); at != std::string_view::npos; at = header.find("\nparent ", at + 1))
+        ++numParents;
+
+    std::string_view* parents = numParents > 0 ? arena.allocate<std::string_view>((size_t) numParents) : nullptr;
+    GitTokenizer lines(header, '\n');
+    std::string_view line;
+
+    while (lines.next(line))
+    {
+        if (line.compare(0, 5, "tree ") == 0)
+        {
+            commit.tree = line.substr(5);
+        }
+        else if (line.compare(0, 7, "parent ") == 0 && commit.numParents < numParents)
+        {
+            parents[commit.numParents++] = line.substr(7);
+        }
+        else if (line.compare(0, 10, "committer ") == 0)
+        {
+            // "committer Name <email> 1700000000 +0100": the name may hold anything but '>'
+            const size_t emailEnd = line.rfind('>');
+
+            if (emailEnd != std::string_view::npos)
+            {
+                std::string_view rest = line.substr(emailEnd + 1);
+                rest.remove_prefix(juce::jmin(rest.size(), rest.find_first_not_of(' ')));
+                parseDecimal(rest.substr(0, rest.find(' ')), commit.committerTime);
+            }
+        }
+    }
+
+    commit.parents = parents;
+
+    if (headerEnd != std::string_view::npos)
+    {
+        // Like "%s": the first paragraph of the message
+        const std::string_view message = content.substr(headerEnd + 2);
+        commit.subject = message.substr(0, message.find("\n\n"));
+    }
+
+    return !commit.tree.empty();
+}
+
+void GitParser::parsePackedRefs(std::string_view text, std::vector<RefInfo>& refs)
+{
+    GitTokenizer lines(text, '\n');
+    std::string_view line;
+
+    while (lines.next(line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        // "# pack-refs with: ..." headers and "^<oid>" peeled tag lines
+        if (line.empty() || line.front() == '#' || line.front() == '^')
+            continue;
+
+        const size_t space = line.find(' ');
+
+        if (space == std::string_view::npos || space + 1 >= line.size())
+            continue;
+
+        refs.push_back({ line.substr(space + 1), line.substr(0, space) });
+    }
+}
+
+void GitParser::parseConfig(std::string_view text, std::vector<ConfigEntry>& entries)
+{
+    // "key\nvalue\0" per item; a key given without a value has no newline at all
+    GitTokenizer items(text, '\0');
+    std::string_view item;
+
+    while (items.next(item))
+    {
+        const size_t newline = item.find('\n');
+
+        if (newline == std::string_view::npos)
+            entries.push_back({ item, {} });
+        else
+            entries.push_back({ item.substr(0, newline), item.substr(newline + 1) });
+    }
+}
+
+juce::String GitParser::toSubjectLine(std::string_view subject)
+{
+    return toString(subject).trim().replaceCharacters("\r\n", "  ");
+}
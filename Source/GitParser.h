@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    GitParser.h
+    Typed, zero-copy parsing of what git hands us: cat-file --batch headers,
+    commit objects, packed-refs and NUL-delimited (-z) output.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <type_traits>
+#include <string_view>
+#include <vector>
+
+//==============================================================================
+/**
+    Bump allocation for one refresh. Parsed records point into the text
+    they came from, or into memory taken from here, and stay valid until
+    reset(). reset() keeps every block for reuse, so a refresh that needs no
+    more room than the biggest one before it doesn't allocate at all.
+*/
+class ParseArena
+{
+public:
+    ParseArena() = default;
+
+    /** Room for count Ts. Only for types that need no destructor. */
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "the arena never runs destructors");
+        return static_cast<T*>(allocateBytes(sizeof(T) * count, alignof(T)));
+    }
+
+    /** A copy of text that lives as long as the arena's contents. */
+    std::string_view copy(std::string_view text);
+
+    void reset();
+
+    size_t getNumBytesUsed() const { return used; }
+
+    static constexpr size_t blockSize = 64 * 1024;
+
+private:
+    void* allocateBytes(size_t numBytes, size_t alignment);
+
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;     // the block being filled
+    size_t position = 0;    // in blocks[current]
+    size_t used = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(ParseArena)
+};
+
+//==============================================================================
+/** Splits text at a delimiter without copying: every token is a view into text. */
+class GitTokenizer
+{
+public:
+    GitTokenizer(std::string_view textToSplit, char delimiterToUse) : text(textToSplit), delimiter(delimiterToUse) {}
+
+    /** The next token, which may be empty. Returns false once the text is used up; a trailing
+        delimiter doesn't produce an empty last token.
+    */
+    bool next(std::string_view& token);
+
+    std::string_view getRemainder() const { return text; }
+
+private:
+    std::string_view text;
+    const char delimiter;
+};
+
+//==============================================================================
+struct GitParser
+{
+    /** A "git cat-file --batch" header: "<oid> <type> <size>", or "<name> missing". */
+    struct ObjectHeader
+    {
+        std::string_view oid, type;
+        size_t size = 0;
+        bool missing = false;
+    };
+
+    /** What history needs from a commit object. Views point into the object and the arena. */
+    struct CommitInfo
+    {
+        std::string_view tree;
+        const std::string_view* parents = nullptr;
+        int numParents = 0;
+        juce::int64 committerTime = 0;  // seconds since epoch
+        std::string_view subject;       // the message's first paragraph, as written (may span lines)
+    };
+
+    /** A branch or other ref: refs/heads/main and its oid. */
+    struct RefInfo
+    {
+        std::string_view name, oid;
+    };
+
+    /** One "key\nvalue" item of "git config -z" output. */
+    struct ConfigEntry
+    {
+        std::string_view key, value;
+    };
+
+    static bool parseObjectHeader(std::string_view line, ObjectHeader& header);
+
+    /** Parents live in arena. Returns false for something that isn't a commit object. */
+    static bool parseCommit(std::string_view content, ParseArena& arena, CommitInfo& commit);
+
+    /** Every ref in a packed-refs file, skipping the header and peeled tag lines. */
+    static void parsePackedRefs(std::string_view text, std::vector<RefInfo>& refs);
+
+    /** Every item of "git config -z --get-regexp" output. Keys are as git prints them, lower case. */
+    static void parseConfig(std::string_view text, std::vector<ConfigEntry>& entries);
+
+    /** Whole, non-negative decimal numbers only; false for anything else. */
+    static bool parseDecimal(std::string_view text, juce::int64& value);
+
+    /** The subject as one line: trimmed, with line breaks turned into spaces like "%s" does. */
+    static juce::String toSubjectLine(std::string_view subject);
+
+    static juce::String toString(std::string_view text) { return juce::String::fromUTF8(text.data(), (int) text.size()); }
+};
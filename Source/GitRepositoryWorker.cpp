@@ -0,0 +1,367 @@
+/*
+  ==============================================================================
+
+    GitRepositoryWorker.cpp
+
+  ==============================================================================
+*/
+
+#include "GitRepositoryWorker.h"
+#include <queue>
+#include <set>
+
+//==============================================================================
+GitRepositoryWorker::GitRepositoryWorker(const juce::File& root)
+    : repositoryRoot(root)
+{
+    gitDirectory = repositoryRoot.getChildFile(".git");
+
+    // Submodules and linked worktrees have a ".git" file pointing somewhere else
+    if (gitDirectory.existsAsFile())
+    {
+        juce::String pointer = gitDirectory.loadFileAsString().trim();
+        if (pointer.startsWith("gitdir:"))
+            gitDirectory = repositoryRoot.getChildFile(pointer.fromFirstOccurrenceOf("gitdir:", false, false).trim());
+    }
+
+    commonDirectory = gitDirectory;
+    juce::File commonDirFile = gitDirectory.getChildFile("commondir");
+    if (commonDirFile.existsAsFile())
+        commonDirectory = gitDirectory.getChildFile(commonDirFile.loadFileAsString().trim());
+}
+
+GitRepositoryWorker::~GitRepositoryWorker()
+{
+    const juce::ScopedLock sl(lock);
+    batchProcess.stop();
+}
+
+//==============================================================================
+GitRepositoryWorker::Summary GitRepositoryWorker::query(int maxCommits)
+{
+    const juce::ScopedLock sl(lock);
+    Summary summary;
+
+    juce::String head = gitDirectory.getChildFile("HEAD").loadFileAsString().trim();
+
+    if (head.startsWith("ref: "))
+    {
+        juce::String target = head.fromFirstOccurrenceOf("ref: ", false, false).trim();
+        summary.currentBranch = target.fromFirstOccurrenceOf("refs/heads/", false, false);
+        summary.headOid = resolveRefLocked(target, 0);
+    }
+    else
+    {
+        summary.detached = true;
+        summary.headOid = head;
+    }
+
+    for (const auto& branch : listBranches())
+        summary.branches.add(branch.first);
+
+    if (summary.headOid.isNotEmpty() && maxCommits != 0)
+        summary.history = walkHistory(summary.headOid, maxCommits);
+
+    return summary;
+}
+
+juce::String GitRepositoryWorker::resolveRef(const juce::String& refName)
+{
+    const juce::ScopedLock sl(lock);
+    return resolveRefLocked(refName, 0);
+}
+
+bool GitRepositoryWorker::readObject(const juce::String& oid, juce::String& type, std::string& content)
+{
+    const juce::ScopedLock sl(lock);
+    return readObjectLocked(oid, type, content);
+}
+
+//==============================================================================
+juce::String GitRepositoryWorker::resolveRefLocked(const juce::String& refName, int depth)
+{
+    if (depth > 5)
+        return {};
+
+    // HEAD and other per-worktree refs live in the git dir, branches in the common dir
+    juce::File looseRef = refName.startsWith("refs/") ? commonDirectory.getChildFile(refName)
+                                                      : gitDirectory.getChildFile(refName);
+
+    if (looseRef.existsAsFile())
+    {
+        juce::String value = looseRef.loadFileAsString().trim();
+
+        if (value.startsWith("ref: "))
+            return resolveRefLocked(value.fromFirstOccurrenceOf("ref: ", false, false).trim(), depth + 1);
+
+        return value;
+    }
+
+    auto packed = readPackedRefs();
+    auto found = packed.find(refName);
+    return found != packed.end() ? found->second : juce::String();
+}
+
+std::map<juce::String, juce::String> GitRepositoryWorker::readPackedRefs()
+{
+    std::map<juce::String, juce::String> refs;
+    juce::MemoryBlock text;
+
+    if (!commonDirectory.getChildFile("packed-refs").loadFileAsData(text))
+        return refs;
+
+    std::vector<GitParser::RefInfo> packed;
+    GitParser::parsePackedRefs({ static_cast<const char*>(text.getData()), text.getSize() }, packed);
+
+    for (const auto& ref : packed)
+        refs[GitParser::toString(ref.name)] = GitParser::toString(ref.oid);
+
+    return refs;
+}
+
+std::map<juce::String, juce::String> GitRepositoryWorker::listBranches()
+{
+    std::map<juce::String, juce::String> branches;
+
+    for (const auto& ref : readPackedRefs())
+        if (ref.first.startsWith("refs/heads/"))
+            branches[ref.first.fromFirstOccurrenceOf("refs/heads/", false, false)] = ref.second;
+
+    // Loose refs win over packed ones
+    juce::File headsDirectory = commonDirectory.getChildFile("refs").getChildFile("heads");
+    juce::Array<juce::File> looseRefs;
+    headsDirectory.findChildFiles(looseRefs, juce::File::findFiles, true);
+
+    for (const auto& file : looseRefs)
+    {
+        juce::String name = file.getRelativePathFrom(headsDirectory).replaceCharacter('\\', '/');
+        branches[name] = file.loadFileAsString().trim();
+    }
+
+    return branches;
+}
+
+//==============================================================================
+bool GitRepositoryWorker::ensureBatchProcess()
+{
+    if (batchProcess.isRunning())
+        return true;
+
+    return batchProcess.start({ "git", "cat-file", "--batch" }, repositoryRoot.getFullPathName().toStdString());
+}
+
+bool GitRepositoryWorker::readObjectLocked(const juce::String& oid, juce::String& type, std::string& content)
+{
+    if (!ensureBatchProcess())
+        return false;
+
+    if (!batchProcess.write(oid.toStdString() + "\n"))
+    {
+        batchProcess.stop();
+        return false;
+    }
+
+    if (!batchProcess.readLine(headerLine, batchTimeoutMs))
+    {
+        batchProcess.stop();
+        return false;
+    }
+
+    GitParser::ObjectHeader header;
+    if (!GitParser::parseObjectHeader(headerLine, header) || header.missing)
+        return false;
+
+    type = GitParser::toString(header.type);
+    content.clear();
+
+    // The object is followed by a single newline
+    if (!batchProcess.readBytes(header.size + 1, content, batchTimeoutMs))
+    {
+        batchProcess.stop();
+        return false;
+    }
+
+    content.pop_back();
+    return true;
+}
+
+bool GitRepositoryWorker::fetchCommits(const juce::StringArray& oids, std::map<juce::String, Commit>& destination)
+{
+    if (oids.isEmpty())
+        return true;
+
+    if (!ensureBatchProcess())
+        return false;
+
+    // Send every request up front, then collect the answers in order
+    std::string request;
+    for (const auto& oid : oids)
+        request += oid.toStdString() + "\n";
+
+    if (!batchProcess.write(request))
+    {
+        batchProcess.stop();
+        return false;
+    }
+
+    for (const auto& oid : oids)
+    {
+        if (!batchProcess.readLine(headerLine, batchTimeoutMs))
+        {
+            batchProcess.stop();
+            return false;
+        }
+
+        GitParser::ObjectHeader header;
+        if (!GitParser::parseObjectHeader(headerLine, header))
+        {
+            batchProcess.stop();
+            return false;
+        }
+
+        if (header.missing)
+            continue; // e.g. a shallow clone boundary
+
+        objectBuffer.clear();
+        if (!batchProcess.readBytes(header.size + 1, objectBuffer, batchTimeoutMs))
+        {
+            batchProcess.stop();
+            return false;
+        }
+
+        GitParser::CommitInfo info;
+        const std::string_view content(objectBuffer.data(), header.size);
+
+        if (header.type == "commit" && GitParser::parseCommit(content, arena, info))
+            destination[oid] = toCommit(header.oid, info);
+    }
+
+    return true;
+}
+
+juce::Array<GitRepositoryWorker::Commit> GitRepositoryWorker::readHistory(HistoryCursor& cursor, int maxCommits,
+                                                                         const std::set<juce::String>* stopAt)
+{
+    const juce::ScopedLock sl(lock);
+    return readHistoryLocked(cursor, maxCommits, stopAt);
+}
+
+juce::Array<GitRepositoryWorker::Commit> GitRepositoryWorker::walkHistory(const juce::String& tip, int maxCommits)
+{
+    HistoryCursor cursor(tip);
+    return readHistoryLocked(cursor, maxCommits, nullptr);
+}
+
+juce::Array<GitRepositoryWorker::Commit> GitRepositoryWorker::readHistoryLocked(HistoryCursor& cursor, int maxCommits,
+                                                                               const std::set<juce::String>* stopAt)
+{
+    // Same order as a plain "git log": newest committer date first
+    juce::Array<Commit> history;
+    arena.reset();
+
+    if (!cursor.started)
+    {
+        cursor.started = true;
+        cursor.seen.insert(cursor.tip);
+
+        if (!fetchCommits({ cursor.tip }, cursor.loaded) || cursor.loaded.empty())
+            return history;
+
+        cursor.queue.push({ cursor.loaded[cursor.tip].committerTime, cursor.tip });
+    }
+
+    while (!cursor.queue.empty() && (maxCommits < 0 || history.size() < maxCommits))
+    {
+        Commit commit = cursor.loaded[cursor.queue.top().second];
+        cursor.queue.pop();
+        cursor.loaded.erase(commit.oid);
+
+        // Already known to the caller, so neither it nor its ancestors are new
+        if (stopAt != nullptr && stopAt->count(commit.oid) > 0)
+        {
+            cursor.stopsReached.insert(commit.oid);
+            continue;
+        }
+
+        juce::StringArray toFetch;
+        for (const auto& parent : commit.parents)
+            if (cursor.seen.insert(parent).second)
+                toFetch.add(parent);
+
+        if (!fetchCommits(toFetch, cursor.loaded))
+            break;
+
+        for (const auto& parent : toFetch)
+        {
+            auto found = cursor.loaded.find(parent);
+            if (found != cursor.loaded.end())
+                cursor.queue.push({ found->second.committerTime, parent });
+        }
+
+        history.add(std::move(commit));
+    }
+
+    return history;
+}
+
+GitRepositoryWorker::Commit GitRepositoryWorker::toCommit(std::string_view oid, const GitParser::CommitInfo& info)
+{
+    Commit commit;
+    commit.oid = GitParser::toString(oid);
+    commit.committerTime = info.committerTime;
+    commit.subject = GitParser::toSubjectLine(info.subject);
+
+    for (int i = 0; i < info.numParents; ++i)
+        commit.parents.add(GitParser::toString(info.parents[i]));
+
+    return commit;
+}
+
+//==============================================================================
+juce::String GitRepositoryWorker::formatRelativeTime(juce::int64 timestamp, juce::int64 now)
+{
+    // Mirrors show_date_relative() in git's date.c
+    auto plural = [](juce::int64 count, const char* unit)
+    {
+        return juce::String(count) + " " + unit + (count == 1 ? "" : "s");
+    };
+
+    if (now < timestamp)
+        return "in the future";
+
+    juce::int64 diff = now - timestamp;
+    if (diff < 90)
+        return plural(diff, "second") + " ago";
+
+    diff = (diff + 30) / 60;
+    if (diff < 90)
+        return plural(diff, "minute") + " ago";
+
+    diff = (diff + 30) / 60;
+    if (diff < 36)
+        return plural(diff, "hour") + " ago";
+
+    diff = (diff + 12) / 24;
+    if (diff < 14)
+        return plural(diff, "day") + " ago";
+
+    if (diff < 70)
+        return plural((diff + 3) / 7, "week") + " ago";
+
+    if (diff < 365)
+        return plural((diff + 15) / 30, "month") + " ago";
+
+    if (diff < 1825)
+    {
+        const juce::int64 totalMonths = (diff * 12 * 2 + 365) / (365 * 2);
+        const juce::int64 years = totalMonths / 12;
+        const juce::int64 months = totalMonths % 12;
+
+        if (months != 0)
+            return plural(years, "year") + ", " + plural(months, "month") + " ago";
+
+        return plural(years, "year") + " ago";
+    }
+
+    return plural((diff + 183) / 365, "year") + " ago";
+}
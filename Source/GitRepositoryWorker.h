@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    GitRepositoryWorker.h
+    Answers the editor's repository queries (branches, current branch, recent
+    history) without spawning a git process per call.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ProcessRunner.h"
+#include "GitParser.h"
+#include <map>
+#include <queue>
+#include <set>
+#include <string_view>
+
+//==============================================================================
+/**
+    Keeps one "git cat-file --batch" process alive per repository and reads
+    refs straight from the .git directory, so a whole summary of the
+    repository costs a handful of pipe round trips instead of one fork per
+    question.
+
+    All public methods are thread safe.
+*/
+class GitRepositoryWorker
+{
+public:
+    struct Commit
+    {
+        juce::String oid;
+        juce::StringArray parents;
+        juce::String subject;
+        juce::int64 committerTime = 0; // seconds since epoch
+    };
+
+    struct Summary
+    {
+        juce::String currentBranch;     // empty when HEAD is detached
+        juce::String headOid;           // empty in a repository without commits
+        bool detached = false;
+        juce::StringArray branches;     // short names, sorted
+        juce::Array<Commit> history;    // newest first
+    };
+
+    /** Where a history walk has got to, so the next page can carry on from there. */
+    class HistoryCursor
+    {
+    public:
+        explicit HistoryCursor(const juce::String& tipOid) : tip(tipOid) {}
+
+        const juce::String& getTip() const { return tip; }
+        bool isExhausted() const { return started && queue.empty(); }
+
+        /** True once a walk with a stop set ran into this stop commit: it's an ancestor of the tip. */
+        bool hasReachedStop(const juce::String& oid) const { return stopsReached.count(oid) > 0; }
+
+    private:
+        friend class GitRepositoryWorker;
+
+        juce::String tip;
+        bool started = false;
+        std::set<juce::String> stopsReached;
+        std::priority_queue<std::pair<juce::int64, juce::String>> queue; // by committer time
+        std::set<juce::String> seen;
+        std::map<juce::String, Commit> loaded;
+    };
+
+    explicit GitRepositoryWorker(const juce::File& repositoryRoot);
+    ~GitRepositoryWorker();
+
+    /** Branches, current branch and the newest maxCommits commits reachable from HEAD
+        (all of them if maxCommits < 0), in one go.
+    */
+    Summary query(int maxCommits);
+
+    /** Continues a history walk by up to maxCommits commits (newest first). Commits in stopAt,
+        and everything only reachable through them, are left out.
+    */
+    juce::Array<Commit> readHistory(HistoryCursor& cursor, int maxCommits, const std::set<juce::String>* stopAt = nullptr);
+
+    /** Resolves a ref such as "HEAD" or "refs/heads/master" to an object id. */
+    juce::String resolveRef(const juce::String& refName);
+
+    /** Reads a raw object through the batch process. Returns false if it is missing. */
+    bool readObject(const juce::String& oid, juce::String& type, std::string& content);
+
+    const juce::File& getGitDirectory() const { return gitDirectory; }
+    const juce::File& getCommonDirectory() const { return commonDirectory; }
+
+    /** Formats a timestamp the way git's "%ar" does, e.g. "3 hours ago". */
+    static juce::String formatRelativeTime(juce::int64 secondsSinceEpoch, juce::int64 now);
+
+private:
+    bool ensureBatchProcess();
+    bool readObjectLocked(const juce::String& oid, juce::String& type, std::string& content);
+    bool fetchCommits(const juce::StringArray& oids, std::map<juce::String, Commit>& destination);
+    juce::Array<Commit> walkHistory(const juce::String& tip, int maxCommits);
+    juce::Array<Commit> readHistoryLocked(HistoryCursor& cursor, int maxCommits, const std::set<juce::String>* stopAt);
+
+    juce::String resolveRefLocked(const juce::String& refName, int depth);
+    std::map<juce::String, juce::String> readPackedRefs();
+    std::map<juce::String, juce::String> listBranches();
+
+    static Commit toCommit(std::string_view oid, const GitParser::CommitInfo& info);
+
+    juce::File repositoryRoot;
+    juce::File gitDirectory;    // .git, or where a "gitdir:" file points
+    juce::File commonDirectory; // where refs live, differs from gitDirectory in linked worktrees
+
+    CoProcess batchProcess;
+    juce::CriticalSection lock;
+
+    // Reused by every history read, so a refresh parses without allocating per commit
+    ParseArena arena;
+    std::string headerLine;
+    std::string objectBuffer;
+
+    static constexpr int batchTimeoutMs = 10000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GitRepositoryWorker)
+};
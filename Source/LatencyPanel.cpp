@@ -0,0 +1,203 @@
+/*
+  ==============================================================================
+
+    LatencyPanel.cpp
+
+  ==============================================================================
+*/
+
+#include "LatencyPanel.h"
+
+namespace
+{
+    // Category ids in the combo box, in order; the first shows everything
+    const char* const categories[] = { "", "git", "query", "snapshot", "deferral", "editor", "command" };
+    const char* const categoryNames[] = { "All spans", "git calls", "Repository queries", "Snapshots", "Deferred snapshots",
+                                          "Editor refreshes", "Commands" };
+
+    juce::String formatLimit(double ms)
+    {
+        return ms < 1000.0 ? juce::String((int) ms) : juce::String((int) (ms / 1000.0)) + "s";
+    }
+}
+
+LatencyPanel::LatencyPanel(Tracer& t, const SnapshotScheduler& s, juce::Colour background, juce::Colour bars, juce::Colour text)
+    : tracer(t), scheduler(s), backgroundColour(background), barColour(bars), textColour(text)
+{
+    for (int i = 0; i < (int) std::size(categoryNames); ++i)
+        categoryBox.addItem(categoryNames[i], i + 1);
+
+    categoryBox.setSelectedId(2, juce::dontSendNotification);
+    categoryBox.onChange = [this] { lastNumRecorded = -1; repaint(); };
+    addAndMakeVisible(categoryBox);
+
+    exportButton.setButtonText("Export trace...");
+    exportButton.onClick = [this] { exportTrace(); };
+    addAndMakeVisible(exportButton);
+}
+
+LatencyPanel::~LatencyPanel()
+{
+    stopTimer();
+}
+
+juce::String LatencyPanel::getSelectedCategory() const
+{
+    return categories[juce::jlimit(0, (int) std::size(categories) - 1, categoryBox.getSelectedId() - 1)];
+}
+
+void LatencyPanel::setBudget(const juce::String& category, const juce::String& name, double budgetMs)
+{
+    budgets.push_back({ category, name, budgetMs });
+    lastNumRecorded = -1;
+    repaint();
+}
+
+juce::StringArray LatencyPanel::describeBudgets() const
+{
+    const juce::String category = getSelectedCategory();
+    juce::StringArray lines;
+
+    for (const auto& budget : budgets)
+    {
+        if (category.isNotEmpty() && category != budget.category)
+            continue;
+
+        int total = 0, over = 0;
+        double slowestMs = 0.0;
+
+        for (const auto& span : tracer.getSpans())
+        {
+            if (span.category != budget.category || span.name != budget.name)
+                continue;
+
+            ++total;
+            slowestMs = juce::jmax(slowestMs, span.durationMs);
+            if (span.durationMs > budget.budgetMs)
+                ++over;
+        }
+
+        if (total > 0)
+            lines.add(budget.name + ": " + juce::String(over) + " of " + juce::String(total) + " over the "
+                      + juce::String(budget.budgetMs, 0) + " ms budget, slowest " + juce::String(slowestMs, 1) + " ms");
+    }
+
+    return lines;
+}
+
+void LatencyPanel::paint(juce::Graphics& g)
+{
+    g.fillAll(backgroundColour);
+    g.setColour(barColour);
+    g.drawRect(getLocalBounds());
+
+    const Tracer::Histogram histogram = tracer.getHistogram(getSelectedCategory());
+    g.setColour(textColour);
+    g.setFont(12.0f);
+
+    juce::StringArray notes = describeBudgets();
+
+    if (getSelectedCategory() == "deferral")
+        notes.add(SnapshotScheduler::describe(scheduler.getStatistics()));
+
+    if (!notes.isEmpty())
+        g.drawFittedText(notes.joinIntoString("\n"), 8, getHeight() - 32, getWidth() - 16, 28, juce::Justification::centredLeft, 2);
+
+    if (histogram.total == 0)
+    {
+        g.drawText("Nothing recorded yet", getLocalBounds(), juce::Justification::centred);
+        return;
+    }
+
+    g.drawText(juce::String(histogram.total) + " spans   median " + juce::String(histogram.medianMs, 1) + " ms   p95 "
+                   + juce::String(histogram.p95Ms, 1) + " ms   max " + juce::String(histogram.maxMs, 1) + " ms",
+               8, 30, getWidth() - 16, 16, juce::Justification::centredLeft);
+
+    // One bar per bucket, scaled to the fullest
+    const int numBuckets = (int) histogram.counts.size();
+    const juce::Rectangle<int> chart(8, 50, getWidth() - 16, 110);
+    const float barWidth = (float) chart.getWidth() / (float) numBuckets;
+    int largest = 1;
+
+    for (auto count : histogram.counts)
+        largest = juce::jmax(largest, count);
+
+    g.setFont(10.0f);
+
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        const int count = histogram.counts[(size_t) i];
+        const float height = (float) (chart.getHeight() - 24) * (float) count / (float) largest;
+        const float x = (float) chart.getX() + barWidth * (float) i;
+
+        g.setColour(barColour);
+        g.fillRect(x + 2.0f, (float) chart.getBottom() - 12.0f - height, barWidth - 4.0f, height);
+
+        g.setColour(textColour);
+        if (count > 0)
+            g.drawText(juce::String(count), (int) x, (int) ((float) chart.getBottom() - 24.0f - height), (int) barWidth, 12,
+                       juce::Justification::centred);
+
+        const juce::String label = i < (int) Tracer::bucketLimitsMs.size() ? "<" + formatLimit(Tracer::bucketLimitsMs[(size_t) i])
+                                                                           : ">" + formatLimit(Tracer::bucketLimitsMs.back());
+        g.drawText(label, (int) x, chart.getBottom() - 12, (int) barWidth, 12, juce::Justification::centred);
+    }
+
+    // Where the time went
+    g.setFont(11.0f);
+    int y = chart.getBottom() + 6;
+
+    for (const auto& name : tracer.getSlowestNames(getSelectedCategory(), 5))
+    {
+        g.drawText(name, 8, y, getWidth() - 16, 14, juce::Justification::centredLeft, true);
+        y += 14;
+    }
+}
+
+void LatencyPanel::resized()
+{
+    categoryBox.setBounds(6, 6, 160, 20);
+    exportButton.setBounds(getWidth() - 106, 6, 100, 20);
+}
+
+void LatencyPanel::visibilityChanged()
+{
+    if (isVisible())
+    {
+        lastNumRecorded = -1;
+        startTimer(500);
+    }
+    else
+    {
+        stopTimer();
+    }
+}
+
+void LatencyPanel::timerCallback()
+{
+    const juce::int64 numRecorded = tracer.getNumRecorded();
+
+    if (numRecorded != lastNumRecorded)
+    {
+        lastNumRecorded = numRecorded;
+        repaint();
+    }
+}
+
+void LatencyPanel::exportTrace()
+{
+    const juce::File defaultFile = juce::File::getSpecialLocation(juce::File::userDesktopDirectory)
+                                       .getChildFile("snaptrack-trace-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".json");
+
+    chooser = std::make_unique<juce::FileChooser>("Export trace", defaultFile, "*.json");
+
+    juce::Component::SafePointer<LatencyPanel> safeThis(this);
+    chooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting,
+        [safeThis](const juce::FileChooser& fc)
+        {
+            const juce::File file = fc.getResult();
+
+            if (safeThis != nullptr && file != juce::File())
+                safeThis->tracer.writeChromeTrace(file);
+        });
+}
@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    LatencyPanel.h
+    A small histogram of recent span latencies, with the slowest calls
+    and a Chrome trace export.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Tracer.h"
+#include "SnapshotScheduler.h"
+
+//==============================================================================
+/**
+    Shows what the Tracer has recorded for one category at a time: a bar per
+    latency bucket, the median/p95/max, and the names that took the most
+    total time. Repaints twice a second while visible, and only when
+    something new was recorded. Deferred snapshots also get the scheduler's
+    running totals, and spans with a budget (see setBudget()) how often they
+    went over it.
+*/
+class LatencyPanel : public juce::Component,
+                     private juce::Timer
+{
+public:
+    LatencyPanel(Tracer& tracer, const SnapshotScheduler& scheduler, juce::Colour background, juce::Colour bars, juce::Colour text);
+    ~LatencyPanel() override;
+
+    /** Counts the spans of that category and name that took longer than budgetMs. */
+    void setBudget(const juce::String& category, const juce::String& name, double budgetMs);
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+    void timerCallback() override;
+    void exportTrace();
+    juce::String getSelectedCategory() const;
+    juce::StringArray describeBudgets() const;
+
+    struct Budget
+    {
+        juce::String category, name;
+        double budgetMs = 0.0;
+    };
+
+    Tracer& tracer;
+    const SnapshotScheduler& scheduler;
+    juce::Colour backgroundColour, barColour, textColour;
+
+    juce::ComboBox categoryBox;
+    juce::TextButton exportButton;
+    std::unique_ptr<juce::FileChooser> chooser;
+    juce::int64 lastNumRecorded = -1;
+    std::vector<Budget> budgets;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LatencyPanel)
+};
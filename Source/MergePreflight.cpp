@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    MergePreflight.cpp
+
+  ==============================================================================
+*/
+
+#include "MergePreflight.h"
+#include <string_view>
+
+//==============================================================================
+namespace
+{
+    juce::String makeKey(const juce::String& targetOid, const juce::String& branchOid)
+    {
+        return targetOid + " " + branchOid;
+    }
+
+    juce::String plural(int count, const char* noun)
+    {
+        return juce::String(count) + " " + noun + (count == 1 ? "" : "s");
+    }
+}
+
+//==============================================================================
+juce::String MergePreflight::Result::describe() const
+{
+    if (!succeeded)
+        return error.isNotEmpty() ? error : juce::String("The merge couldn't be checked");
+
+    if (alreadyMerged)
+        return target + " already has everything on " + branch;
+
+    if (!clean)
+    {
+        juce::StringArray lines;
+        lines.add(plural(conflicts.size(), "conflict") + " merging into " + target + ":");
+        lines.addArray(conflicts);
+        return lines.joinIntoString("\n");
+    }
+
+    const juce::String counts = plural(ahead, "snapshot") + " ahead of " + target
+                              + (behind > 0 ? ", " + juce::String(behind) + " behind" : juce::String());
+
+    return (fastForward ? "Fast-forward: " : "Merges cleanly: ") + counts;
+}
+
+//==============================================================================
+MergePreflight::MergePreflight(GitRunner runner)
+    : runGit(std::move(runner))
+{
+}
+
+MergePreflight::Result MergePreflight::check(GitRepositoryWorker& worker, const juce::String& target, const juce::String& branch,
+                                             const std::atomic<bool>* cancelFlag)
+{
+    Result result;
+    result.target = target;
+    result.branch = branch;
+    result.targetOid = worker.resolveRef("refs/heads/" + target);
+    result.branchOid = worker.resolveRef("refs/heads/" + branch);
+
+    if (result.targetOid.isEmpty() || result.branchOid.isEmpty())
+    {
+        result.error = "There is no branch " + (result.targetOid.isEmpty() ? target : branch);
+        return result;
+    }
+
+    Result cached;
+
+    if (getCachedResult(result.targetOid, result.branchOid, cached))
+    {
+        cached.target = target;
+        cached.branch = branch;
+        return cached;
+    }
+
+    // "behind<TAB>ahead": the left side is what only the target has
+    const ProcessResult counts = runGit({ "rev-list", "--left-right", "--count", result.targetOid + "..." + result.branchOid },
+                                        cancelFlag, gitTimeoutMs);
+
+    if (!counts.succeeded())
+    {
+        result.error = "Couldn't compare " + branch + " with " + target;
+        return result;
+    }
+
+    const juce::StringArray fields = juce::StringArray::fromTokens(juce::String(counts.output), " \t\r\n", "");
+    result.behind = fields[0].getIntValue();
+    result.ahead = fields[1].getIntValue();
+
+    if (result.ahead == 0)
+    {
+        result.alreadyMerged = true;
+        result.clean = true;
+    }
+    else if (result.behind == 0)
+    {
+        result.fastForward = true;
+        result.clean = true;
+    }
+    else
+    {
+        // Exit code 1 is a merge with conflicts; -z puts the tree, then each conflicted path, then an
+        // empty field, all NUL terminated
+        const ProcessResult merge = runGit({ "merge-tree", "--write-tree", "-z", "--name-only", "--no-messages",
+                                             result.targetOid, result.branchOid },
+                                           cancelFlag, gitTimeoutMs);
+
+        if (!merge.launched || merge.timedOut || merge.cancelled || (merge.exitCode != 0 && merge.exitCode != 1))
+        {
+            result.error = merge.cancelled ? juce::String("The merge check was cancelled")
+                                           : juce::String("The merge couldn't be checked (it needs git 2.38 or later)");
+            return result;
+        }
+
+        result.clean = merge.exitCode == 0;
+        std::string_view fieldsLeft(merge.output);
+        bool first = true;
+
+        while (!fieldsLeft.empty())
+        {
+            const size_t end = fieldsLeft.find('\0');
+            const std::string_view field = fieldsLeft.substr(0, end);
+            fieldsLeft.remove_prefix(end == std::string_view::npos ? fieldsLeft.size() : end + 1);
+
+            if (first)
+            {
+                first = false;  // the tree it would have made
+                continue;
+            }
+
+            if (field.empty())
+                break;
+
+            // A path with conflicting stages is listed once per stage
+            result.conflicts.addIfNotAlreadyThere(juce::String::fromUTF8(field.data(), (int) field.size()));
+        }
+    }
+
+    result.succeeded = true;
+    remember(result);
+    return result;
+}
+
+//==============================================================================
+bool MergePreflight::getCachedResult(const juce::String& targetOid, const juce::String& branchOid, Result& result) const
+{
+    const juce::ScopedLock sl(lock);
+    auto found = results.find(makeKey(targetOid, branchOid));
+
+    if (found == results.end())
+        return false;
+
+    result = found->second;
+    return true;
+}
+
+void MergePreflight::remember(const Result& result)
+{
+    const juce::String key = makeKey(result.targetOid, result.branchOid);
+    const juce::ScopedLock sl(lock);
+
+    if (results.count(key) == 0)
+        resultOrder.push_front(key);
+
+    results[key] = result;
+
+    while ((int) resultOrder.size() > maxCachedResults)
+    {
+        results.erase(resultOrder.back());
+        resultOrder.pop_back();
+    }
+}
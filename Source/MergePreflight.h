@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    MergePreflight.h
+    Whether a branch would merge cleanly, worked out without touching the
+    working tree or the index.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include "ProcessRunner.h"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+
+//==============================================================================
+/**
+    A merge that stops on a conflict leaves a half-merged set behind, and the
+    DAW reloads it. So the merge is tried first where it costs nothing:
+    "git merge-tree --write-tree" does the whole three-way merge in the object
+    database and only reports the tree it would have made, plus the files it
+    couldn't merge. The checkout, the index and the refs are never touched.
+
+    A branch that only adds commits on top of the target is a fast-forward
+    and needs no merge-tree run at all, and a branch the target already has
+    needs nothing. "rev-list --left-right --count" answers both, along with
+    the ahead/behind counts the editor shows.
+
+    Results are cached by the pair of branch tips, so checking the same
+    branch again after a refresh is free until either side moves. Thread
+    safe; check() runs git, so call it from a background queue.
+*/
+class MergePreflight
+{
+public:
+    using GitRunner = std::function<ProcessResult(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)>;
+
+    struct Result
+    {
+        juce::String target, branch;        // merging branch into target
+        juce::String targetOid, branchOid;  // the tips this is the answer for
+        bool succeeded = false;             // false if git couldn't say (merge-tree --write-tree needs git 2.38)
+        bool clean = false;
+        bool fastForward = false;
+        bool alreadyMerged = false;         // target already has everything on branch
+        int ahead = 0;                      // commits on branch that target hasn't got
+        int behind = 0;                     // commits on target that branch hasn't got
+        juce::StringArray conflicts;        // paths merge-tree couldn't merge
+        juce::String error;                 // why it didn't succeed
+
+        /** A line or two for the editor. */
+        juce::String describe() const;
+    };
+
+    explicit MergePreflight(GitRunner runGit);
+
+    /** Works out what merging branch into target would do. Both are short branch names. */
+    Result check(GitRepositoryWorker& worker, const juce::String& target, const juce::String& branch,
+                 const std::atomic<bool>* cancelFlag);
+
+    static constexpr int maxCachedResults = 16;
+    static constexpr int gitTimeoutMs = 60000;
+
+private:
+    bool getCachedResult(const juce::String& targetOid, const juce::String& branchOid, Result& result) const;
+    void remember(const Result& result);
+
+    GitRunner runGit;
+
+    mutable juce::CriticalSection lock;
+    std::map<juce::String, Result> results;     // by "targetOid branchOid"
+    std::list<juce::String> resultOrder;        // most recently used first
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MergePreflight)
+};
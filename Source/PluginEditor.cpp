@@ -5,20 +5,17 @@
 
 DAWVSCAudioProcessorEditor::DAWVSCAudioProcessorEditor(DAWVSCAudioProcessor& p)
     : AudioProcessorEditor(&p), audioProcessor(p),
-    commitListBoxModel(commitHistory),
+    commitListBoxModel(commitHistory, [this] { loadMoreHistory(); }, [this](int row) { showChanges(row); }),
     branchListBoxModel(branchList, [this](int row) { onBranchListItemClicked(row); })
 {
+    // Opening is timed against openBudgetMs; the span shows up under Timings, with the overruns
+    Tracer::ScopedSpan openSpan(audioProcessor.getTracer(), "editor", "open");
 
     //Fetch OS
     audioProcessor.getOS();
-    // Check git installation
-    gitInstalled = false;
-    gitVersion = audioProcessor.getGitVersion();
-    DBG("Git version: " + gitVersion);
-    if (gitVersion.contains("git version"))
-    {
-		gitInstalled = true;
-    }
+    // Git counts as installed until the probe the processor started at load says otherwise;
+    // waiting for it here could take as long as spawning git
+    gitInstalled = true;
 
 
     // Colors
@@ -66,20 +63,21 @@ DAWVSCAudioProcessorEditor::DAWVSCAudioProcessorEditor(DAWVSCAudioProcessor& p)
     {
         audioProcessor.checkForGit(projectPath); // Check for git repository in project path
         addAndMakeVisible(commitListBox);
+        addAndMakeVisible(changesView);
         addAndMakeVisible(commitButton);
+        addAndMakeVisible(previewButton);
+        addAndMakeVisible(markButton);
         addAndMakeVisible(checkoutButton);
         addAndMakeVisible(goForwardButton);
         addAndMakeVisible(branchListBox);
         addAndMakeVisible(branchButton);
         addAndMakeVisible(mergeButton);
         addAndMakeVisible(deleteBranchButton);
+        addAndMakeVisible(chunkAudioToggle);
     }
-    else if (gitInstalled) {
+    else {
         addAndMakeVisible(browseButton);
-    } else {
-		DBG("Git is not installed");
-        gitNotInstalledMessage = "Git is not installed.";
-	}
+    }
 
     // Initialize Browse
     browseButton.setButtonText("Browse...");
@@ -88,18 +86,43 @@ DAWVSCAudioProcessorEditor::DAWVSCAudioProcessorEditor(DAWVSCAudioProcessor& p)
 
     // Commits Controls
     commitListBox.setModel(&commitListBoxModel);
-    commitListBox.setBounds(130, 5, 260, 180);
-    commitButton.setBounds(130, commitListBox.getBottom() + 5, 260, 45);
+    commitListBox.setBounds(130, 5, 260, 120);
+    changesView.setReadOnly(true);
+    changesView.setMultiLine(true);
+    changesView.setScrollbarsShown(true);
+    changesView.setCaretVisible(false);
+    changesView.setFont(juce::Font(12.0f));
+    changesView.setColour(juce::TextEditor::backgroundColourId, secondaryBackgroundColor);
+    changesView.setColour(juce::TextEditor::textColourId, textColor);
+    changesView.setColour(juce::TextEditor::outlineColourId, accentColor);
+    changesView.setBounds(130, commitListBox.getBottom() + 5, 260, 55);
+    audioChangesView = std::make_unique<AudioChangesView>(secondaryBackgroundColor, accentColor, textColor);
+    audioChangesView->setBounds(295, changesView.getY(), 95, changesView.getHeight());
+    addChildComponent(*audioChangesView);
+    commitButton.setBounds(130, changesView.getBottom() + 5, 170, 45);
     checkoutButton.setBounds(130, commitButton.getBottom(), 130, 45);
     goForwardButton.setBounds(checkoutButton.getRight(), commitButton.getBottom(), 130, 45);
     commitButton.setButtonText("Take a Snapshot");
     checkoutButton.setButtonText("Checkout");
     goForwardButton.setButtonText("Return");
-    refreshCommitListBox();
     checkoutButton.onClick = [this] { checkoutButtonClicked(); };
     goForwardButton.onClick = [this] { goForwardButtonClicked(); };
     commitButton.onClick = [this] { commitButtonClicked(); };
 
+    // Audio previews: the selected snapshot's, and marking what the next snapshot keeps
+    previewButton.setColour(juce::TextButton::buttonColourId, secondaryColor);
+    previewButton.setBounds(commitButton.getRight(), commitButton.getY(), 90, 22);
+    previewButton.setButtonText("Play preview");
+    previewButton.onClick = [this] { previewButtonClicked(); };
+    markButton.setColour(juce::TextButton::buttonColourId, secondaryColor);
+    markButton.setColour(juce::TextButton::buttonOnColourId, accentColor);
+    markButton.setBounds(commitButton.getRight(), previewButton.getBottom(), 90, 23);
+    markButton.setButtonText("Mark preview");
+    markButton.setTooltip("While this is on, what the host plays becomes the next snapshot's preview");
+    markButton.setClickingTogglesState(true);
+    markButton.setToggleState(audioProcessor.isMarkingPreview(), juce::dontSendNotification);
+    markButton.onClick = [this] { audioProcessor.setMarkingPreview(markButton.getToggleState()); };
+
     // Branch Controls
     branchListBox.setModel(&branchListBoxModel);
     branchListBox.setBounds(10, 5, 110, 180);
@@ -109,17 +132,127 @@ DAWVSCAudioProcessorEditor::DAWVSCAudioProcessorEditor(DAWVSCAudioProcessor& p)
     branchButton.setButtonText("Create Branch");
     mergeButton.setButtonText("Merge");
     deleteBranchButton.setButtonText("Delete");
-    refreshBranchListBox();
+    attachToRepository();
+    refreshRepositoryViews();
     branchButton.onClick = [this] { branchButtonClicked(); };
     mergeButton.onClick = [this] { mergeButtonClicked(); };
     deleteBranchButton.onClick = [this] { deleteBranchButtonClicked(); };
 
+    // Background job status
+    jobStatusLabel.setColour(juce::Label::textColourId, textColor);
+    jobStatusLabel.setFont(juce::Font(12.0f));
+    jobStatusLabel.setBounds(130, 281, 80, 18);
+    addAndMakeVisible(jobStatusLabel);
+    cancelJobButton.setButtonText("Cancel");
+    cancelJobButton.setColour(juce::TextButton::buttonColourId, secondaryColor);
+    cancelJobButton.setBounds(320, 281, 70, 18);
+    cancelJobButton.onClick = [this]
+    {
+        repository->getSnapshotScheduler().cancelAll();
+        repository->getJobQueue().cancelAll();
+    };
+    addChildComponent(cancelJobButton);
+    chunkAudioToggle.setButtonText("Chunk audio");
+    chunkAudioToggle.setColour(juce::ToggleButton::textColourId, textColor);
+    chunkAudioToggle.setColour(juce::ToggleButton::tickColourId, textColor);
+    chunkAudioToggle.setBounds(215, 281, 100, 18);
+    chunkAudioToggle.setToggleState(audioProcessor.isChunkingLargeAudio(), juce::dontSendNotification);
+    chunkAudioToggle.onClick = [this] { audioProcessor.setChunkingLargeAudio(chunkAudioToggle.getToggleState()); };
+
+    // Where the time goes: git calls and refreshes as a histogram over the lists
+    timingsButton.setButtonText("Timings");
+    timingsButton.setColour(juce::TextButton::buttonColourId, secondaryColor);
+    timingsButton.setClickingTogglesState(true);
+    timingsButton.setBounds(10, 281, 55, 18);
+    timingsButton.onClick = [this] { latencyPanel->setVisible(timingsButton.getToggleState()); };
+    addAndMakeVisible(timingsButton);
+
+    // Backups to a mirror repository on another disk, see RepositoryBackup
+    backupButton.setButtonText("Backup");
+    backupButton.setColour(juce::TextButton::buttonColourId, secondaryColor);
+    backupButton.setBounds(timingsButton.getRight() + 5, 281, 55, 18);
+    backupButton.onClick = [this] { backupButtonClicked(); };
+    addAndMakeVisible(backupButton);
+    updateJobStatus();
+
+    // Auto snapshots happen in the processor, we just show them
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    audioProcessor.setCommitHistoryChangedCallback([safeThis]
+    {
+        if (safeThis != nullptr)
+            safeThis->refreshRepositoryViews();
+    });
+
+    audioProcessor.getGitVersionAsync([safeThis](const juce::String& version)
+    {
+        if (safeThis != nullptr)
+            safeThis->showGitVersion(version);
+    });
 
-    // Editor Created
+    // Editor Created: everything above draws from memory, the repository catches up afterwards
+}
+
+void DAWVSCAudioProcessorEditor::showGitVersion(const juce::String& version)
+{
+    gitVersion = version;
+    DBG("Git version: " + gitVersion);
+
+    if (gitVersion.contains("git version"))
+        return;
+
+    DBG("Git is not installed");
+    gitInstalled = false;
+    gitNotInstalledMessage = "Git is not installed.";
+    browseButton.setVisible(false);
+    repaint();
 }
 
 DAWVSCAudioProcessorEditor::~DAWVSCAudioProcessorEditor()
 {
+    stopReadingChanges();
+    repository->cancelMergePreflight(mergeCheckJob);
+    repository->getJobQueue().removeChangeListener(this);
+    repository->getSnapshotScheduler().removeChangeListener(this);
+    repository->getMaintenance().removeChangeListener(this);
+    repository->getBackup().removeChangeListener(this);
+    audioProcessor.setCommitHistoryChangedCallback(nullptr);
+}
+
+void DAWVSCAudioProcessorEditor::attachToRepository()
+{
+    std::shared_ptr<RepositoryService> current = audioProcessor.getRepository();
+
+    if (current == repository)
+        return;
+
+    if (repository != nullptr)
+    {
+        stopReadingChanges();
+        repository->cancelMergePreflight(mergeCheckJob);
+        mergeCheckJob = 0;
+        repository->getJobQueue().removeChangeListener(this);
+        repository->getSnapshotScheduler().removeChangeListener(this);
+        repository->getMaintenance().removeChangeListener(this);
+        repository->getBackup().removeChangeListener(this);
+    }
+
+    // Held, so the queues we listen to live as long as we do
+    repository = current;
+    shownState = nullptr;
+    changesOid.clear();
+    repository->getJobQueue().addChangeListener(this);
+    repository->getSnapshotScheduler().addChangeListener(this);
+    repository->getMaintenance().addChangeListener(this);
+    repository->getBackup().addChangeListener(this);
+
+    // The panel reads the tracer of the service it was made for
+    latencyPanel = std::make_unique<LatencyPanel>(repository->getTracer(), repository->getSnapshotScheduler(), secondaryBackgroundColor, accentColor, textColor);
+    latencyPanel->setBounds(5, 5, 390, 270);
+    latencyPanel->setBudget("editor", "open", openBudgetMs);
+    addChildComponent(*latencyPanel);
+    latencyPanel->setVisible(timingsButton.getToggleState());
+
+    updateJobStatus();
 }
 
 //==============================================================================
@@ -161,17 +294,22 @@ void DAWVSCAudioProcessorEditor::browseButtonClicked()
             if (fc.getResult().exists())
             {
                 audioProcessor.setProjectPath(fc.getResult().getFullPathName());
+                attachToRepository();
                 audioProcessor.checkForGit(audioProcessor.getProjectPath());
-                refreshCommitListBox();
-                refreshBranchListBox();
+                refreshRepositoryViews();
                 addAndMakeVisible(branchListBox);
                 addAndMakeVisible(branchButton);
                 addAndMakeVisible(mergeButton);
                 addAndMakeVisible(deleteBranchButton);
                 addAndMakeVisible(commitListBox);
+                addAndMakeVisible(changesView);
                 addAndMakeVisible(commitButton);
+                addAndMakeVisible(previewButton);
+                addAndMakeVisible(markButton);
                 addAndMakeVisible(checkoutButton);
                 addAndMakeVisible(goForwardButton);
+                chunkAudioToggle.setToggleState(audioProcessor.isChunkingLargeAudio(), juce::dontSendNotification);
+                addAndMakeVisible(chunkAudioToggle);
                 browseButton.setVisible(false);
             }
         });
@@ -181,23 +319,18 @@ void DAWVSCAudioProcessorEditor::browseButtonClicked()
 void DAWVSCAudioProcessorEditor::checkoutButtonClicked()
 {
     int row = commitListBox.getSelectedRow();
-    juce::StringArray commitHistory = audioProcessor.getCommitHistory();
-    if (row >= 0 && row < commitHistory.size())
+    if (const GitRepositoryWorker::Commit* commit = commitHistory != nullptr ? commitHistory->getCommit(row) : nullptr)
 	{
-		juce::String hash = commitHashes[row];
-        juce::String cmd = "git checkout " + hash;
-		executeAndRefresh(cmd);
+		executeAndRefresh("Checking out snapshot", { juce::StringArray { "checkout", commit->oid } });
 	}
 }
 
 void DAWVSCAudioProcessorEditor::goForwardButtonClicked()
 {
-    juce::String res = "";
-    res = audioProcessor.executeCommand("git status");
-    if (res.contains("HEAD detached at"))
+    if (audioProcessor.getRepositorySummary(0).detached)
     {
-        // AT = just checking out a commit, we should return to master branch without worrying about any changes
-        executeAndRefresh("git checkout master");
+        // Just checking out a commit, we should return to master branch without worrying about any changes
+        executeAndRefresh("Returning to master", { juce::StringArray { "checkout", "master" } });
     }
 }
 
@@ -214,8 +347,7 @@ void DAWVSCAudioProcessorEditor::branchButtonClicked()
         {
             juce::String branchName = alertWindow->getTextEditorContents("branchName");
             branchName = branchName.replaceCharacter(' ', '-');
-            juce::String cmd = "git checkout -b " + branchName;
-            executeAndRefresh(cmd);
+            executeAndRefresh("Creating branch", { juce::StringArray { "checkout", "-b", branchName } });
         }
         this->alertWindow.reset();
     }));
@@ -246,8 +378,9 @@ void DAWVSCAudioProcessorEditor::deleteBranchButtonClicked()
 		{
 			if (result != 0)
 			{
-				juce::String cmd = "git checkout master && git branch -D " + audioProcessor.getCurrentBranch();
-				executeAndRefresh(cmd);
+                juce::String branchName = audioProcessor.getCurrentBranch();
+				executeAndRefresh("Deleting branch", { juce::StringArray { "checkout", "master" },
+                                                       juce::StringArray { "branch", "-D", branchName } });
 			}
 			this->alertWindow.reset();
 		}));
@@ -268,64 +401,452 @@ void DAWVSCAudioProcessorEditor::mergeButtonClicked()
 	}
 	else
 	{
-        auto alertWindow = std::make_unique<juce::AlertWindow>("Merge branch", "Are you sure you want to merge the current branch into master?", juce::AlertWindow::NoIcon);
-        alertWindow->setLookAndFeel(&customLookAndFeel);
+        // The merge rewrites the working tree and reloads the set: ask first whether it will go through.
+        // Usually the check ran when the branch was shown and this answers from its cache.
+        confirmMergeWhenChecked = true;
+        checkMerge(currentBranch.trim());
+	}
+}
+
+void DAWVSCAudioProcessorEditor::checkMerge(const juce::String& branch)
+{
+    repository->cancelMergePreflight(mergeCheckJob);
+    mergeCheckJob = 0;
+
+    if (branch.isEmpty() || branch == "master")
+    {
+        mergeButton.setTooltip({});
+        confirmMergeWhenChecked = false;
+        return;
+    }
+
+    mergeButton.setTooltip("Checking whether " + branch + " merges into master...");
+
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    mergeCheckJob = repository->preflightMerge("master", branch, [safeThis](const MergePreflight::Result& result)
+    {
+        if (safeThis == nullptr)
+            return;
+
+        safeThis->mergeCheckJob = 0;
+        safeThis->mergeButton.setTooltip(result.describe());
+
+        if (std::exchange(safeThis->confirmMergeWhenChecked, false))
+            safeThis->confirmMerge(result);
+    });
+
+    // Nothing to check against: say so rather than leave the click unanswered
+    if (mergeCheckJob == 0 && std::exchange(confirmMergeWhenChecked, false))
+    {
+        MergePreflight::Result unchecked;
+        unchecked.target = "master";
+        unchecked.branch = branch;
+        unchecked.error = "The repository isn't open";
+        mergeButton.setTooltip(unchecked.describe());
+        confirmMerge(unchecked);
+    }
+}
+
+void DAWVSCAudioProcessorEditor::confirmMerge(const MergePreflight::Result& check)
+{
+    // Only a merge known to go through cleanly gets to the working tree. One that couldn't be
+    // checked (an old git, a timeout) would be run blind, and could leave it half merged.
+    const bool canMerge = check.succeeded && check.clean;
+    juce::String message = "Are you sure you want to merge the current branch into master?";
+
+    if (!check.succeeded)
+        message = "Couldn't check whether " + check.branch + " merges into master, so it can't be merged from here.";
+    else if (!check.clean)
+        message = check.branch + " can't be merged into master yet.";
+
+    auto alertWindow = std::make_unique<juce::AlertWindow>("Merge branch", message + "\n\n" + check.describe(), juce::AlertWindow::NoIcon);
+    alertWindow->setLookAndFeel(&customLookAndFeel);
+    if (canMerge)
         alertWindow->addButton("Merge", 1);
-        alertWindow->addButton("Cancel", 0);
-        alertWindow->enterModalState(true, juce::ModalCallbackFunction::create([this, alertWindow = alertWindow.get()](int result) mutable
+    alertWindow->addButton(canMerge ? "Cancel" : "OK", 0);
+    alertWindow->enterModalState(true, juce::ModalCallbackFunction::create([this, alertWindow = alertWindow.get(), branchName = check.branch](int result) mutable
+    {
+        if (result != 0)
         {
-            if (result != 0)
-			{
-                juce::String branchName = audioProcessor.getCurrentBranch().trim();
-				juce::String cmd = "git checkout master && git merge " + branchName + " && git branch -D " + branchName;
-				executeAndRefresh(cmd);
-			}
-			this->alertWindow.reset();
-		}));
-        this->alertWindow = std::move(alertWindow);
-	}
+            executeAndRefresh("Merging branch", { juce::StringArray { "checkout", "master" },
+                                                  juce::StringArray { "merge", branchName },
+                                                  juce::StringArray { "branch", "-D", branchName } });
+        }
+        this->alertWindow.reset();
+    }));
+    this->alertWindow = std::move(alertWindow);
 }
 
-void DAWVSCAudioProcessorEditor::refreshCommitListBox()
+void DAWVSCAudioProcessorEditor::refreshRepositoryViews()
 {
-    // separate the hash from the rest of the commit message
-    commitHashes.clear();
-    commitHistory.clear();
-    juce::StringArray commitHistoryTmp = audioProcessor.getCommitHistory();
-    for (int i = 0; i < commitHistoryTmp.size(); i++)
-	{
-		commitHashes.add(commitHistoryTmp[i].upToFirstOccurrenceOf(" ", false, false));
-        commitHistory.add(commitHistoryTmp[i].fromFirstOccurrenceOf(" ", false, false));
-	}
-    commitListBox.updateContent();
-    commitListBox.selectRow(0);
+    // The host may have restored another project into the processor since we last looked
+    attachToRepository();
+
+    Tracer::ScopedSpan span(repository->getTracer(), "editor", "refreshRepositoryViews");
+
+    // Whatever was last published straight away, then again if the repository moved on
+    showState(repository->getState());
+
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    auto showLatest = [safeThis](bool changed)
+    {
+        if (safeThis != nullptr && changed)
+            safeThis->showState(safeThis->repository->getState());
+    };
+
+    repository->refreshSummary(showLatest);
+    audioProcessor.refreshHistory(showLatest);
+}
+
+void DAWVSCAudioProcessorEditor::showState(std::shared_ptr<const RepositoryState> state)
+{
+    // Editors on the same project are handed the same versions; older ones may still arrive late
+    if (state == nullptr || state == shownState || (shownState != nullptr && state->version < shownState->version))
+        return;
+
+    Tracer::ScopedSpan span(repository->getTracer(), "editor", "showState");
+    std::shared_ptr<const RepositoryState> before = std::move(shownState);
+    shownState = state;
+
+    if (state->hasSummary && (before == nullptr || !before->hasSummary || !RepositoryState::isSameSummary(before->summary, state->summary)))
+    {
+        refreshBranchListBox(state->summary);
+        // The merge button knows what it would do before it's pressed
+        checkMerge(state->summary.currentBranch);
+    }
+
+    if (before == nullptr || state->history != before->history)
+        showHistory(state->history);
+}
+
+void DAWVSCAudioProcessorEditor::showHistory(std::shared_ptr<const RepositoryState::History> history)
+{
+    std::shared_ptr<const RepositoryState::History> before = std::move(commitHistory);
+    commitHistory = std::move(history);
+
+    const int oldRows = before != nullptr ? before->getNumRows() : 0;
+    const int newRows = commitHistory != nullptr ? commitHistory->getNumRows() : 0;
+
+    // Only the row count: rows that keep their index keep their component and aren't repainted
+    if (newRows != oldRows)
+        commitListBox.updateContent();
+
+    // So repaint the rows in view whose commit or lanes moved on. Rows out of view paint from the
+    // new state when they're scrolled to.
+    const int firstVisible = commitListBox.getViewport()->getViewPositionY() / commitListBox.getRowHeight();
+    const int lastVisible = juce::jmin(newRows, firstVisible + commitListBox.getNumRowsOnScreen() + 1);
+
+    for (int row = firstVisible; row < lastVisible; ++row)
+        if (!RepositoryState::isSameRow(before.get(), commitHistory.get(), row))
+            commitListBox.repaintRow(row);
+
+    // A new tip is a new snapshot or another branch: show its newest commit, as the list always has.
+    // More pages or a redone graph leave the selection where it is.
+    const juce::String oldTip = before != nullptr ? before->tip : juce::String();
+    const juce::String newTip = commitHistory != nullptr ? commitHistory->tip : juce::String();
+
+    if (before == nullptr || oldTip != newTip)
+    {
+        commitListBox.selectRow(0);
+        // Row 0 may have been selected already, with the commit before this one in it
+        showChanges(commitListBox.getSelectedRow());
+    }
+}
+
+void DAWVSCAudioProcessorEditor::showChanges(int row)
+{
+    const GitRepositoryWorker::Commit* commit = commitHistory != nullptr ? commitHistory->getCommit(row) : nullptr;
+
+    if (commit == nullptr)
+    {
+        stopReadingChanges();
+        changesOid.clear();
+        changesView.clear();
+        showAudioChanges({});
+        return;
+    }
+
+    if (commit->oid == changesOid)
+        return;
+
+    // Only the latest selection is worth reading
+    stopReadingChanges();
+    changesOid = commit->oid;
+    changesView.setText("Reading changes...", false);
+    showAudioChanges({});
+
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    changesJob = repository->diffSnapshot(commit->oid, [safeThis](const ProjectDiff::Result& result)
+    {
+        if (safeThis == nullptr || result.newCommit != safeThis->changesOid)
+            return;
+
+        safeThis->changesJob = 0;
+        safeThis->changesView.setText(result.describe(), false);
+
+        const juce::String oid = result.newCommit;
+        safeThis->audioJob = safeThis->repository->compareAudio(result, [safeThis, oid](const std::vector<AudioOverviewCache::Comparison>& comparisons)
+        {
+            if (safeThis == nullptr || oid != safeThis->changesOid)
+                return;
+
+            safeThis->audioJob = 0;
+            safeThis->showAudioChanges(comparisons);
+        });
+    });
+}
+
+void DAWVSCAudioProcessorEditor::stopReadingChanges()
+{
+    repository->cancelDiff(changesJob);
+    repository->cancelAudioComparison(audioJob);
+    audioProcessor.cancelPreview(previewJob);
+    changesJob = 0;
+    audioJob = 0;
+    previewJob = 0;
+    previewButton.setButtonText(audioProcessor.isPlayingPreview() ? "Stop preview" : "Play preview");
+}
+
+void DAWVSCAudioProcessorEditor::previewButtonClicked()
+{
+    // The player stops by itself at the end, so ask it rather than trust the label
+    if (audioProcessor.isPlayingPreview() || previewJob != 0)
+    {
+        audioProcessor.cancelPreview(previewJob);
+        audioProcessor.stopPreview();
+        previewJob = 0;
+        previewButton.setButtonText("Play preview");
+        return;
+    }
+
+    if (changesOid.isEmpty())
+        return;
+
+    previewButton.setButtonText("Loading...");
+
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    const juce::String oid = changesOid;
+    previewJob = audioProcessor.playPreview(oid, [safeThis, oid](bool found)
+    {
+        if (safeThis == nullptr || oid != safeThis->changesOid)
+            return;
+
+        safeThis->previewJob = 0;
+        safeThis->previewButton.setButtonText(found ? "Stop preview" : "No preview");
+    });
+
+    if (previewJob == 0)
+        previewButton.setButtonText("No preview");
+}
+
+void DAWVSCAudioProcessorEditor::showAudioChanges(const std::vector<AudioOverviewCache::Comparison>& comparisons)
+{
+    // The thumbnails take the right of the changes list while there are any
+    audioChangesView->setComparisons(comparisons);
+    audioChangesView->setVisible(changesView.isVisible() && !comparisons.empty());
+    changesView.setSize(comparisons.empty() ? 260 : 160, changesView.getHeight());
 }
 
-void DAWVSCAudioProcessorEditor::refreshBranchListBox()
+void DAWVSCAudioProcessorEditor::loadMoreHistory()
 {
-	branchList.clear();
+    if (historyPageRequested)
+        return;
+
+    historyPageRequested = true;
+
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    audioProcessor.loadMoreHistory([safeThis](int)
+    {
+        if (safeThis != nullptr)
+        {
+            safeThis->historyPageRequested = false;
+            safeThis->showState(safeThis->repository->getState());
+        }
+    });
+}
+
+void DAWVSCAudioProcessorEditor::refreshBranchListBox(const GitRepositoryWorker::Summary& summary)
+{
+    Tracer::ScopedSpan span(repository->getTracer(), "editor", "refreshBranchListBox");
+    const juce::StringArray before = branchList;
+    branchList = DAWVSCAudioProcessor::formatBranches(summary);
     int headBranch = -1;
-	juce::StringArray branches = audioProcessor.getBranches();
-	for (int i = 0; i < branches.size(); i++)
-	{
-		branchList.add(branches[i]);
-        if (branches[i].contains("*"))
-		{
-			headBranch = i;
-		}
-	}
-	branchListBox.updateContent();
+
+    // Rows in formatBranches() order; the detached HEAD row has no branch behind it
+    branchNames.clear();
+    if (summary.detached)
+    {
+        branchNames.add({});
+        headBranch = 0;
+    }
+
+    for (const auto& branch : summary.branches)
+    {
+        if (branch == summary.currentBranch && !summary.detached)
+            headBranch = branchNames.size();
+
+        branchNames.add(branch);
+    }
+
+    // Like the commit list: a new row count, then only the rows whose text changed
+    if (branchList.size() != before.size())
+        branchListBox.updateContent();
+
+    for (int row = 0; row < branchList.size(); ++row)
+        if (row >= before.size() || branchList[row] != before[row])
+            branchListBox.repaintRow(row);
+
     if (headBranch >= 0)
 	{
 		branchListBox.selectRow(headBranch);
 	}
 }
 
-void DAWVSCAudioProcessorEditor::executeAndRefresh(juce::String command)
+void DAWVSCAudioProcessorEditor::executeAndRefresh(const juce::String& description, const juce::Array<juce::StringArray>& steps)
 {
-    // Execute command and refresh the DAW
-	audioProcessor.executeCommand(command.toStdString());
-	audioProcessor.reloadWorkingTree();
+    // Execute command in the background, then refresh the lists and the DAW
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    audioProcessor.runGitJob(description, steps, [safeThis](const GitJobQueue::Result& result)
+    {
+        if (safeThis == nullptr)
+            return;
+
+        safeThis->refreshRepositoryViews();
+
+        if (!result.cancelled)
+            safeThis->audioProcessor.reloadWorkingTree();
+    });
+}
+
+void DAWVSCAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadcaster*)
+{
+    updateJobStatus();
+}
+
+void DAWVSCAudioProcessorEditor::updateJobStatus()
+{
+    GitJobQueue::Status status = repository->getJobQueue().getStatus();
+    RepositoryMaintenance& maintenance = repository->getMaintenance();
+
+    // Maintenance steps aside for whatever the user starts, so it doesn't lock the controls
+    const bool busy = (status.busy && !maintenance.isRunning()) || status.numPending > 0;
+
+    // Everything that starts git work waits until the queue is idle again
+    juce::Array<juce::Component*> controls { &commitButton, &checkoutButton, &goForwardButton,
+                                             &branchButton, &mergeButton, &deleteBranchButton, &branchListBox,
+                                             &chunkAudioToggle };
+    for (auto* control : controls)
+        control->setEnabled(!busy);
+
+    juce::String text;
+    if (status.busy)
+    {
+        text = status.description;
+        if (status.detail.isNotEmpty())
+            text += " (" + status.detail + ")";
+        if (status.progress >= 0.0f)
+            text += " " + juce::String(juce::roundToInt(status.progress * 100.0f)) + "%";
+        if (status.numPending > 0)
+            text += ", " + juce::String(status.numPending) + " queued";
+    }
+    else
+    {
+        SnapshotScheduler& scheduler = repository->getSnapshotScheduler();
+        SnapshotScheduler::WaitReason reason = scheduler.getWaitReason();
+
+        if (reason != SnapshotScheduler::WaitReason::none)
+            text = "Snapshot waiting for " + SnapshotScheduler::describe(reason) + " to stop";
+        else
+            text = RepositoryMaintenance::describe(maintenance.getMetrics());
+    }
+
+    const bool snapshotWaiting = repository->getSnapshotScheduler().getNumWaiting() > 0;
+
+    // A backup runs alongside the queue, so it only gets the line while nothing else wants it
+    RepositoryBackup& backup = repository->getBackup();
+    const RepositoryBackup::Status backupStatus = backup.getStatus();
+    const juce::String backupText = RepositoryBackup::describe(backup.getSettings(), backupStatus);
+
+    if (backupStatus.running && !status.busy && !snapshotWaiting)
+        text = backupText;
+
+    juce::String tooltip = RepositoryMaintenance::describeInDetail(maintenance.getMetrics());
+    if (backupText.isNotEmpty())
+        tooltip << "\n" << backupText;
+    if (tooltip.isNotEmpty())
+        tooltip << "\n";
+    tooltip << SnapshotScheduler::describe(repository->getSnapshotScheduler().getStatistics());
+
+    jobStatusLabel.setText(text, juce::dontSendNotification);
+    jobStatusLabel.setTooltip(tooltip);
+    cancelJobButton.setVisible(busy || snapshotWaiting);
+}
+
+void DAWVSCAudioProcessorEditor::backupButtonClicked()
+{
+    RepositoryBackup& backup = audioProcessor.getBackup();
+    const RepositoryBackup::Settings settings = backup.getSettings();
+
+    juce::PopupMenu menu;
+    menu.setLookAndFeel(&customLookAndFeel);
+
+    if (settings.isEnabled())
+    {
+        menu.addSectionHeader(settings.mirror.getFullPathName());
+        menu.addItem(juce::PopupMenu::Item(RepositoryBackup::describe(settings, backup.getStatus())).setEnabled(false));
+    }
+
+    menu.addItem(1, settings.isEnabled() ? "Back up somewhere else..." : "Back up to...");
+    menu.addItem(2, "Back up now", settings.isEnabled());
+    menu.addItem(3, "Stop backing up", settings.isEnabled());
+
+    juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&backupButton), [safeThis](int choice)
+    {
+        if (safeThis == nullptr)
+            return;
+
+        RepositoryBackup& backup = safeThis->audioProcessor.getBackup();
+        RepositoryBackup::Settings settings = backup.getSettings();
+
+        if (choice == 1)
+        {
+            safeThis->chooseBackupMirror();
+        }
+        else if (choice == 2)
+        {
+            backup.runNow();
+        }
+        else if (choice == 3)
+        {
+            backup.cancel();
+            settings.mirror = juce::File();
+            backup.setSettings(settings);
+        }
+    });
+}
+
+void DAWVSCAudioProcessorEditor::chooseBackupMirror()
+{
+    chooser = std::make_unique<juce::FileChooser>("Back up the snapshots to", juce::File::getSpecialLocation(juce::File::userHomeDirectory), "*");
+
+    chooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+        [this](const juce::FileChooser& fc)
+        {
+            const juce::File chosen = fc.getResult();
+            if (!chosen.isDirectory())
+                return;
+
+            // An existing mirror or an empty folder is used as it is, anything else gets a mirror inside it
+            const bool isMirror = chosen.getChildFile("HEAD").existsAsFile() && chosen.getChildFile("objects").isDirectory();
+            const bool isEmpty = chosen.getNumberOfChildFiles(juce::File::findFilesAndDirectories) == 0;
+
+            RepositoryBackup& backup = audioProcessor.getBackup();
+            RepositoryBackup::Settings settings = backup.getSettings();
+            settings.mirror = isMirror || isEmpty ? chosen
+                                                  : chosen.getChildFile(juce::File(audioProcessor.getProjectPath()).getFileName() + ".git");
+            backup.setSettings(settings);
+        });
 }
 
 void DAWVSCAudioProcessorEditor::commitButtonClicked()
@@ -341,10 +862,12 @@ void DAWVSCAudioProcessorEditor::commitButtonClicked()
 		{
 			juce::String commitMessage = alertWindow->getTextEditorContents("commitMessage");
             if (commitMessage.isEmpty()) commitMessage = "No message attached";
-			juce::String cmd = "git add . && git commit -m \"" + commitMessage + "\"";
-			audioProcessor.executeCommand(cmd.toStdString());
-            refreshCommitListBox();
-            refreshBranchListBox();
+            juce::Component::SafePointer<DAWVSCAudioProcessorEditor> safeThis(this);
+            audioProcessor.takeSnapshot(commitMessage, [safeThis](const GitJobQueue::Result&)
+                {
+                    if (safeThis != nullptr)
+                        safeThis->refreshRepositoryViews();
+                });
 		}
 		this->alertWindow.reset();
 	}));
@@ -354,8 +877,9 @@ void DAWVSCAudioProcessorEditor::commitButtonClicked()
 
 void DAWVSCAudioProcessorEditor::onBranchListItemClicked(int row)
 {
-    juce::String branchName = branchList[row];
-    branchName = branchName.fromFirstOccurrenceOf(" ", false, false);
-    juce::String cmd = "git checkout " + branchName;
-    executeAndRefresh(cmd);
+    const juce::String branchName = branchNames[row];
+    if (branchName.isEmpty())
+        return; // the "(HEAD detached at ...)" row
+
+    executeAndRefresh("Switching branch", { juce::StringArray { "checkout", branchName } });
 }
\ No newline at end of file
@@ -2,9 +2,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "LatencyPanel.h"
+#include "CommitRowPainter.h"
+#include "AudioChangesView.h"
 
 //==============================================================================
-class DAWVSCAudioProcessorEditor : public juce::AudioProcessorEditor
+class DAWVSCAudioProcessorEditor : public juce::AudioProcessorEditor,
+                                   private juce::ChangeListener
 {
 public:
     DAWVSCAudioProcessorEditor(DAWVSCAudioProcessor&);
@@ -14,32 +18,64 @@ public:
     void paint(juce::Graphics&) override;
     void resized() override;
 
+    // Opening draws from the processor's caches; one frame at 60 Hz is all it may take
+    static constexpr double openBudgetMs = 16.0;
+
 private:
     juce::ListBox commitListBox;
-    juce::StringArray commitHistory;
-    juce::StringArray commitHashes;
+    std::shared_ptr<const RepositoryState::History> commitHistory;  // the history of shownState
     class CommitListBoxModel : public juce::ListBoxModel
     {
         public:
-            CommitListBoxModel(juce::StringArray& commits) : commitHistory(commits) {}
+            using NeedMoreRowsCallback = std::function<void()>;
+            using SelectionChangedCallback = std::function<void(int)>;
+
+            CommitListBoxModel(std::shared_ptr<const RepositoryState::History>& commits, NeedMoreRowsCallback callback,
+                               SelectionChangedCallback selectionCallback)
+                : commitHistory(commits), needMoreRowsCallback(callback), selectionChangedCallback(selectionCallback) {}
 
             int getNumRows() override
             {
-                return commitHistory.size();
+                // One extra row at the bottom while there is older history left to load
+                return commitHistory != nullptr ? commitHistory->getNumRows() : 0;
             }
 
             void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override
             {
+                // Only rows that get painted are ever loaded: fetch the next page as the end comes into view
+                if (commitHistory != nullptr && !commitHistory->complete
+                    && rowNumber >= commitHistory->getNumCommits() - CommitHistoryCache::pageSize / 4
+                    && needMoreRowsCallback)
+                    needMoreRowsCallback();
+
+                if (const GitRepositoryWorker::Commit* commit = commitHistory != nullptr ? commitHistory->getCommit(rowNumber) : nullptr)
+                {
+                    const juce::String text = commit->subject + " " + GitRepositoryWorker::formatRelativeTime(commit->committerTime, juce::Time::currentTimeMillis() / 1000);
+
+                    rowPainter.paint(g, commit->oid, commitHistory->getGraphRow(rowNumber), commitHistory->graphColumns,
+                                     text, width, height, rowIsSelected);
+                    return;
+                }
+
                 if (rowIsSelected)
                     g.fillAll(juce::Colour(212, 163, 115));
 
                 g.setColour(juce::Colour(6, 6, 5));
                 g.setFont(height * 0.5f);
-                g.drawText(commitHistory[rowNumber], 5, 0, width, height, juce::Justification::centredLeft, true);
+                g.drawText("Loading older snapshots...", 5, 0, width, height, juce::Justification::centredLeft, true);
+            }
+
+            void selectedRowsChanged(int lastRowSelected) override
+            {
+                if (selectionChangedCallback)
+                    selectionChangedCallback(lastRowSelected);
             }
 
         private:
-            juce::StringArray& commitHistory;
+            std::shared_ptr<const RepositoryState::History>& commitHistory;
+            NeedMoreRowsCallback needMoreRowsCallback;
+            SelectionChangedCallback selectionChangedCallback;
+            CommitRowPainter rowPainter;
     };
 
     juce::ListBox branchListBox;
@@ -91,6 +127,8 @@ private:
     juce::TextButton mergeButton;
     // Commit Controls
     juce::TextButton commitButton;
+    juce::TextButton previewButton;
+    juce::TextButton markButton;
     juce::TextButton checkoutButton;
     juce::TextButton goForwardButton;
 
@@ -104,12 +142,58 @@ private:
     void branchButtonClicked();
     void deleteBranchButtonClicked();
     void mergeButtonClicked();
-    void commitButtonClicked();
 
-    void executeAndRefresh(juce::String command);
-
-    void refreshCommitListBox();
-    void refreshBranchListBox();
+    // Merging is checked in the background whenever a branch is shown (see MergePreflight), and the
+    // answer goes in the merge button's tooltip. Pressing it confirms with the answer, or refuses.
+    void checkMerge(const juce::String& branch);
+    void confirmMerge(const MergePreflight::Result& check);
+    GitJobQueue::JobId mergeCheckJob = 0;
+    bool confirmMergeWhenChecked = false;   // the merge button was pressed while the check was running
+    void commitButtonClicked();
+    void previewButtonClicked();
+
+    // Queues the git steps on the processor's job queue, then refreshes the lists and reloads the DAW
+    void executeAndRefresh(const juce::String& description, const juce::Array<juce::StringArray>& steps);
+
+    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+    void updateJobStatus();
+    void showGitVersion(const juce::String& version);
+    juce::Label jobStatusLabel;   // repository size and loose objects while nothing is running, more in its tooltip
+    juce::TooltipWindow tooltipWindow { this };
+    juce::TextButton cancelJobButton;
+    juce::ToggleButton chunkAudioToggle;
+    juce::TextButton timingsButton;
+    juce::TextButton backupButton;
+    void backupButtonClicked();
+    void chooseBackupMirror();
+    std::unique_ptr<LatencyPanel> latencyPanel; // remade with the tracer of each repository we attach to
+
+    // Listens to the processor's current RepositoryService, and moves over when that changes
+    std::shared_ptr<RepositoryService> repository;
+    void attachToRepository();
+
+    // Refreshes both lists: from the service's published state at once, and from the repository in the background
+    void refreshRepositoryViews();
+    void loadMoreHistory();
+    bool historyPageRequested = false;
+
+    // Moves the lists on to a newer state, touching only the rows that differ from the one shown
+    std::shared_ptr<const RepositoryState> shownState;
+    void showState(std::shared_ptr<const RepositoryState> state);
+    void showHistory(std::shared_ptr<const RepositoryState::History> history);
+    void refreshBranchListBox(const GitRepositoryWorker::Summary& summary);
+    juce::StringArray branchNames;  // the branch on each row of branchList, empty for a detached HEAD
+
+    // What the selected snapshot changed in the set, read in the background
+    juce::TextEditor changesView;
+    juce::String changesOid;            // the commit changesView is showing or waiting for
+    GitJobQueue::JobId changesJob = 0;
+    std::unique_ptr<AudioChangesView> audioChangesView;
+    GitJobQueue::JobId audioJob = 0;
+    GitJobQueue::JobId previewJob = 0;  // loading the selected snapshot's preview to play it
+    void showChanges(int row);
+    void stopReadingChanges();
+    void showAudioChanges(const std::vector<AudioOverviewCache::Comparison>& comparisons);
 
     std::unique_ptr<juce::AlertWindow> alertWindow;
 
@@ -8,7 +8,6 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include <Windows.h>
 
 
 //==============================================================================
@@ -24,10 +23,19 @@ DAWVSCAudioProcessor::DAWVSCAudioProcessor()
                        )
 #endif
 {
+    // The editor needs it, and by the time the editor opens it's been answered
+    RepositoryService::probeGitVersion();
+
+    repository = RepositoryService::acquire({});
+    repository->addListener(this);
+    repository->addPreviewSource(&previewCapture);
 }
 
 DAWVSCAudioProcessor::~DAWVSCAudioProcessor()
 {
+    *alive = false;
+    repository->removePreviewSource(&previewCapture);
+    repository->removeListener(this);
 }
 
 //==============================================================================
@@ -96,8 +104,10 @@ void DAWVSCAudioProcessor::changeProgramName (int index, const juce::String& new
 //==============================================================================
 void DAWVSCAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    juce::ignoreUnused (samplesPerBlock);
+
+    // Everything the audio thread will touch is allocated here, never in processBlock
+    previewCapture.prepare (sampleRate, juce::jmin (PreviewCapture::maxChannels, getTotalNumInputChannels()));
 }
 
 void DAWVSCAudioProcessor::releaseResources()
@@ -134,31 +144,30 @@ bool DAWVSCAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) c
 
 void DAWVSCAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    juce::ignoreUnused (midiMessages);
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
+    // Outputs without an input would otherwise pass on whatever garbage the host left in them
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // This is the place where you'd normally do the guts of your plugin's
-    // audio processing...
-    // Make sure to reset the state if your inner loop is processing
-    // the samples and the outer loop is handling the channels.
-    // Alternatively, you can process the samples with the channels
-    // interleaved by keeping the same state.
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
-    {
-        auto* channelData = buffer.getWritePointer (channel);
+    bool isPlaying = false;
 
-        // ..do something to the data...
+    // Lets the snapshot scheduler keep git off the disk while the host plays or records
+    if (auto* playHead = getPlayHead())
+    {
+        if (auto position = playHead->getPosition())
+        {
+            isPlaying = position->getIsPlaying();
+            RepositoryService::getTransportState().publish(isPlaying, position->getIsRecording());
+        }
     }
+
+    // What the host played, before a preview being auditioned replaces it. Neither call locks or allocates.
+    previewCapture.push (buffer, isPlaying);
+    previewPlayer.render (buffer);
 }
 
 //==============================================================================
@@ -169,7 +178,6 @@ bool DAWVSCAudioProcessor::hasEditor() const
 
 juce::AudioProcessorEditor* DAWVSCAudioProcessor::createEditor()
 {
-    createdEditor = true;
     return new DAWVSCAudioProcessorEditor (*this);
 }
 
@@ -186,6 +194,9 @@ void DAWVSCAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 		xml.setAttribute("projectPath", projectPath->getFullPathName());
 	}
 
+    xml.addChildElement(getMaintenance().getBudget().toXml().release());
+    xml.addChildElement(getBackup().getSettings().toXml().release());
+
     // Add any other metadata here
 
     // Convert the XML to a string and then store it in the memory block
@@ -205,98 +216,171 @@ void DAWVSCAudioProcessor::setStateInformation (const void* data, int sizeInByte
         {
             setProjectPath(xmlState->getStringAttribute("projectPath"));
         }
+
+        if (auto* budget = xmlState->getChildByName("Maintenance"))
+            getMaintenance().setBudget(RepositoryMaintenance::Budget::fromXml(*budget));
+
+        if (auto* backup = xmlState->getChildByName("Backup"))
+            getBackup().setSettings(RepositoryBackup::Settings::fromXml(*backup));
     }
     // Restore any other parameters from the xmlState here
 }
 
 juce::String DAWVSCAudioProcessor::executeCommand(const std::string& command)
 {
-    if (!createdEditor) {
-        createEditor();
-    }
-    if (os.toLowerCase().contains("windows") || os.toLowerCase().contains("mac")) {
-        HANDLE hPipeRead, hPipeWrite;
-        SECURITY_ATTRIBUTES saAttr = { sizeof(SECURITY_ATTRIBUTES) };
-        saAttr.bInheritHandle = TRUE; // Pipe handles are inherited by child process.
-        saAttr.lpSecurityDescriptor = NULL;
-
-        // Create a pipe to get results from child's stdout.
-        if (!CreatePipe(&hPipeRead, &hPipeWrite, &saAttr, 0))
-            return "Error creating pipe";
-
-        // Ensure the read handle to the pipe for STDOUT is not inherited.
-        SetHandleInformation(hPipeRead, HANDLE_FLAG_INHERIT, 0);
-
-        PROCESS_INFORMATION processInfo;
-        STARTUPINFO startupInfo;
-        ZeroMemory(&startupInfo, sizeof(startupInfo));
-        startupInfo.cb = sizeof(startupInfo);
-        startupInfo.dwFlags |= STARTF_USESTDHANDLES;
-        startupInfo.hStdOutput = hPipeWrite;
-        startupInfo.hStdError = hPipeWrite;
-        startupInfo.hStdInput = NULL; // Ensure the input handle is not inherited
-
-        std::string cmd = "cmd /C " + command;
-
-        if (!CreateProcess(NULL, const_cast<char*>(cmd.c_str()), NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &startupInfo, &processInfo))
-        {
-            CloseHandle(hPipeWrite);
-            CloseHandle(hPipeRead);
-            return "Error creating process";
-        }
+    ProcessRunner::Options options;
+    options.workingDirectory = getProjectPath().toStdString();
+    options.mergeStderr = true; // Capture both stdout and stderr
 
-        // Close the write end of the pipe before reading from the read end of the pipe.
-        CloseHandle(hPipeWrite);
+    // Simple command lines are spawned directly, only "&&" chains and redirects need a shell
+    std::vector<std::string> argv = ProcessRunner::splitCommandLine(command);
+    Tracer::ScopedSpan span(getTracer(), "command", argv.empty() ? juce::String("shell") : juce::String(argv[0]));
+    span.setDetail(command);
 
-        char buffer[128];
-        DWORD bytesRead;
-        std::string result;
+    ProcessResult result = argv.empty() ? ProcessRunner::runShell(command, options)
+                                        : ProcessRunner::run(argv, options);
 
-        // Read output from the child process.
-        while (ReadFile(hPipeRead, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0)
-        {
-            buffer[bytesRead] = '\0';
-            result += buffer;
-        }
+    span.setOutputBytes((juce::int64) result.output.size());
+    span.setExitCode(result.exitCode);
 
-        CloseHandle(hPipeRead);
-        CloseHandle(processInfo.hProcess);
-        CloseHandle(processInfo.hThread);
+    if (!result.launched)
+        return "Error creating process";
 
-        return result;
-    }
-    else {
-        std::array<char, 128> buffer;
-        std::string cmd = command + " 2>&1"; // Capture both stdout and stderr
-        std::unique_ptr<FILE, decltype(&_pclose)> pipe(_popen(cmd.c_str(), "r"), _pclose);
-        juce::String result;
+    return juce::String::fromUTF8(result.output.data(), (int) result.output.size());
+}
 
-        if (!pipe)
-        {
-            throw std::runtime_error("popen() failed!");
-        }
+juce::String DAWVSCAudioProcessor::executeGit(const juce::StringArray& arguments, int timeoutMs)
+{
+    ProcessResult result = runGit(arguments, nullptr, timeoutMs);
+    return juce::String::fromUTF8(result.output.data(), (int) result.output.size());
+}
 
-        while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr)
-        {
-            result.append(buffer.data(), buffer.size());
-        }
+ProcessResult DAWVSCAudioProcessor::runGit(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs,
+                                           bool lowPriority, const std::vector<std::string>& environment)
+{
+    return getRepository()->runGit(arguments, cancelFlag, timeoutMs, lowPriority, environment);
+}
+
+GitJobQueue::JobId DAWVSCAudioProcessor::runGitJob(const juce::String& description,
+                                                   const juce::Array<juce::StringArray>& steps,
+                                                   GitJobQueue::Completion onComplete)
+{
+    return getRepository()->runGitJob(description, steps, std::move(onComplete));
+}
+
+std::shared_ptr<RepositoryService> DAWVSCAudioProcessor::getRepository()
+{
+    const juce::ScopedLock sl(projectLock);
+    return repository;
+}
+
+Tracer& DAWVSCAudioProcessor::getTracer()
+{
+    return getRepository()->getTracer();
+}
+
+GitJobQueue& DAWVSCAudioProcessor::getJobQueue()
+{
+    return getRepository()->getJobQueue();
+}
+
+SnapshotScheduler& DAWVSCAudioProcessor::getSnapshotScheduler()
+{
+    return getRepository()->getSnapshotScheduler();
+}
+
+RepositoryMaintenance& DAWVSCAudioProcessor::getMaintenance()
+{
+    return getRepository()->getMaintenance();
+}
+
+RepositoryBackup& DAWVSCAudioProcessor::getBackup()
+{
+    return getRepository()->getBackup();
+}
+
+void DAWVSCAudioProcessor::setProjectPath(const juce::String& path, bool watchForSaves)
+{
+    std::shared_ptr<RepositoryService> previous;
+    std::shared_ptr<RepositoryService> next;
+
+    {
+        const juce::ScopedLock sl(projectLock);
+        projectPath = std::make_unique<juce::File>(path);
 
-        return result;
+        if (!projectPath->exists())
+            projectPath = nullptr;
+
+        // Another instance on the same project hands us the service it already runs
+        next = RepositoryService::acquire(projectPath != nullptr ? *projectPath : juce::File());
+        previous = std::exchange(repository, next);
+    }
+
+    if (previous != next)
+    {
+        // A pass on the old repository has no business running on past the switch
+        previous->getMaintenance().noteUserActivity();
+        previous->removePreviewSource(&previewCapture);
+        previous->removeListener(this);
+        next->addListener(this);
+        next->addPreviewSource(&previewCapture);
     }
+
+    // Snapshot on save: the watcher reports which files changed once a save burst is over
+    if (watchForSaves)
+        next->startWatching();
+
+    // The host restores projectPath long before anyone opens the editor: read what it shows now
+    next->prefetch();
 }
 
-void DAWVSCAudioProcessor::setProjectPath(const juce::String& path)
+GitJobQueue::JobId DAWVSCAudioProcessor::playPreview(const juce::String& commitOid, std::function<void(bool found)> onDone)
 {
-	projectPath = std::make_unique<juce::File>(path);
-    if (projectPath->exists()) {
-		projectPath->setAsCurrentWorkingDirectory();
-	} else {
-		projectPath = nullptr;
-	}
+    previewPlayer.stop();
+
+    std::shared_ptr<bool> stillAlive = alive;
+
+    return getRepository()->loadPreview(commitOid, [this, stillAlive, onDone](std::shared_ptr<const juce::AudioBuffer<float>> audio, double sampleRate)
+    {
+        if (!*stillAlive)
+            return;
+
+        if (audio != nullptr)
+            previewPlayer.play(*audio, sampleRate, getSampleRate());
+
+        if (onDone)
+            onDone(audio != nullptr);
+    });
+}
+
+void DAWVSCAudioProcessor::cancelPreview(GitJobQueue::JobId job)
+{
+    getRepository()->cancelPreviewLoad(job);
+}
+
+void DAWVSCAudioProcessor::stopPreview()
+{
+    previewPlayer.stop();
+}
+
+bool DAWVSCAudioProcessor::isPlayingPreview() const
+{
+    return previewPlayer.isPlaying();
+}
+
+void DAWVSCAudioProcessor::setMarkingPreview(bool shouldMark)
+{
+    previewCapture.setMarking(shouldMark);
+}
+
+bool DAWVSCAudioProcessor::isMarkingPreview() const
+{
+    return previewCapture.isMarking();
 }
 
 juce::String DAWVSCAudioProcessor::getProjectPath()
 {
+    const juce::ScopedLock sl(projectLock);
     if (projectPath == nullptr) {
 		return "";
 	}
@@ -305,27 +389,10 @@ juce::String DAWVSCAudioProcessor::getProjectPath()
 
 void DAWVSCAudioProcessor::checkForGit(const juce::String& path)
 {
-    juce::File projectDir(path);
-    juce::Array<juce::File> gitFolders;
-    projectDir.findChildFiles(gitFolders, juce::File::findDirectories, false, ".git");
+    std::shared_ptr<RepositoryService> service = getRepository();
 
-    if (gitFolders.isEmpty())
-    {
-        DBG("Git repository not found, initializing git repository in " + path);
-        DBG("Attempting initialization of git repository in " + path);
-        executeCommand("git init");
-        if (os.toLowerCase().contains("windows") || os.toLowerCase().contains("mac")) {
-            executeCommand("echo Backup/ > .gitignore && echo Ableton Project Info/ >> .gitignore");
-        }
-        else if (os.toLowerCase().contains("linux")) {
-            executeCommand("sh -c 'echo Backup/ > .gitignore && echo \"Ableton Project Info/\" >> .gitignore'");
-        }
-        checkForGit(path);
-    }
-    else
-    {
-        // git repository found
-    }
+    if (service->getProjectDirectory() == juce::File(path))
+        service->checkForGit();
 }
 
 juce::String DAWVSCAudioProcessor::getOS()
@@ -336,35 +403,35 @@ juce::String DAWVSCAudioProcessor::getOS()
 
 juce::String DAWVSCAudioProcessor::getGitVersion()
 {
-	juce::String result;
-	result = executeCommand("git --version");
-    gitVersion = result;
-	return gitVersion;
+    gitVersion = RepositoryService::getGitVersion();
+    return gitVersion;
+}
+
+void DAWVSCAudioProcessor::getGitVersionAsync(std::function<void(const juce::String& version)> onKnown)
+{
+    RepositoryService::getGitVersionAsync(std::move(onKnown));
 }
 
 void DAWVSCAudioProcessor::checkGitStatus()
 {
-    juce::String result;
-    result = executeCommand("git status --porcelain");
+    if (snapshotChangedFiles({}))
+        getRepository()->notifyHistoryChanged();
+}
 
-    if (result != "")
-    {
-        DBG("Working tree has changed");
-        juce::String status = executeCommand("git status");
-        if (status.contains("HEAD detached"))
-		{
-            juce::String hash = status.fromFirstOccurrenceOf("HEAD detached ", false, true);
-            hash = hash.fromFirstOccurrenceOf(" ", false, true);
-            hash = hash.upToFirstOccurrenceOf("\n", false, true);
-            juce::String cmd = "git checkout -b " + hash + "-branch";
-            executeCommand(cmd.toStdString());
-        }
-        else
-        {
-            executeCommand("git add . && git commit -m \"Auto commit\"");
-            commitHistoryChangedCallback();
-        }
-    }
+bool DAWVSCAudioProcessor::snapshotChangedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag,
+                                                const juce::String& message)
+{
+    return getRepository()->snapshotChangedFiles(changedPaths, cancelFlag, message);
+}
+
+void DAWVSCAudioProcessor::queueAutoSnapshot(const juce::StringArray& changedPaths)
+{
+    getRepository()->queueAutoSnapshot(changedPaths);
+}
+
+void DAWVSCAudioProcessor::takeSnapshot(const juce::String& message, GitJobQueue::Completion onComplete)
+{
+    getRepository()->takeSnapshot(message, std::move(onComplete));
 }
 
 void DAWVSCAudioProcessor::reloadWorkingTree()
@@ -385,10 +452,8 @@ void DAWVSCAudioProcessor::reloadWorkingTree()
 
 juce::StringArray DAWVSCAudioProcessor::getCommitHistory()
 {
-	juce::String result;
-	result = executeCommand("git log --pretty=format:\"%h %s %ar\"");
-	juce::StringArray commits;
-	commits.addLines(result);
+	// Only the newest page, the editor pages through the rest with loadMoreHistory()
+	juce::StringArray commits = formatCommitHistory(getRepositorySummary(CommitHistoryCache::pageSize));
     // Remove the first commit, which is the most recent commit
     // Removing this line cleans up the commit history list, but looks confusing if a user
     // expects the most recent commit to be at the top of the list
@@ -400,6 +465,14 @@ void DAWVSCAudioProcessor::setCommitHistoryChangedCallback(CommitHistoryChangedC
 {
 	commitHistoryChangedCallback = std::move(callback);
 }
+
+void DAWVSCAudioProcessor::repositoryHistoryChanged()
+{
+    // A snapshot by any instance on this project, or an auto snapshot
+    if (commitHistoryChangedCallback)
+        commitHistoryChangedCallback();
+}
+
 //==============================================================================
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -409,16 +482,81 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 
 juce::String DAWVSCAudioProcessor::getCurrentBranch()
 {
-	juce::String result;
-	result = executeCommand("git branch --show-current");
-	return result;
+	return getRepositorySummary(0).currentBranch;
 }
 
 juce::StringArray DAWVSCAudioProcessor::getBranches()
 {
-    juce::String result;
-	result = executeCommand("git branch");
-	juce::StringArray branches;
-	branches.addLines(result);
-	return branches;
-}
\ No newline at end of file
+	return formatBranches(getRepositorySummary(0));
+}
+
+GitRepositoryWorker::Summary DAWVSCAudioProcessor::getRepositorySummary(int maxCommits)
+{
+    return getRepository()->getRepositorySummary(maxCommits);
+}
+
+std::shared_ptr<GitRepositoryWorker> DAWVSCAudioProcessor::getRepositoryWorker()
+{
+    return getRepository()->getRepositoryWorker();
+}
+
+std::shared_ptr<ProjectFileStore> DAWVSCAudioProcessor::getProjectFileStore()
+{
+    return getRepository()->getProjectFileStore();
+}
+
+std::shared_ptr<AssetStore> DAWVSCAudioProcessor::getAssetStore()
+{
+    return getRepository()->getAssetStore();
+}
+
+bool DAWVSCAudioProcessor::isChunkingLargeAudio()
+{
+    return getRepository()->isChunkingLargeAudio();
+}
+
+void DAWVSCAudioProcessor::setChunkingLargeAudio(bool shouldChunk)
+{
+    getRepository()->setChunkingLargeAudio(shouldChunk);
+}
+
+std::shared_ptr<const RepositoryState> DAWVSCAudioProcessor::getRepositoryState()
+{
+    return getRepository()->getState();
+}
+
+void DAWVSCAudioProcessor::refreshHistory(std::function<void(bool)> onDone)
+{
+    getRepository()->refreshHistory(std::move(onDone));
+}
+
+void DAWVSCAudioProcessor::loadMoreHistory(std::function<void(int)> onDone)
+{
+    getRepository()->loadMoreHistory(std::move(onDone));
+}
+
+juce::StringArray DAWVSCAudioProcessor::formatCommitHistory(const GitRepositoryWorker::Summary& summary)
+{
+    // Same shape as "git log --pretty=format:%H %s %ar"
+    const juce::int64 now = juce::Time::currentTimeMillis() / 1000;
+    juce::StringArray commits;
+
+    for (const auto& commit : summary.history)
+        commits.add(commit.oid + " " + commit.subject + " " + GitRepositoryWorker::formatRelativeTime(commit.committerTime, now));
+
+    return commits;
+}
+
+juce::StringArray DAWVSCAudioProcessor::formatBranches(const GitRepositoryWorker::Summary& summary)
+{
+    // Same shape as "git branch": the checked out branch is marked with "* "
+    juce::StringArray branches;
+
+    if (summary.detached)
+        branches.add("* (HEAD detached at " + summary.headOid.substring(0, 7) + ")");
+
+    for (const auto& branch : summary.branches)
+        branches.add((branch == summary.currentBranch ? "* " : "  ") + branch);
+
+    return branches;
+}
@@ -9,6 +9,10 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "RepositoryService.h"
+#include "PreviewCapture.h"
+#include "PreviewPlayer.h"
+#include <set>
 #include <thread>
 #include <atomic>
 #include <cstdio>
@@ -20,7 +24,8 @@
 //==============================================================================
 /**
 */
-class DAWVSCAudioProcessor  : public juce::AudioProcessor
+class DAWVSCAudioProcessor  : public juce::AudioProcessor,
+                              private RepositoryService::Listener
 {
 public:
     //==============================================================================
@@ -61,16 +66,49 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     juce::String executeCommand(const std::string& command);
-
-    void setProjectPath(const juce::String& path);
+    // Runs git with a direct argv (no shell) in the project directory and returns its stdout
+    juce::String executeGit(const juce::StringArray& arguments, int timeoutMs = -1);
+    ProcessResult runGit(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag = nullptr, int timeoutMs = -1,
+                         bool lowPriority = false, const std::vector<std::string>& environment = {});
+
+    // Everything below goes to the project's RepositoryService, which every instance on the
+    // same project shares. The service changes with setProjectPath.
+    std::shared_ptr<RepositoryService> getRepository();
+
+    // Every git call, command and repository query is timed into this, see Tracer
+    Tracer& getTracer();
+
+    // Background repository work. Steps run one after another and stop at the first failing git call.
+    // Snapshots still waiting on the transport are handed to the queue first, so they stay in order.
+    GitJobQueue& getJobQueue();
+    GitJobQueue::JobId runGitJob(const juce::String& description, const juce::Array<juce::StringArray>& steps,
+                                 GitJobQueue::Completion onComplete = nullptr);
+
+    // Headless callers (the benchmarks) pass watchForSaves = false and snapshot explicitly
+    void setProjectPath(const juce::String& path, bool watchForSaves = true);
     juce::String getProjectPath();
 
     void checkForGit(const juce::String& path);
 
     juce::String getOS();
+    // Probed once per process, in the background from the first instance's constructor.
+    // getGitVersion waits for the probe; the editor uses getGitVersionAsync, which never does.
     juce::String getGitVersion();
+    void getGitVersionAsync(std::function<void(const juce::String& version)> onKnown);
 
     void checkGitStatus();
+    // Stages the given paths (everything if empty) and commits if that changed anything.
+    // Runs git at low CPU/IO priority. Returns true if a snapshot was made.
+    bool snapshotChangedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag = nullptr,
+                              const juce::String& message = "Auto commit");
+    // Both wait for the host transport to stop before touching the disk
+    void queueAutoSnapshot(const juce::StringArray& changedPaths);
+    void takeSnapshot(const juce::String& message, GitJobQueue::Completion onComplete = nullptr);
+    SnapshotScheduler& getSnapshotScheduler();
+    // Packs and prunes the repository while the host is idle; every user action interrupts it
+    RepositoryMaintenance& getMaintenance();
+    // Copies new snapshots to a mirror repository elsewhere, set up from the editor and kept in our state
+    RepositoryBackup& getBackup();
 
     void reloadWorkingTree();
 
@@ -81,12 +119,51 @@ public:
     juce::String getCurrentBranch();
     juce::StringArray getBranches();
 
+    // Branches, current branch and history in one round trip to the repository worker.
+    // maxCommits < 0 returns the whole history.
+    GitRepositoryWorker::Summary getRepositorySummary(int maxCommits = -1);
+    static juce::StringArray formatCommitHistory(const GitRepositoryWorker::Summary& summary);
+    static juce::StringArray formatBranches(const GitRepositoryWorker::Summary& summary);
+
+    // Paged commit history for the current project. Both calls walk history off the message
+    // thread and call back on it; refreshHistory reports whether the visible rows changed.
+    // What they read is published in getRepositoryState(), shared by every editor on the project.
+    std::shared_ptr<GitRepositoryWorker> getRepositoryWorker();
+    std::shared_ptr<const RepositoryState> getRepositoryState();
+
+    // Chunked storage for large recordings. The setting belongs to the repository;
+    // changing it queues a full snapshot so git catches up.
+    std::shared_ptr<AssetStore> getAssetStore();
+    bool isChunkingLargeAudio();
+    void setChunkingLargeAudio(bool shouldChunk);
+    // .als files are snapshotted as decompressed XML, see ProjectFileStore
+    std::shared_ptr<ProjectFileStore> getProjectFileStore();
+    void refreshHistory(std::function<void(bool changed)> onDone);
+    void loadMoreHistory(std::function<void(int added)> onDone);
+
+    // Audio previews: what the host plays through this instance is captured for the next snapshot,
+    // and a snapshot's preview plays back through processBlock in place of the input.
+    // onDone gets false if the snapshot has no preview.
+    GitJobQueue::JobId playPreview(const juce::String& commitOid, std::function<void(bool found)> onDone);
+    void cancelPreview(GitJobQueue::JobId job);
+    void stopPreview();
+    bool isPlayingPreview() const;
+    // While marking, what plays becomes the next snapshot's preview instead of the last 20 seconds
+    void setMarkingPreview(bool shouldMark);
+    bool isMarkingPreview() const;
+
 private:
+    void repositoryHistoryChanged() override;
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DAWVSCAudioProcessor)
+    juce::CriticalSection projectLock; // projectPath and repository are read from the job threads
     std::unique_ptr<juce::File> projectPath;
+    std::shared_ptr<RepositoryService> repository; // never null: without a project, the service without one
     juce::String os;
     juce::String gitVersion;
-    bool createdEditor = false; // We need to create the editor only once to prevent the bug where the terminal shows on relaunch
     CommitHistoryChangedCallback commitHistoryChangedCallback;
+    PreviewCapture previewCapture;
+    PreviewPlayer previewPlayer;
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true); // a preview that loads after we're gone is dropped
 };
@@ -0,0 +1,190 @@
+/*
+  ==============================================================================
+
+    PreviewCapture.cpp
+
+  ==============================================================================
+*/
+
+#include "PreviewCapture.h"
+
+//==============================================================================
+PreviewCapture::PreviewCapture()
+    : juce::Thread("SnapTrack preview capture")
+{
+}
+
+PreviewCapture::~PreviewCapture()
+{
+    stopThread(2000);
+}
+
+void PreviewCapture::prepare(double sampleRate, int numChannels)
+{
+    stopThread(2000);
+
+    const int channels = juce::jlimit(0, maxChannels, numChannels);
+
+    // Hosts prepare again for every buffer size change: keep what was captured when the format stays
+    if (sampleRate != currentSampleRate || channels != currentNumChannels)
+    {
+        const juce::ScopedLock sl(lock);
+        const int rate = juce::roundToInt(sampleRate);
+
+        currentSampleRate = sampleRate;
+        currentNumChannels = channels;
+
+        // A second of slack: the drain thread would have to stall for that long before anything is dropped
+        fifo.setTotalSize(juce::jmax(1, rate));
+        fifoBuffer.setSize(juce::jmax(1, channels), juce::jmax(1, rate));
+        history.setSize(juce::jmax(1, channels), juce::jmax(1, rate * historySeconds));
+        marked.setSize(juce::jmax(1, channels), juce::jmax(1, rate * maxMarkedSeconds));
+        historyWritePosition = 0;
+        historyLength = 0;
+        markedLength = 0;
+        hasNewAudio = false;
+    }
+
+    fifo.reset();
+
+    if (currentNumChannels > 0 && currentSampleRate > 0.0)
+        startThread();
+}
+
+void PreviewCapture::push(const juce::AudioBuffer<float>& buffer, bool transportPlaying) noexcept
+{
+    const int numSamples = buffer.getNumSamples();
+
+    if (!transportPlaying || currentNumChannels == 0 || buffer.getNumChannels() == 0 || numSamples <= 0)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    // All or nothing: half a block in the preview would be a click
+    if (size1 + size2 < numSamples)
+    {
+        numDropped.fetch_add(numSamples, std::memory_order_relaxed);
+        return;
+    }
+
+    for (int channel = 0; channel < currentNumChannels; ++channel)
+    {
+        // A mono bus fills both sides
+        const int source = juce::jmin(channel, buffer.getNumChannels() - 1);
+
+        if (size1 > 0)
+            fifoBuffer.copyFrom(channel, start1, buffer, source, 0, size1);
+
+        if (size2 > 0)
+            fifoBuffer.copyFrom(channel, start2, buffer, source, size1, size2);
+    }
+
+    fifo.finishedWrite(size1 + size2);
+}
+
+void PreviewCapture::setMarking(bool shouldMark)
+{
+    const juce::ScopedLock sl(lock);
+
+    if (shouldMark && !marking.load())
+        markedLength = 0;
+
+    marking = shouldMark;
+}
+
+bool PreviewCapture::takePreview(juce::AudioBuffer<float>& audio, double& sampleRate)
+{
+    const juce::ScopedLock sl(lock);
+    const int minimumLength = juce::roundToInt(currentSampleRate * minPreviewSeconds);
+
+    if (!hasNewAudio || currentNumChannels == 0)
+        return false;
+
+    if (markedLength >= minimumLength)
+    {
+        audio.setSize(currentNumChannels, markedLength);
+
+        for (int channel = 0; channel < currentNumChannels; ++channel)
+            audio.copyFrom(channel, 0, marked, channel, 0, markedLength);
+
+        // A region goes with one snapshot; the next one gets the history again unless the user marks another
+        if (!marking.load())
+            markedLength = 0;
+    }
+    else if (historyLength >= minimumLength)
+    {
+        // Oldest first: the part after the write position, then the part before it
+        const int tail = historyLength - historyWritePosition;
+        audio.setSize(currentNumChannels, historyLength);
+
+        for (int channel = 0; channel < currentNumChannels; ++channel)
+        {
+            if (tail > 0)
+                audio.copyFrom(channel, 0, history, channel, historyWritePosition, tail);
+
+            if (historyWritePosition > 0)
+                audio.copyFrom(channel, juce::jmax(0, tail), history, channel, 0, historyWritePosition);
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    sampleRate = currentSampleRate;
+    hasNewAudio = false;
+    return true;
+}
+
+//==============================================================================
+void PreviewCapture::run()
+{
+    while (!threadShouldExit())
+    {
+        drain();
+        wait(drainIntervalMs);
+    }
+}
+
+void PreviewCapture::drain()
+{
+    const int numReady = fifo.getNumReady();
+
+    if (numReady <= 0)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    {
+        const juce::ScopedLock sl(lock);
+        const bool isMarking = marking.load();
+
+        for (const auto& block : { std::make_pair(start1, size1), std::make_pair(start2, size2) })
+        {
+            for (int done = 0; done < block.second;)
+            {
+                const int count = juce::jmin(block.second - done, history.getNumSamples() - historyWritePosition);
+
+                for (int channel = 0; channel < currentNumChannels; ++channel)
+                    history.copyFrom(channel, historyWritePosition, fifoBuffer, channel, block.first + done, count);
+
+                historyWritePosition = (historyWritePosition + count) % history.getNumSamples();
+                historyLength = juce::jmin(history.getNumSamples(), historyLength + count);
+                done += count;
+            }
+
+            const int toMark = isMarking ? juce::jmin(block.second, marked.getNumSamples() - markedLength) : 0;
+
+            for (int channel = 0; channel < currentNumChannels && toMark > 0; ++channel)
+                marked.copyFrom(channel, markedLength, fifoBuffer, channel, block.first, toMark);
+
+            markedLength += toMark;
+        }
+
+        hasNewAudio = true;
+    }
+
+    fifo.finishedRead(size1 + size2);
+}
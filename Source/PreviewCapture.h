@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    PreviewCapture.h
+    Keeps the last seconds of what the host played through the plugin, so a
+    snapshot can take an audio preview of the version it saves.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+//==============================================================================
+/**
+    processBlock() hands every block to push(), which copies it into a
+    juce::AbstractFifo: a single-producer, single-consumer ring with no locks
+    and no allocation. If the FIFO is full the block is dropped and counted,
+    and the audio thread never waits. Everything is allocated in prepare(),
+    which the host never calls while processBlock() runs.
+
+    A background thread drains the FIFO every drainIntervalMs into a history
+    of the last historySeconds. While the user marks a region it also goes
+    into a second buffer, and a marked region wins over the history when a
+    preview is taken. Only audio played with the transport running is
+    captured, so stopping doesn't fill the preview with silence (or with a
+    preview being auditioned).
+
+    Put the plugin on the master track and the preview is the mix.
+*/
+class PreviewCapture : private juce::Thread
+{
+public:
+    PreviewCapture();
+    ~PreviewCapture() override;
+
+    /** Allocates for the new format. Not while push() may run. */
+    void prepare(double sampleRate, int numChannels);
+
+    /** Audio thread. Copies up to maxChannels channels of buffer. */
+    void push(const juce::AudioBuffer<float>& buffer, bool transportPlaying) noexcept;
+
+    /** Starts or ends a marked region. Starting throws away the previous one. */
+    void setMarking(bool shouldMark);
+    bool isMarking() const { return marking.load(); }
+
+    /** The marked region if there is one, otherwise the last historySeconds. Returns false if nothing
+        new was played since the last preview that was taken.
+    */
+    bool takePreview(juce::AudioBuffer<float>& audio, double& sampleRate);
+
+    juce::int64 getNumDroppedSamples() const { return numDropped.load(); }
+
+    static constexpr int maxChannels = 2;
+    static constexpr int historySeconds = 20;
+    static constexpr int maxMarkedSeconds = 60;
+    static constexpr int minPreviewSeconds = 1;   // less than this isn't worth attaching
+    static constexpr int drainIntervalMs = 20;
+
+private:
+    void run() override;
+    void drain();
+
+    juce::AbstractFifo fifo { 1 };
+    juce::AudioBuffer<float> fifoBuffer;
+    std::atomic<juce::int64> numDropped { 0 };
+
+    juce::CriticalSection lock; // history and marked, between the drain thread and takePreview()
+    juce::AudioBuffer<float> history;
+    int historyWritePosition = 0;
+    int historyLength = 0;
+    juce::AudioBuffer<float> marked;
+    int markedLength = 0;
+    bool hasNewAudio = false;
+    std::atomic<bool> marking { false };
+
+    double currentSampleRate = 0.0;
+    int currentNumChannels = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PreviewCapture)
+};
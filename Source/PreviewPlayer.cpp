@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    PreviewPlayer.cpp
+
+  ==============================================================================
+*/
+
+#include "PreviewPlayer.h"
+
+//==============================================================================
+PreviewPlayer::~PreviewPlayer()
+{
+    // The processor is going away, so the audio thread is done with us
+    collectGarbage();
+    delete pending.exchange(nullptr);
+    delete current;
+}
+
+void PreviewPlayer::play(const juce::AudioBuffer<float>& audio, double sourceRate, double hostRate)
+{
+    collectGarbage();
+
+    if (audio.getNumSamples() <= 0 || sourceRate <= 0.0 || hostRate <= 0.0)
+        return;
+
+    auto buffer = std::make_unique<juce::AudioBuffer<float>>();
+
+    if (juce::approximatelyEqual(sourceRate, hostRate))
+    {
+        buffer->makeCopyOf(audio);
+    }
+    else
+    {
+        const double ratio = sourceRate / hostRate;
+        const int length = (int) ((double) audio.getNumSamples() / ratio);
+        buffer->setSize(audio.getNumChannels(), length);
+
+        for (int channel = 0; channel < audio.getNumChannels(); ++channel)
+        {
+            juce::LagrangeInterpolator interpolator;
+            interpolator.process(ratio, audio.getReadPointer(channel), buffer->getWritePointer(channel), length);
+        }
+    }
+
+    stopRequested = false;
+    playing = true;
+
+    // Never picked up: still ours to delete
+    delete pending.exchange(buffer.release());
+}
+
+void PreviewPlayer::stop()
+{
+    stopRequested = true;
+    playing = false;
+    delete pending.exchange(nullptr);
+    collectGarbage();
+}
+
+void PreviewPlayer::render(juce::AudioBuffer<float>& buffer) noexcept
+{
+    if (stopRequested.load() && current != nullptr && retire(current))
+        current = nullptr;
+
+    if (pending.load() != nullptr && (current == nullptr || retire(current)))
+    {
+        current = pending.exchange(nullptr);
+        position = 0;
+    }
+
+    if (current == nullptr)
+        return;
+
+    const int numSamples = juce::jmin(buffer.getNumSamples(), current->getNumSamples() - position);
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        buffer.clear(channel, 0, buffer.getNumSamples());
+
+        if (numSamples > 0)
+            buffer.copyFrom(channel, 0, *current, juce::jmin(channel, current->getNumChannels() - 1), position, numSamples);
+    }
+
+    position += juce::jmax(0, numSamples);
+
+    if (position >= current->getNumSamples() && retire(current))
+    {
+        current = nullptr;
+        playing = pending.load() != nullptr;
+    }
+}
+
+void PreviewPlayer::collectGarbage()
+{
+    for (auto& slot : retired)
+        delete slot.exchange(nullptr);
+}
+
+bool PreviewPlayer::retire(juce::AudioBuffer<float>* finished) noexcept
+{
+    for (auto& slot : retired)
+    {
+        juce::AudioBuffer<float>* empty = nullptr;
+
+        if (slot.compare_exchange_strong(empty, finished))
+            return true;
+    }
+
+    return false;
+}
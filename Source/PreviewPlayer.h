@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    PreviewPlayer.h
+    Plays a snapshot's audio preview through the plugin's output, handed to
+    the audio thread without locks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+//==============================================================================
+/**
+    The message thread prepares a whole buffer at the host's sample rate and
+    play() posts a pointer to it. The audio thread picks the pointer up in
+    render() and plays it in place of the plugin's input. It never frees
+    memory: the buffer it lets go of goes into a retired slot, and the
+    message thread deletes it on its next call. If every slot is still
+    taken, the audio thread keeps the current buffer until one is free.
+*/
+class PreviewPlayer
+{
+public:
+    PreviewPlayer() = default;
+    ~PreviewPlayer();
+
+    /** Message thread. Replaces whatever is playing; audio is resampled from sourceRate to hostRate first. */
+    void play(const juce::AudioBuffer<float>& audio, double sourceRate, double hostRate);
+    void stop();
+
+    bool isPlaying() const { return playing.load(); }
+
+    /** Audio thread. Writes the preview over buffer while one is playing. */
+    void render(juce::AudioBuffer<float>& buffer) noexcept;
+
+    /** Message thread. Frees buffers the audio thread is done with. */
+    void collectGarbage();
+
+private:
+    bool retire(juce::AudioBuffer<float>* finished) noexcept;
+
+    std::atomic<juce::AudioBuffer<float>*> pending { nullptr };
+    std::atomic<bool> stopRequested { false };
+    std::atomic<bool> playing { false };
+    std::array<std::atomic<juce::AudioBuffer<float>*>, 4> retired {};
+
+    juce::AudioBuffer<float>* current = nullptr;   // audio thread only
+    int position = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PreviewPlayer)
+};
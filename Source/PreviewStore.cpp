@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    PreviewStore.cpp
+
+  ==============================================================================
+*/
+
+#include "PreviewStore.h"
+#include <limits>
+#include <string>
+
+//==============================================================================
+namespace
+{
+    bool readCommitTree(GitRepositoryWorker& worker, const juce::String& commitOid, juce::String& tree)
+    {
+        juce::String type;
+        std::string content;
+
+        if (!worker.readObject(commitOid, type, content) || type != "commit" || content.compare(0, 5, "tree ") != 0)
+            return false;
+
+        tree = juce::String(content.substr(5, 40));
+        return true;
+    }
+
+    // The entry in treeOid whose name is the start of path (git's fanout splits note names into
+    // "ab/cdef..."), or whose name is path itself
+    juce::String findInTree(GitRepositoryWorker& worker, const juce::String& treeOid, const juce::String& path)
+    {
+        juce::String type;
+        std::string content;
+
+        if (!worker.readObject(treeOid, type, content) || type != "tree")
+            return {};
+
+        for (size_t at = 0; at < content.size();)
+        {
+            const size_t space = content.find(' ', at);
+            const size_t nul = space == std::string::npos ? space : content.find('\0', space);
+
+            if (nul == std::string::npos || nul + 21 > content.size())
+                return {};
+
+            const juce::String name = juce::String::fromUTF8(content.data() + space + 1, (int) (nul - space - 1));
+            const juce::String oid = juce::String::toHexString(content.data() + nul + 1, 20, 0);
+            const bool isTree = content.compare(at, space - at, "40000") == 0;
+
+            if (!isTree && name.equalsIgnoreCase(path))
+                return oid;
+
+            if (isTree && name.length() < path.length() && path.startsWithIgnoreCase(name))
+                return findInTree(worker, oid, path.substring(name.length()));
+
+            at = nul + 21;
+        }
+
+        return {};
+    }
+
+    struct BlobContent
+    {
+        std::string content;
+    };
+
+    class BlobStream : private BlobContent,
+                       public juce::MemoryInputStream
+    {
+    public:
+        explicit BlobStream(std::string&& blob)
+            : BlobContent { std::move(blob) },
+              juce::MemoryInputStream(content.data(), content.size(), false) {}
+    };
+}
+
+//==============================================================================
+PreviewStore::PreviewStore(const juce::File& gitDirectory, GitRunner runner)
+    : directory(gitDirectory.getChildFile("snaptrack").getChildFile("previews")),
+      runGit(std::move(runner))
+{
+}
+
+bool PreviewStore::attach(const juce::String& commitOid, const juce::AudioBuffer<float>& audio, double sampleRate,
+                          const std::atomic<bool>* cancelFlag)
+{
+    if (commitOid.isEmpty() || audio.getNumSamples() <= 0 || audio.getNumChannels() <= 0 || !directory.createDirectory())
+        return false;
+
+    juce::TemporaryFile temp(directory.getChildFile(commitOid + ".ogg"));
+
+    {
+        juce::OggVorbisAudioFormat format;
+        auto out = std::make_unique<juce::FileOutputStream>(temp.getFile());
+
+        if (!out->openedOk())
+            return false;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(out.get(), sampleRate,
+                                                                               (unsigned int) audio.getNumChannels(), 16, {}, qualityIndex));
+        if (writer == nullptr)
+            return false;
+
+        out.release();  // the writer owns it now
+
+        if (!writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples()))
+            return false;
+    }
+
+    // The temporary file goes once the blob is in the object store
+    ProcessResult blob = runGit({ "hash-object", "-w", "--", temp.getFile().getFullPathName() }, cancelFlag, -1);
+
+    if (!blob.succeeded())
+        return false;
+
+    const juce::String blobOid = juce::String::fromUTF8(blob.output.data(), (int) blob.output.size()).trim();
+
+    return runGit({ "notes", juce::String("--ref=") + notesRef, "add", "-f", "-C", blobOid, commitOid }, cancelFlag, -1).succeeded();
+}
+
+bool PreviewStore::load(GitRepositoryWorker& worker, const juce::String& commitOid, juce::AudioBuffer<float>& audio, double& sampleRate)
+{
+    const juce::String blobOid = findNote(worker, commitOid);
+
+    juce::String type;
+    std::string content;
+
+    if (blobOid.isEmpty() || !worker.readObject(blobOid, type, content) || type != "blob")
+        return false;
+
+    juce::OggVorbisAudioFormat format;
+    std::unique_ptr<juce::AudioFormatReader> reader(format.createReaderFor(new BlobStream(std::move(content)), true));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels <= 0
+        || reader->lengthInSamples > (juce::int64) std::numeric_limits<int>::max())
+        return false;
+
+    audio.setSize((int) reader->numChannels, (int) reader->lengthInSamples);
+    sampleRate = reader->sampleRate;
+
+    return reader->read(&audio, 0, audio.getNumSamples(), 0, true, true);
+}
+
+juce::String PreviewStore::findNote(GitRepositoryWorker& worker, const juce::String& commitOid)
+{
+    const juce::String notesCommit = worker.resolveRef(notesRef);
+    juce::String tree;
+
+    if (notesCommit.isEmpty() || !readCommitTree(worker, notesCommit, tree))
+        return {};
+
+    return findInTree(worker, tree, commitOid);
+}
@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    PreviewStore.h
+    Audio previews of snapshots, kept as git notes so the project's tree
+    never sees them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include "ProcessRunner.h"
+#include <atomic>
+#include <functional>
+
+//==============================================================================
+/**
+    A preview is an Ogg Vorbis blob, attached to its snapshot's commit as a
+    note under refs/notes/snaptrack-previews. Notes don't change the commit,
+    so a snapshot is the same with or without one, and previews never turn
+    up in a checkout or a diff. They still travel with a push or a mirror
+    that includes the notes ref.
+
+    attach() encodes and writes through git. load() finds the note and reads
+    its blob natively. Both are slow, so call them from a background queue.
+*/
+class PreviewStore
+{
+public:
+    using GitRunner = std::function<ProcessResult(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)>;
+
+    PreviewStore(const juce::File& gitDirectory, GitRunner runGit);
+
+    /** Encodes audio and attaches it to commitOid, replacing any preview it had. */
+    bool attach(const juce::String& commitOid, const juce::AudioBuffer<float>& audio, double sampleRate,
+                const std::atomic<bool>* cancelFlag);
+
+    /** Decodes commitOid's preview. Returns false if it has none. */
+    bool load(GitRepositoryWorker& worker, const juce::String& commitOid, juce::AudioBuffer<float>& audio, double& sampleRate);
+
+    static constexpr const char* notesRef = "refs/notes/snaptrack-previews";
+    static constexpr int qualityIndex = 4;  // ~160 kbit/s for stereo: plenty to recognise a version by ear
+
+private:
+    juce::String findNote(GitRepositoryWorker& worker, const juce::String& commitOid);
+
+    const juce::File directory;
+    GitRunner runGit;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PreviewStore)
+};
@@ -0,0 +1,1047 @@
+/*
+  ==============================================================================
+
+    ProcessRunner.cpp
+
+  ==============================================================================
+*/
+
+#include "ProcessRunner.h"
+#include <chrono>
+
+#if JUCE_WINDOWS
+ #include <Windows.h>
+ #include <cstring>
+ #include <thread>
+#else
+ #include <cerrno>
+ #include <csignal>
+ #include <cstdlib>
+ #include <cstring>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <spawn.h>
+ #include <sys/resource.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+
+ #if JUCE_LINUX
+  #include <sys/syscall.h>
+ #endif
+
+ extern char** environ;
+
+ // posix_spawn can only change directory in the child on newer libcs, otherwise
+ // we fall back to vfork + chdir + exec.
+ #if defined (__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+  #define SNAPTRACK_SPAWN_HAS_CHDIR 1
+ #elif defined (__APPLE__)
+  #define SNAPTRACK_SPAWN_HAS_CHDIR 1
+ #else
+  #define SNAPTRACK_SPAWN_HAS_CHDIR 0
+ #endif
+#endif
+
+namespace
+{
+    constexpr size_t readChunkSize = 64 * 1024;
+    constexpr int cancelPollIntervalMs = 50;
+    constexpr int terminateGraceMs = 3000;  // for git to remove its lock files before it's killed
+
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // The inherited environment with the overrides applied, as "NAME=value" strings
+    std::vector<std::string> mergeEnvironment(const std::vector<std::string>& inherited, const std::vector<std::string>& overrides)
+    {
+        std::vector<std::string> merged;
+
+        for (const auto& entry : inherited)
+        {
+            const std::string name = entry.substr(0, entry.find('=') + 1);
+            bool overridden = false;
+
+            for (const auto& override : overrides)
+                overridden = overridden || override.compare(0, name.size(), name) == 0;
+
+            if (!overridden)
+                merged.push_back(entry);
+        }
+
+        merged.insert(merged.end(), overrides.begin(), overrides.end());
+        return merged;
+    }
+}
+
+//==============================================================================
+std::vector<std::string> ProcessRunner::splitCommandLine(const std::string& commandLine)
+{
+    std::vector<std::string> args;
+    std::string current;
+    bool inArg = false;
+    char quote = 0;
+
+    for (size_t i = 0; i < commandLine.size(); ++i)
+    {
+        const char c = commandLine[i];
+
+        if (quote != 0)
+        {
+            if (c == quote)
+                quote = 0;
+            else
+                current += c;
+            continue;
+        }
+
+        switch (c)
+        {
+            case '"':
+            case '\'':
+                quote = c;
+                inArg = true;
+                break;
+
+            case ' ':
+            case '\t':
+                if (inArg)
+                {
+                    args.push_back(current);
+                    current.clear();
+                    inArg = false;
+                }
+                break;
+
+            // Anything that needs a real shell
+            case '&': case '|': case ';': case '<': case '>':
+            case '$': case '`': case '*': case '?': case '\n':
+                return {};
+
+            default:
+                current += c;
+                inArg = true;
+                break;
+        }
+    }
+
+    if (quote != 0)
+        return {};
+
+    if (inArg)
+        args.push_back(current);
+
+    return args;
+}
+
+ProcessResult ProcessRunner::run(const std::vector<std::string>& argv)
+{
+    return run(argv, Options());
+}
+
+ProcessResult ProcessRunner::runShell(const std::string& commandLine, const Options& options)
+{
+   #if JUCE_WINDOWS
+    return run({ "cmd", "/C", commandLine }, options);
+   #else
+    return run({ "/bin/sh", "-c", commandLine }, options);
+   #endif
+}
+
+#if JUCE_WINDOWS
+//==============================================================================
+namespace
+{
+    // Quoting rules as understood by CommandLineToArgvW / the MSVC runtime.
+    void appendQuotedArgument(std::string& commandLine, const std::string& arg)
+    {
+        if (!commandLine.empty())
+            commandLine += ' ';
+
+        if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == std::string::npos)
+        {
+            commandLine += arg;
+            return;
+        }
+
+        commandLine += '"';
+
+        for (size_t i = 0;; ++i)
+        {
+            size_t backslashes = 0;
+
+            while (i < arg.size() && arg[i] == '\\')
+            {
+                ++i;
+                ++backslashes;
+            }
+
+            if (i == arg.size())
+            {
+                commandLine.append(backslashes * 2, '\\');
+                break;
+            }
+
+            if (arg[i] == '"')
+                commandLine.append(backslashes * 2 + 1, '\\');
+            else
+                commandLine.append(backslashes, '\\');
+
+            commandLine += arg[i];
+        }
+
+        commandLine += '"';
+    }
+
+    void drainPipe(HANDLE pipe, std::string& destination)
+    {
+        DWORD bytesRead = 0;
+
+        for (;;)
+        {
+            const size_t oldSize = destination.size();
+            destination.resize(oldSize + readChunkSize);
+
+            if (!ReadFile(pipe, &destination[oldSize], (DWORD) readChunkSize, &bytesRead, NULL) || bytesRead == 0)
+            {
+                destination.resize(oldSize);
+                return;
+            }
+
+            destination.resize(oldSize + bytesRead);
+        }
+    }
+}
+
+ProcessResult ProcessRunner::run(const std::vector<std::string>& argv, const Options& options)
+{
+    ProcessResult result;
+    const auto start = Clock::now();
+
+    if (argv.empty())
+        return result;
+
+    std::string commandLine;
+
+    // cmd.exe does its own parsing, so the command after /C has to go through untouched
+    if (argv.size() == 3 && argv[0] == "cmd" && argv[1] == "/C")
+        commandLine = "cmd /C " + argv[2];
+    else
+        for (const auto& arg : argv)
+            appendQuotedArgument(commandLine, arg);
+
+    SECURITY_ATTRIBUTES saAttr = { sizeof(SECURITY_ATTRIBUTES) };
+    saAttr.bInheritHandle = TRUE; // Pipe handles are inherited by child process.
+    saAttr.lpSecurityDescriptor = NULL;
+
+    HANDLE outRead = NULL, outWrite = NULL, errRead = NULL, errWrite = NULL;
+
+    if (!CreatePipe(&outRead, &outWrite, &saAttr, 0))
+        return result;
+
+    if (!options.mergeStderr && !CreatePipe(&errRead, &errWrite, &saAttr, 0))
+    {
+        CloseHandle(outRead);
+        CloseHandle(outWrite);
+        return result;
+    }
+
+    // Ensure the read handles are not inherited.
+    SetHandleInformation(outRead, HANDLE_FLAG_INHERIT, 0);
+    if (errRead != NULL)
+        SetHandleInformation(errRead, HANDLE_FLAG_INHERIT, 0);
+
+    PROCESS_INFORMATION processInfo;
+    STARTUPINFOA startupInfo;
+    ZeroMemory(&startupInfo, sizeof(startupInfo));
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+    startupInfo.hStdOutput = outWrite;
+    startupInfo.hStdError = options.mergeStderr ? outWrite : errWrite;
+    startupInfo.hStdInput = NULL;
+
+    const char* cwd = options.workingDirectory.empty() ? NULL : options.workingDirectory.c_str();
+
+    // An environment block is NUL separated and ends with an empty entry
+    std::string environmentBlock;
+
+    if (!options.environment.empty())
+    {
+        std::vector<std::string> inherited;
+
+        if (char* strings = GetEnvironmentStringsA())
+        {
+            for (const char* entry = strings; *entry != 0; entry += std::strlen(entry) + 1)
+                inherited.emplace_back(entry);
+
+            FreeEnvironmentStringsA(strings);
+        }
+
+        for (const auto& entry : mergeEnvironment(inherited, options.environment))
+            environmentBlock.append(entry.c_str(), entry.size() + 1);
+
+        environmentBlock.push_back(0);
+    }
+
+    const DWORD creationFlags = CREATE_NO_WINDOW | (options.lowPriority ? BELOW_NORMAL_PRIORITY_CLASS : 0);
+    const BOOL created = CreateProcessA(NULL, const_cast<char*>(commandLine.c_str()), NULL, NULL, TRUE, creationFlags,
+                                        environmentBlock.empty() ? NULL : &environmentBlock[0], cwd, &startupInfo, &processInfo);
+
+    // Close our copies of the write ends so the readers see EOF when the child exits.
+    CloseHandle(outWrite);
+    if (errWrite != NULL)
+        CloseHandle(errWrite);
+
+    if (!created)
+    {
+        CloseHandle(outRead);
+        if (errRead != NULL)
+            CloseHandle(errRead);
+        return result;
+    }
+
+    result.launched = true;
+
+    std::thread errReader;
+    if (errRead != NULL)
+        errReader = std::thread([&] { drainPipe(errRead, result.error); });
+
+    std::thread outReader([&] { drainPipe(outRead, result.output); });
+
+    const auto deadline = start + std::chrono::milliseconds(options.timeoutMs);
+
+    while (WaitForSingleObject(processInfo.hProcess, cancelPollIntervalMs) == WAIT_TIMEOUT)
+    {
+        result.cancelled = options.cancelFlag != nullptr && options.cancelFlag->load();
+        result.timedOut = options.timeoutMs > 0 && Clock::now() > deadline;
+
+        if (result.cancelled || result.timedOut)
+        {
+            TerminateProcess(processInfo.hProcess, 1);
+            WaitForSingleObject(processInfo.hProcess, INFINITE);
+            break;
+        }
+    }
+
+    outReader.join();
+    if (errReader.joinable())
+        errReader.join();
+
+    DWORD exitCode = 0;
+    if (GetExitCodeProcess(processInfo.hProcess, &exitCode))
+        result.exitCode = (int) exitCode;
+
+    CloseHandle(outRead);
+    if (errRead != NULL)
+        CloseHandle(errRead);
+    CloseHandle(processInfo.hProcess);
+    CloseHandle(processInfo.hThread);
+
+    result.elapsedMs = millisecondsSince(start);
+    return result;
+}
+
+#else
+//==============================================================================
+namespace
+{
+    struct Pipe
+    {
+        int fds[2] = { -1, -1 };
+
+        ~Pipe()
+        {
+            closeEnd(0);
+            closeEnd(1);
+        }
+
+        // Close-on-exec from the start: another thread of the host may fork at any time, and a child
+        // holding our write end would keep EOF from ever arriving
+        bool open()
+        {
+           #if JUCE_LINUX
+            return ::pipe2(fds, O_CLOEXEC) == 0;
+           #else
+            if (::pipe(fds) != 0)
+                return false;
+
+            ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+            return true;
+           #endif
+        }
+
+        void closeEnd(int end)
+        {
+            if (fds[end] >= 0)
+            {
+                ::close(fds[end]);
+                fds[end] = -1;
+            }
+        }
+    };
+
+    // Reads whatever is available into the tail of destination. Returns false on EOF or error.
+    bool readInto(int fd, std::string& destination)
+    {
+        const size_t oldSize = destination.size();
+        destination.resize(oldSize + readChunkSize);
+
+        ssize_t bytesRead;
+        do
+        {
+            bytesRead = ::read(fd, &destination[oldSize], readChunkSize);
+        } while (bytesRead < 0 && errno == EINTR);
+
+        destination.resize(oldSize + (size_t) juce::jmax((ssize_t) 0, bytesRead));
+        return bytesRead > 0;
+    }
+
+    struct SpawnSettings
+    {
+        std::string workingDirectory;
+        int stdinFd = -1;               // -1 means /dev/null
+        int stdoutFd = -1;
+        int stderrFd = -1;              // -1 means /dev/null
+        bool ownProcessGroup = false;   // so a timeout or cancel can take down everything a shell started
+        bool lowPriority = false;
+        const std::vector<std::string>* environment = nullptr; // overrides, may be null
+    };
+
+    // execvp's PATH search, done before vfork since the child can't allocate
+    std::string findExecutable(const std::string& name)
+    {
+        if (name.find('/') != std::string::npos)
+            return name;
+
+        const char* path = std::getenv("PATH");
+        std::string directories = path != nullptr ? path : "/usr/bin:/bin";
+
+        for (size_t start = 0; start <= directories.size();)
+        {
+            size_t end = directories.find(':', start);
+            if (end == std::string::npos)
+                end = directories.size();
+
+            const std::string directory = end > start ? directories.substr(start, end - start) : ".";
+            const std::string candidate = directory + "/" + name;
+
+            if (::access(candidate.c_str(), X_OK) == 0)
+                return candidate;
+
+            start = end + 1;
+        }
+
+        return name;
+    }
+
+    // Runs in the child between fork and exec, so only async-signal-safe calls
+    void lowerChildPriority()
+    {
+        ::setpriority(PRIO_PROCESS, 0, 10);
+
+       #if JUCE_LINUX
+        constexpr int ioprioWhoProcess = 1;
+        constexpr int ioprioClassIdle = 3;
+        ::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << 13);
+       #elif JUCE_MAC
+        ::setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_PROCESS, IOPOL_THROTTLE);
+       #endif
+    }
+
+    pid_t spawnChild(const std::vector<std::string>& argv, const SpawnSettings& settings)
+    {
+        const std::string& workingDirectory = settings.workingDirectory;
+        const int stdinFd = settings.stdinFd;
+        const int stdoutFd = settings.stdoutFd;
+        const int stderrFd = settings.stderrFd;
+        const bool ownProcessGroup = settings.ownProcessGroup;
+
+        std::vector<char*> args;
+        args.reserve(argv.size() + 1);
+        for (const auto& arg : argv)
+            args.push_back(const_cast<char*>(arg.c_str()));
+        args.push_back(nullptr);
+
+        // Extra variables mean a merged copy of environ, built here because the child can't allocate
+        std::vector<std::string> environmentStrings;
+        std::vector<char*> environment;
+        char** envp = environ;
+        std::string executable;
+
+        if (settings.environment != nullptr && !settings.environment->empty())
+        {
+            std::vector<std::string> inherited;
+            for (char** entry = environ; *entry != nullptr; ++entry)
+                inherited.emplace_back(*entry);
+
+            environmentStrings = mergeEnvironment(inherited, *settings.environment);
+            for (auto& entry : environmentStrings)
+                environment.push_back(&entry[0]);
+            environment.push_back(nullptr);
+
+            envp = environment.data();
+            executable = findExecutable(argv[0]);
+        }
+
+        pid_t pid = -1;
+
+        // posix_spawn can't lower priorities, and can't chdir on older libcs
+        const bool needsVfork = settings.lowPriority || (! SNAPTRACK_SPAWN_HAS_CHDIR && !workingDirectory.empty());
+
+        if (needsVfork)
+        {
+            // vfork shares our memory until exec, so only async-signal-safe calls here
+            pid = vfork();
+
+            if (pid == 0)
+            {
+                const int devNull = ::open("/dev/null", O_RDWR);
+                ::dup2(stdinFd >= 0 ? stdinFd : devNull, STDIN_FILENO);
+                ::dup2(stdoutFd, STDOUT_FILENO);
+                ::dup2(stderrFd >= 0 ? stderrFd : devNull, STDERR_FILENO);
+
+                sigset_t noSignals;
+                sigemptyset(&noSignals);
+                ::sigprocmask(SIG_SETMASK, &noSignals, nullptr);
+                ::signal(SIGPIPE, SIG_DFL);
+
+                if (ownProcessGroup)
+                    ::setpgid(0, 0);
+
+                if (settings.lowPriority)
+                    lowerChildPriority();
+
+                if (!workingDirectory.empty() && ::chdir(workingDirectory.c_str()) != 0)
+                    _exit(127);
+
+                if (envp != environ)
+                    ::execve(executable.c_str(), args.data(), envp);
+                else
+                    ::execvp(args[0], args.data());
+
+                _exit(127);
+            }
+
+            return pid;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+
+        if (stdinFd >= 0)
+            posix_spawn_file_actions_adddup2(&actions, stdinFd, STDIN_FILENO);
+        else
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+        posix_spawn_file_actions_adddup2(&actions, stdoutFd, STDOUT_FILENO);
+
+        if (stderrFd >= 0)
+            posix_spawn_file_actions_adddup2(&actions, stderrFd, STDERR_FILENO);
+        else
+            posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+       #if SNAPTRACK_SPAWN_HAS_CHDIR
+        if (!workingDirectory.empty())
+            posix_spawn_file_actions_addchdir_np(&actions, workingDirectory.c_str());
+       #endif
+
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+
+        // The host may have ignored or blocked signals that git expects to have defaults for
+        sigset_t defaultSignals;
+        sigemptyset(&defaultSignals);
+        sigaddset(&defaultSignals, SIGPIPE);
+        sigset_t noSignals;
+        sigemptyset(&noSignals);
+        posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+        posix_spawnattr_setsigmask(&attributes, &noSignals);
+
+        short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+
+        if (ownProcessGroup)
+        {
+            posix_spawnattr_setpgroup(&attributes, 0);
+            flags |= POSIX_SPAWN_SETPGROUP;
+        }
+
+        posix_spawnattr_setflags(&attributes, flags);
+
+        if (posix_spawnp(&pid, args[0], &actions, &attributes, args.data(), envp) != 0)
+            pid = -1;
+
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+        return pid;
+    }
+
+    // SIGKILL straight away would leave index.lock and friends behind, and every later git call
+    // would fail on them. Git removes its lock files on SIGTERM, so that goes first, and the
+    // group is only killed if it's still there after the grace period. Returns the reaped status.
+    int stopProcessGroup(pid_t pid)
+    {
+        ::kill(-pid, SIGTERM);
+
+        int status = 0;
+        const auto deadline = Clock::now() + std::chrono::milliseconds(terminateGraceMs);
+
+        while (Clock::now() < deadline)
+        {
+            const pid_t reaped = ::waitpid(pid, &status, WNOHANG);
+
+            if (reaped == pid || (reaped < 0 && errno != EINTR))
+            {
+                // What the child started may still be running on its own
+                ::kill(-pid, SIGKILL);
+                return status;
+            }
+
+            ::usleep(10000);
+        }
+
+        ::kill(-pid, SIGKILL);
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        return status;
+    }
+}
+
+ProcessResult ProcessRunner::run(const std::vector<std::string>& argv, const Options& options)
+{
+    ProcessResult result;
+    const auto start = Clock::now();
+
+    if (argv.empty())
+        return result;
+
+    Pipe outPipe, errPipe;
+
+    if (!outPipe.open() || (!options.mergeStderr && !errPipe.open()))
+        return result;
+
+    const int childStderr = options.mergeStderr ? outPipe.fds[1] : errPipe.fds[1];
+    SpawnSettings settings;
+    settings.workingDirectory = options.workingDirectory;
+    settings.stdoutFd = outPipe.fds[1];
+    settings.stderrFd = childStderr;
+    settings.ownProcessGroup = true;
+    settings.lowPriority = options.lowPriority;
+    settings.environment = &options.environment;
+
+    const pid_t pid = spawnChild(argv, settings);
+
+    // Our copies of the write ends have to go, otherwise we never see EOF
+    outPipe.closeEnd(1);
+    errPipe.closeEnd(1);
+
+    if (pid <= 0)
+        return result;
+
+    result.launched = true;
+
+    const auto deadline = start + std::chrono::milliseconds(options.timeoutMs);
+    bool outOpen = true;
+    bool errOpen = errPipe.fds[0] >= 0;
+
+    while (outOpen || errOpen)
+    {
+        pollfd fds[2];
+        nfds_t count = 0;
+
+        if (outOpen)
+            fds[count++] = { outPipe.fds[0], POLLIN, 0 };
+        if (errOpen)
+            fds[count++] = { errPipe.fds[0], POLLIN, 0 };
+
+        int waitMs = -1;
+
+        if (options.cancelFlag != nullptr)
+        {
+            if (options.cancelFlag->load())
+            {
+                result.cancelled = true;
+                break;
+            }
+
+            waitMs = cancelPollIntervalMs;
+        }
+
+        if (options.timeoutMs > 0)
+        {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+
+            if (remaining <= 0)
+            {
+                result.timedOut = true;
+                break;
+            }
+
+            waitMs = waitMs < 0 ? (int) remaining : juce::jmin(waitMs, (int) remaining);
+        }
+
+        const int ready = ::poll(fds, count, waitMs);
+
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (nfds_t i = 0; i < count; ++i)
+        {
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+                continue;
+
+            const bool isOut = fds[i].fd == outPipe.fds[0];
+
+            if (!readInto(fds[i].fd, isOut ? result.output : result.error))
+                (isOut ? outOpen : errOpen) = false;
+        }
+    }
+
+    int status = 0;
+
+    if (result.cancelled || result.timedOut)
+        status = stopProcessGroup(pid);
+    else
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+
+    if (WIFEXITED(status))
+        result.exitCode = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        result.exitCode = 128 + WTERMSIG(status);
+
+    // exec failures in the vfork path show up as 127 with nothing written
+    if (result.exitCode == 127 && result.output.empty() && result.error.empty())
+        result.launched = false;
+
+    result.elapsedMs = millisecondsSince(start);
+    return result;
+}
+#endif
+
+//==============================================================================
+CoProcess::~CoProcess()
+{
+    stop();
+}
+
+bool CoProcess::readLine(std::string& line, int timeoutMs)
+{
+    for (;;)
+    {
+        const size_t newline = buffer.find('\n', bufferStart);
+
+        if (newline != std::string::npos)
+        {
+            line.assign(buffer, bufferStart, newline - bufferStart);
+            bufferStart = newline + 1;
+            return true;
+        }
+
+        if (!fillBuffer(timeoutMs))
+            return false;
+    }
+}
+
+bool CoProcess::readBytes(size_t count, std::string& destination, int timeoutMs)
+{
+    while (buffer.size() - bufferStart < count)
+        if (!fillBuffer(timeoutMs))
+            return false;
+
+    destination.append(buffer, bufferStart, count);
+    bufferStart += count;
+    return true;
+}
+
+#if JUCE_WINDOWS
+bool CoProcess::start(const std::vector<std::string>& argv, const std::string& workingDirectory)
+{
+    stop();
+
+    std::string commandLine;
+    for (const auto& arg : argv)
+        appendQuotedArgument(commandLine, arg);
+
+    SECURITY_ATTRIBUTES saAttr = { sizeof(SECURITY_ATTRIBUTES) };
+    saAttr.bInheritHandle = TRUE;
+    saAttr.lpSecurityDescriptor = NULL;
+
+    HANDLE inRead = NULL, inWrite = NULL, outRead = NULL, outWrite = NULL;
+
+    if (!CreatePipe(&inRead, &inWrite, &saAttr, 0))
+        return false;
+
+    if (!CreatePipe(&outRead, &outWrite, &saAttr, 0))
+    {
+        CloseHandle(inRead);
+        CloseHandle(inWrite);
+        return false;
+    }
+
+    SetHandleInformation(inWrite, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(outRead, HANDLE_FLAG_INHERIT, 0);
+
+    PROCESS_INFORMATION processInfo;
+    STARTUPINFOA startupInfo;
+    ZeroMemory(&startupInfo, sizeof(startupInfo));
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+    startupInfo.hStdInput = inRead;
+    startupInfo.hStdOutput = outWrite;
+    startupInfo.hStdError = NULL;
+
+    const char* cwd = workingDirectory.empty() ? NULL : workingDirectory.c_str();
+
+    const BOOL created = CreateProcessA(NULL, const_cast<char*>(commandLine.c_str()), NULL, NULL, TRUE,
+                                        CREATE_NO_WINDOW, NULL, cwd, &startupInfo, &processInfo);
+
+    CloseHandle(inRead);
+    CloseHandle(outWrite);
+
+    if (!created)
+    {
+        CloseHandle(inWrite);
+        CloseHandle(outRead);
+        return false;
+    }
+
+    CloseHandle(processInfo.hThread);
+    process = processInfo.hProcess;
+    stdinWrite = inWrite;
+    stdoutRead = outRead;
+    return true;
+}
+
+void CoProcess::stop()
+{
+    if (stdinWrite != nullptr)
+        CloseHandle((HANDLE) stdinWrite);
+
+    if (process != nullptr)
+    {
+        // Closing stdin lets git exit on its own, only force it if it doesn't
+        if (WaitForSingleObject((HANDLE) process, 1000) == WAIT_TIMEOUT)
+            TerminateProcess((HANDLE) process, 1);
+
+        CloseHandle((HANDLE) process);
+    }
+
+    if (stdoutRead != nullptr)
+        CloseHandle((HANDLE) stdoutRead);
+
+    process = stdinWrite = stdoutRead = nullptr;
+    buffer.clear();
+    bufferStart = 0;
+}
+
+bool CoProcess::isRunning()
+{
+    if (process == nullptr)
+        return false;
+
+    if (WaitForSingleObject((HANDLE) process, 0) == WAIT_TIMEOUT)
+        return true;
+
+    stop();
+    return false;
+}
+
+bool CoProcess::write(const std::string& data)
+{
+    size_t written = 0;
+
+    while (stdinWrite != nullptr && written < data.size())
+    {
+        DWORD chunk = 0;
+
+        if (!WriteFile((HANDLE) stdinWrite, data.data() + written, (DWORD) (data.size() - written), &chunk, NULL))
+            return false;
+
+        written += chunk;
+    }
+
+    return written == data.size();
+}
+
+bool CoProcess::fillBuffer(int timeoutMs)
+{
+    if (stdoutRead == nullptr)
+        return false;
+
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    DWORD available = 0;
+
+    // Anonymous pipes have no overlapped reads, so poll for data to honour the timeout
+    while (PeekNamedPipe((HANDLE) stdoutRead, NULL, 0, NULL, &available, NULL) && available == 0)
+    {
+        if (timeoutMs > 0 && Clock::now() > deadline)
+            return false;
+
+        Sleep(1);
+    }
+
+    if (bufferStart > 0)
+    {
+        buffer.erase(0, bufferStart);
+        bufferStart = 0;
+    }
+
+    const size_t oldSize = buffer.size();
+    buffer.resize(oldSize + readChunkSize);
+
+    DWORD bytesRead = 0;
+    const BOOL ok = ReadFile((HANDLE) stdoutRead, &buffer[oldSize], (DWORD) readChunkSize, &bytesRead, NULL);
+    buffer.resize(oldSize + (ok ? bytesRead : 0));
+    return ok && bytesRead > 0;
+}
+
+#else
+bool CoProcess::start(const std::vector<std::string>& argv, const std::string& workingDirectory)
+{
+    stop();
+
+    Pipe inPipe, outPipe;
+
+    if (!inPipe.open() || !outPipe.open())
+        return false;
+
+    SpawnSettings settings;
+    settings.workingDirectory = workingDirectory;
+    settings.stdinFd = inPipe.fds[0];
+    settings.stdoutFd = outPipe.fds[1];
+
+    const pid_t child = spawnChild(argv, settings);
+
+    if (child <= 0)
+        return false;
+
+    pid = child;
+    stdinFd = inPipe.fds[1];
+    stdoutFd = outPipe.fds[0];
+    inPipe.fds[1] = -1;
+    outPipe.fds[0] = -1;
+    return true;
+}
+
+void CoProcess::stop()
+{
+    if (stdinFd >= 0)
+        ::close(stdinFd);
+
+    if (stdoutFd >= 0)
+        ::close(stdoutFd);
+
+    if (pid > 0)
+    {
+        // Closing stdin lets git exit on its own, only force it if it doesn't
+        int status = 0;
+
+        for (int i = 0; i < 100 && ::waitpid(pid, &status, WNOHANG) == 0; ++i)
+        {
+            if (i == 99)
+            {
+                ::kill(pid, SIGKILL);
+                ::waitpid(pid, &status, 0);
+            }
+            else
+            {
+                ::usleep(10000);
+            }
+        }
+    }
+
+    pid = stdinFd = stdoutFd = -1;
+    buffer.clear();
+    bufferStart = 0;
+}
+
+bool CoProcess::isRunning()
+{
+    if (pid <= 0)
+        return false;
+
+    // kill(pid, 0) succeeds on a zombie too: only waitpid tells a child that exited
+    int status = 0;
+
+    if (::waitpid(pid, &status, WNOHANG) == 0)
+        return true;
+
+    // Reaped now, so stop() mustn't wait for it or signal a pid that may be reused
+    pid = -1;
+    stop();
+    return false;
+}
+
+bool CoProcess::write(const std::string& data)
+{
+    if (stdinFd < 0)
+        return false;
+
+    // A dead child would raise SIGPIPE, which would take the whole host down with it.
+    // Block it on this thread for the write and swallow anything that became pending.
+    sigset_t pipeSignal, previousMask;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousMask);
+
+    size_t written = 0;
+    bool ok = true;
+
+    while (written < data.size())
+    {
+        const ssize_t chunk = ::write(stdinFd, data.data() + written, data.size() - written);
+
+        if (chunk < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            ok = false;
+            break;
+        }
+
+        written += (size_t) chunk;
+    }
+
+    if (!ok && errno == EPIPE)
+    {
+        const timespec noWait { 0, 0 };
+        sigtimedwait(&pipeSignal, nullptr, &noWait);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+    return ok;
+}
+
+bool CoProcess::fillBuffer(int timeoutMs)
+{
+    if (stdoutFd < 0)
+        return false;
+
+    pollfd fd { stdoutFd, POLLIN, 0 };
+    int ready;
+
+    do
+    {
+        ready = ::poll(&fd, 1, timeoutMs > 0 ? timeoutMs : -1);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready <= 0)
+        return false;
+
+    if (bufferStart > 0)
+    {
+        buffer.erase(0, bufferStart);
+        bufferStart = 0;
+    }
+
+    return readInto(stdoutFd, buffer);
+}
+#endif
@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    ProcessRunner.h
+    Launches child processes (git, mostly) without going through a shell and
+    collects their output, exit code and timing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+//==============================================================================
+struct ProcessResult
+{
+    bool launched = false;  // false if the process could not be started at all
+    bool timedOut = false;  // true if the process was killed because it ran past the timeout
+    bool cancelled = false; // true if the process was killed because cancelFlag was raised
+    int exitCode = -1;
+    std::string output;     // stdout
+    std::string error;      // stderr (or empty if it was merged into output)
+    double elapsedMs = 0.0;
+
+    bool succeeded() const { return launched && !timedOut && !cancelled && exitCode == 0; }
+};
+
+//==============================================================================
+/**
+    Runs a program with a direct argv (no shell in between) and reads its
+    stdout/stderr through pipes.
+
+    On Linux and macOS this uses posix_spawn and a poll() loop reading large
+    chunks into a growable buffer, on Windows it uses CreateProcess with one
+    reader thread per pipe. A cancelled or timed-out process gets SIGTERM and
+    a few seconds to tidy up before its process group is killed.
+*/
+class ProcessRunner
+{
+public:
+    struct Options
+    {
+        std::string workingDirectory;   // empty = inherit the host's cwd
+        int timeoutMs = -1;             // <= 0 means wait forever
+        bool mergeStderr = false;       // append stderr to output, like "2>&1"
+        const std::atomic<bool>* cancelFlag = nullptr; // polled while waiting, stops the process when set
+        bool lowPriority = false;       // nice 10 + idle I/O class, for work that shouldn't compete with audio
+        std::vector<std::string> environment; // "NAME=value" entries added to (or replacing) the inherited ones
+    };
+
+    /** argv[0] is looked up on the PATH. */
+    static ProcessResult run(const std::vector<std::string>& argv, const Options& options);
+    static ProcessResult run(const std::vector<std::string>& argv);
+
+    /** Runs a command line through the platform shell ("/bin/sh -c" or "cmd /C").
+        Only use this for commands that actually need shell syntax such as "&&".
+    */
+    static ProcessResult runShell(const std::string& commandLine, const Options& options);
+
+    /** Splits a simple command line into argv, honouring double and single quotes.
+        Returns an empty array if the line contains shell operators and therefore
+        has to go through runShell().
+    */
+    static std::vector<std::string> splitCommandLine(const std::string& commandLine);
+};
+
+//==============================================================================
+/**
+    A long-lived child process we talk to over its stdin/stdout, e.g.
+    "git cat-file --batch". stderr is discarded.
+
+    Not thread safe, callers serialise access themselves.
+*/
+class CoProcess
+{
+public:
+    CoProcess() = default;
+    ~CoProcess();
+
+    bool start(const std::vector<std::string>& argv, const std::string& workingDirectory);
+    void stop();
+
+    /** False once the child has exited, which also tidies up after it so start() can run again. */
+    bool isRunning();
+
+    bool write(const std::string& data);
+
+    /** Reads up to and excluding the next '\n'. Returns false on EOF or timeout. */
+    bool readLine(std::string& line, int timeoutMs);
+
+    /** Appends exactly count bytes to destination. Returns false on EOF or timeout. */
+    bool readBytes(size_t count, std::string& destination, int timeoutMs);
+
+private:
+    bool fillBuffer(int timeoutMs);
+
+    std::string buffer;
+    size_t bufferStart = 0;
+
+   #if JUCE_WINDOWS
+    void* process = nullptr;
+    void* stdinWrite = nullptr;
+    void* stdoutRead = nullptr;
+   #else
+    int pid = -1;
+    int stdinFd = -1;
+    int stdoutFd = -1;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE(CoProcess)
+};
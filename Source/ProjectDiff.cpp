@@ -0,0 +1,919 @@
+/*
+  ==============================================================================
+
+    ProjectDiff.cpp
+
+  ==============================================================================
+*/
+
+#include "ProjectDiff.h"
+#include "ProcessRunner.h"
+#include "ProjectFileStore.h"
+#include "AssetStore.h"
+#include "CheckoutEngine.h"
+#include "GitParser.h"
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+//==============================================================================
+namespace
+{
+    constexpr int readTimeoutMs = 30000;
+    constexpr size_t blockSize = 64 * 1024;
+    constexpr size_t maxTagLength = 1024 * 1024;   // anything longer isn't a Live set
+
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    //==============================================================================
+    // One blob, streamed out of its own "git cat-file --batch" as it is read
+    class BlobInputStream : public juce::InputStream
+    {
+    public:
+        BlobInputStream(const juce::File& gitDirectory, const juce::String& oid)
+        {
+            std::string header;
+
+            if (!process.start({ "git", "--git-dir=" + gitDirectory.getFullPathName().toStdString(), "cat-file", "--batch" }, {})
+                || !process.write(oid.toStdString() + "\n")
+                || !process.readLine(header, readTimeoutMs))
+                return;
+
+            // "<oid> blob <size>", or "<oid> missing"
+            const juce::StringArray fields = juce::StringArray::fromTokens(juce::String(header), " ", "");
+
+            if (fields.size() == 3 && fields[1] == "blob")
+            {
+                size = fields[2].getLargeIntValue();
+                valid = true;
+            }
+        }
+
+        bool isValid() const { return valid; }
+
+        juce::int64 getTotalLength() override { return size; }
+        bool isExhausted() override { return position >= size; }
+        juce::int64 getPosition() override { return position; }
+        bool setPosition(juce::int64 newPosition) override { return newPosition == position; }
+
+        int read(void* destination, int maxBytesToRead) override
+        {
+            const juce::int64 count = juce::jmin((juce::int64) maxBytesToRead, size - position);
+
+            if (!valid || count <= 0)
+                return 0;
+
+            chunk.clear();
+
+            if (!process.readBytes((size_t) count, chunk, readTimeoutMs))
+            {
+                valid = false;
+                return 0;
+            }
+
+            std::memcpy(destination, chunk.data(), chunk.size());
+            position += count;
+            return (int) count;
+        }
+
+    private:
+        CoProcess process;
+        std::string chunk;
+        juce::int64 size = 0;
+        juce::int64 position = 0;
+        bool valid = false;
+    };
+
+    //==============================================================================
+    juce::uint64 hashBytes(juce::uint64 hash, const char* data, size_t size)
+    {
+        // FNV-1a: cheap, and good enough to tell two versions of a device apart
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ (juce::uint8) data[i]) * 0x100000001b3ULL;
+
+        return hash;
+    }
+
+    // Written on every save without anything in the set changing
+    bool isViewState(const std::string& name)
+    {
+        static const std::set<std::string> names { "LomId", "LomIdView", "IsExpanded", "IsFolded", "ViewData",
+                                                   "SelectedDevice", "SelectedEnvelope", "LastSelectedTimeableIndex",
+                                                   "LastSelectedClipEnvelopeIndex", "ScrollerTimePreserver", "TimeSelection" };
+        return names.count(name) > 0;
+    }
+
+    bool isTrack(const std::string& name)
+    {
+        return name == "AudioTrack" || name == "MidiTrack" || name == "ReturnTrack" || name == "GroupTrack";
+    }
+
+    //==============================================================================
+    /*  A pull-free XML scanner that turns a Live set into a Summary as blocks arrive.
+        Only the tag being read is ever buffered. Text content and comments are skipped,
+        Live keeps everything it needs in attributes.
+    */
+    class SetReader
+    {
+    public:
+        explicit SetReader(ProjectDiff::Summary& destination) : summary(destination) {}
+
+        bool feed(const char* data, size_t size)
+        {
+            pending.append(data, size);
+            size_t position = 0;
+
+            for (;;)
+            {
+                const size_t open = pending.find('<', position);
+
+                if (open == std::string::npos)
+                {
+                    position = pending.size();
+                    break;
+                }
+
+                size_t close = std::string::npos;
+
+                if (pending.compare(open, 4, "<!--") == 0)
+                {
+                    close = pending.find("-->", open + 4);
+                    close = close == std::string::npos ? close : close + 2;
+                }
+                else if (pending.compare(open, 9, "<![CDATA[") == 0)
+                {
+                    close = pending.find("]]>", open + 9);
+                    close = close == std::string::npos ? close : close + 2;
+                }
+                else
+                {
+                    close = findTagEnd(open + 1);
+                }
+
+                if (close == std::string::npos)
+                {
+                    position = open;
+                    break;
+                }
+
+                if (!readTag(open, close))
+                    return false;
+
+                position = close + 1;
+            }
+
+            pending.erase(0, position);
+            return pending.size() < maxTagLength;
+        }
+
+        bool isComplete() const { return sawRoot && stack.empty(); }
+
+    private:
+        struct Attribute
+        {
+            std::string name, value;
+        };
+
+        struct Frame
+        {
+            std::string name;
+            int entity = -1;        // index into open, if this element is a track, device or clip
+            bool ignored = false;
+            std::string clipSlot;
+        };
+
+        struct OpenEntity
+        {
+            std::string key;
+            ProjectDiff::Summary::Entity entity;
+            size_t depth = 0;
+            int namePriority = 0;
+        };
+
+        size_t findTagEnd(size_t from) const
+        {
+            char quote = 0;
+
+            for (size_t i = from; i < pending.size(); ++i)
+            {
+                const char c = pending[i];
+
+                if (quote != 0)
+                {
+                    if (c == quote)
+                        quote = 0;
+                }
+                else if (c == '"' || c == '\'')
+                {
+                    quote = c;
+                }
+                else if (c == '>')
+                {
+                    return i;
+                }
+            }
+
+            return std::string::npos;
+        }
+
+        static void unescape(std::string& value)
+        {
+            if (value.find('&') == std::string::npos)
+                return;
+
+            std::string result;
+            result.reserve(value.size());
+
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                const size_t end = value[i] == '&' ? value.find(';', i) : std::string::npos;
+
+                if (end == std::string::npos)
+                {
+                    result += value[i];
+                    continue;
+                }
+
+                const std::string entity = value.substr(i + 1, end - i - 1);
+
+                if (entity == "amp")        result += '&';
+                else if (entity == "lt")    result += '<';
+                else if (entity == "gt")    result += '>';
+                else if (entity == "quot")  result += '"';
+                else if (entity == "apos")  result += '\'';
+                else if (!entity.empty() && entity[0] == '#')
+                {
+                    const bool hex = entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X');
+                    const juce::juce_wchar c = (juce::juce_wchar) std::strtoul(entity.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10);
+                    result += juce::String::charToString(c).toStdString();
+                }
+                else
+                {
+                    result.append(value, i, end - i + 1);
+                }
+
+                i = end;
+            }
+
+            value.swap(result);
+        }
+
+        bool readTag(size_t open, size_t close)
+        {
+            const char* tag = pending.data() + open;
+            const size_t length = close - open + 1;
+
+            if (length < 3 || tag[1] == '?' || tag[1] == '!')
+                return true;
+
+            if (tag[1] == '/')
+                return endElement();
+
+            const bool selfClosing = tag[length - 2] == '/';
+            const size_t end = length - (selfClosing ? 2 : 1);
+            size_t i = 1;
+
+            auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+
+            while (i < end && !isSpace(tag[i]))
+                ++i;
+
+            name.assign(tag + 1, i - 1);
+            numAttributes = 0;
+
+            while (i < end)
+            {
+                while (i < end && isSpace(tag[i]))
+                    ++i;
+
+                const size_t nameStart = i;
+
+                while (i < end && tag[i] != '=' && !isSpace(tag[i]))
+                    ++i;
+
+                const size_t nameEnd = i;
+
+                while (i < end && (tag[i] == '=' || isSpace(tag[i])))
+                    ++i;
+
+                if (nameEnd == nameStart || i >= end || (tag[i] != '"' && tag[i] != '\''))
+                    break;
+
+                const char quote = tag[i++];
+                const size_t valueStart = i;
+
+                while (i < end && tag[i] != quote)
+                    ++i;
+
+                if (attributes.size() <= numAttributes)
+                    attributes.emplace_back();
+
+                Attribute& attribute = attributes[numAttributes++];
+                attribute.name.assign(tag + nameStart, nameEnd - nameStart);
+                attribute.value.assign(tag + valueStart, i - valueStart);
+                unescape(attribute.value);
+                ++i;
+            }
+
+            startElement();
+            return !selfClosing || endElement();
+        }
+
+        const std::string* getAttribute(const char* attributeName) const
+        {
+            for (size_t i = 0; i < numAttributes; ++i)
+                if (attributes[i].name == attributeName)
+                    return &attributes[i].value;
+
+            return nullptr;
+        }
+
+        std::string getId() const
+        {
+            const std::string* id = getAttribute("Id");
+            return id != nullptr ? *id : std::string("?");
+        }
+
+        void openEntity(Frame& frame, ProjectDiff::Element element, const std::string& key, const std::string& defaultName)
+        {
+            OpenEntity entity;
+            entity.key = key;
+            entity.entity.element = element;
+            entity.entity.name = juce::String::fromUTF8(defaultName.c_str());
+            entity.entity.order = nextOrder++;
+            entity.depth = stack.size();
+
+            frame.entity = (int) open.size();
+            open.push_back(std::move(entity));
+
+            if (element == ProjectDiff::Element::track)
+                track = frame.entity;
+        }
+
+        void setName(OpenEntity& entity, int priority)
+        {
+            const std::string* value = getAttribute("Value");
+
+            if (value != nullptr && !value->empty() && priority >= entity.namePriority)
+            {
+                entity.entity.name = juce::String::fromUTF8(value->c_str());
+                entity.namePriority = priority;
+            }
+        }
+
+        void startElement()
+        {
+            sawRoot = true;
+
+            Frame frame;
+            frame.name = name;
+            frame.ignored = (!stack.empty() && stack.back().ignored) || isViewState(name);
+
+            const std::string& parent = stack.empty() ? name : stack.back().name;
+
+            if (parent == "Tracks" && isTrack(name))
+            {
+                openEntity(frame, ProjectDiff::Element::track, name + "#" + getId(), name);
+            }
+            else if (parent == "LiveSet" && (name == "MasterTrack" || name == "MainTrack"))
+            {
+                // Live 12 renamed it: the same track either way
+                openEntity(frame, ProjectDiff::Element::track, "Main", "Main");
+            }
+            else if (parent == "LiveSet" && name == "PreHearTrack")
+            {
+                frame.ignored = true;
+            }
+            else if (track >= 0 && parent == "Devices")
+            {
+                openEntity(frame, ProjectDiff::Element::device, open.back().key + "/" + name + "#" + getId(), name);
+            }
+            else if (track >= 0 && name == "ClipSlot" && getAttribute("Id") != nullptr)
+            {
+                frame.clipSlot = getId();
+            }
+            else if (track >= 0 && (name == "AudioClip" || name == "MidiClip"))
+            {
+                std::string slot;
+
+                for (auto it = stack.rbegin(); it != stack.rend() && slot.empty(); ++it)
+                    slot = it->clipSlot;
+
+                const std::string& trackKey = open[(size_t) track].key;
+                openEntity(frame, ProjectDiff::Element::clip,
+                           slot.empty() ? trackKey + "/Arrangement/" + name + "#" + getId() : trackKey + "/Session/" + slot,
+                           name);
+            }
+            else if (!open.empty())
+            {
+                OpenEntity& owner = open.back();
+                const size_t depth = stack.size() - owner.depth;
+
+                switch (owner.entity.element)
+                {
+                    case ProjectDiff::Element::track:
+                        if (name == "EffectiveName" && parent == "Name" && depth == 2)
+                            setName(owner, 2);
+                        else if (name == "Manual" && parent == "Tempo" && owner.key == "Main")
+                            if (const std::string* value = getAttribute("Value"))
+                                summary.tempo = juce::String(juce::String(*value).getDoubleValue());
+                        break;
+
+                    case ProjectDiff::Element::device:
+                        if (name == "UserName" && depth == 1)
+                            setName(owner, 3);
+                        else if (name == "PlugName" || (name == "Name" && (parent == "Vst3PluginInfo" || parent == "AuPluginInfo")))
+                            setName(owner, 2);
+                        break;
+
+                    case ProjectDiff::Element::clip:
+                        if (name == "Name" && depth == 1)
+                            setName(owner, 2);
+                        break;
+
+                    case ProjectDiff::Element::tempo:
+                    default:
+                        break;
+                }
+            }
+
+            // The tempo is reported on its own, not as a change to the main track
+            if (name == "Tempo" && !open.empty() && open.back().key == "Main")
+                frame.ignored = true;
+
+            if (!frame.ignored && !open.empty())
+            {
+                juce::uint64& hash = open.back().entity.hash;
+                hash = hashBytes(hash, name.data(), name.size() + 1);
+
+                for (size_t i = 0; i < numAttributes; ++i)
+                {
+                    hash = hashBytes(hash, attributes[i].name.data(), attributes[i].name.size() + 1);
+                    hash = hashBytes(hash, attributes[i].value.data(), attributes[i].value.size() + 1);
+                }
+            }
+
+            stack.push_back(std::move(frame));
+        }
+
+        bool endElement()
+        {
+            if (stack.empty())
+                return false;
+
+            const int entity = stack.back().entity;
+            stack.pop_back();
+
+            if (entity >= 0)
+            {
+                OpenEntity closed = std::move(open.back());
+                open.pop_back();
+
+                if (track >= 0 && entity != track)
+                    closed.entity.track = open[(size_t) track].entity.name;
+
+                if (entity == track)
+                    track = -1;
+
+                // Two entities in one place would be a set we don't understand: keep both
+                std::string key = closed.key;
+                for (int n = 2; summary.entities.count(key) > 0; ++n)
+                    key = closed.key + "~" + std::to_string(n);
+
+                summary.entities[key] = std::move(closed.entity);
+            }
+
+            return true;
+        }
+
+        ProjectDiff::Summary& summary;
+        std::string pending;
+        std::string name;
+        std::vector<Attribute> attributes;
+        size_t numAttributes = 0;
+        std::vector<Frame> stack;
+        std::vector<OpenEntity> open;
+        int track = -1;
+        int nextOrder = 0;
+        bool sawRoot = false;
+    };
+
+    //==============================================================================
+    constexpr uint32_t modeGitlink = 0160000;
+
+    std::string toRawOid(const juce::String& hex)
+    {
+        juce::MemoryBlock raw;
+        raw.loadFromHexString(hex);
+        return std::string(static_cast<const char*>(raw.getData()), raw.getSize());
+    }
+
+    juce::String toHexOid(const std::string& raw)
+    {
+        return raw.empty() ? juce::String() : juce::String::toHexString(raw.data(), (int) raw.size(), 0);
+    }
+
+    bool readCommit(GitRepositoryWorker& worker, const juce::String& commitOid, juce::String& tree, juce::String& firstParent)
+    {
+        juce::String type;
+        std::string content;
+        ParseArena arena;
+        GitParser::CommitInfo commit;
+
+        if (!worker.readObject(commitOid, type, content) || type != "commit" || !GitParser::parseCommit(content, arena, commit))
+            return false;
+
+        tree = GitParser::toString(commit.tree);
+        firstParent = commit.numParents > 0 ? GitParser::toString(commit.parents[0]) : juce::String();
+        return true;
+    }
+
+    // The project file a changed path is a version of: a raw .als, or the shadow of one
+    juce::String getProjectFilePath(const juce::String& path, bool& compressed)
+    {
+        const juce::String shadowPrefix = juce::String(ProjectFileStore::shadowDirectoryName) + "/";
+
+        if (path.startsWith(shadowPrefix) && path.endsWithIgnoreCase(".als.xml"))
+        {
+            compressed = false;
+            return path.substring(shadowPrefix.length()).dropLastCharacters(4);
+        }
+
+        if (path.endsWithIgnoreCase(".als"))
+        {
+            compressed = true;
+            return path;
+        }
+
+        return {};
+    }
+
+    // The audio file a changed path is a version of: the file itself, or an AssetStore pointer to it
+    juce::String getAudioFilePath(const juce::String& path, bool& isPointer)
+    {
+        static const juce::StringArray extensions = juce::StringArray::fromTokens(CheckoutEngine::sampleExtensions, ";", "");
+        const juce::String pointerPrefix = juce::String(AssetStore::pointerDirectoryName) + "/";
+
+        isPointer = path.startsWith(pointerPrefix) && path.endsWith(".asset");
+        const juce::String audioPath = isPointer ? path.substring(pointerPrefix.length()).dropLastCharacters(6) : path;
+
+        return extensions.contains(audioPath.fromLastOccurrenceOf(".", false, false), true) ? audioPath : juce::String();
+    }
+
+    // Both versions of a file that changed. Where one side has it in two forms (while a file
+    // becomes managed) the managed form wins: a shadow over a raw .als, a pointer over audio.
+    struct ChangedFile
+    {
+        juce::String oldOid, newOid;
+        bool oldManaged = false, newManaged = false;
+
+        void add(const juce::String& before, const juce::String& after, bool managed)
+        {
+            if (before.isNotEmpty() && (oldOid.isEmpty() || managed))
+            {
+                oldOid = before;
+                oldManaged = managed;
+            }
+
+            if (after.isNotEmpty() && (newOid.isEmpty() || managed))
+            {
+                newOid = after;
+                newManaged = managed;
+            }
+        }
+    };
+
+    using ChangedFiles = std::map<juce::String, ChangedFile>;
+
+    // The files that changed between both trees and are versions of a project file or of audio
+    bool findChangedFiles(GitRepositoryWorker& worker, const juce::String& oldTree, const juce::String& newTree,
+                          ChangedFiles& projectFiles, ChangedFiles& audioFiles)
+    {
+        std::vector<SnapshotBuilder::CheckoutChange> changes;
+
+        if (!CheckoutEngine::diffTrees(worker, toRawOid(oldTree), toRawOid(newTree), {}, changes))
+            return false;
+
+        for (const auto& change : changes)
+        {
+            if (change.oldMode == modeGitlink || change.newMode == modeGitlink)
+                continue;
+
+            const juce::String path = juce::String::fromUTF8(change.path.c_str());
+            const juce::String before = toHexOid(change.oldOid);
+            const juce::String after = toHexOid(change.newOid);
+
+            bool compressed = false;
+            const juce::String projectFile = getProjectFilePath(path, compressed);
+
+            if (projectFile.isNotEmpty())
+            {
+                projectFiles[projectFile].add(before, after, !compressed);
+                continue;
+            }
+
+            bool isPointer = false;
+            const juce::String audioFile = getAudioFilePath(path, isPointer);
+
+            if (audioFile.isNotEmpty())
+                audioFiles[audioFile].add(before, after, isPointer);
+        }
+
+        return true;
+    }
+
+    const char* getElementName(ProjectDiff::Element element)
+    {
+        switch (element)
+        {
+            case ProjectDiff::Element::track:   return "Track";
+            case ProjectDiff::Element::device:  return "Device";
+            case ProjectDiff::Element::clip:    return "Clip";
+            case ProjectDiff::Element::tempo:   return "Tempo";
+            default:                            return "";
+        }
+    }
+}
+
+//==============================================================================
+juce::String ProjectDiff::Change::describe() const
+{
+    juce::String text;
+    text << (kind == Kind::added ? "+ " : kind == Kind::removed ? "- " : "~ ") << getElementName(element);
+
+    if (element != Element::tempo)
+        text << " \"" << name << "\"";
+
+    if (track.isNotEmpty())
+        text << " on \"" << track << "\"";
+
+    if (detail.isNotEmpty())
+        text << (element == Element::tempo ? " " : " (") << detail << (element == Element::tempo ? "" : ")");
+
+    return text;
+}
+
+juce::String ProjectDiff::AudioChange::describe() const
+{
+    juce::String text;
+    text << (kind == Kind::added ? "+ " : kind == Kind::removed ? "- " : "~ ") << "Audio \""
+         << path.fromLastOccurrenceOf("/", false, false) << "\"";
+    return text;
+}
+
+juce::String ProjectDiff::Result::describe() const
+{
+    if (!succeeded)
+        return error.isNotEmpty() ? error : juce::String("Changes couldn't be read");
+
+    juce::StringArray files;
+    for (const auto& change : changes)
+        files.addIfNotAlreadyThere(change.projectFile);
+
+    juce::StringArray lines;
+
+    if (numProjectFiles > 0 && changes.isEmpty())
+        lines.add("Saved, nothing in the set changed");
+
+    for (const auto& change : changes)
+        lines.add(files.size() > 1 ? change.projectFile.fromLastOccurrenceOf("/", false, false) + ": " + change.describe()
+                                   : change.describe());
+
+    for (const auto& change : audioChanges)
+        lines.add(change.describe());
+
+    return lines.isEmpty() ? juce::String("The set didn't change") : lines.joinIntoString("\n");
+}
+
+//==============================================================================
+bool ProjectDiff::summarise(juce::InputStream& xml, Summary& summary, const std::atomic<bool>* cancelFlag)
+{
+    SetReader reader(summary);
+    std::vector<char> block(blockSize);
+
+    for (;;)
+    {
+        if (isCancelled(cancelFlag))
+            return false;
+
+        const int numRead = xml.read(block.data(), (int) block.size());
+
+        if (numRead <= 0)
+            break;
+
+        if (!reader.feed(block.data(), (size_t) numRead))
+            return false;
+    }
+
+    return reader.isComplete();
+}
+
+void ProjectDiff::compare(const Summary& before, const Summary& after, const juce::String& projectFile, juce::Array<Change>& changes)
+{
+    // Inside something added or removed as a whole: reported with it, not on its own
+    auto isInsideOneSided = [&before, &after](const std::string& key)
+    {
+        for (size_t slash = key.find('/'); slash != std::string::npos; slash = key.find('/', slash + 1))
+        {
+            const std::string owner = key.substr(0, slash);
+            if ((before.entities.count(owner) > 0) != (after.entities.count(owner) > 0))
+                return true;
+        }
+
+        return false;
+    };
+
+    std::vector<std::pair<int, Change>> found;
+
+    auto add = [&found, &projectFile](Kind kind, const Summary::Entity& entity, int order, const juce::String& detail)
+    {
+        Change change;
+        change.kind = kind;
+        change.element = entity.element;
+        change.name = entity.name;
+        change.track = entity.track;
+        change.detail = detail;
+        change.projectFile = projectFile;
+        found.emplace_back(order, change);
+    };
+
+    for (const auto& item : after.entities)
+    {
+        auto previous = before.entities.find(item.first);
+
+        if (previous == before.entities.end())
+        {
+            if (!isInsideOneSided(item.first))
+                add(Kind::added, item.second, item.second.order, {});
+        }
+        else if (previous->second.hash != item.second.hash)
+        {
+            add(Kind::modified, item.second, item.second.order,
+                previous->second.name != item.second.name ? "renamed from \"" + previous->second.name + "\"" : juce::String());
+        }
+    }
+
+    for (const auto& item : before.entities)
+        if (after.entities.count(item.first) == 0 && !isInsideOneSided(item.first))
+            add(Kind::removed, item.second, item.second.order, {});
+
+    std::stable_sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    if (before.tempo != after.tempo && before.tempo.isNotEmpty() && after.tempo.isNotEmpty())
+    {
+        Change tempo;
+        tempo.element = Element::tempo;
+        tempo.name = "Tempo";
+        tempo.detail = before.tempo + " -> " + after.tempo + " BPM";
+        tempo.projectFile = projectFile;
+        changes.add(tempo);
+    }
+
+    for (const auto& change : found)
+        changes.add(change.second);
+}
+
+//==============================================================================
+ProjectDiff::Result ProjectDiff::diffCommit(GitRepositoryWorker& worker, const juce::String& commitOid, const std::atomic<bool>* cancelFlag)
+{
+    Result result;
+
+    if (getCachedResult(commitOid, result))
+        return result;
+
+    const juce::int64 start = juce::Time::getHighResolutionTicks();
+    result.newCommit = commitOid;
+
+    juce::String newTree, oldTree, unusedParent;
+    ChangedFiles projectFiles, audioFiles;
+
+    if (!readCommit(worker, commitOid, newTree, result.oldCommit)
+        || (result.oldCommit.isNotEmpty() && !readCommit(worker, result.oldCommit, oldTree, unusedParent))
+        || !findChangedFiles(worker, oldTree, newTree, projectFiles, audioFiles))
+    {
+        result.error = "The snapshot couldn't be read";
+        return result;
+    }
+
+    for (const auto& file : audioFiles)
+    {
+        if (file.second.oldOid == file.second.newOid)
+            continue;
+
+        AudioChange change;
+        change.kind = file.second.oldOid.isEmpty() ? Kind::added : file.second.newOid.isEmpty() ? Kind::removed : Kind::modified;
+        change.path = file.first;
+        change.oldBlob = { file.second.oldOid, file.second.oldManaged };
+        change.newBlob = { file.second.newOid, file.second.newManaged };
+        result.audioChanges.add(change);
+    }
+
+    for (const auto& file : projectFiles)
+    {
+        if (file.second.oldOid == file.second.newOid)
+            continue;
+
+        ++result.numProjectFiles;
+
+        // Unmanaged here means compressed: the raw .als rather than its shadow
+        std::shared_ptr<const Summary> before = file.second.oldOid.isEmpty() ? std::make_shared<const Summary>()
+                                              : getSummary(worker, { file.second.oldOid, !file.second.oldManaged }, cancelFlag);
+        std::shared_ptr<const Summary> after = file.second.newOid.isEmpty() ? std::make_shared<const Summary>()
+                                             : getSummary(worker, { file.second.newOid, !file.second.newManaged }, cancelFlag);
+
+        if (isCancelled(cancelFlag))
+            return result;
+
+        if (before == nullptr || after == nullptr)
+        {
+            result.error = file.first + " couldn't be read";
+            return result;
+        }
+
+        compare(*before, *after, file.first, result.changes);
+    }
+
+    result.succeeded = true;
+    result.totalMs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0;
+    remember(result);
+    return result;
+}
+
+bool ProjectDiff::getCachedResult(const juce::String& commitOid, Result& result) const
+{
+    const juce::ScopedLock sl(lock);
+    auto found = results.find(commitOid);
+
+    if (found == results.end())
+        return false;
+
+    result = found->second;
+    return true;
+}
+
+std::shared_ptr<const ProjectDiff::Summary> ProjectDiff::getSummary(GitRepositoryWorker& worker, const ProjectFileBlob& blob,
+                                                                    const std::atomic<bool>* cancelFlag)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        for (auto it = summaries.begin(); it != summaries.end(); ++it)
+        {
+            if (it->first == blob.oid)
+            {
+                summaries.splice(summaries.begin(), summaries, it);
+                return summaries.front().second;
+            }
+        }
+    }
+
+    BlobInputStream source(worker.getGitDirectory(), blob.oid);
+
+    if (!source.isValid())
+        return nullptr;
+
+    auto summary = std::make_shared<Summary>();
+    bool ok = false;
+
+    if (blob.compressed)
+    {
+        juce::GZIPDecompressorInputStream xml(&source, false, juce::GZIPDecompressorInputStream::gzipFormat);
+        ok = summarise(xml, *summary, cancelFlag);
+    }
+    else
+    {
+        ok = summarise(source, *summary, cancelFlag);
+    }
+
+    if (!ok)
+        return nullptr;
+
+    const juce::ScopedLock sl(lock);
+    summaries.emplace_front(blob.oid, summary);
+
+    while ((int) summaries.size() > maxCachedSummaries)
+        summaries.pop_back();
+
+    return summary;
+}
+
+void ProjectDiff::remember(const Result& result)
+{
+    const juce::ScopedLock sl(lock);
+
+    if (results.count(result.newCommit) == 0)
+        resultOrder.push_front(result.newCommit);
+
+    results[result.newCommit] = result;
+
+    while ((int) resultOrder.size() > maxCachedResults)
+    {
+        results.erase(resultOrder.back());
+        resultOrder.pop_back();
+    }
+}
@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    ProjectDiff.h
+    What changed in the Live set between two snapshots: tracks, devices,
+    clips and tempo, read by streaming both versions of each project file.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+
+//==============================================================================
+/**
+    A structural diff of the .als files of a snapshot against its parent.
+
+    Neither version is ever held in memory. Each one is streamed out of git
+    (the decompressed shadow XML ProjectFileStore keeps, or the gzipped .als
+    of snapshots older than that). The stream goes through an incremental
+    XML scanner that keeps only a Summary: one entry per track, device and
+    clip, with a hash of everything inside it that isn't view state, plus
+    the tempo. Comparing two summaries gives the added, removed and modified
+    parts. A track's own hash leaves out its devices and clips, so editing
+    a clip doesn't also report the track as changed.
+
+    Project files whose blob didn't change are skipped without being read.
+    Audio files that changed are listed too, but not read here.
+    Results are cached per commit (a commit fixes its parent) and summaries per blob, so stepping
+    through the history reads each version once. Thread safe; diffCommits()
+    does its work on the calling thread, so call it from the query queue.
+*/
+class ProjectDiff
+{
+public:
+    enum class Kind
+    {
+        added,
+        removed,
+        modified
+    };
+
+    enum class Element
+    {
+        track,
+        device,
+        clip,
+        tempo
+    };
+
+    struct Change
+    {
+        Kind kind = Kind::modified;
+        Element element = Element::track;
+        juce::String name;
+        juce::String track;         // the track a device or clip belongs to
+        juce::String detail;        // "renamed from ...", "120 -> 124"
+        juce::String projectFile;
+
+        juce::String describe() const;
+    };
+
+    /** A version of an audio file in git: the file itself, or an AssetStore pointer to it. */
+    struct AudioBlob
+    {
+        juce::String oid;           // empty if the file isn't on that side
+        bool isPointer = false;
+    };
+
+    struct AudioChange
+    {
+        Kind kind = Kind::modified;
+        juce::String path;
+        AudioBlob oldBlob, newBlob;
+
+        juce::String describe() const;
+    };
+
+    struct Result
+    {
+        bool succeeded = false;
+        juce::String error;
+        juce::String oldCommit;     // empty for the first snapshot
+        juce::String newCommit;
+        int numProjectFiles = 0;    // that differ between the two
+        juce::Array<Change> changes;
+        juce::Array<AudioChange> audioChanges; // found on the way, for AudioOverviewCache to look at
+        double totalMs = 0.0;
+
+        /** One line per change, for the editor. */
+        juce::String describe() const;
+    };
+
+    /** What diffing needs to know of one version of a project file. */
+    struct Summary
+    {
+        struct Entity
+        {
+            Element element = Element::track;
+            juce::String name;
+            juce::String track;
+            juce::uint64 hash = 0;
+            int order = 0;          // position in the document, to report changes in set order
+        };
+
+        std::map<std::string, Entity> entities; // keyed by where they sit in the set, e.g. "AudioTrack#8/Eq8#0"
+        juce::String tempo;
+    };
+
+    ProjectDiff() = default;
+
+    /** Diffs commitOid against its first parent. */
+    Result diffCommit(GitRepositoryWorker& worker, const juce::String& commitOid, const std::atomic<bool>* cancelFlag);
+
+    /** A result diffCommit() already has, without touching the repository. */
+    bool getCachedResult(const juce::String& commitOid, Result& result) const;
+
+    /** Reads one version of a set. Returns false if it was cancelled or isn't XML. */
+    static bool summarise(juce::InputStream& xml, Summary& summary, const std::atomic<bool>* cancelFlag);
+
+    static void compare(const Summary& before, const Summary& after, const juce::String& projectFile, juce::Array<Change>& changes);
+
+    static constexpr int maxCachedResults = 64;
+    static constexpr int maxCachedSummaries = 8;
+
+private:
+    struct ProjectFileBlob
+    {
+        juce::String oid;
+        bool compressed = false;    // a raw .als rather than ProjectFileStore's shadow XML
+    };
+
+    std::shared_ptr<const Summary> getSummary(GitRepositoryWorker& worker, const ProjectFileBlob& blob, const std::atomic<bool>* cancelFlag);
+    void remember(const Result& result);
+
+    mutable juce::CriticalSection lock;
+    std::map<juce::String, Result> results;     // by new commit, whose parent is fixed
+    std::list<juce::String> resultOrder;        // most recently used first
+    std::list<std::pair<juce::String, std::shared_ptr<const Summary>>> summaries; // by blob, most recently used first
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectDiff)
+};
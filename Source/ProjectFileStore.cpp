@@ -0,0 +1,579 @@
+/*
+  ==============================================================================
+
+    ProjectFileStore.cpp
+
+  ==============================================================================
+*/
+
+#include "ProjectFileStore.h"
+#include "ProjectWatcher.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr int blockSize = 64 * 1024;
+
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    // Decompresses a gzipped stream block by block, turning "\r\n" into "\n" on the way,
+    // including a pair that straddles two blocks. sink returns false to stop early.
+    bool readCanonical(juce::InputStream& compressed, const std::function<bool(const char*, size_t)>& sink,
+                       const std::atomic<bool>* cancelFlag)
+    {
+        juce::GZIPDecompressorInputStream gzip(&compressed, false, juce::GZIPDecompressorInputStream::gzipFormat);
+
+        std::vector<char> raw(blockSize);
+        std::vector<char> canonical(blockSize + 1);
+        bool pendingReturn = false;
+
+        for (;;)
+        {
+            if (isCancelled(cancelFlag))
+                return false;
+
+            const int numRead = gzip.read(raw.data(), (int) raw.size());
+            size_t produced = 0;
+
+            if (numRead <= 0)
+            {
+                if (pendingReturn)
+                    canonical[produced++] = '\r';
+
+                return produced == 0 || sink(canonical.data(), produced);
+            }
+
+            for (int i = 0; i < numRead; ++i)
+            {
+                const char c = raw[(size_t) i];
+
+                if (pendingReturn)
+                {
+                    pendingReturn = false;
+
+                    if (c == '\n')
+                    {
+                        canonical[produced++] = '\n';
+                        continue;
+                    }
+
+                    canonical[produced++] = '\r';
+                }
+
+                if (c == '\r')
+                    pendingReturn = true;
+                else
+                    canonical[produced++] = c;
+            }
+
+            if (produced > 0 && !sink(canonical.data(), produced))
+                return false;
+        }
+    }
+
+    // Does the gzipped project file decompress to exactly what the shadow holds?
+    bool matchesCanonical(const juce::File& projectFile, const juce::File& shadowFile, const std::atomic<bool>* cancelFlag)
+    {
+        juce::FileInputStream projectIn(projectFile);
+        juce::FileInputStream shadowIn(shadowFile);
+
+        if (!projectIn.openedOk() || !shadowIn.openedOk())
+            return false;
+
+        std::vector<char> expected(blockSize + 1);
+
+        const bool same = readCanonical(projectIn, [&](const char* data, size_t size)
+        {
+            return shadowIn.read(expected.data(), (int) size) == (int) size
+                && std::memcmp(expected.data(), data, size) == 0;
+        }, cancelFlag);
+
+        return same && shadowIn.isExhausted();
+    }
+
+    juce::File getTempFileFor(const juce::File& file)
+    {
+        // The .tmp suffix keeps the project watcher from reporting it
+        return file.getSiblingFile(file.getFileName() + ".snaptrack.tmp");
+    }
+}
+
+//==============================================================================
+ProjectFileStore::ProjectFileStore(const juce::File& project, const juce::File& gitDirectory, const juce::File& commonDirectory)
+    : projectDirectory(project),
+      shadowDirectory(project.getChildFile(shadowDirectoryName)),
+      cacheFile(gitDirectory.getChildFile("snaptrack").getChildFile("project-cache")),
+      excludeFile(commonDirectory.getChildFile("info").getChildFile("exclude")),
+      attributesFile(commonDirectory.getChildFile("info").getChildFile("attributes"))
+{
+}
+
+bool ProjectFileStore::isEnabled() const
+{
+    return shadowDirectory.isDirectory();
+}
+
+void ProjectFileStore::setEnabled(bool shouldBeEnabled)
+{
+    if (shouldBeEnabled)
+    {
+        shadowDirectory.createDirectory();
+        juce::File marker = shadowDirectory.getChildFile("store");
+        if (!marker.existsAsFile())
+            marker.replaceWithText("SnapTrack keeps project files here decompressed, so snapshots can share their contents.\n");
+    }
+    else
+    {
+        shadowDirectory.deleteRecursively();
+        cache.clear();
+        cacheDirty = false;
+        cacheFile.deleteFile();
+        updateExcludes();
+    }
+}
+
+bool ProjectFileStore::isCompressedProjectFile(const juce::File& file)
+{
+    if (!file.hasFileExtension("als"))
+        return false;
+
+    juce::FileInputStream in(file);
+    return in.openedOk() && in.readByte() == (char) 0x1f && in.readByte() == (char) 0x8b;
+}
+
+//==============================================================================
+bool ProjectFileStore::decompressToCanonical(const juce::File& source, const juce::File& destination,
+                                             const std::atomic<bool>* cancelFlag)
+{
+    juce::FileInputStream in(source);
+    if (!in.openedOk())
+        return false;
+
+    destination.getParentDirectory().createDirectory();
+    const juce::File temp = getTempFileFor(destination);
+    bool ok = false;
+
+    {
+        juce::FileOutputStream out(temp);
+        if (!out.openedOk())
+            return false;
+
+        out.setPosition(0);
+        out.truncate();
+
+        ok = readCanonical(in, [&out](const char* data, size_t size) { return out.write(data, size); }, cancelFlag);
+
+        out.flush();
+        ok = ok && !out.getStatus().failed();
+    }
+
+    if (!ok || !temp.moveFileTo(destination))
+    {
+        temp.deleteFile();
+        return false;
+    }
+
+    return true;
+}
+
+bool ProjectFileStore::compressFromCanonical(const juce::File& source, const juce::File& destination,
+                                             const std::atomic<bool>* cancelFlag)
+{
+    juce::FileInputStream in(source);
+    if (!in.openedOk())
+        return false;
+
+    destination.getParentDirectory().createDirectory();
+    const juce::File temp = getTempFileFor(destination);
+    bool ok = true;
+
+    {
+        juce::FileOutputStream out(temp);
+        if (!out.openedOk())
+            return false;
+
+        out.setPosition(0);
+        out.truncate();
+
+        {
+            juce::GZIPCompressorOutputStream gzip(out, 6, juce::GZIPCompressorOutputStream::windowBitsGZip);
+            std::vector<char> block(blockSize);
+
+            for (;;)
+            {
+                if (isCancelled(cancelFlag))
+                {
+                    ok = false;
+                    break;
+                }
+
+                const int numRead = in.read(block.data(), (int) block.size());
+                if (numRead <= 0)
+                    break;
+
+                if (!gzip.write(block.data(), (size_t) numRead))
+                {
+                    ok = false;
+                    break;
+                }
+            }
+
+            gzip.flush();
+        }
+
+        out.flush();
+        ok = ok && !out.getStatus().failed();
+    }
+
+    if (!ok || !temp.moveFileTo(destination))
+    {
+        temp.deleteFile();
+        return false;
+    }
+
+    return true;
+}
+
+juce::StringArray ProjectFileStore::findReferencedFiles(const juce::File& projectFile, const juce::File& projectDirectory)
+{
+    juce::StringArray found;
+
+    if (!isCompressedProjectFile(projectFile))
+        return found;
+
+    juce::FileInputStream in(projectFile);
+    if (!in.openedOk())
+        return found;
+
+    // Live writes one element per line. A sample is a <FileRef> holding either a RelativePath
+    // and a Path value (Live 11 and later), or RelativePathElement directories and a Name (before).
+    auto valueOf = [](const juce::String& line, const char* attribute)
+    {
+        const juce::String text = line.fromFirstOccurrenceOf(juce::String(attribute) + "=\"", false, false).upToFirstOccurrenceOf("\"", false, false);
+        return text.replace("&quot;", "\"").replace("&apos;", "'").replace("&lt;", "<").replace("&gt;", ">").replace("&amp;", "&");
+    };
+
+    auto add = [&found, &projectDirectory](const juce::String& path)
+    {
+        const juce::File file = juce::File::isAbsolutePath(path) ? juce::File(path) : projectDirectory.getChildFile(path);
+        if (path.isNotEmpty() && file.isAChildOf(projectDirectory))
+            found.addIfNotAlreadyThere(file.getRelativePathFrom(projectDirectory).replaceCharacter('\\', '/'));
+    };
+
+    // Raw bytes until a line is complete: a block can end inside a multi-byte character
+    std::string partial;
+    juce::StringArray elements;
+    bool inFileRef = false;
+
+    readCanonical(in, [&](const char* data, size_t size)
+    {
+        partial.append(data, size);
+        size_t start = 0;
+
+        for (size_t newline = partial.find('\n'); newline != std::string::npos; newline = partial.find('\n', start))
+        {
+            const juce::String line = juce::String::fromUTF8(partial.data() + start, (int) (newline - start)).trim();
+            start = newline + 1;
+
+            if (line.startsWith("<FileRef>"))
+            {
+                inFileRef = true;
+                elements.clear();
+            }
+            else if (line.startsWith("</FileRef>"))
+            {
+                inFileRef = false;
+            }
+            else if (inFileRef && line.startsWith("<RelativePath Value="))
+            {
+                add(valueOf(line, "Value"));
+            }
+            else if (inFileRef && line.startsWith("<Path Value="))
+            {
+                add(valueOf(line, "Value"));
+            }
+            else if (inFileRef && line.startsWith("<RelativePathElement "))
+            {
+                elements.add(valueOf(line, "Dir"));
+            }
+            else if (inFileRef && line.startsWith("<Name Value=") && !elements.isEmpty())
+            {
+                add(elements.joinIntoString("/") + "/" + valueOf(line, "Value"));
+                elements.clear();
+            }
+        }
+
+        partial.erase(0, start);
+        return true;
+    }, nullptr);
+
+    return found;
+}
+
+//==============================================================================
+ProjectFileStore::PreparedSnapshot ProjectFileStore::prepareSnapshot(const juce::StringArray& changedPaths,
+                                                                     const std::atomic<bool>* cancelFlag)
+{
+    PreparedSnapshot prepared;
+
+    if (!isEnabled())
+    {
+        prepared.pathsToStage = changedPaths;
+        return prepared;
+    }
+
+    loadCache();
+
+    const std::map<juce::String, juce::File> shadows = findShadows();
+    const juce::String shadowPrefix = juce::String(shadowDirectoryName) + "/";
+    juce::StringArray projectFiles;
+
+    if (changedPaths.isEmpty())
+    {
+        findProjectFiles(projectDirectory, {}, projectFiles);
+
+        for (const auto& shadow : shadows)
+        {
+            if (!projectFiles.contains(shadow.first))
+            {
+                shadow.second.deleteFile();
+                cache.erase(shadow.first);
+                cacheDirty = true;
+            }
+        }
+    }
+    else
+    {
+        for (const auto& path : changedPaths)
+        {
+            if (isCompressedProjectFile(projectDirectory.getChildFile(path)))
+            {
+                projectFiles.add(path);
+                prepared.pathsToStage.add(shadowPrefix + path + ".xml");
+            }
+            else if (shadows.count(path) > 0)
+            {
+                // Deleted, or saved uncompressed: git gets the file itself back
+                shadows.at(path).deleteFile();
+                cache.erase(path);
+                cacheDirty = true;
+                prepared.pathsToStage.add(shadowPrefix + path + ".xml");
+
+                if (projectDirectory.getChildFile(path).existsAsFile())
+                    prepared.pathsToStage.add(path);
+            }
+            else
+            {
+                prepared.pathsToStage.add(path);
+            }
+        }
+    }
+
+    for (const auto& path : projectFiles)
+    {
+        if (isCancelled(cancelFlag))
+            break;
+
+        if (storeProjectFile(path, cancelFlag) && shadows.count(path) == 0)
+            prepared.newlyManaged.add(path);
+    }
+
+    updateExcludes();
+    saveCache();
+    return prepared;
+}
+
+int ProjectFileStore::restoreProjectFiles(const std::atomic<bool>* cancelFlag)
+{
+    if (!isEnabled())
+        return 0;
+
+    loadCache();
+
+    int numWritten = 0;
+    bool failed = false;
+
+    for (const auto& shadow : findShadows())
+    {
+        if (isCancelled(cancelFlag))
+            break;
+
+        const juce::File target = projectDirectory.getChildFile(shadow.first);
+
+        if (target.existsAsFile())
+        {
+            // The shadow is where we left it, so whatever is in the .als is the user's
+            // (possibly a save that hasn't been snapshotted yet): never overwrite that
+            auto entry = cache.find(shadow.first);
+            if (entry != cache.end()
+                && entry->second.shadowSize == shadow.second.getSize()
+                && entry->second.shadowModified == shadow.second.getLastModificationTime().toMilliseconds())
+                continue;
+
+            if (matchesCanonical(target, shadow.second, cancelFlag))
+            {
+                remember(shadow.first, target, shadow.second);
+                continue;
+            }
+        }
+
+        if (compressFromCanonical(shadow.second, target, cancelFlag))
+        {
+            remember(shadow.first, target, shadow.second);
+            ++numWritten;
+        }
+        else if (!isCancelled(cancelFlag))
+        {
+            DBG("Couldn't rebuild " + shadow.first + " from its snapshot");
+            failed = true;
+        }
+    }
+
+    updateExcludes();
+    saveCache();
+    return failed ? -1 : numWritten;
+}
+
+void ProjectFileStore::updateExcludes()
+{
+    juce::StringArray paths;
+
+    if (isEnabled())
+        for (const auto& shadow : findShadows())
+            paths.add(shadow.first);
+
+    AssetStore::writeExcludeBlock(excludeFile, "project files", paths);
+
+    // Merged line by line, two branches that each add a track both move NextPointeeId to the same
+    // value and give their tracks clashing ids, and git calls that clean. As binary, a shadow both
+    // sides changed is a conflict, so merge-tree reports it and a merge never writes such a set.
+    juce::StringArray attributes;
+
+    if (isEnabled())
+        attributes.add("/" + juce::String(shadowDirectoryName) + "/** -merge");
+
+    AssetStore::writeManagedBlock(attributesFile, "project files", attributes);
+}
+
+//==============================================================================
+bool ProjectFileStore::storeProjectFile(const juce::String& relativePath, const std::atomic<bool>* cancelFlag)
+{
+    const juce::File projectFile = projectDirectory.getChildFile(relativePath);
+    const juce::File shadowFile = getShadowFile(relativePath);
+
+    if (shadowFile.existsAsFile() && isUpToDate(relativePath, projectFile, shadowFile))
+        return true;
+
+    const juce::int64 size = projectFile.getSize();
+    const juce::int64 modified = projectFile.getLastModificationTime().toMilliseconds();
+
+    if (!decompressToCanonical(projectFile, shadowFile, cancelFlag))
+        return false;
+
+    // Only trust the stat info if the DAW didn't save again while we were reading
+    if (projectFile.getSize() == size && projectFile.getLastModificationTime().toMilliseconds() == modified)
+        remember(relativePath, projectFile, shadowFile);
+
+    return true;
+}
+
+bool ProjectFileStore::isUpToDate(const juce::String& relativePath, const juce::File& projectFile, const juce::File& shadowFile) const
+{
+    auto entry = cache.find(relativePath);
+
+    return entry != cache.end()
+        && entry->second.projectSize == projectFile.getSize()
+        && entry->second.projectModified == projectFile.getLastModificationTime().toMilliseconds()
+        && entry->second.shadowSize == shadowFile.getSize()
+        && entry->second.shadowModified == shadowFile.getLastModificationTime().toMilliseconds();
+}
+
+void ProjectFileStore::remember(const juce::String& relativePath, const juce::File& projectFile, const juce::File& shadowFile)
+{
+    cache[relativePath] = { projectFile.getSize(), projectFile.getLastModificationTime().toMilliseconds(),
+                            shadowFile.getSize(), shadowFile.getLastModificationTime().toMilliseconds() };
+    cacheDirty = true;
+}
+
+//==============================================================================
+juce::File ProjectFileStore::getShadowFile(const juce::String& relativePath) const
+{
+    return shadowDirectory.getChildFile(relativePath + ".xml");
+}
+
+std::map<juce::String, juce::File> ProjectFileStore::findShadows() const
+{
+    std::map<juce::String, juce::File> shadows;
+
+    if (!shadowDirectory.isDirectory())
+        return shadows;
+
+    for (const auto& entry : juce::RangedDirectoryIterator(shadowDirectory, true, "*.als.xml", juce::File::findFiles))
+    {
+        const juce::File file = entry.getFile();
+        const juce::String relativePath = file.getRelativePathFrom(shadowDirectory).replaceCharacter('\\', '/');
+        shadows[relativePath.dropLastCharacters(4)] = file;
+    }
+
+    return shadows;
+}
+
+void ProjectFileStore::findProjectFiles(const juce::File& directory, const juce::String& relativePath, juce::StringArray& found) const
+{
+    for (const auto& entry : juce::RangedDirectoryIterator(directory, false, "*", juce::File::findFilesAndDirectories))
+    {
+        const juce::File file = entry.getFile();
+        const juce::String path = relativePath.isEmpty() ? file.getFileName() : relativePath + "/" + file.getFileName();
+
+        if (ProjectWatcher::shouldIgnore(path))
+            continue;
+
+        if (entry.isDirectory())
+            findProjectFiles(file, path, found);
+        else if (isCompressedProjectFile(file))
+            found.add(path);
+    }
+}
+
+//==============================================================================
+void ProjectFileStore::loadCache()
+{
+    if (cacheLoaded)
+        return;
+
+    cacheLoaded = true;
+
+    juce::StringArray lines;
+    lines.addLines(cacheFile.loadFileAsString());
+
+    // project size \t project modified \t shadow size \t shadow modified \t path
+    for (const auto& line : lines)
+    {
+        juce::StringArray fields;
+        fields.addTokens(line, "\t", "");
+
+        if (fields.size() == 5)
+            cache[fields[4]] = { fields[0].getLargeIntValue(), fields[1].getLargeIntValue(),
+                                 fields[2].getLargeIntValue(), fields[3].getLargeIntValue() };
+    }
+}
+
+void ProjectFileStore::saveCache()
+{
+    if (!cacheDirty)
+        return;
+
+    juce::String text;
+    for (const auto& entry : cache)
+        text << entry.second.projectSize << "\t" << entry.second.projectModified << "\t"
+             << entry.second.shadowSize << "\t" << entry.second.shadowModified << "\t" << entry.first << "\n";
+
+    cacheFile.getParentDirectory().createDirectory();
+    if (cacheFile.replaceWithText(text))
+        cacheDirty = false;
+}
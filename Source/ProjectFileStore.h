@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    ProjectFileStore.h
+    Stores gzipped DAW project files (Ableton's .als) decompressed, so git can
+    delta one snapshot against the next.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AssetStore.h"
+#include <atomic>
+#include <map>
+
+//==============================================================================
+/**
+    A clean/smudge transform for .als files, done in-process.
+
+    Snapshot ("clean"): each .als is streamed through a gzip decoder, line
+    endings are canonicalised to '\n', and the XML is written to
+    .snaptrack-projects/<path>.xml, which is what git tracks. The .als itself
+    is hidden from git with a managed block in .git/info/exclude, and
+    .git/info/attributes has git merge the shadows as binary. Two saves
+    that differ by one clip now differ by a few lines instead of by a whole
+    new compressed blob, so git's delta compression finally applies.
+
+    Checkout ("smudge"): restoreProjectFiles() gzips every shadow XML whose
+    copy on disk is out of date back into its .als.
+
+    Both directions stream in fixed-size blocks, so memory use doesn't depend
+    on the size of the project. A stat cache (.git/snaptrack/project-cache)
+    skips files that haven't changed on either side.
+
+    On for a repository while its .snaptrack-projects directory exists. Not
+    thread safe: call it from the job queue.
+*/
+class ProjectFileStore
+{
+public:
+    using PreparedSnapshot = AssetStore::PreparedSnapshot;
+
+    ProjectFileStore(const juce::File& projectDirectory, const juce::File& gitDirectory, const juce::File& commonDirectory);
+
+    bool isEnabled() const;
+    void setEnabled(bool shouldBeEnabled);
+
+    /** Refreshes the shadow XML of the project files among changedPaths (all of them if
+        empty) and swaps them for their shadows in the list of paths to stage.
+    */
+    PreparedSnapshot prepareSnapshot(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag);
+
+    /** Recompresses project files whose shadow changed, e.g. after a checkout.
+        Returns the number of files written, or -1 if one couldn't be written.
+    */
+    int restoreProjectFiles(const std::atomic<bool>* cancelFlag);
+
+    void updateExcludes();
+
+    /** The files inside projectDirectory that a .als refers to (samples, recordings), in the
+        order the set lists them, which is roughly the order Live loads them in.
+    */
+    static juce::StringArray findReferencedFiles(const juce::File& projectFile, const juce::File& projectDirectory);
+
+    /** A .als that really is gzipped (the magic bytes are checked). */
+    static bool isCompressedProjectFile(const juce::File& file);
+
+    /** The "clean" and "smudge" halves, usable on their own. */
+    static bool decompressToCanonical(const juce::File& source, const juce::File& destination, const std::atomic<bool>* cancelFlag);
+    static bool compressFromCanonical(const juce::File& source, const juce::File& destination, const std::atomic<bool>* cancelFlag);
+
+    static constexpr const char* shadowDirectoryName = ".snaptrack-projects";
+
+private:
+    struct CacheEntry
+    {
+        juce::int64 projectSize = 0;
+        juce::int64 projectModified = 0;
+        juce::int64 shadowSize = 0;
+        juce::int64 shadowModified = 0;
+    };
+
+    bool storeProjectFile(const juce::String& relativePath, const std::atomic<bool>* cancelFlag);
+    bool isUpToDate(const juce::String& relativePath, const juce::File& projectFile, const juce::File& shadowFile) const;
+    void remember(const juce::String& relativePath, const juce::File& projectFile, const juce::File& shadowFile);
+
+    juce::File getShadowFile(const juce::String& relativePath) const;
+    std::map<juce::String, juce::File> findShadows() const; // relative project file path -> shadow
+    void findProjectFiles(const juce::File& directory, const juce::String& relativePath, juce::StringArray& found) const;
+
+    void loadCache();
+    void saveCache();
+
+    juce::File projectDirectory;
+    juce::File shadowDirectory;
+    juce::File cacheFile;
+    juce::File excludeFile;
+    juce::File attributesFile;  // marks the shadows "-merge", see updateExcludes()
+
+    std::map<juce::String, CacheEntry> cache;
+    bool cacheLoaded = false;
+    bool cacheDirty = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectFileStore)
+};
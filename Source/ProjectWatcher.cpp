@@ -0,0 +1,272 @@
+/*
+  ==============================================================================
+
+    ProjectWatcher.cpp
+
+  ==============================================================================
+*/
+
+#include "ProjectWatcher.h"
+
+#if JUCE_LINUX
+ #include <cerrno>
+ #include <poll.h>
+ #include <sys/inotify.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+ProjectWatcher::ProjectWatcher(const juce::File& directory, ChangeCallback changeCallback, int quietMs)
+    : juce::Thread("SnapTrack project watcher"),
+      projectDirectory(directory),
+      callback(std::move(changeCallback)),
+      quietPeriodMs(quietMs)
+{
+    startThread();
+}
+
+ProjectWatcher::~ProjectWatcher()
+{
+    stopThread(5000);
+}
+
+bool ProjectWatcher::shouldIgnore(const juce::String& relativePath)
+{
+    // Matches what checkForGit writes into .gitignore, plus git's own directory and the
+    // pointer/shadow files of the asset and project file stores, which only snapshots write
+    if (relativePath == ".git" || relativePath.startsWith(".git/")
+        || relativePath == ".snaptrack-assets" || relativePath.startsWith(".snaptrack-assets/")
+        || relativePath == ".snaptrack-projects" || relativePath.startsWith(".snaptrack-projects/")
+        || relativePath.startsWith("Backup/") || relativePath == "Backup"
+        || relativePath.startsWith("Ableton Project Info/") || relativePath == "Ableton Project Info")
+        return true;
+
+    // Editor and OS droppings that come and go during a save
+    juce::String name = relativePath.fromLastOccurrenceOf("/", false, false);
+    return name.endsWith("~") || name.endsWithIgnoreCase(".tmp") || name == ".DS_Store"
+        || name.startsWith(".#") || name.startsWith("~$");
+}
+
+//==============================================================================
+void ProjectWatcher::run()
+{
+    if (!runNativeEvents())
+        runPolling();
+}
+
+void ProjectWatcher::markDirty(const juce::String& relativePath)
+{
+    if (shouldIgnore(relativePath))
+        return;
+
+    dirtyPaths.insert(relativePath);
+    lastChangeTime = juce::Time::getMillisecondCounter();
+}
+
+void ProjectWatcher::markEverythingDirty()
+{
+    everythingDirty = true;
+    lastChangeTime = juce::Time::getMillisecondCounter();
+}
+
+void ProjectWatcher::deliverIfQuiet()
+{
+    if (dirtyPaths.empty() && !everythingDirty)
+        return;
+
+    if (juce::Time::getMillisecondCounter() - lastChangeTime < (juce::uint32) quietPeriodMs)
+        return;
+
+    juce::StringArray paths;
+    if (!everythingDirty)
+        for (const auto& path : dirtyPaths)
+            paths.add(path);
+
+    dirtyPaths.clear();
+    everythingDirty = false;
+
+    if (callback)
+        callback(paths);
+}
+
+//==============================================================================
+#if JUCE_LINUX
+bool ProjectWatcher::runNativeEvents()
+{
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                        | IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+    std::map<int, juce::String> directories; // watch descriptor -> relative path ("" for the root)
+
+    std::function<void(const juce::File&, const juce::String&, bool)> watchTree =
+        [&](const juce::File& dir, const juce::String& relativePath, bool markFiles)
+    {
+        if (relativePath.isNotEmpty() && shouldIgnore(relativePath))
+            return;
+
+        const int wd = inotify_add_watch(fd, dir.getFullPathName().toRawUTF8(), mask);
+        if (wd < 0)
+        {
+            // Out of watches (fs.inotify.max_user_watches): let the snapshot scan everything
+            markEverythingDirty();
+            return;
+        }
+
+        directories[wd] = relativePath;
+
+        for (const auto& entry : juce::RangedDirectoryIterator(dir, false, "*", juce::File::findFilesAndDirectories))
+        {
+            const juce::File child = entry.getFile();
+            const juce::String childPath = relativePath.isEmpty() ? child.getFileName()
+                                                                 : relativePath + "/" + child.getFileName();
+
+            if (entry.isDirectory())
+                watchTree(child, childPath, markFiles);
+            else if (markFiles)
+                markDirty(childPath);
+        }
+    };
+
+    watchTree(projectDirectory, {}, false);
+    usingNativeEvents = true;
+
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (!threadShouldExit())
+    {
+        pollfd pfd { fd, POLLIN, 0 };
+        const int ready = ::poll(&pfd, 1, 100);
+
+        if (ready > 0)
+        {
+            ssize_t length;
+            while ((length = ::read(fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* p = buffer; p < buffer + length;)
+                {
+                    const auto* event = reinterpret_cast<const inotify_event*>(p);
+                    p += sizeof(inotify_event) + event->len;
+
+                    if ((event->mask & IN_Q_OVERFLOW) != 0)
+                    {
+                        markEverythingDirty();
+                        continue;
+                    }
+
+                    auto dir = directories.find(event->wd);
+                    if (dir == directories.end())
+                        continue;
+
+                    if ((event->mask & IN_IGNORED) != 0)
+                    {
+                        directories.erase(dir);
+                        continue;
+                    }
+
+                    if (event->len == 0)
+                        continue;
+
+                    const juce::String name = juce::String::fromUTF8(event->name);
+                    const juce::String path = dir->second.isEmpty() ? name : dir->second + "/" + name;
+
+                    if ((event->mask & IN_ISDIR) != 0)
+                    {
+                        // A new or moved-in directory: watch it, and everything already in it is new
+                        if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+                            watchTree(projectDirectory.getChildFile(path), path, true);
+                        else if ((event->mask & IN_MOVED_FROM) != 0)
+                            markDirty(path);
+                    }
+                    else
+                    {
+                        markDirty(path);
+                    }
+                }
+            }
+        }
+        else if (ready < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        deliverIfQuiet();
+    }
+
+    ::close(fd);
+    return true;
+}
+#else
+bool ProjectWatcher::runNativeEvents()
+{
+    return false;
+}
+#endif
+
+void ProjectWatcher::runPolling()
+{
+    struct Stamp
+    {
+        juce::int64 size;
+        juce::int64 modified;
+        bool operator!= (const Stamp& other) const { return size != other.size || modified != other.modified; }
+    };
+
+    std::function<void(const juce::File&, const juce::String&, std::map<juce::String, Stamp>&)> scanTree =
+        [&](const juce::File& dir, const juce::String& relativePath, std::map<juce::String, Stamp>& stamps)
+    {
+        for (const auto& entry : juce::RangedDirectoryIterator(dir, false, "*", juce::File::findFilesAndDirectories))
+        {
+            if (threadShouldExit())
+                return;
+
+            const juce::String path = relativePath.isEmpty() ? entry.getFile().getFileName()
+                                                            : relativePath + "/" + entry.getFile().getFileName();
+
+            // Skipping whole ignored directories keeps us out of .git entirely
+            if (shouldIgnore(path))
+                continue;
+
+            if (entry.isDirectory())
+                scanTree(entry.getFile(), path, stamps);
+            else
+                stamps[path] = { entry.getFileSize(), entry.getModificationTime().toMilliseconds() };
+        }
+    };
+
+    auto scan = [&]
+    {
+        std::map<juce::String, Stamp> stamps;
+        scanTree(projectDirectory, {}, stamps);
+        return stamps;
+    };
+
+    std::map<juce::String, Stamp> previous = scan();
+
+    while (!threadShouldExit())
+    {
+        // Short waits so the debounce still fires on time between scans
+        for (int waited = 0; waited < pollingIntervalMs && !threadShouldExit(); waited += 100)
+        {
+            wait(100);
+            deliverIfQuiet();
+        }
+
+        std::map<juce::String, Stamp> current = scan();
+
+        for (const auto& file : current)
+        {
+            auto old = previous.find(file.first);
+            if (old == previous.end() || old->second != file.second)
+                markDirty(file.first);
+        }
+
+        for (const auto& file : previous)
+            if (current.find(file.first) == current.end())
+                markDirty(file.first);
+
+        previous = std::move(current);
+    }
+}
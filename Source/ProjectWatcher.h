@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    ProjectWatcher.h
+    Tracks which files in the project directory changed, so snapshots only
+    touch those instead of rescanning the whole tree.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <set>
+
+//==============================================================================
+/**
+    Watches a project directory on a background thread and collects the paths
+    (relative to the project, '/' separated) that were written, created,
+    moved or deleted.
+
+    On Linux this uses inotify. Elsewhere it falls back to comparing file sizes
+    and modification times every few seconds, which still only stats the tree
+    and never asks git to rescan it.
+
+    Saves arrive in bursts (DAWs write temp files, rename, then touch sidecar
+    files), so the callback only fires once nothing has changed for
+    quietPeriodMs. It is called on the watcher thread.
+*/
+class ProjectWatcher : private juce::Thread
+{
+public:
+    /** dirtyPaths is empty if the watcher lost track (e.g. an event queue overflow)
+        and the whole tree should be treated as changed.
+    */
+    using ChangeCallback = std::function<void(const juce::StringArray& dirtyPaths)>;
+
+    ProjectWatcher(const juce::File& projectDirectory, ChangeCallback callback, int quietPeriodMs = 1500);
+    ~ProjectWatcher() override;
+
+    bool isUsingNativeEvents() const { return usingNativeEvents; }
+
+    /** True for paths we never snapshot: git's own files, the DAW's backups and temp files. */
+    static bool shouldIgnore(const juce::String& relativePath);
+
+private:
+    void run() override;
+    bool runNativeEvents();
+    void runPolling();
+
+    void markDirty(const juce::String& relativePath);
+    void markEverythingDirty();
+    void deliverIfQuiet();
+
+    juce::File projectDirectory;
+    ChangeCallback callback;
+    const int quietPeriodMs;
+    bool usingNativeEvents = false;
+
+    std::set<juce::String> dirtyPaths;
+    bool everythingDirty = false;
+    juce::uint32 lastChangeTime = 0;
+
+    static constexpr int pollingIntervalMs = 2000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectWatcher)
+};
@@ -0,0 +1,688 @@
+/*
+  ==============================================================================
+
+    RepositoryBackup.cpp
+
+  ==============================================================================
+*/
+
+#include "RepositoryBackup.h"
+#include <map>
+#include <vector>
+
+namespace
+{
+    // "oid refname" lines, as for-each-ref prints them
+    std::vector<std::pair<juce::String, juce::String>> parseRefs(const std::string& output)
+    {
+        std::vector<std::pair<juce::String, juce::String>> refs;
+        juce::StringArray lines;
+        lines.addLines(juce::String(output));
+
+        for (const auto& line : lines)
+            if (line.containsChar(' '))
+                refs.emplace_back(line.upToFirstOccurrenceOf(" ", false, false), line.fromFirstOccurrenceOf(" ", false, false).trim());
+
+        return refs;
+    }
+
+    double millisecondsSince(juce::int64 startTicks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1000.0;
+    }
+
+    // Filesystems with coarse timestamps (FAT keeps two seconds) can date a chunk a little early
+    constexpr juce::int64 timestampSlackMs = 5000;
+
+    const juce::String progressRefPrefix = "refs/snaptrack-backup/";
+}
+
+//==============================================================================
+std::unique_ptr<juce::XmlElement> RepositoryBackup::Settings::toXml() const
+{
+    auto xml = std::make_unique<juce::XmlElement>("Backup");
+    xml->setAttribute("mirror", mirror.getFullPathName());
+    xml->setAttribute("maxBytesPerSecond", juce::String(maxBytesPerSecond));
+    xml->setAttribute("delayMs", delayMs);
+    xml->setAttribute("commitsPerStep", commitsPerStep);
+    return xml;
+}
+
+RepositoryBackup::Settings RepositoryBackup::Settings::fromXml(const juce::XmlElement& xml)
+{
+    Settings defaults, result;
+    const juce::String mirror = xml.getStringAttribute("mirror");
+    result.mirror = juce::File::isAbsolutePath(mirror) ? juce::File(mirror) : juce::File();
+    result.maxBytesPerSecond = xml.getStringAttribute("maxBytesPerSecond", juce::String(defaults.maxBytesPerSecond)).getLargeIntValue();
+    result.delayMs = xml.getIntAttribute("delayMs", defaults.delayMs);
+    result.commitsPerStep = juce::jmax(1, xml.getIntAttribute("commitsPerStep", defaults.commitsPerStep));
+    return result;
+}
+
+//==============================================================================
+RepositoryBackup::RepositoryBackup(const HostTransportState& transport, WorkerProvider workerProvider, GitRunner gitRunner)
+    : juce::Thread("SnapTrack backup"),
+      transportState(transport),
+      getWorker(std::move(workerProvider)),
+      runGit(std::move(gitRunner))
+{
+    lastChangeTime = juce::Time::getMillisecondCounter();
+}
+
+RepositoryBackup::~RepositoryBackup()
+{
+    // Git is killed through the cancel flag, a copy stops after its block
+    cancelPass = true;
+    signalThreadShouldExit();
+    wakeUp.signal();
+    notify();
+    stopThread(10000);
+}
+
+void RepositoryBackup::start()
+{
+    if (!isThreadRunning())
+        startThread();
+}
+
+void RepositoryBackup::setSettings(const Settings& newSettings)
+{
+    bool mirrorChanged = false;
+
+    {
+        const juce::ScopedLock sl(lock);
+        mirrorChanged = newSettings.mirror != settings.mirror;
+        settings = newSettings;
+
+        if (mirrorChanged)
+        {
+            status = Status();
+            chunksCopiedTime = 0;
+        }
+    }
+
+    if (mirrorChanged)
+    {
+        cancel();
+        forcePass = newSettings.isEnabled();
+        wakeUp.signal();
+    }
+
+    sendChangeMessage();
+}
+
+RepositoryBackup::Settings RepositoryBackup::getSettings() const
+{
+    const juce::ScopedLock sl(lock);
+    return settings;
+}
+
+void RepositoryBackup::noteChange()
+{
+    lastChangeTime = juce::Time::getMillisecondCounter();
+    changePending = true;
+
+    const juce::ScopedLock sl(lock);
+    status.upToDate = false;
+}
+
+void RepositoryBackup::runNow()
+{
+    forcePass = true;
+    wakeUp.signal();
+}
+
+void RepositoryBackup::cancel()
+{
+    cancelPass = true;
+    notify();
+}
+
+RepositoryBackup::Status RepositoryBackup::getStatus() const
+{
+    const juce::ScopedLock sl(lock);
+    return status;
+}
+
+juce::String RepositoryBackup::describe(const Settings& s, const Status& st)
+{
+    if (!s.isEnabled())
+        return {};
+
+    if (st.running)
+    {
+        juce::String text = "Backing up";
+
+        if (st.stepsTotal > 1)
+            text << ", step " << st.stepsDone + 1 << " of " << st.stepsTotal;
+
+        return text + " (" + juce::File::descriptionOfSizeInBytes(st.bytesSent) + ")";
+    }
+
+    if (st.error.isNotEmpty())
+        return "Backup: " + st.error;
+
+    if (st.lastBackupTime == 0)
+        return "Not backed up yet";
+
+    return "Backed up " + GitRepositoryWorker::formatRelativeTime(st.lastBackupTime / 1000, juce::Time::currentTimeMillis() / 1000);
+}
+
+//==============================================================================
+void RepositoryBackup::run()
+{
+    while (!threadShouldExit())
+    {
+        wakeUp.wait(checkIntervalMs);
+
+        if (threadShouldExit())
+            break;
+
+        const Settings passSettings = getSettings();
+        std::shared_ptr<GitRepositoryWorker> worker = getWorker();
+
+        if (worker == nullptr || !passSettings.isEnabled())
+            continue;
+
+        checkRepository(*worker);
+
+        const juce::uint32 now = juce::Time::getMillisecondCounter();
+        const bool due = changePending && now - lastChangeTime.load() >= (juce::uint32) passSettings.delayMs;
+        const bool forced = forcePass.exchange(false);
+
+        if (!forced && (!due || isTransportRunning()))
+            continue;
+
+        runRecordedPass(*worker, passSettings);
+    }
+}
+
+bool RepositoryBackup::backUpNow()
+{
+    const Settings passSettings = getSettings();
+    std::shared_ptr<GitRepositoryWorker> worker = getWorker();
+
+    if (worker == nullptr || !passSettings.isEnabled())
+        return false;
+
+    checkRepository(*worker);
+    return runRecordedPass(*worker, passSettings);
+}
+
+void RepositoryBackup::checkRepository(GitRepositoryWorker& worker)
+{
+    const juce::File commonDirectory = worker.getCommonDirectory();
+    bool switched = false;
+
+    {
+        const juce::ScopedLock sl(lock);
+        switched = commonDirectory != repositoryDirectory;
+    }
+
+    // A project we haven't seen this session may have a pass left over from the last one
+    if (switched)
+    {
+        loadState(commonDirectory);
+        noteChange();
+    }
+}
+
+bool RepositoryBackup::runRecordedPass(GitRepositoryWorker& worker, const Settings& passSettings)
+{
+    changePending = false;
+    cancelPass = false;
+
+    {
+        const juce::ScopedLock sl(lock);
+        status.running = true;
+        status.bytesSent = 0;
+        status.stepsDone = 0;
+        status.stepsTotal = 0;
+        status.error.clear();
+    }
+
+    sendChangeMessage();
+
+    const juce::uint32 start = juce::Time::getMillisecondCounter();
+    const bool succeeded = runPass(worker, passSettings);
+    const bool cancelled = isCancelled();
+
+    {
+        const juce::ScopedLock sl(lock);
+        status.running = false;
+
+        if (succeeded && settings.mirror == passSettings.mirror)
+        {
+            status.lastBackupTime = juce::Time::currentTimeMillis();
+            status.upToDate = !changePending;
+        }
+        else if (cancelled)
+        {
+            status.error = "stopped, carries on next time";
+        }
+    }
+
+    // A mirror that's offline, or a disk that's full, gets tried again after the delay
+    if (!succeeded && !cancelled)
+        noteChange();
+
+    saveState();
+    sendChangeMessage();
+
+    DBG("Backup: " << (succeeded ? "done" : cancelled ? "cancelled" : "failed") << " in "
+        << (juce::Time::getMillisecondCounter() - start) << " ms");
+
+    return succeeded;
+}
+
+bool RepositoryBackup::runPass(GitRepositoryWorker& worker, const Settings& passSettings)
+{
+    if (!prepareMirror(passSettings))
+        return false;
+
+    // Chunks first: a snapshot in the mirror must never point at audio it can't rebuild
+    if (!copyChunks(worker.getCommonDirectory(), passSettings))
+        return false;
+
+    return pushHistory(worker, passSettings);
+}
+
+bool RepositoryBackup::prepareMirror(const Settings& passSettings)
+{
+    const juce::File& mirror = passSettings.mirror;
+
+    if (mirror.getChildFile("HEAD").existsAsFile() && mirror.getChildFile("objects").isDirectory())
+        return true;
+
+    // A share that isn't mounted: don't make its mount point into a repository
+    if (!mirror.getParentDirectory().isDirectory())
+    {
+        fail(mirror.getParentDirectory().getFullPathName() + " isn't available");
+        return false;
+    }
+
+    if (mirror.exists() && (!mirror.isDirectory() || mirror.getNumberOfChildFiles(juce::File::findFilesAndDirectories) > 0))
+    {
+        fail(mirror.getFullPathName() + " isn't a git repository");
+        return false;
+    }
+
+    if (!runGit({ "init", "--bare", "--quiet", mirror.getFullPathName() }, &cancelPass, gitTimeoutMs).succeeded())
+    {
+        fail("couldn't create " + mirror.getFullPathName());
+        return false;
+    }
+
+    // Clones of the mirror check out the branch the project is on
+    const ProcessResult head = runGit({ "symbolic-ref", "-q", "HEAD" }, &cancelPass, gitTimeoutMs);
+
+    if (head.succeeded())
+        runGit({ "--git-dir=" + mirror.getFullPathName(), "symbolic-ref", "HEAD", juce::String(head.output).trim() }, &cancelPass, gitTimeoutMs);
+
+    return true;
+}
+
+bool RepositoryBackup::copyChunks(const juce::File& commonDirectory, const Settings& passSettings)
+{
+    const juce::File source = commonDirectory.getChildFile("snaptrack").getChildFile("chunks");
+    const juce::File target = passSettings.mirror.getChildFile("snaptrack").getChildFile("chunks");
+
+    if (!source.isDirectory())
+        return true;
+
+    // Chunks never change once written, so those older than the last complete copy are there already,
+    // and the mirror (maybe a share) isn't asked about each one
+    const juce::int64 start = juce::Time::currentTimeMillis();
+    juce::int64 copiedBefore = 0;
+
+    {
+        const juce::ScopedLock sl(lock);
+        copiedBefore = chunksCopiedTime - timestampSlackMs;
+    }
+
+    for (const auto& entry : juce::RangedDirectoryIterator(source, true, "*", juce::File::findFiles))
+    {
+        if (isCancelled())
+            return false;
+
+        const juce::File& file = entry.getFile();
+
+        // Still being written by AssetStore
+        if (file.getFileExtension() == ".tmp" || entry.getModificationTime().toMilliseconds() < copiedBefore)
+            continue;
+
+        const juce::File copy = target.getChildFile(file.getRelativePathFrom(source));
+
+        if (copy.existsAsFile() && copy.getSize() == file.getSize())
+            continue;
+
+        if (!copyFile(file, copy, passSettings))
+            return false;
+    }
+
+    // Unless the mirror was changed under us, in which case this copy counts for nothing
+    const juce::ScopedLock sl(lock);
+
+    if (settings.mirror == passSettings.mirror)
+        chunksCopiedTime = start;
+
+    return true;
+}
+
+bool RepositoryBackup::copyFile(const juce::File& source, const juce::File& target, const Settings& passSettings)
+{
+    // The copy is made under another name and renamed when it's complete, so a chunk in the
+    // mirror is always whole. An interrupted copy carries on from where it got to.
+    const juce::File partial = target.getSiblingFile(target.getFileName() + ".partial");
+
+    if (target.getParentDirectory().createDirectory().failed())
+    {
+        fail("couldn't write to " + passSettings.mirror.getFullPathName());
+        return false;
+    }
+
+    {
+        juce::FileInputStream in(source);
+
+        if (!in.openedOk())
+        {
+            fail("couldn't read " + source.getFullPathName());
+            return false;
+        }
+
+        juce::int64 done = partial.existsAsFile() ? partial.getSize() : 0;
+
+        if (done > in.getTotalLength())
+        {
+            partial.deleteFile();
+            done = 0;
+        }
+
+        juce::FileOutputStream out(partial);    // appends to what is there
+
+        if (!out.openedOk() || !in.setPosition(done))
+        {
+            fail("couldn't write to " + passSettings.mirror.getFullPathName());
+            return false;
+        }
+
+        std::vector<char> block((size_t) copyBlockSize);
+        const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+        juce::int64 copied = 0;
+
+        while (!in.isExhausted())
+        {
+            const int numRead = in.read(block.data(), (int) block.size());
+
+            if (numRead <= 0)
+                break;
+
+            if (!out.write(block.data(), (size_t) numRead))
+            {
+                fail("couldn't write to " + passSettings.mirror.getFullPathName());
+                return false;
+            }
+
+            copied += numRead;
+
+            {
+                const juce::ScopedLock sl(lock);
+                status.bytesSent += numRead;
+            }
+
+            if (!pace(copied, millisecondsSince(startTicks), passSettings))
+                return false;
+        }
+
+        out.flush();
+
+        if (out.getStatus().failed())
+        {
+            fail("couldn't write to " + passSettings.mirror.getFullPathName());
+            return false;
+        }
+    }
+
+    if (!partial.moveFileTo(target))
+    {
+        fail("couldn't write to " + passSettings.mirror.getFullPathName());
+        return false;
+    }
+
+    return true;
+}
+
+bool RepositoryBackup::pushHistory(GitRepositoryWorker& worker, const Settings& passSettings)
+{
+    const juce::String mirrorPath = passSettings.mirror.getFullPathName();
+
+    const ProcessResult localRefs = runGit({ "for-each-ref", "--format=%(objectname) %(refname)", "refs/heads", "refs/tags", "refs/notes" },
+                                           &cancelPass, gitTimeoutMs);
+    const ProcessResult mirrorRefs = runGit({ "--git-dir=" + mirrorPath, "for-each-ref", "--format=%(objectname) %(refname)" },
+                                            &cancelPass, gitTimeoutMs);
+
+    if (!localRefs.succeeded() || !mirrorRefs.succeeded())
+    {
+        fail("couldn't read the branches of " + (localRefs.succeeded() ? mirrorPath : juce::String("the project")));
+        return false;
+    }
+
+    // What the mirror has and we have too is what the walks below stop at. Git negotiates the same
+    // thing on every push, so only objects the mirror lacks are ever sent.
+    std::map<juce::String, juce::String> inMirror;
+    juce::StringArray haves, progressRefs;
+
+    for (const auto& [oid, ref] : parseRefs(mirrorRefs.output))
+    {
+        inMirror[ref] = oid;
+
+        if (ref.startsWith(progressRefPrefix))
+            progressRefs.add(ref);
+
+        juce::String type;
+        std::string content;
+
+        if (worker.readObject(oid, type, content))
+            haves.addIfNotAlreadyThere(oid);
+    }
+
+    struct Step
+    {
+        juce::String oid;
+        juce::String progressRef;
+    };
+
+    std::vector<Step> steps;
+    juce::StringArray tips;
+
+    for (const auto& [oid, ref] : parseRefs(localRefs.output))
+    {
+        if (inMirror.count(ref) > 0 && inMirror[ref] == oid)
+            continue;
+
+        tips.add(oid);
+
+        // Along first parents, each step is a descendant of the last, and brings what it merged
+        juce::StringArray walk { "rev-list", "--reverse", "--first-parent", oid, "--not" };
+        walk.addArray(haves);
+        const ProcessResult commits = runGit(walk, &cancelPass, gitTimeoutMs);
+
+        if (!commits.succeeded())
+        {
+            fail("couldn't read the history of " + ref);
+            return false;
+        }
+
+        juce::StringArray oids;
+        oids.addTokens(juce::String(commits.output), "\n", "");
+        oids.trim();
+        oids.removeEmptyStrings();
+
+        // The last commit goes with the final push
+        const juce::String progressRef = progressRefPrefix + ref.fromFirstOccurrenceOf("refs/", false, false);
+
+        for (int i = passSettings.commitsPerStep - 1; i < oids.size() - 1; i += passSettings.commitsPerStep)
+            steps.push_back({ oids[i], progressRef });
+    }
+
+    if (tips.isEmpty() && progressRefs.isEmpty())
+        return true;
+
+    {
+        const juce::ScopedLock sl(lock);
+        status.stepsTotal = (int) steps.size() + 1;
+    }
+
+    sendChangeMessage();
+
+    // How much a push will send, for pacing; git before 2.31 can't say, and its steps go unpaced
+    auto measure = [this, &haves](const juce::StringArray& oids) -> juce::int64
+    {
+        juce::StringArray usage { "rev-list", "--objects", "--disk-usage" };
+        usage.addArray(oids);
+        usage.add("--not");
+        usage.addArray(haves);
+
+        const ProcessResult size = runGit(usage, &cancelPass, gitTimeoutMs);
+        return size.succeeded() ? juce::String(size.output).trim().getLargeIntValue() : 0;
+    };
+
+    auto push = [this, &mirrorPath, &passSettings](const juce::StringArray& refspecs, juce::int64 bytes)
+    {
+        juce::StringArray arguments { "push", "--quiet", "--no-verify", "--force", mirrorPath };
+        arguments.addArray(refspecs);
+
+        const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+        const ProcessResult result = runGit(arguments, &cancelPass, gitTimeoutMs);
+
+        if (!result.succeeded())
+        {
+            fail("couldn't push to " + mirrorPath);
+            return false;
+        }
+
+        {
+            const juce::ScopedLock sl(lock);
+            status.bytesSent += bytes;
+            ++status.stepsDone;
+        }
+
+        sendChangeMessage();
+        return pace(bytes, millisecondsSince(startTicks), passSettings);
+    };
+
+    for (const auto& step : steps)
+    {
+        if (!push({ step.oid + ":" + step.progressRef }, measure({ step.oid })))
+            return false;
+
+        haves.add(step.oid);
+        progressRefs.addIfNotAlreadyThere(step.progressRef);
+    }
+
+    // Every branch, tag and note where it is here, and the progress refs gone
+    juce::StringArray refspecs { "refs/heads/*:refs/heads/*", "refs/tags/*:refs/tags/*", "refs/notes/*:refs/notes/*" };
+
+    for (const auto& ref : progressRefs)
+        refspecs.add(":" + ref);
+
+    return push(refspecs, tips.isEmpty() ? 0 : measure(tips));
+}
+
+//==============================================================================
+bool RepositoryBackup::pace(juce::int64 bytes, double elapsedMs, const Settings& passSettings)
+{
+    const double budgetMs = passSettings.maxBytesPerSecond > 0 ? (double) bytes * 1000.0 / (double) passSettings.maxBytesPerSecond : 0.0;
+    const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+
+    for (;;)
+    {
+        if (isCancelled())
+            return false;
+
+        if (elapsedMs + millisecondsSince(startTicks) >= budgetMs && !isTransportRunning())
+            return true;
+
+        wait(checkIntervalMs);
+    }
+}
+
+bool RepositoryBackup::isTransportRunning() const
+{
+    // Same rule as the snapshot scheduler: a host that stopped calling us has stopped playing
+    const juce::uint32 now = juce::Time::getMillisecondCounter();
+    const bool transportFresh = now - transportState.lastBlockTime.load(std::memory_order_relaxed) <= (juce::uint32) SnapshotScheduler::staleStateMs;
+
+    return transportFresh && (transportState.playing.load(std::memory_order_relaxed)
+                              || transportState.recording.load(std::memory_order_relaxed));
+}
+
+bool RepositoryBackup::isCancelled() const
+{
+    return cancelPass.load() || threadShouldExit();
+}
+
+void RepositoryBackup::fail(const juce::String& error)
+{
+    // A cancelled git call fails too, but that isn't worth reporting
+    if (isCancelled())
+        return;
+
+    const juce::ScopedLock sl(lock);
+    status.error = error;
+}
+
+//==============================================================================
+void RepositoryBackup::loadState(const juce::File& commonDirectory)
+{
+    juce::StringArray lines;
+    lines.addLines(commonDirectory.getChildFile("snaptrack").getChildFile("backup").loadFileAsString());
+
+    const juce::ScopedLock sl(lock);
+    repositoryDirectory = commonDirectory;
+    status = Status();
+    chunksCopiedTime = 0;
+    juce::String mirror;
+
+    // One "name value" pair per line
+    for (const auto& line : lines)
+    {
+        const juce::String name = line.upToFirstOccurrenceOf(" ", false, false);
+        const juce::String value = line.fromFirstOccurrenceOf(" ", false, false);
+
+        if (name == "mirror")
+            mirror = value;
+        else if (name == "lastBackup")
+            status.lastBackupTime = value.getLargeIntValue();
+        else if (name == "chunksCopied")
+            chunksCopiedTime = value.getLargeIntValue();
+    }
+
+    // What was copied where says nothing about another mirror
+    if (mirror != settings.mirror.getFullPathName())
+    {
+        status.lastBackupTime = 0;
+        chunksCopiedTime = 0;
+    }
+}
+
+void RepositoryBackup::saveState()
+{
+    juce::String text;
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (repositoryDirectory == juce::File())
+            return;
+
+        file = repositoryDirectory.getChildFile("snaptrack").getChildFile("backup");
+        text << "mirror " << settings.mirror.getFullPathName() << "\n"
+             << "lastBackup " << status.lastBackupTime << "\n"
+             << "chunksCopied " << chunksCopiedTime << "\n";
+    }
+
+    file.getParentDirectory().createDirectory();
+    file.replaceWithText(text);
+}
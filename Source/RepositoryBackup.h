@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    RepositoryBackup.h
+    Copies new snapshots to a bare mirror repository on another disk or a
+    mounted share, a step at a time in the background.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include "ProcessRunner.h"
+#include "SnapshotScheduler.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+//==============================================================================
+/**
+    The history lives in the project's own .git, so a disk that dies takes the
+    set and every snapshot of it together. A backup mirror is a bare
+    repository somewhere else that is kept up to date on its own.
+
+    A while after the repository changes (settings.delayMs), a pass runs on
+    the backup thread. It doesn't use the job queue, so it never holds up a
+    snapshot. Only reads touch the project. A pass has two parts:
+
+    - Chunks of large audio (see AssetStore) live outside git's objects, so
+      the chunk files the mirror hasn't got are copied first, into the
+      mirror's snaptrack/chunks. A copy in progress is kept as a .partial
+      file and carries on from where it stopped.
+    - Then git pushes the history. A branch many snapshots ahead of the
+      mirror goes over in steps of commitsPerStep commits along its first
+      parents. Each step moves a progress ref under refs/snaptrack-backup/
+      in the mirror, and git only sends objects the mirror doesn't have.
+      An interrupted pass loses at most the step it was on. The last push
+      moves the mirror's branches, tags and notes (previews included) and
+      removes the progress refs.
+
+    Chunks go before the commits that point to them, so the mirror never
+    has a snapshot it can't rebuild. Branches deleted here are kept in the
+    mirror; it's a backup, not a copy.
+
+    Throttling: git and the copies run at idle CPU and I/O priority. Each
+    step and each copied block waits long enough to keep the average under
+    maxBytesPerSecond. The work pauses while the host's transport runs.
+
+    Status is broadcast as a change message. The time of the last complete
+    pass is kept in .git/snaptrack/backup.
+*/
+class RepositoryBackup : public juce::ChangeBroadcaster,
+                         private juce::Thread
+{
+public:
+    struct Settings
+    {
+        juce::File mirror;                                  // a bare repository, created if it doesn't exist; none turns backups off
+        juce::int64 maxBytesPerSecond = 16 * 1024 * 1024;   // 0 for no limit
+        int delayMs = 30 * 1000;                            // after a change, before a pass starts
+        int commitsPerStep = 10;                            // snapshots per push while catching up
+
+        bool isEnabled() const { return mirror != juce::File(); }
+
+        std::unique_ptr<juce::XmlElement> toXml() const;
+        static Settings fromXml(const juce::XmlElement& xml);
+    };
+
+    struct Status
+    {
+        bool running = false;
+        bool upToDate = false;          // the last pass finished and nothing has changed since
+        juce::int64 lastBackupTime = 0; // ms since epoch of the last complete pass, 0 if never
+        juce::int64 bytesSent = 0;      // by the pass running, or the last one
+        int stepsDone = 0;
+        int stepsTotal = 0;
+        juce::String error;             // why the last pass didn't finish, empty if it did
+    };
+
+    using WorkerProvider = std::function<std::shared_ptr<GitRepositoryWorker>()>;
+    using GitRunner = std::function<ProcessResult(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)>;
+
+    /** getWorker returns the current project's worker (or nullptr), runGit runs git in its
+        working tree at low priority. The thread starts with the first call to start().
+    */
+    RepositoryBackup(const HostTransportState& transport, WorkerProvider getWorker, GitRunner runGit);
+    ~RepositoryBackup() override;
+
+    void start();
+
+    /** A different mirror stops the pass that's running and starts over against the new one. */
+    void setSettings(const Settings& newSettings);
+    Settings getSettings() const;
+
+    /** The repository moved on: a pass starts settings.delayMs from now. */
+    void noteChange();
+
+    /** Starts a pass now. */
+    void runNow();
+
+    /** Stops the pass that is running. The next one carries on where it stopped. */
+    void cancel();
+
+    /** Runs a pass on the calling thread, as the backup thread would, and returns true if it
+        finished. For tools and tests that don't start() the thread; cancel() works the same.
+    */
+    bool backUpNow();
+
+    Status getStatus() const;
+
+    /** "Backed up 5 min ago" for a status line. */
+    static juce::String describe(const Settings& settings, const Status& status);
+
+    static constexpr int checkIntervalMs = 250;
+    static constexpr int gitTimeoutMs = 60 * 60 * 1000;
+    static constexpr int copyBlockSize = 1024 * 1024;
+
+private:
+    void run() override;
+    void checkRepository(GitRepositoryWorker& worker);
+    bool runRecordedPass(GitRepositoryWorker& worker, const Settings& passSettings);
+    bool runPass(GitRepositoryWorker& worker, const Settings& passSettings);
+    bool prepareMirror(const Settings& passSettings);
+    bool copyChunks(const juce::File& commonDirectory, const Settings& passSettings);
+    bool copyFile(const juce::File& source, const juce::File& target, const Settings& passSettings);
+    bool pushHistory(GitRepositoryWorker& worker, const Settings& passSettings);
+
+    // Waits until bytes taking elapsedMs is within the budget and the transport has stopped.
+    // Returns false if the pass was cancelled meanwhile.
+    bool pace(juce::int64 bytes, double elapsedMs, const Settings& passSettings);
+    bool isTransportRunning() const;
+    bool isCancelled() const;
+
+    void fail(const juce::String& error);
+    void loadState(const juce::File& commonDirectory);
+    void saveState();
+
+    const HostTransportState& transportState;
+    WorkerProvider getWorker;
+    GitRunner runGit;
+
+    mutable juce::CriticalSection lock;
+    Settings settings;
+    Status status;
+    juce::File repositoryDirectory;     // the common directory the state belongs to
+    juce::int64 chunksCopiedTime = 0;   // when the last complete chunk copy to this mirror started
+
+    std::atomic<bool> cancelPass { false };
+    std::atomic<bool> forcePass { false };
+    std::atomic<bool> changePending { true };   // a pass is owed, also for whatever an earlier session left undone
+    std::atomic<juce::uint32> lastChangeTime { 0 };
+    juce::WaitableEvent wakeUp;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RepositoryBackup)
+};
@@ -0,0 +1,595 @@
+/*
+  ==============================================================================
+
+    RepositoryMaintenance.cpp
+
+  ==============================================================================
+*/
+
+#include "RepositoryMaintenance.h"
+
+namespace
+{
+    juce::int64 countPackedObjects(const juce::File& indexFile)
+    {
+        juce::FileInputStream in(indexFile);
+        if (!in.openedOk())
+            return 0;
+
+        // Version 2 indexes start with "\377tOc" and a version number, version 1 with the fanout
+        const juce::uint32 magic = (juce::uint32) in.readIntBigEndian();
+        const juce::int64 fanout = magic == 0xff744f63 ? 8 : 0;
+
+        // The last fanout entry counts every object in the pack
+        if (!in.setPosition(fanout + 255 * 4))
+            return 0;
+
+        return (juce::int64) (juce::uint32) in.readIntBigEndian();
+    }
+
+    bool isTemporaryPackFile(const juce::String& name)
+    {
+        return name.startsWith("tmp_") || name.startsWith(".tmp-");
+    }
+}
+
+//==============================================================================
+std::unique_ptr<juce::XmlElement> RepositoryMaintenance::Budget::toXml() const
+{
+    auto xml = std::make_unique<juce::XmlElement>("Maintenance");
+    xml->setAttribute("enabled", enabled);
+    xml->setAttribute("idleDelayMs", idleDelayMs);
+    xml->setAttribute("minIntervalMs", minIntervalMs);
+    xml->setAttribute("maxPassMs", maxPassMs);
+    xml->setAttribute("looseObjectLimit", looseObjectLimit);
+    xml->setAttribute("packLimit", packLimit);
+    xml->setAttribute("maxConsolidateBytes", juce::String(maxConsolidateBytes));
+    xml->setAttribute("expireIntervalMs", juce::String(expireIntervalMs));
+    xml->setAttribute("expiry", expiry);
+    return xml;
+}
+
+RepositoryMaintenance::Budget RepositoryMaintenance::Budget::fromXml(const juce::XmlElement& xml)
+{
+    Budget defaults, result;
+    result.enabled = xml.getBoolAttribute("enabled", defaults.enabled);
+    result.idleDelayMs = xml.getIntAttribute("idleDelayMs", defaults.idleDelayMs);
+    result.minIntervalMs = xml.getIntAttribute("minIntervalMs", defaults.minIntervalMs);
+    result.maxPassMs = xml.getIntAttribute("maxPassMs", defaults.maxPassMs);
+    result.looseObjectLimit = xml.getIntAttribute("looseObjectLimit", defaults.looseObjectLimit);
+    result.packLimit = xml.getIntAttribute("packLimit", defaults.packLimit);
+    result.maxConsolidateBytes = xml.getStringAttribute("maxConsolidateBytes", juce::String(defaults.maxConsolidateBytes)).getLargeIntValue();
+    result.expireIntervalMs = xml.getStringAttribute("expireIntervalMs", juce::String(defaults.expireIntervalMs)).getLargeIntValue();
+    result.expiry = xml.getStringAttribute("expiry", defaults.expiry);
+    return result;
+}
+
+//==============================================================================
+RepositoryMaintenance::RepositoryMaintenance(GitJobQueue& jobQueue, const SnapshotScheduler& scheduler, const HostTransportState& transport,
+                                             WorkerProvider workerProvider, GitRunner gitRunner)
+    : juce::Thread("SnapTrack maintenance"),
+      queue(jobQueue),
+      snapshotScheduler(scheduler),
+      transportState(transport),
+      getWorker(std::move(workerProvider)),
+      runGit(std::move(gitRunner))
+{
+    lastActivityTime = juce::Time::getMillisecondCounter();
+}
+
+RepositoryMaintenance::~RepositoryMaintenance()
+{
+    *alive = false;
+    signalThreadShouldExit();
+    wakeUp.signal();
+    stopThread(5000);
+
+    {
+        const juce::ScopedLock sl(lock);
+        if (passRunning)
+            queue.cancel(passJob);
+    }
+
+    // A pass that was already running has been told to stop; wait until it has
+    const juce::ScopedLock pl(passLock);
+    shuttingDown = true;
+}
+
+void RepositoryMaintenance::start()
+{
+    if (!isThreadRunning())
+        startThread();
+}
+
+void RepositoryMaintenance::setBudget(const Budget& newBudget)
+{
+    {
+        const juce::ScopedLock sl(lock);
+        budget = newBudget;
+    }
+
+    wakeUp.signal();
+}
+
+RepositoryMaintenance::Budget RepositoryMaintenance::getBudget() const
+{
+    const juce::ScopedLock sl(lock);
+    return budget;
+}
+
+void RepositoryMaintenance::noteUserActivity()
+{
+    lastActivityTime = juce::Time::getMillisecondCounter();
+
+    const juce::ScopedLock sl(lock);
+    if (passRunning)
+        queue.cancel(passJob);
+}
+
+void RepositoryMaintenance::runNow()
+{
+    forcePass = true;
+    start();
+    wakeUp.signal();
+}
+
+RepositoryMaintenance::Metrics RepositoryMaintenance::getMetrics() const
+{
+    const juce::ScopedLock sl(lock);
+    return metrics;
+}
+
+RepositoryMaintenance::Statistics RepositoryMaintenance::getStatistics() const
+{
+    const juce::ScopedLock sl(lock);
+    return statistics;
+}
+
+juce::String RepositoryMaintenance::describe(const Metrics& m)
+{
+    if (!m.valid)
+        return {};
+
+    return juce::File::descriptionOfSizeInBytes(m.getTotalBytes()) + ", " + juce::String(m.looseObjects) + " loose";
+}
+
+juce::String RepositoryMaintenance::describeInDetail(const Metrics& m)
+{
+    if (!m.valid)
+        return {};
+
+    const juce::int64 now = juce::Time::currentTimeMillis();
+
+    juce::String text;
+    text << "Repository: " << juce::File::descriptionOfSizeInBytes(m.getTotalBytes()) << "\n"
+         << m.packs << (m.packs == 1 ? " pack, " : " packs, ") << m.packedObjects << " objects ("
+         << juce::File::descriptionOfSizeInBytes(m.packedBytes) << ")\n"
+         << m.looseObjects << " loose objects (" << juce::File::descriptionOfSizeInBytes(m.looseBytes) << ")\n"
+         << "Commit-graph: " << (m.hasCommitGraph ? "written" : "not written yet") << "\n"
+         << "Last tidied up: " << (m.lastPassTime == 0 ? juce::String("never")
+                                                       : GitRepositoryWorker::formatRelativeTime(m.lastPassTime / 1000, now / 1000));
+    return text;
+}
+
+RepositoryMaintenance::Metrics RepositoryMaintenance::measure(const juce::File& commonDirectory)
+{
+    Metrics m;
+    const juce::File objects = commonDirectory.getChildFile("objects");
+
+    if (!objects.isDirectory())
+        return m;
+
+    m.valid = true;
+
+    // Loose objects live in one directory per first byte of their id
+    for (const auto& directory : juce::RangedDirectoryIterator(objects, false, "??", juce::File::findDirectories))
+    {
+        if (!directory.getFile().getFileName().containsOnly("0123456789abcdef"))
+            continue;
+
+        for (const auto& entry : juce::RangedDirectoryIterator(directory.getFile(), false, "*", juce::File::findFiles))
+        {
+            ++m.looseObjects;
+            m.looseBytes += entry.getFileSize();
+        }
+    }
+
+    for (const auto& entry : juce::RangedDirectoryIterator(objects.getChildFile("pack"), false, "*", juce::File::findFiles))
+    {
+        const juce::File file = entry.getFile();
+        const juce::String name = file.getFileName();
+
+        if (isTemporaryPackFile(name))
+        {
+            ++m.garbageFiles;
+        }
+        else if (file.hasFileExtension("pack"))
+        {
+            const juce::File index = file.withFileExtension("idx");
+            ++m.packs;
+            m.packedBytes += entry.getFileSize() + index.getSize();
+            m.packedObjects += countPackedObjects(index);
+        }
+    }
+
+    const juce::File info = objects.getChildFile("info");
+    m.hasCommitGraph = info.getChildFile("commit-graph").existsAsFile()
+                    || info.getChildFile("commit-graphs").getChildFile("commit-graph-chain").existsAsFile();
+    return m;
+}
+
+//==============================================================================
+bool RepositoryMaintenance::isQuiet(juce::uint32 now) const
+{
+    const Budget current = getBudget();
+
+    if (now - lastActivityTime.load() < (juce::uint32) current.idleDelayMs)
+        return false;
+
+    return !shouldYield(now) && !queue.isBusy();
+}
+
+bool RepositoryMaintenance::shouldYield(juce::uint32 now) const
+{
+    // Same rule as the snapshot scheduler: a host that stopped calling us has stopped playing
+    const bool transportFresh = now - transportState.lastBlockTime.load(std::memory_order_relaxed) <= (juce::uint32) SnapshotScheduler::staleStateMs;
+    const bool transportRunning = transportFresh && (transportState.playing.load(std::memory_order_relaxed)
+                                                     || transportState.recording.load(std::memory_order_relaxed));
+
+    return transportRunning || queue.getStatus().numPending > 0 || snapshotScheduler.getNumWaiting() > 0;
+}
+
+RepositoryMaintenance::Plan RepositoryMaintenance::makePlan(const Metrics& m, const Budget& passBudget, bool forced) const
+{
+    Plan plan;
+    const juce::int64 now = juce::Time::currentTimeMillis();
+
+    if (!m.valid || (!forced && (!passBudget.enabled || now - m.lastPassTime < (juce::int64) passBudget.minIntervalMs)))
+        return plan;
+
+    plan.removeGarbage = m.garbageFiles > 0;
+    plan.consolidate = m.packs > passBudget.packLimit && m.packedBytes <= passBudget.maxConsolidateBytes;
+
+    // A full repack packs the loose objects too
+    plan.packLoose = !plan.consolidate && m.looseObjects >= (forced ? 1 : passBudget.looseObjectLimit);
+
+    // Every new commit arrives as a loose object, so a changed count means the graph is behind
+    plan.writeCommitGraph = forced || !m.hasCommitGraph || m.looseObjects != looseObjectsAfterPass;
+    plan.expire = forced || now - lastExpireTime >= passBudget.expireIntervalMs;
+    return plan;
+}
+
+//==============================================================================
+void RepositoryMaintenance::run()
+{
+    while (!threadShouldExit())
+    {
+        wakeUp.wait(checkIntervalMs);
+
+        if (threadShouldExit())
+            break;
+
+        const juce::uint32 now = juce::Time::getMillisecondCounter();
+
+        if (passRunning)
+        {
+            if (shouldYield(now))
+            {
+                const juce::ScopedLock sl(lock);
+                queue.cancel(passJob);
+            }
+
+            continue;
+        }
+
+        std::shared_ptr<GitRepositoryWorker> worker = getWorker();
+        if (worker == nullptr)
+            continue;
+
+        const juce::File commonDirectory = worker->getCommonDirectory();
+        bool switched = false;
+
+        {
+            const juce::ScopedLock sl(lock);
+            switched = commonDirectory != repositoryDirectory;
+        }
+
+        // Metrics are measured once per project straight away, then every so often while it's quiet
+        const bool quiet = isQuiet(now);
+
+        if (switched)
+        {
+            loadState(commonDirectory);
+            refreshMetrics(commonDirectory);
+        }
+        else if (quiet && now - lastMetricsTime >= (juce::uint32) metricsIntervalMs)
+        {
+            refreshMetrics(commonDirectory);
+        }
+
+        const bool forced = forcePass.exchange(false);
+        if (!forced && !quiet)
+            continue;
+
+        Plan plan;
+        Budget passBudget;
+
+        {
+            const juce::ScopedLock sl(lock);
+            passBudget = budget;
+            plan = makePlan(metrics, passBudget, forced);
+        }
+
+        if (!plan.isEmpty())
+            submitPass(plan, passBudget);
+    }
+}
+
+void RepositoryMaintenance::submitPass(const Plan& plan, const Budget& passBudget)
+{
+    const juce::ScopedLock sl(lock);
+    passRunning = true;
+
+    std::shared_ptr<bool> stillAlive = alive;
+    passJob = queue.submit("Tidying up the repository", [this, plan, passBudget](GitJobQueue::Context& context)
+    {
+        const juce::ScopedLock pl(passLock);
+
+        GitJobQueue::Result result;
+        result.cancelled = true;
+
+        if (!shuttingDown && !context.shouldCancel())
+            result = runPass(plan, passBudget, context);
+
+        passRunning = false;
+        return result;
+    },
+    [this, stillAlive](const GitJobQueue::Result&)
+    {
+        // Also reached when the pass was cancelled before it started
+        if (*stillAlive)
+        {
+            passRunning = false;
+            sendChangeMessage();
+        }
+    });
+}
+
+GitJobQueue::Result RepositoryMaintenance::runPass(const Plan& plan, const Budget& passBudget, GitJobQueue::Context& context)
+{
+    GitJobQueue::Result result;
+    std::shared_ptr<GitRepositoryWorker> worker = getWorker();
+
+    if (worker == nullptr)
+        return result;
+
+    const juce::File commonDirectory = worker->getCommonDirectory();
+    const juce::File objects = commonDirectory.getChildFile("objects");
+    const juce::uint32 start = juce::Time::getMillisecondCounter();
+
+    const int numSteps = (int) plan.removeGarbage + (int) plan.writeCommitGraph + (int) plan.packLoose
+                       + (int) plan.consolidate + 2 * (int) plan.expire;
+    int stepsDone = 0;
+    int stepsSkipped = 0;
+    bool cancelled = false;
+    bool outOfBudget = false;
+
+    // Returns true if git succeeded. A step that was killed takes its half-written files with it.
+    auto step = [&](const juce::String& detail, const juce::StringArray& arguments, bool interruptible)
+    {
+        const int remainingMs = passBudget.maxPassMs - (int) (juce::Time::getMillisecondCounter() - start);
+
+        if (cancelled || context.shouldCancel())
+        {
+            cancelled = true;
+            return false;
+        }
+
+        if (remainingMs < minStepMs)
+        {
+            ++stepsSkipped;
+            outOfBudget = true;
+            return false;
+        }
+
+        context.setProgress((float) stepsDone / (float) juce::jmax(1, numSteps), detail);
+
+        const juce::int64 stepStart = juce::Time::currentTimeMillis();
+        const juce::Array<juce::File> existingTemporaryFiles = findTemporaryFiles(objects);
+        const ProcessResult step = runGit(arguments, interruptible ? context.getCancelFlag() : nullptr,
+                                          interruptible ? remainingMs : -1);
+
+        if (step.cancelled || step.timedOut)
+        {
+            cancelled = cancelled || step.cancelled;
+            outOfBudget = outOfBudget || step.timedOut;
+            removeNewTemporaryFiles(objects, existingTemporaryFiles, stepStart - 1000);
+        }
+
+        return step.succeeded();
+    };
+
+    if (plan.removeGarbage)
+    {
+        // Anything an hour old is from a git that crashed or was killed, not one still working
+        context.setProgress((float) stepsDone / (float) juce::jmax(1, numSteps), "removing temporary packs");
+        removeTemporaryFiles(objects, juce::Time::currentTimeMillis() - 60 * 60 * 1000);
+        ++stepsDone;
+    }
+
+    if (plan.writeCommitGraph)
+    {
+        // Incremental layers where git has them (2.24 on), one whole file before that
+        if (!step("writing commit-graph", { "commit-graph", "write", "--reachable", "--split", "--no-progress" }, true)
+            && !cancelled && !outOfBudget)
+            step("writing commit-graph", { "commit-graph", "write", "--reachable" }, true);
+
+        ++stepsDone;
+    }
+
+    // No -a: only the loose objects go into a new pack, the existing packs stay as they are.
+    // -n skips update-server-info, nobody fetches from here over dumb http.
+    if (plan.packLoose)
+    {
+        step("packing loose objects", { "repack", "-d", "-l", "-q", "-n" }, true);
+        ++stepsDone;
+    }
+
+    // Like gc: unreachable objects younger than the expiry come out as loose objects instead of being dropped
+    if (plan.consolidate)
+    {
+        step("merging packs", { "repack", "-A", "-d", "-l", "-q", "-n", "--unpack-unreachable=" + passBudget.expiry }, true);
+        ++stepsDone;
+    }
+
+    bool expired = false;
+
+    if (plan.expire)
+    {
+        // reflog expire holds ref locks, so it's never killed halfway; it's quick anyway
+        expired = step("expiring deleted snapshots", { "reflog", "expire", "--expire-unreachable=" + passBudget.expiry, "--all" }, false);
+        ++stepsDone;
+        expired = expired && step("pruning unreachable objects", { "prune", "--expire=" + passBudget.expiry }, true);
+        ++stepsDone;
+    }
+
+    refreshMetrics(commonDirectory);
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        ++statistics.numPasses;
+        statistics.numStepsSkipped += stepsSkipped;
+        statistics.lastPassMs = (double) (juce::Time::getMillisecondCounter() - start);
+
+        if (cancelled || outOfBudget)
+            ++statistics.numInterrupted;
+
+        // A pass the user cut short is tried again at the next pause; one that ran out of
+        // budget waits its turn, or a repository too big for the budget would never rest
+        if (!cancelled)
+        {
+            metrics.lastPassTime = juce::Time::currentTimeMillis();
+            looseObjectsAfterPass = metrics.looseObjects;
+        }
+
+        if (expired)
+            lastExpireTime = juce::Time::currentTimeMillis();
+    }
+
+    saveState();
+
+    DBG("Maintenance: " << numSteps << " steps planned, done in " << (juce::Time::getMillisecondCounter() - start) << " ms"
+        << (cancelled ? ", cancelled" : "") << (outOfBudget ? ", out of budget" : ""));
+
+    result.succeeded = !cancelled && !outOfBudget;
+    result.cancelled = cancelled;
+    return result;
+}
+
+//==============================================================================
+void RepositoryMaintenance::refreshMetrics(const juce::File& commonDirectory)
+{
+    Metrics measured = measure(commonDirectory);
+    lastMetricsTime = juce::Time::getMillisecondCounter();
+
+    {
+        const juce::ScopedLock sl(lock);
+        measured.lastPassTime = metrics.lastPassTime;
+        metrics = measured;
+    }
+
+    sendChangeMessage();
+}
+
+void RepositoryMaintenance::loadState(const juce::File& commonDirectory)
+{
+    juce::StringArray lines;
+    lines.addLines(commonDirectory.getChildFile("snaptrack").getChildFile("maintenance").loadFileAsString());
+
+    const juce::ScopedLock sl(lock);
+    repositoryDirectory = commonDirectory;
+    metrics = Metrics();
+    lastExpireTime = 0;
+    looseObjectsAfterPass = -1;
+
+    // One "name value" pair per line
+    for (const auto& line : lines)
+    {
+        const juce::String name = line.upToFirstOccurrenceOf(" ", false, false);
+        const juce::int64 value = line.fromFirstOccurrenceOf(" ", false, false).getLargeIntValue();
+
+        if (name == "lastPass")
+            metrics.lastPassTime = value;
+        else if (name == "lastExpire")
+            lastExpireTime = value;
+        else if (name == "looseAfterPass")
+            looseObjectsAfterPass = value;
+    }
+}
+
+void RepositoryMaintenance::saveState()
+{
+    juce::String text;
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (repositoryDirectory == juce::File())
+            return;
+
+        file = repositoryDirectory.getChildFile("snaptrack").getChildFile("maintenance");
+        text << "lastPass " << metrics.lastPassTime << "\n"
+             << "lastExpire " << lastExpireTime << "\n"
+             << "looseAfterPass " << looseObjectsAfterPass << "\n";
+    }
+
+    file.getParentDirectory().createDirectory();
+    file.replaceWithText(text);
+}
+
+juce::Array<juce::File> RepositoryMaintenance::findTemporaryFiles(const juce::File& objectsDirectory)
+{
+    juce::Array<juce::File> files;
+
+    auto addIf = [&](const juce::File& directory, std::function<bool(const juce::String&)> matches)
+    {
+        for (const auto& entry : juce::RangedDirectoryIterator(directory, false, "*", juce::File::findFiles))
+            if (matches(entry.getFile().getFileName()))
+                files.add(entry.getFile());
+    };
+
+    const juce::File info = objectsDirectory.getChildFile("info");
+
+    addIf(objectsDirectory.getChildFile("pack"), [](const juce::String& name)
+    {
+        return isTemporaryPackFile(name) || name.endsWith(".lock");
+    });
+
+    addIf(info, [](const juce::String& name) { return name.endsWith(".lock") || name.startsWith("tmp_"); });
+    addIf(info.getChildFile("commit-graphs"), [](const juce::String& name) { return name.endsWith(".lock") || name.startsWith("tmp_"); });
+    return files;
+}
+
+int RepositoryMaintenance::removeTemporaryFiles(const juce::File& objectsDirectory, juce::int64 olderThanMs)
+{
+    int numRemoved = 0;
+
+    for (const auto& file : findTemporaryFiles(objectsDirectory))
+        if (file.getLastModificationTime().toMilliseconds() < olderThanMs && file.deleteFile())
+            ++numRemoved;
+
+    return numRemoved;
+}
+
+int RepositoryMaintenance::removeNewTemporaryFiles(const juce::File& objectsDirectory, const juce::Array<juce::File>& existing, juce::int64 fromMs)
+{
+    int numRemoved = 0;
+
+    for (const auto& file : findTemporaryFiles(objectsDirectory))
+        if (!existing.contains(file) && file.getLastModificationTime().toMilliseconds() >= fromMs && file.deleteFile())
+            ++numRemoved;
+
+    return numRemoved;
+}
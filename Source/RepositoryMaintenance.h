@@ -0,0 +1,187 @@
+/*
+  ==============================================================================
+
+    RepositoryMaintenance.h
+    Tidies the object store while nobody is using it: commit-graph, packing
+    loose objects, expiring what deleted branches left behind.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitJobQueue.h"
+#include "GitRepositoryWorker.h"
+#include "ProcessRunner.h"
+#include "SnapshotScheduler.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+//==============================================================================
+/**
+    The housekeeping "git gc" would do, split into steps small enough to run
+    in the gaps of a session.
+
+    Every snapshot leaves a few loose objects behind and nothing ever packs
+    them, so history walks and checkouts open more and more tiny files. Once
+    the host has been stopped and nobody has touched the repository for
+    idleDelayMs, a pass is queued on the job queue. It writes an incremental
+    commit-graph, packs the loose objects, consolidates packs once there are
+    too many, and expires reflog entries and objects only deleted branches
+    still referred to.
+
+    A pass gives way the moment anything else wants the repository. The
+    transport starting, a job queued behind it, or noteUserActivity() all
+    cancel it. A cancelled or timed-out step leaves behind only what git
+    would after a crash. The temporary packs and lock files that appeared
+    during the step are removed straight away; ones that were already there
+    may belong to a git the user is running, and are only removed once
+    they're an hour old. Steps that hold ref locks aren't
+    interrupted. They take milliseconds.
+
+    The budget (how long to wait, how often to run, how long a pass may take,
+    which thresholds call for which step) can be changed at any time.
+    Metrics of the object store are measured natively on the maintenance
+    thread and broadcast as a change message.
+*/
+class RepositoryMaintenance : public juce::ChangeBroadcaster,
+                              private juce::Thread
+{
+public:
+    struct Budget
+    {
+        bool enabled = true;
+        int idleDelayMs = 60 * 1000;            // quiet time before a pass may start
+        int minIntervalMs = 30 * 60 * 1000;     // between passes
+        int maxPassMs = 2 * 60 * 1000;          // wall time one pass may take, the last step is killed past it
+        int looseObjectLimit = 500;             // pack loose objects once there are this many
+        int packLimit = 20;                     // merge packs once there are more than this
+        juce::int64 maxConsolidateBytes = (juce::int64) 2 * 1024 * 1024 * 1024; // bigger stores keep their packs
+        juce::int64 expireIntervalMs = (juce::int64) 24 * 60 * 60 * 1000;        // between reflog expiry and prune runs
+        juce::String expiry = "2.weeks.ago";    // unreachable snapshots younger than this are kept
+
+        std::unique_ptr<juce::XmlElement> toXml() const;
+        static Budget fromXml(const juce::XmlElement& xml);
+    };
+
+    /** The object store, as "git count-objects -v" would describe it. */
+    struct Metrics
+    {
+        bool valid = false;
+        juce::int64 looseObjects = 0;
+        juce::int64 looseBytes = 0;
+        int packs = 0;
+        juce::int64 packedObjects = 0;
+        juce::int64 packedBytes = 0;
+        int garbageFiles = 0;               // temporary packs of interrupted writes
+        bool hasCommitGraph = false;
+        juce::int64 lastPassTime = 0;       // ms since epoch, 0 if never
+
+        juce::int64 getTotalBytes() const { return looseBytes + packedBytes; }
+    };
+
+    struct Statistics
+    {
+        int numPasses = 0;
+        int numInterrupted = 0;             // cancelled, or ran out of budget
+        int numStepsSkipped = 0;            // not started because the budget was spent
+        double lastPassMs = 0.0;
+    };
+
+    using WorkerProvider = std::function<std::shared_ptr<GitRepositoryWorker>()>;
+    using GitRunner = std::function<ProcessResult(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)>;
+
+    /** getWorker returns the current project's worker (or nullptr), runGit runs git in its
+        working tree. The thread starts with the first call to start().
+    */
+    RepositoryMaintenance(GitJobQueue& jobQueue, const SnapshotScheduler& scheduler, const HostTransportState& transport,
+                          WorkerProvider getWorker, GitRunner runGit);
+    ~RepositoryMaintenance() override;
+
+    void start();
+
+    void setBudget(const Budget& newBudget);
+    Budget getBudget() const;
+
+    /** Restarts the idle countdown and cancels a pass that is running. */
+    void noteUserActivity();
+
+    /** Queues a pass now, whatever the transport and the thresholds say. */
+    void runNow();
+
+    bool isRunning() const { return passRunning.load(); }
+    Metrics getMetrics() const;
+    Statistics getStatistics() const;
+
+    /** "412 MB, 1204 loose" for a status line, and the whole picture for a tooltip. */
+    static juce::String describe(const Metrics& metrics);
+    static juce::String describeInDetail(const Metrics& metrics);
+
+    static Metrics measure(const juce::File& commonDirectory);
+
+    static constexpr int checkIntervalMs = 250;
+    static constexpr int metricsIntervalMs = 60 * 1000;
+    static constexpr int minStepMs = 1000;  // don't start a step with less budget left than this
+
+private:
+    struct Plan
+    {
+        bool removeGarbage = false;
+        bool writeCommitGraph = false;
+        bool packLoose = false;
+        bool consolidate = false;
+        bool expire = false;
+
+        bool isEmpty() const { return !(removeGarbage || writeCommitGraph || packLoose || consolidate || expire); }
+    };
+
+    void run() override;
+    bool isQuiet(juce::uint32 now) const;
+    bool shouldYield(juce::uint32 now) const;
+    Plan makePlan(const Metrics& metrics, const Budget& passBudget, bool forced) const;
+    void submitPass(const Plan& plan, const Budget& passBudget);
+    GitJobQueue::Result runPass(const Plan& plan, const Budget& passBudget, GitJobQueue::Context& context);
+    void refreshMetrics(const juce::File& commonDirectory);
+    void loadState(const juce::File& commonDirectory);
+    void saveState();
+
+    // Temporary packs and lock files git writes while it works
+    static juce::Array<juce::File> findTemporaryFiles(const juce::File& objectsDirectory);
+    // Those of them last modified before olderThanMs
+    static int removeTemporaryFiles(const juce::File& objectsDirectory, juce::int64 olderThanMs);
+    // Those that appeared since existing was listed and were modified from fromMs on: what a step
+    // of ours left behind when it was killed. A git the user runs alongside could leave files too,
+    // but it would have had to start them during our step.
+    static int removeNewTemporaryFiles(const juce::File& objectsDirectory, const juce::Array<juce::File>& existing, juce::int64 fromMs);
+
+    GitJobQueue& queue;
+    const SnapshotScheduler& snapshotScheduler;
+    const HostTransportState& transportState;
+    WorkerProvider getWorker;
+    GitRunner runGit;
+
+    mutable juce::CriticalSection lock;
+    Budget budget;
+    Metrics metrics;
+    Statistics statistics;
+    juce::File repositoryDirectory;     // the common directory the metrics and state belong to
+    juce::int64 lastExpireTime = 0;
+    juce::int64 looseObjectsAfterPass = -1;
+    GitJobQueue::JobId passJob = 0;
+
+    std::atomic<bool> passRunning { false };
+    std::atomic<bool> forcePass { false };
+    std::atomic<juce::uint32> lastActivityTime { 0 };
+    juce::uint32 lastMetricsTime = 0;
+    juce::WaitableEvent wakeUp;
+
+    // Held for the whole of a pass, so the destructor can wait for one to end
+    juce::CriticalSection passLock;
+    bool shuttingDown = false;
+
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RepositoryMaintenance)
+};
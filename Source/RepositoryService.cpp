@@ -0,0 +1,1305 @@
+/*
+  ==============================================================================
+
+    RepositoryService.cpp
+
+  ==============================================================================
+*/
+
+#include "RepositoryService.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+//==============================================================================
+namespace
+{
+    // Services by project, held weakly: the instances using a service own it
+    struct Registry
+    {
+        juce::CriticalSection lock;
+        std::map<juce::String, std::weak_ptr<RepositoryService>> services;
+        std::set<juce::String> stopping;    // services whose destructor is still draining their queues
+        juce::WaitableEvent stopped;
+    };
+
+    Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    constexpr int gitVersionTimeoutMs = 10000;
+
+    // The probe's thread runs code from this binary, which a host unloading us would unmap under
+    // it. So the static's destructor, which runs on unload, waits for a probe still running. All
+    // the thread does after signalling done is return, a window of a few instructions that a
+    // detached thread can't close.
+    struct GitVersionProbe
+    {
+        ~GitVersionProbe()
+        {
+            bool running = false;
+
+            {
+                const juce::ScopedLock sl(lock);
+                running = started;
+            }
+
+            if (running)
+                done.wait(gitVersionTimeoutMs + 1000);
+        }
+
+        juce::CriticalSection lock;
+        bool started = false;
+        bool finished = false;
+        juce::String version;
+        std::vector<std::function<void(const juce::String&)>> waiting;  // getGitVersionAsync callers
+        juce::WaitableEvent done { true };
+    };
+
+    GitVersionProbe& getGitVersionProbe()
+    {
+        static GitVersionProbe probe;
+        return probe;
+    }
+}
+
+//==============================================================================
+RepositoryService::RepositoryService(const juce::File& directory)
+    : projectDirectory(directory), key(makeKey(directory))
+{
+}
+
+RepositoryService::~RepositoryService()
+{
+    // Until the queues are drained, acquire() waits rather than start a second service on the project
+    Registry& registry = getRegistry();
+
+    {
+        const juce::ScopedLock sl(registry.lock);
+        registry.stopping.insert(key);
+    }
+
+    // A watcher thread mid-callback would queue a snapshot on a queue that's going away
+    projectWatcher = nullptr;
+
+    // Running jobs reach the scheduler, maintenance, backup and the other queues through this,
+    // and those are destroyed before the queues would be: every job ends here. All three are
+    // cancelled first, so none waits for another's slow job to notice.
+    for (GitJobQueue* queue : { &jobQueue, &queryQueue, &analysisQueue })
+        queue->cancelAll();
+
+    for (GitJobQueue* queue : { &jobQueue, &queryQueue, &analysisQueue })
+        queue->stop();
+
+    {
+        const juce::ScopedLock sl(registry.lock);
+        auto found = registry.services.find(key);
+
+        if (found != registry.services.end() && found->second.expired())
+            registry.services.erase(found);
+
+        registry.stopping.erase(key);
+    }
+
+    registry.stopped.signal();
+}
+
+std::shared_ptr<RepositoryService> RepositoryService::acquire(const juce::File& projectDirectory)
+{
+    const juce::File directory = projectDirectory != juce::File() && projectDirectory.isDirectory() ? projectDirectory : juce::File();
+    const juce::String serviceKey = makeKey(directory);
+
+    Registry& registry = getRegistry();
+
+    for (;;)
+    {
+        {
+            const juce::ScopedLock sl(registry.lock);
+
+            if (std::shared_ptr<RepositoryService> existing = registry.services[serviceKey].lock())
+                return existing;
+
+            if (registry.stopping.count(serviceKey) == 0)
+            {
+                std::shared_ptr<RepositoryService> service(new RepositoryService(directory));
+                registry.services[serviceKey] = service;
+                return service;
+            }
+        }
+
+        // The last one is still finishing its jobs: two services would run them side by side.
+        // The timeout covers a signal meant for another waiter.
+        registry.stopped.wait(100);
+    }
+}
+
+HostTransportState& RepositoryService::getTransportState()
+{
+    static HostTransportState transportState;
+    return transportState;
+}
+
+void RepositoryService::probeGitVersion()
+{
+    GitVersionProbe& probe = getGitVersionProbe();
+
+    {
+        const juce::ScopedLock sl(probe.lock);
+
+        if (probe.started)
+            return;
+
+        probe.started = true;
+    }
+
+    // Spawning git costs tens of milliseconds, too long for plugin load or for opening the editor
+    juce::Thread::launch([&probe]
+    {
+        ProcessRunner::Options options;
+        options.timeoutMs = gitVersionTimeoutMs;
+        ProcessResult result = ProcessRunner::run({ "git", "--version" }, options);
+        const juce::String version = juce::String::fromUTF8(result.output.data(), (int) result.output.size());
+        std::vector<std::function<void(const juce::String&)>> waiting;
+
+        {
+            const juce::ScopedLock sl(probe.lock);
+            probe.version = version;
+            probe.finished = true;
+            waiting.swap(probe.waiting);
+        }
+
+        for (auto& onKnown : waiting)
+            juce::MessageManager::callAsync([onKnown, version] { onKnown(version); });
+
+        probe.done.signal();
+    });
+}
+
+juce::String RepositoryService::getGitVersion()
+{
+    probeGitVersion();
+
+    GitVersionProbe& probe = getGitVersionProbe();
+    probe.done.wait(gitVersionTimeoutMs);
+
+    const juce::ScopedLock sl(probe.lock);
+    return probe.version;
+}
+
+void RepositoryService::getGitVersionAsync(std::function<void(const juce::String& version)> onKnown)
+{
+    probeGitVersion();
+
+    GitVersionProbe& probe = getGitVersionProbe();
+    juce::String version;
+
+    {
+        const juce::ScopedLock sl(probe.lock);
+
+        if (!probe.finished)
+        {
+            probe.waiting.push_back(std::move(onKnown));
+            return;
+        }
+
+        version = probe.version;
+    }
+
+    onKnown(version);
+}
+
+juce::String RepositoryService::makeKey(const juce::File& projectDirectory)
+{
+    if (projectDirectory == juce::File())
+        return {};
+
+    // "/Music/Set" and "/music/set/" are one project where the file system says so
+    const juce::File target = projectDirectory.isSymbolicLink() ? projectDirectory.getLinkedTarget() : projectDirectory;
+    const juce::String path = target.getFullPathName();
+    return juce::File::areFileNamesCaseSensitive() ? path : path.toLowerCase();
+}
+
+//==============================================================================
+void RepositoryService::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void RepositoryService::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+void RepositoryService::notifyHistoryChanged()
+{
+    listeners.call([](Listener& listener) { listener.repositoryHistoryChanged(); });
+}
+
+void RepositoryService::startWatching()
+{
+    if (!hasProject())
+        return;
+
+    const juce::ScopedLock sl(lock);
+
+    if (projectWatcher != nullptr)
+        return;
+
+    // Snapshot on save: the watcher reports which files changed once a save burst is over
+    maintenance.start();
+    backup.start();
+    projectWatcher = std::make_unique<ProjectWatcher>(projectDirectory, [this](const juce::StringArray& changedPaths)
+    {
+        queueAutoSnapshot(changedPaths);
+    });
+}
+
+void RepositoryService::checkForGit()
+{
+    if (!hasProject())
+        return;
+
+    if (!projectDirectory.getChildFile(".git").exists())
+    {
+        // Editors ask as they open, so git runs on the queue, ahead of anything that needs the repository
+        jobQueue.submit("Creating the repository", [this](GitJobQueue::Context& context)
+        {
+            GitJobQueue::Result result;
+            result.succeeded = true;
+
+            // Two editors opening at once both queue this
+            if (projectDirectory.getChildFile(".git").exists())
+                return result;
+
+            DBG("Git repository not found, initializing git repository in " + projectDirectory.getFullPathName());
+            const ProcessResult init = runGit({ "init" }, context.getCancelFlag());
+            result.succeeded = init.succeeded();
+            result.cancelled = init.cancelled;
+
+            if (result.succeeded)
+                projectDirectory.getChildFile(".gitignore").replaceWithText("Backup/\nAbleton Project Info/\n");
+
+            return result;
+        },
+        [this](const GitJobQueue::Result&) { notifyHistoryChanged(); });
+    }
+
+    {
+        // Every instance's editor asks when it opens; the first one to ask gets it done
+        const juce::ScopedLock sl(lock);
+
+        if (managedFilesRestored)
+            return;
+
+        managedFilesRestored = true;
+    }
+
+    jobQueue.submit("Restoring project files", [this](GitJobQueue::Context& context)
+    {
+        // Projects on a branch switch to decompressed project files, and a full snapshot
+        // migrates them. Old snapshots checked out for a listen are left as they are.
+        std::shared_ptr<ProjectFileStore> projectFiles = getProjectFileStore();
+        if (projectFiles != nullptr && !projectFiles->isEnabled() && !getRepositorySummary(0).detached)
+        {
+            projectFiles->setEnabled(true);
+            queueAutoSnapshot({});
+        }
+
+        // A fresh clone has pointer and shadow files but not the recordings and .als files yet
+        GitJobQueue::Result result;
+        result.succeeded = restoreManagedFiles(context.getCancelFlag());
+        return result;
+    });
+}
+
+//==============================================================================
+juce::String RepositoryService::executeGit(const juce::StringArray& arguments, int timeoutMs)
+{
+    ProcessResult result = runGit(arguments, nullptr, timeoutMs);
+    return juce::String::fromUTF8(result.output.data(), (int) result.output.size());
+}
+
+ProcessResult RepositoryService::runGit(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs,
+                                        bool lowPriority, const std::vector<std::string>& environment)
+{
+    std::vector<std::string> argv { "git" };
+    for (const auto& argument : arguments)
+        argv.push_back(argument.toStdString());
+
+    ProcessRunner::Options options;
+    options.workingDirectory = projectDirectory.getFullPathName().toStdString(); // never the process's cwd
+    options.timeoutMs = timeoutMs;
+    options.cancelFlag = cancelFlag;
+    options.lowPriority = lowPriority;
+    options.environment = environment;
+
+    Tracer::ScopedSpan span(tracer, "git", "git " + arguments[0]);
+    span.setDetail("git " + arguments.joinIntoString(" "));
+
+    ProcessResult result = ProcessRunner::run(argv, options);
+
+    span.setOutputBytes((juce::int64) result.output.size());
+    span.setExitCode(result.exitCode);
+
+    if (!result.succeeded())
+    {
+        DBG("git " + arguments.joinIntoString(" ") + " failed (" + juce::String(result.exitCode) + "): "
+            + juce::String::fromUTF8(result.error.data(), (int) result.error.size()));
+    }
+
+    return result;
+}
+
+GitJobQueue::JobId RepositoryService::runGitJob(const juce::String& description,
+                                                const juce::Array<juce::StringArray>& steps,
+                                                GitJobQueue::Completion onComplete)
+{
+    maintenance.noteUserActivity();
+    backup.noteChange();
+    snapshotScheduler.flush();
+
+    return jobQueue.submit(description, [this, steps](GitJobQueue::Context& context)
+    {
+        GitJobQueue::Result result;
+        result.succeeded = true;
+
+        // Checkout, merge and friends work on .git/index: bring it up to the last snapshot first,
+        // which includes the samples of a checkout that are still coming in
+        if (areSamplesPending() && !restoreSamples(context.getCancelFlag(), &context))
+        {
+            result.succeeded = false;
+            result.cancelled = context.shouldCancel();
+            result.output = "The samples of the last checkout couldn't be restored\n";
+            return result;
+        }
+
+        std::shared_ptr<SnapshotBuilder> builder = getSnapshotBuilder();
+        std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+        if (builder != nullptr && worker != nullptr)
+            builder->syncSharedIndex(*worker);
+
+        // A checkout that ends the job is staged: project file now, samples in a job of their own
+        const bool staged = !steps.isEmpty() && steps.getLast().size() == 2 && steps.getLast()[0] == "checkout";
+
+        for (int i = 0; i < steps.size(); ++i)
+        {
+            context.setProgress((float) i / (float) steps.size(), "git " + steps[i][0]);
+
+            // Only the files that differ get written; anything unusual still goes to git. A native
+            // checkout that failed must not get git's turn: git would start from a HEAD that's
+            // no longer what the working tree was checked against.
+            if (steps[i].size() == 2 && steps[i][0] == "checkout")
+            {
+                juce::String error;
+                const CheckoutEngine::Outcome outcome = checkoutNatively(steps[i][1], context.getCancelFlag(),
+                                                                         staged && i == steps.size() - 1, error);
+
+                if (outcome == CheckoutEngine::Outcome::done)
+                    continue;
+
+                if (outcome != CheckoutEngine::Outcome::unsupported)
+                {
+                    result.succeeded = false;
+                    result.cancelled = outcome == CheckoutEngine::Outcome::cancelled;
+                    result.output += error + "\n";
+                    break;
+                }
+            }
+
+            ProcessResult step = runGit(steps[i], context.getCancelFlag());
+            result.output += juce::String::fromUTF8(step.output.data(), (int) step.output.size());
+            result.output += juce::String::fromUTF8(step.error.data(), (int) step.error.size());
+
+            // Same semantics as the "&&" chains this replaces
+            if (!step.succeeded())
+            {
+                result.succeeded = false;
+                result.cancelled = step.cancelled;
+                break;
+            }
+        }
+
+        // A checkout or merge may have swapped pointer or shadow files: bring the real ones in line
+        if (!context.shouldCancel() && staged)
+        {
+            context.setProgress(1.0f, "restoring project files");
+
+            std::shared_ptr<ProjectFileStore> projectFiles = getProjectFileStore();
+            if (projectFiles != nullptr && projectFiles->restoreProjectFiles(context.getCancelFlag()) < 0)
+                result.output += "Some project files couldn't be restored from the snapshot\n";
+
+            // The samples the set loads first are there when the completion reopens the DAW
+            std::shared_ptr<CheckoutEngine> engine = getCheckoutEngine();
+            if (engine != nullptr && builder != nullptr && worker != nullptr && engine->hasPendingFiles())
+            {
+                context.setProgress(1.0f, "restoring the first samples");
+                engine->finishCheckout(*worker, *builder, findSampleLoadOrder(), context.getCancelFlag(), nullptr, samplesBeforeReopen);
+            }
+
+            // The rest are queued before the completion runs, so anything submitted after that
+            // (a snapshot of the reopened set, say) waits until every sample is back
+            samplesPending = true;
+            jobQueue.submit("Restoring samples", [this](GitJobQueue::Context& samplesContext)
+            {
+                GitJobQueue::Result samplesResult;
+                samplesResult.succeeded = restoreSamples(samplesContext.getCancelFlag(), &samplesContext);
+                samplesResult.cancelled = samplesContext.shouldCancel();
+                return samplesResult;
+            });
+        }
+        else if (!context.shouldCancel())
+        {
+            context.setProgress(1.0f, "restoring project files");
+            if (!restoreManagedFiles(context.getCancelFlag()))
+                result.output += "Some project files couldn't be restored from the snapshot\n";
+        }
+
+        return result;
+    }, std::move(onComplete));
+}
+
+bool RepositoryService::snapshotChangedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag,
+                                             const juce::String& message)
+{
+    if (!commitChangedFiles(changedPaths, cancelFlag, message))
+        return false;
+
+    if (std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker())
+        attachPreview(worker->resolveRef("HEAD"), cancelFlag);
+
+    backup.noteChange();
+    return true;
+}
+
+bool RepositoryService::commitChangedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag,
+                                           const juce::String& message)
+{
+    Tracer::ScopedSpan span(tracer, "snapshot", "snapshot");
+    span.setDetail(changedPaths.isEmpty() ? juce::String("full scan") : juce::String(changedPaths.size()) + " changed paths");
+
+    // Never snapshot a checkout whose samples haven't all arrived: they'd be committed as deleted or stale
+    if (areSamplesPending() && !restoreSamples(cancelFlag, nullptr))
+        return false;
+
+    juce::StringArray pathsToStage = prepareManagedFiles(changedPaths, cancelFlag);
+
+    // Hash and commit in-process where we can; git is the fallback for what the builder doesn't model
+    std::shared_ptr<SnapshotBuilder> builder = getSnapshotBuilder();
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    if (builder == nullptr || worker == nullptr)
+        return false;
+
+    const juce::StringArray paths = pathsToStage.size() <= maxPathsPerSnapshot ? pathsToStage : juce::StringArray();
+    const SnapshotBuilder::Outcome outcome = builder->snapshot(*worker, paths, message, cancelFlag);
+
+    if (outcome != SnapshotBuilder::Outcome::unsupported)
+    {
+        const SnapshotBuilder::Statistics& stats = builder->getLastStatistics();
+        DBG("Snapshot: " << stats.numStatted << " statted, " << stats.numHashed << " hashed, "
+            << stats.numTreesWritten << " trees written in " << stats.totalMs << " ms");
+        return outcome == SnapshotBuilder::Outcome::committed;
+    }
+
+    // The same steps with git's plumbing, still in the builder's private index so the
+    // user's staging area (and a held .git/index.lock) never gets in the way
+    bool needsFullScan = false;
+    if (!builder->preparePrivateIndex(*worker, needsFullScan))
+        return false;
+
+    const std::vector<std::string> environment { "GIT_INDEX_FILE=" + builder->getPrivateIndexFile().getFullPathName().toStdString() };
+
+    // Stage only what the watcher saw change. Very long lists, or paths git refuses
+    // (e.g. ones it ignores), fall back to one scan of the whole tree.
+    bool staged = false;
+
+    if (!needsFullScan && !paths.isEmpty())
+    {
+        juce::StringArray arguments { "add", "-A", "--" };
+        arguments.addArray(paths);
+        staged = runGit(arguments, cancelFlag, -1, true, environment).succeeded();
+    }
+
+    if (!staged && !runGit({ "add", "-A" }, cancelFlag, -1, true, environment).succeeded())
+        return false;
+
+    ProcessResult tree = runGit({ "write-tree" }, cancelFlag, -1, true, environment);
+    if (!tree.succeeded())
+        return false;
+
+    const juce::String treeOid = juce::String::fromUTF8(tree.output.data(), (int) tree.output.size()).trim();
+    const juce::String headOid = worker->resolveRef("HEAD");
+    const juce::String headTree = headOid.isEmpty() ? juce::String() : executeGit({ "rev-parse", "-q", "--verify", "HEAD^{tree}" }).trim();
+
+    // A save that didn't change any content (same bytes, new timestamp) ends here without a commit
+    if (headOid.isNotEmpty() && treeOid == headTree)
+        return false;
+
+    DBG("Working tree has changed");
+
+    juce::StringArray commitArguments { "commit-tree", treeOid };
+    if (headOid.isNotEmpty())
+        commitArguments.addArray({ "-p", headOid });
+    commitArguments.addArray({ "-m", message });
+
+    ProcessResult commit = runGit(commitArguments, cancelFlag, -1, true);
+    if (!commit.succeeded())
+        return false;
+
+    const juce::String commitOid = juce::String::fromUTF8(commit.output.data(), (int) commit.output.size()).trim();
+    const juce::String reflogMessage = "commit: " + message.upToFirstOccurrenceOf("\n", false, false);
+    GitRepositoryWorker::Summary summary = getRepositorySummary(0);
+
+    if (summary.detached)
+    {
+        // Saving on top of an old snapshot: keep the work on its own branch instead of losing it.
+        // The empty old value makes update-ref fail rather than move an existing branch.
+        const juce::String branch = "refs/heads/" + headOid.substring(0, 7) + "-branch";
+
+        if (!runGit({ "update-ref", "-m", reflogMessage, branch, commitOid, "" }, cancelFlag, -1, true).succeeded()
+            || !runGit({ "symbolic-ref", "HEAD", branch }, cancelFlag, -1, true).succeeded())
+            return false;
+    }
+    else if (!runGit({ "update-ref", "-m", reflogMessage, "HEAD", commitOid, headOid }, cancelFlag, -1, true).succeeded())
+    {
+        // HEAD moved underneath us; the commit stays unreferenced and the next snapshot retries
+        return false;
+    }
+
+    builder->noteCommitted(*worker, headTree);
+    return true;
+}
+
+void RepositoryService::attachPreview(const juce::String& commitOid, const std::atomic<bool>* cancelFlag)
+{
+    std::shared_ptr<PreviewStore> store = getPreviewStore();
+
+    if (store == nullptr || commitOid.isEmpty())
+        return;
+
+    juce::AudioBuffer<float> audio;
+    double sampleRate = 0.0;
+    bool found = false;
+
+    {
+        const juce::ScopedLock sl(previewLock);
+
+        for (auto* source : previewSources)
+        {
+            found = source->takePreview(audio, sampleRate);
+
+            if (found)
+                break;
+        }
+    }
+
+    if (!found)
+        return;
+
+    // A missing preview never fails the snapshot it belongs to
+    Tracer::ScopedSpan span(tracer, "snapshot", "attach preview");
+    span.setDetail(juce::String(audio.getNumSamples() / juce::jmax(1.0, sampleRate), 1) + " s");
+
+    if (!store->attach(commitOid, audio, sampleRate, cancelFlag))
+        DBG("Couldn't attach a preview to " << commitOid);
+}
+
+void RepositoryService::queueAutoSnapshot(const juce::StringArray& changedPaths)
+{
+    // A save is the user at work: maintenance waits until they pause again
+    maintenance.noteUserActivity();
+
+    {
+        // Saves during a long take pile up into one snapshot instead of a queue of them
+        const juce::ScopedLock sl(autoSnapshotLock);
+
+        if (changedPaths.isEmpty())
+            autoSnapshotEverything = true;
+
+        for (const auto& path : changedPaths)
+            autoSnapshotPaths.insert(path);
+
+        if (autoSnapshotScheduled)
+            return;
+
+        autoSnapshotScheduled = true;
+    }
+
+    snapshotScheduler.schedule("Auto snapshot", [this](GitJobQueue::Context& context)
+    {
+        juce::StringArray paths;
+
+        {
+            const juce::ScopedLock sl(autoSnapshotLock);
+
+            if (!autoSnapshotEverything)
+                for (const auto& path : autoSnapshotPaths)
+                    paths.add(path);
+
+            autoSnapshotPaths.clear();
+            autoSnapshotEverything = false;
+            autoSnapshotScheduled = false;
+        }
+
+        GitJobQueue::Result result;
+        result.succeeded = snapshotChangedFiles(paths, context.getCancelFlag());
+        return result;
+    },
+    [this](const GitJobQueue::Result& result)
+    {
+        if (result.cancelled)
+        {
+            const juce::ScopedLock sl(autoSnapshotLock);
+            autoSnapshotScheduled = false;
+        }
+
+        if (result.succeeded)
+            notifyHistoryChanged();
+    });
+}
+
+void RepositoryService::takeSnapshot(const juce::String& message, GitJobQueue::Completion onComplete)
+{
+    maintenance.noteUserActivity();
+    snapshotScheduler.schedule("Taking a snapshot", [this, message](GitJobQueue::Context& context)
+    {
+        GitJobQueue::Result result;
+        result.succeeded = snapshotChangedFiles({}, context.getCancelFlag(), message);
+        return result;
+    }, std::move(onComplete));
+}
+
+GitRepositoryWorker::Summary RepositoryService::getRepositorySummary(int maxCommits)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    if (worker == nullptr)
+        return {};
+
+    Tracer::ScopedSpan span(tracer, "query", "repository summary");
+    span.setDetail(juce::String(maxCommits) + " commits");
+    return worker->query(maxCommits);
+}
+
+std::shared_ptr<GitRepositoryWorker> RepositoryService::getRepositoryWorker()
+{
+    const juce::ScopedLock sl(lock);
+
+    if (!hasProject())
+        return nullptr;
+
+    if (repositoryWorker == nullptr)
+    {
+        repositoryWorker = std::make_shared<GitRepositoryWorker>(projectDirectory);
+        historyCache = std::make_shared<CommitHistoryCache>();
+    }
+
+    return repositoryWorker;
+}
+
+std::shared_ptr<CommitHistoryCache> RepositoryService::getHistoryCache()
+{
+    getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+    return historyCache;
+}
+
+std::shared_ptr<ProjectFileStore> RepositoryService::getProjectFileStore()
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+
+    if (worker == nullptr)
+        return nullptr;
+
+    if (projectFileStore == nullptr)
+        projectFileStore = std::make_shared<ProjectFileStore>(projectDirectory, worker->getGitDirectory(), worker->getCommonDirectory());
+
+    return projectFileStore;
+}
+
+std::shared_ptr<SnapshotBuilder> RepositoryService::getSnapshotBuilder()
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+
+    if (worker == nullptr)
+        return nullptr;
+
+    if (snapshotBuilder == nullptr)
+        snapshotBuilder = std::make_shared<SnapshotBuilder>(projectDirectory, worker->getGitDirectory(), worker->getCommonDirectory());
+
+    return snapshotBuilder;
+}
+
+std::shared_ptr<CheckoutEngine> RepositoryService::getCheckoutEngine()
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+
+    if (worker == nullptr)
+        return nullptr;
+
+    if (checkoutEngine == nullptr)
+        checkoutEngine = std::make_shared<CheckoutEngine>(projectDirectory, worker->getGitDirectory());
+
+    return checkoutEngine;
+}
+
+std::shared_ptr<AssetStore> RepositoryService::getAssetStore()
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+
+    if (worker == nullptr)
+        return nullptr;
+
+    if (assetStore == nullptr)
+        assetStore = std::make_shared<AssetStore>(projectDirectory, worker->getGitDirectory(), worker->getCommonDirectory());
+
+    return assetStore;
+}
+
+bool RepositoryService::isChunkingLargeAudio()
+{
+    std::shared_ptr<AssetStore> assets = getAssetStore();
+    return assets != nullptr && assets->isEnabled();
+}
+
+void RepositoryService::setChunkingLargeAudio(bool shouldChunk)
+{
+    std::shared_ptr<AssetStore> assets = getAssetStore();
+
+    if (assets == nullptr || assets->isEnabled() == shouldChunk)
+        return;
+
+    maintenance.noteUserActivity();
+
+    // On the job queue, since a snapshot may be using the store right now
+    jobQueue.submit(shouldChunk ? "Enabling audio chunking" : "Disabling audio chunking",
+                    [assets, shouldChunk](GitJobQueue::Context&)
+    {
+        assets->setEnabled(shouldChunk);
+        GitJobQueue::Result result;
+        result.succeeded = true;
+        return result;
+    });
+
+    queueAutoSnapshot({});
+}
+//==============================================================================
+template <typename Value>
+void RepositoryService::submitSharedQuery(SharedQuery<Value>& query, const juce::String& description,
+                                          std::function<Value()> compute, std::function<void(Value)> onDone)
+{
+    {
+        const juce::ScopedLock sl(queryLock);
+        query.waiting.push_back(std::move(onDone));
+
+        // One is queued and hasn't looked at the repository yet: its answer is ours too
+        if (query.queued)
+            return;
+
+        query.queued = true;
+    }
+
+    struct Run
+    {
+        Value value {};
+        std::vector<std::function<void(Value)>> callers;
+    };
+
+    auto run = std::make_shared<Run>();
+
+    queryQueue.submit(description, [this, &query, run, compute](GitJobQueue::Context&)
+    {
+        {
+            // Whoever asks from here on may need what this run is about to miss
+            const juce::ScopedLock sl(queryLock);
+            run->callers = std::move(query.waiting);
+            query.waiting.clear();
+            query.queued = false;
+        }
+
+        run->value = compute();
+        GitJobQueue::Result result;
+        result.succeeded = true;
+        return result;
+    },
+    [this, &query, run](const GitJobQueue::Result&)
+    {
+        if (run->callers.empty())
+        {
+            // Cancelled before it started: still answer everyone who waited on it
+            const juce::ScopedLock sl(queryLock);
+
+            if (query.queued)
+            {
+                run->callers = std::move(query.waiting);
+                query.waiting.clear();
+                query.queued = false;
+            }
+        }
+
+        for (auto& caller : run->callers)
+            if (caller)
+                caller(run->value);
+    });
+}
+
+void RepositoryService::refreshHistory(std::function<void(bool)> onDone)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+    std::shared_ptr<CommitHistoryCache> cache = getHistoryCache();
+
+    if (worker == nullptr || cache == nullptr)
+        return;
+
+    submitSharedQuery<bool>(historyQuery, "Reading history", [this, worker, cache]
+    {
+        Tracer::ScopedSpan span(tracer, "query", "read history");
+        const bool changed = cache->update(*worker, worker->resolveRef("HEAD"));
+
+        if (changed)
+        {
+            publishState([&cache](RepositoryState& next)
+            {
+                next.history = cache->getSnapshot();
+                return true;
+            });
+        }
+
+        return changed;
+    }, std::move(onDone));
+}
+
+void RepositoryService::loadMoreHistory(std::function<void(int)> onDone)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+    std::shared_ptr<CommitHistoryCache> cache = getHistoryCache();
+
+    if (worker == nullptr || cache == nullptr)
+        return;
+
+    submitSharedQuery<int>(olderHistoryQuery, "Reading older history", [this, worker, cache]
+    {
+        Tracer::ScopedSpan span(tracer, "query", "read older history");
+        const int added = cache->loadNextPage(*worker);
+
+        // A last page that added nothing still takes away the "loading" row
+        publishState([added, &cache](RepositoryState& next)
+        {
+            std::shared_ptr<const RepositoryState::History> history = cache->getSnapshot();
+
+            if (added == 0 && (history == nullptr || next.history == nullptr || next.history->complete == history->complete))
+                return false;
+
+            next.history = std::move(history);
+            return true;
+        });
+
+        return added;
+    }, std::move(onDone));
+}
+
+void RepositoryService::prefetch()
+{
+    if (!hasProject())
+        return;
+
+    {
+        const juce::ScopedLock sl(queryLock);
+
+        if (prefetched)
+            return;
+
+        prefetched = true;
+    }
+
+    refreshSummary(nullptr);
+    refreshHistory(nullptr);
+}
+
+std::shared_ptr<const RepositoryState> RepositoryService::getState() const
+{
+    return std::atomic_load(&state);
+}
+
+void RepositoryService::refreshSummary(std::function<void(bool)> onDone)
+{
+    if (!hasProject())
+        return;
+
+    submitSharedQuery<bool>(summaryQuery, "Reading branches", [this]
+    {
+        GitRepositoryWorker::Summary summary = getRepositorySummary(0);
+
+        return publishState([&summary](RepositoryState& next)
+        {
+            if (next.hasSummary && RepositoryState::isSameSummary(summary, next.summary))
+                return false;
+
+            next.summary = std::move(summary);
+            next.hasSummary = true;
+            return true;
+        });
+    }, std::move(onDone));
+}
+
+bool RepositoryService::publishState(const std::function<bool(RepositoryState&)>& change)
+{
+    // Writers take turns; readers only ever see a finished version
+    const juce::ScopedLock sl(stateLock);
+
+    auto next = std::make_shared<RepositoryState>(*state);
+
+    if (!change(*next))
+        return false;
+
+    next->version = state->version + 1;
+    std::atomic_store(&state, std::shared_ptr<const RepositoryState>(std::move(next)));
+    return true;
+}
+
+std::shared_ptr<ProjectDiff> RepositoryService::getProjectDiff()
+{
+    const juce::ScopedLock sl(lock);
+
+    if (!hasProject())
+        return nullptr;
+
+    if (projectDiff == nullptr)
+        projectDiff = std::make_shared<ProjectDiff>();
+
+    return projectDiff;
+}
+
+GitJobQueue::JobId RepositoryService::diffSnapshot(const juce::String& commitOid, std::function<void(const ProjectDiff::Result&)> onDone)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+    std::shared_ptr<ProjectDiff> diff = getProjectDiff();
+
+    if (worker == nullptr || diff == nullptr || commitOid.isEmpty())
+        return 0;
+
+    auto result = std::make_shared<ProjectDiff::Result>();
+
+    if (diff->getCachedResult(commitOid, *result))
+    {
+        if (onDone)
+            onDone(*result);
+
+        return 0;
+    }
+
+    return queryQueue.submit("Reading changes", [this, worker, diff, commitOid, result](GitJobQueue::Context& context)
+    {
+        Tracer::ScopedSpan span(tracer, "query", "diff snapshot");
+        *result = diff->diffCommit(*worker, commitOid, context.getCancelFlag());
+
+        GitJobQueue::Result jobResult;
+        jobResult.succeeded = result->succeeded;
+        return jobResult;
+    },
+    [result, onDone](const GitJobQueue::Result& jobResult)
+    {
+        if (!jobResult.cancelled && onDone)
+            onDone(*result);
+    });
+}
+
+void RepositoryService::cancelDiff(GitJobQueue::JobId job)
+{
+    if (job != 0)
+        queryQueue.cancel(job);
+}
+
+std::shared_ptr<AudioOverviewCache> RepositoryService::getAudioOverviews()
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+
+    if (worker == nullptr)
+        return nullptr;
+
+    if (audioOverviews == nullptr)
+        audioOverviews = std::make_shared<AudioOverviewCache>(worker->getGitDirectory());
+
+    return audioOverviews;
+}
+
+GitJobQueue::JobId RepositoryService::compareAudio(const ProjectDiff::Result& diff,
+                                                   std::function<void(const std::vector<AudioOverviewCache::Comparison>&)> onDone)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+    std::shared_ptr<AudioOverviewCache> overviews = getAudioOverviews();
+
+    if (worker == nullptr || overviews == nullptr || diff.audioChanges.isEmpty())
+        return 0;
+
+    std::shared_ptr<AssetStore> assets = getAssetStore();
+    auto comparisons = std::make_shared<std::vector<AudioOverviewCache::Comparison>>();
+    const juce::Array<ProjectDiff::AudioChange> changes = diff.audioChanges;
+
+    return analysisQueue.submit("Reading audio", [this, worker, overviews, assets, changes, comparisons](GitJobQueue::Context& context)
+    {
+        Tracer::ScopedSpan span(tracer, "query", "compare audio");
+        *comparisons = overviews->compare(*worker, assets.get(), changes, context.getCancelFlag());
+
+        GitJobQueue::Result result;
+        result.succeeded = true;
+        return result;
+    },
+    [comparisons, onDone](const GitJobQueue::Result& result)
+    {
+        if (!result.cancelled && onDone)
+            onDone(*comparisons);
+    });
+}
+
+void RepositoryService::cancelAudioComparison(GitJobQueue::JobId job)
+{
+    if (job != 0)
+        analysisQueue.cancel(job);
+}
+
+void RepositoryService::addPreviewSource(PreviewCapture* source)
+{
+    const juce::ScopedLock sl(previewLock);
+
+    if (std::find(previewSources.begin(), previewSources.end(), source) == previewSources.end())
+        previewSources.push_back(source);
+}
+
+void RepositoryService::removePreviewSource(PreviewCapture* source)
+{
+    const juce::ScopedLock sl(previewLock);
+    previewSources.erase(std::remove(previewSources.begin(), previewSources.end(), source), previewSources.end());
+}
+
+std::shared_ptr<PreviewStore> RepositoryService::getPreviewStore()
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    const juce::ScopedLock sl(lock);
+
+    if (worker == nullptr)
+        return nullptr;
+
+    if (previewStore == nullptr)
+        previewStore = std::make_shared<PreviewStore>(worker->getGitDirectory(),
+                                                      [this](const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)
+                                                      { return runGit(arguments, cancelFlag, timeoutMs, true); });
+
+    return previewStore;
+}
+
+GitJobQueue::JobId RepositoryService::loadPreview(const juce::String& commitOid,
+                                                  std::function<void(std::shared_ptr<const juce::AudioBuffer<float>>, double sampleRate)> onDone)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+    std::shared_ptr<PreviewStore> store = getPreviewStore();
+
+    if (worker == nullptr || store == nullptr || commitOid.isEmpty())
+        return 0;
+
+    auto audio = std::make_shared<juce::AudioBuffer<float>>();
+    auto sampleRate = std::make_shared<double>(0.0);
+
+    return analysisQueue.submit("Reading preview", [this, worker, store, commitOid, audio, sampleRate](GitJobQueue::Context&)
+    {
+        Tracer::ScopedSpan span(tracer, "query", "load preview");
+
+        GitJobQueue::Result result;
+        result.succeeded = store->load(*worker, commitOid, *audio, *sampleRate);
+        return result;
+    },
+    [audio, sampleRate, onDone](const GitJobQueue::Result& result)
+    {
+        if (!result.cancelled && onDone)
+            onDone(result.succeeded ? audio : nullptr, *sampleRate);
+    });
+}
+
+void RepositoryService::cancelPreviewLoad(GitJobQueue::JobId job)
+{
+    if (job != 0)
+        analysisQueue.cancel(job);
+}
+
+std::shared_ptr<MergePreflight> RepositoryService::getMergePreflight()
+{
+    const juce::ScopedLock sl(lock);
+
+    if (!hasProject())
+        return nullptr;
+
+    if (mergePreflight == nullptr)
+        mergePreflight = std::make_shared<MergePreflight>([this](const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)
+                                                          { return runGit(arguments, cancelFlag, timeoutMs, true); });
+
+    return mergePreflight;
+}
+
+GitJobQueue::JobId RepositoryService::preflightMerge(const juce::String& target, const juce::String& branch,
+                                                     std::function<void(const MergePreflight::Result&)> onDone)
+{
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+    std::shared_ptr<MergePreflight> preflight = getMergePreflight();
+
+    if (worker == nullptr || preflight == nullptr || target.isEmpty() || branch.isEmpty())
+        return 0;
+
+    auto result = std::make_shared<MergePreflight::Result>();
+
+    return queryQueue.submit("Checking merge", [this, worker, preflight, target, branch, result](GitJobQueue::Context& context)
+    {
+        Tracer::ScopedSpan span(tracer, "query", "preflight merge");
+        *result = preflight->check(*worker, target, branch, context.getCancelFlag());
+
+        GitJobQueue::Result jobResult;
+        jobResult.succeeded = result->succeeded;
+        return jobResult;
+    },
+    [result, onDone](const GitJobQueue::Result& jobResult)
+    {
+        if (!jobResult.cancelled && onDone)
+            onDone(*result);
+    });
+}
+
+void RepositoryService::cancelMergePreflight(GitJobQueue::JobId job)
+{
+    if (job != 0)
+        queryQueue.cancel(job);
+}
+
+//==============================================================================
+juce::StringArray RepositoryService::prepareManagedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag)
+{
+    juce::StringArray pathsToStage = changedPaths;
+    juce::StringArray newlyManaged;
+
+    // Large recordings become pointer files, gzipped project files become plain XML
+    if (std::shared_ptr<AssetStore> assets = getAssetStore())
+    {
+        AssetStore::PreparedSnapshot prepared = assets->prepareSnapshot(pathsToStage, cancelFlag);
+        pathsToStage = prepared.pathsToStage;
+        newlyManaged.addArray(prepared.newlyManaged);
+    }
+
+    if (std::shared_ptr<ProjectFileStore> projectFiles = getProjectFileStore())
+    {
+        ProjectFileStore::PreparedSnapshot prepared = projectFiles->prepareSnapshot(pathsToStage, cancelFlag);
+        pathsToStage = prepared.pathsToStage;
+        newlyManaged.addArray(prepared.newlyManaged);
+    }
+
+    // Files git used to track directly are dropped from the index, the shadows replace them
+    if (!newlyManaged.isEmpty())
+    {
+        juce::StringArray arguments { "rm", "--cached", "-q", "--ignore-unmatch", "--" };
+        arguments.addArray(newlyManaged);
+        runGit(arguments, cancelFlag, -1, true);
+    }
+
+    return pathsToStage;
+}
+
+bool RepositoryService::restoreManagedFiles(const std::atomic<bool>* cancelFlag)
+{
+    bool ok = true;
+
+    if (std::shared_ptr<ProjectFileStore> projectFiles = getProjectFileStore())
+        ok = projectFiles->restoreProjectFiles(cancelFlag) >= 0;
+
+    return restoreSamples(cancelFlag, nullptr) && ok;
+}
+
+bool RepositoryService::restoreSamples(const std::atomic<bool>* cancelFlag, GitJobQueue::Context* context)
+{
+    const juce::StringArray order = findSampleLoadOrder();
+    bool ok = true;
+
+    std::shared_ptr<CheckoutEngine> engine = getCheckoutEngine();
+    std::shared_ptr<SnapshotBuilder> builder = getSnapshotBuilder();
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    if (engine != nullptr && builder != nullptr && worker != nullptr && engine->hasPendingFiles())
+    {
+        ok = engine->finishCheckout(*worker, *builder, order, cancelFlag, [context](int done, int total)
+        {
+            if (context != nullptr)
+                context->setProgress((float) done / (float) total, juce::String(done + 1) + " of " + juce::String(total) + " samples");
+        }) == CheckoutEngine::Outcome::done;
+    }
+
+    if (context != nullptr)
+        context->setProgress(-1.0f, "rebuilding recordings");
+
+    if (std::shared_ptr<AssetStore> assets = getAssetStore())
+        ok = assets->restoreAssets(cancelFlag, order) >= 0 && ok;
+
+    samplesPending = !ok;
+    return ok;
+}
+
+bool RepositoryService::areSamplesPending()
+{
+    if (samplesPending)
+        return true;
+
+    std::shared_ptr<CheckoutEngine> engine = getCheckoutEngine();
+    return engine != nullptr && engine->hasPendingFiles();
+}
+
+juce::StringArray RepositoryService::findSampleLoadOrder()
+{
+    juce::StringArray order;
+
+    if (!hasProject())
+        return order;
+
+    juce::Array<juce::File> children;
+    projectDirectory.findChildFiles(children, juce::File::findFiles, false, "*.als");
+
+    for (const auto& child : children)
+        order.addArray(ProjectFileStore::findReferencedFiles(child, projectDirectory));
+
+    order.removeDuplicates(false);
+    return order;
+}
+
+CheckoutEngine::Outcome RepositoryService::checkoutNatively(const juce::String& target, const std::atomic<bool>* cancelFlag, bool deferSamples,
+                                                            juce::String& error)
+{
+    std::shared_ptr<CheckoutEngine> engine = getCheckoutEngine();
+    std::shared_ptr<SnapshotBuilder> builder = getSnapshotBuilder();
+    std::shared_ptr<GitRepositoryWorker> worker = getRepositoryWorker();
+
+    if (engine == nullptr || builder == nullptr || worker == nullptr)
+        return CheckoutEngine::Outcome::unsupported;
+
+    Tracer::ScopedSpan span(tracer, "git", "checkout (native)");
+    span.setDetail("checkout " + target);
+
+    const CheckoutEngine::Outcome outcome = engine->checkout(*worker, *builder, target, cancelFlag, deferSamples);
+    const CheckoutEngine::Statistics& stats = engine->getLastStatistics();
+    DBG("Checkout: " << stats.numChanged << " changed, " << stats.numWritten << " written, " << stats.numFromCache
+        << " from the clone cache, " << stats.numDeferred << " deferred, " << stats.numRemoved << " removed in " << stats.totalMs << " ms");
+
+    if (outcome == CheckoutEngine::Outcome::failed)
+        error = engine->getLastError();
+    else if (outcome == CheckoutEngine::Outcome::cancelled)
+        error = "The checkout was cancelled before anything was written";
+
+    return outcome;
+}
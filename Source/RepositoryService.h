@@ -0,0 +1,306 @@
+/*
+  ==============================================================================
+
+    RepositoryService.h
+    Everything one project's repository needs at runtime, shared by every
+    plugin instance in the process that works on that project.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ProcessRunner.h"
+#include "GitRepositoryWorker.h"
+#include "GitJobQueue.h"
+#include "CommitHistoryCache.h"
+#include "RepositoryState.h"
+#include "ProjectWatcher.h"
+#include "SnapshotScheduler.h"
+#include "AssetStore.h"
+#include "ProjectFileStore.h"
+#include "SnapshotBuilder.h"
+#include "CheckoutEngine.h"
+#include "RepositoryMaintenance.h"
+#include "RepositoryBackup.h"
+#include "ProjectDiff.h"
+#include "AudioOverviewCache.h"
+#include "PreviewCapture.h"
+#include "PreviewStore.h"
+#include "MergePreflight.h"
+#include "Tracer.h"
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+//==============================================================================
+/**
+    SnapTrack on several tracks, or two sets open in one host, used to mean
+    an independent git pipeline per plugin instance. Each one spawned its own
+    git processes against the same .git/index.lock and had its own watcher
+    reporting the same saves. The last one loaded also changed the host's
+    working directory.
+
+    acquire() hands out one service per project directory, and every instance
+    on that project holds a reference to it. They share one job queue (so git
+    writers never race each other), one query queue, the history cache, the
+    snapshot scheduler, maintenance and the save watcher. The service goes
+    away with the last instance that uses it. Git always gets the project
+    directory as its working directory, and nothing touches the process's.
+
+    A history read that is still waiting in the query queue answers every
+    instance that asks for the same thing before it starts, so N editors
+    refreshing after a snapshot cost one walk. What the reads find is
+    published as one immutable RepositoryState that every editor paints
+    from. Listeners are told (on the
+    message thread) when a snapshot one of them started, or an auto snapshot,
+    changes the history.
+
+    Instances without a project share a service without one. It has queues
+    but no repository.
+*/
+class RepositoryService
+{
+public:
+    struct Listener
+    {
+        virtual ~Listener() = default;
+        virtual void repositoryHistoryChanged() = 0;
+    };
+
+    ~RepositoryService();
+
+    /** The service for projectDirectory, created on first use. Paths naming the same
+        directory get the same service. A directory that doesn't exist gets the one without a project.
+        While the project's previous service is still finishing its jobs, this waits for it.
+    */
+    static std::shared_ptr<RepositoryService> acquire(const juce::File& projectDirectory);
+
+    /** The host's transport, published by every instance's processBlock. One host, one transport. */
+    static HostTransportState& getTransportState();
+
+    /** Starts "git --version" in the background, once per process. */
+    static void probeGitVersion();
+
+    /** What the probe printed, empty if git can't be run. Waits while the probe is still running,
+        so not for the message thread; headless callers only.
+    */
+    static juce::String getGitVersion();
+
+    /** Calls onKnown with what the probe printed: straight away if it has finished, otherwise on the
+        message thread once it has. Never waits.
+    */
+    static void getGitVersionAsync(std::function<void(const juce::String& version)> onKnown);
+
+    bool hasProject() const { return projectDirectory != juce::File(); }
+    const juce::File& getProjectDirectory() const { return projectDirectory; }
+
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
+    /** Starts the save watcher, maintenance and backups; later calls do nothing. */
+    void startWatching();
+
+    /** Queues initialising a repository if there isn't one, and restoring managed files (once,
+        however many instances ask). Listeners hear about the new repository.
+    */
+    void checkForGit();
+
+    // Runs git with a direct argv (no shell) in the project directory and returns its stdout
+    juce::String executeGit(const juce::StringArray& arguments, int timeoutMs = -1);
+    ProcessResult runGit(const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag = nullptr, int timeoutMs = -1,
+                         bool lowPriority = false, const std::vector<std::string>& environment = {});
+
+    Tracer& getTracer() { return tracer; }
+    GitJobQueue& getJobQueue() { return jobQueue; }
+    SnapshotScheduler& getSnapshotScheduler() { return snapshotScheduler; }
+    RepositoryMaintenance& getMaintenance() { return maintenance; }
+    RepositoryBackup& getBackup() { return backup; }
+
+    GitJobQueue::JobId runGitJob(const juce::String& description, const juce::Array<juce::StringArray>& steps,
+                                 GitJobQueue::Completion onComplete = nullptr);
+
+    /** Commits what changed, then attaches an audio preview to the new snapshot if a preview source
+        has played anything since the last one.
+    */
+    bool snapshotChangedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag = nullptr,
+                              const juce::String& message = "Auto commit");
+    void queueAutoSnapshot(const juce::StringArray& changedPaths);
+    void takeSnapshot(const juce::String& message, GitJobQueue::Completion onComplete = nullptr);
+
+    GitRepositoryWorker::Summary getRepositorySummary(int maxCommits = -1);
+    std::shared_ptr<GitRepositoryWorker> getRepositoryWorker();
+    std::shared_ptr<CommitHistoryCache> getHistoryCache();
+    std::shared_ptr<AssetStore> getAssetStore();
+    std::shared_ptr<ProjectFileStore> getProjectFileStore();
+    bool isChunkingLargeAudio();
+    void setChunkingLargeAudio(bool shouldChunk);
+
+    void refreshHistory(std::function<void(bool changed)> onDone);
+    void loadMoreHistory(std::function<void(int added)> onDone);
+
+    /** Warms what an editor shows when it opens (the branch summary and the first page of history)
+        on the query queue, so the editor can draw from memory. Later calls do nothing.
+    */
+    void prefetch();
+
+    /** The latest published version of the branch summary and history, from any thread without
+        touching the repository. refreshSummary(), refreshHistory() and loadMoreHistory() publish a
+        new version when what they read differs.
+    */
+    std::shared_ptr<const RepositoryState> getState() const;
+
+    /** Reads the branch summary (no history) on the query queue. onDone is called on the message
+        thread, with changed set if a new state was published.
+    */
+    void refreshSummary(std::function<void(bool changed)> onDone);
+
+    std::shared_ptr<ProjectDiff> getProjectDiff();
+
+    /** What commitOid changed in the set, read on the query queue. onDone gets it on the message
+        thread, straight away if it's cached, and not at all if the job is cancelled. Returns the job
+        to cancel when the caller no longer wants the answer, 0 if there is none.
+    */
+    GitJobQueue::JobId diffSnapshot(const juce::String& commitOid, std::function<void(const ProjectDiff::Result&)> onDone);
+
+    /** Cancels a diff diffSnapshot() queued. */
+    void cancelDiff(GitJobQueue::JobId job);
+
+    std::shared_ptr<AudioOverviewCache> getAudioOverviews();
+
+    /** Overviews of both versions of the audio files a diff found changed, decoded on the analysis
+        queue where they aren't cached. Works like diffSnapshot().
+    */
+    GitJobQueue::JobId compareAudio(const ProjectDiff::Result& diff,
+                                    std::function<void(const std::vector<AudioOverviewCache::Comparison>&)> onDone);
+
+    void cancelAudioComparison(GitJobQueue::JobId job);
+
+    /** Instances whose audio can become a snapshot's preview. The first one that has played something
+        new supplies it, so with the plugin on the master track that's the mix. Message thread.
+    */
+    void addPreviewSource(PreviewCapture* source);
+    void removePreviewSource(PreviewCapture* source);
+
+    std::shared_ptr<PreviewStore> getPreviewStore();
+
+    /** commitOid's audio preview, decoded on the analysis queue. onDone gets nullptr if it has none,
+        and isn't called if the job is cancelled.
+    */
+    GitJobQueue::JobId loadPreview(const juce::String& commitOid,
+                                   std::function<void(std::shared_ptr<const juce::AudioBuffer<float>>, double sampleRate)> onDone);
+
+    void cancelPreviewLoad(GitJobQueue::JobId job);
+
+    std::shared_ptr<MergePreflight> getMergePreflight();
+
+    /** Whether merging branch into target would go through, worked out on the query queue without
+        touching the working tree. Works like diffSnapshot(), except that even a cached answer is
+        looked up on the queue, since the branch tips have to be read to find it.
+    */
+    GitJobQueue::JobId preflightMerge(const juce::String& target, const juce::String& branch,
+                                      std::function<void(const MergePreflight::Result&)> onDone);
+
+    void cancelMergePreflight(GitJobQueue::JobId job);
+
+    /** Sends repositoryHistoryChanged() to every listener. */
+    void notifyHistoryChanged();
+
+    static constexpr int maxPathsPerSnapshot = 1000; // beyond this a full "git add -A" is cheaper than a huge argv
+    static constexpr int samplesBeforeReopen = 8;    // written before a staged checkout reopens the DAW, the rest after
+
+private:
+    explicit RepositoryService(const juce::File& projectDirectory);
+
+    // Callers of a query that hasn't started yet, who all get its answer
+    template <typename Value>
+    struct SharedQuery
+    {
+        std::vector<std::function<void(Value)>> waiting;
+        bool queued = false;
+    };
+
+    template <typename Value>
+    void submitSharedQuery(SharedQuery<Value>& query, const juce::String& description,
+                           std::function<Value()> compute, std::function<void(Value)> onDone);
+
+    // Applies change to a copy of the current state and swaps the copy in, unless change returns false
+    bool publishState(const std::function<bool(RepositoryState&)>& change);
+
+    bool commitChangedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag, const juce::String& message);
+    void attachPreview(const juce::String& commitOid, const std::atomic<bool>* cancelFlag);
+
+    // Swap managed files for their pointer/shadow files before staging, and back after a checkout.
+    // Both run on the job queue.
+    juce::StringArray prepareManagedFiles(const juce::StringArray& changedPaths, const std::atomic<bool>* cancelFlag);
+    bool restoreManagedFiles(const std::atomic<bool>* cancelFlag);
+    // The second stage of a checkout: deferred samples and recordings, in the order the project loads them
+    bool restoreSamples(const std::atomic<bool>* cancelFlag, GitJobQueue::Context* context);
+    // Also true after a restart in the middle of a staged checkout, which the engine keeps on disk
+    bool areSamplesPending();
+    juce::StringArray findSampleLoadOrder();
+    std::shared_ptr<SnapshotBuilder> getSnapshotBuilder();
+    std::shared_ptr<CheckoutEngine> getCheckoutEngine();
+    // "git checkout <branch or commit>" done natively where possible, see CheckoutEngine. Only
+    // Outcome::unsupported leaves it to git; error says why it failed otherwise.
+    CheckoutEngine::Outcome checkoutNatively(const juce::String& target, const std::atomic<bool>* cancelFlag, bool deferSamples,
+                                             juce::String& error);
+
+    static juce::String makeKey(const juce::File& projectDirectory);
+
+    const juce::File projectDirectory;  // juce::File() for the service without a project
+    const juce::String key;
+
+    juce::CriticalSection lock; // the lazily created parts below are reached from several threads
+    std::shared_ptr<GitRepositoryWorker> repositoryWorker;
+    std::shared_ptr<CommitHistoryCache> historyCache;      // same lifetime as repositoryWorker
+    std::shared_ptr<AssetStore> assetStore;
+    std::shared_ptr<ProjectFileStore> projectFileStore;
+    std::shared_ptr<SnapshotBuilder> snapshotBuilder;
+    std::shared_ptr<CheckoutEngine> checkoutEngine;
+    std::shared_ptr<ProjectDiff> projectDiff;
+    std::shared_ptr<AudioOverviewCache> audioOverviews;
+    std::shared_ptr<PreviewStore> previewStore;
+    std::shared_ptr<MergePreflight> mergePreflight;
+    bool managedFilesRestored = false;
+
+    juce::ListenerList<Listener> listeners;
+
+    juce::CriticalSection previewLock;
+    std::vector<PreviewCapture*> previewSources;
+
+    juce::CriticalSection queryLock;
+    SharedQuery<bool> historyQuery;
+    SharedQuery<int> olderHistoryQuery;
+    SharedQuery<bool> summaryQuery;
+    bool prefetched = false;
+
+    juce::CriticalSection stateLock;    // held by writers only; readers use std::atomic_load
+    std::shared_ptr<const RepositoryState> state = std::make_shared<const RepositoryState>();
+
+    juce::CriticalSection autoSnapshotLock;
+    std::set<juce::String> autoSnapshotPaths; // saves collected while an auto snapshot waits
+    bool autoSnapshotEverything = false;
+    bool autoSnapshotScheduled = false;
+    std::atomic<bool> samplesPending { false }; // a staged checkout hasn't written every sample yet
+
+    Tracer tracer; // before the queues, their jobs record into it
+    GitJobQueue jobQueue; // the three queues are stopped first thing in the destructor, their jobs use everything here
+    GitJobQueue queryQueue; // read-only history walks, so they don't wait behind a long snapshot
+    GitJobQueue analysisQueue; // decoding audio, which would hold up history reads for seconds
+    SnapshotScheduler snapshotScheduler { jobQueue, getTransportState(), tracer };
+    RepositoryMaintenance maintenance { jobQueue, snapshotScheduler, getTransportState(),
+                                        [this] { return getRepositoryWorker(); },
+                                        [this](const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)
+                                        { return runGit(arguments, cancelFlag, timeoutMs, true); } };
+    RepositoryBackup backup { getTransportState(),
+                              [this] { return getRepositoryWorker(); },
+                              [this](const juce::StringArray& arguments, const std::atomic<bool>* cancelFlag, int timeoutMs)
+                              { return runGit(arguments, cancelFlag, timeoutMs, true); } };
+    std::unique_ptr<ProjectWatcher> projectWatcher; // after the queues: it submits to them until destroyed
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RepositoryService)
+};
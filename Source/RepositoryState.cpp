@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    RepositoryState.cpp
+
+  ==============================================================================
+*/
+
+#include "RepositoryState.h"
+#include <algorithm>
+
+//==============================================================================
+const RepositoryState::History::Block* RepositoryState::History::findBlock(int index, int& indexInBlock) const
+{
+    if (!juce::isPositiveAndBelow(index, numCommits))
+        return nullptr;
+
+    // The last block starting at or before index
+    const auto next = std::upper_bound(blockStarts.begin(), blockStarts.end(), index);
+
+    if (next == blockStarts.begin())
+        return nullptr;
+
+    const size_t block = (size_t) (next - blockStarts.begin()) - 1;
+    indexInBlock = index - blockStarts[block];
+    return blocks[block].get();
+}
+
+const GitRepositoryWorker::Commit* RepositoryState::History::getCommit(int index) const
+{
+    int indexInBlock = 0;
+    const Block* block = findBlock(index, indexInBlock);
+
+    return block != nullptr && indexInBlock < block->commits.size() ? &block->commits.getReference(indexInBlock) : nullptr;
+}
+
+const CommitGraphLayout::Row* RepositoryState::History::getGraphRow(int index) const
+{
+    int indexInBlock = 0;
+    const Block* block = findBlock(index, indexInBlock);
+
+    return block != nullptr && indexInBlock < (int) block->rows.size() ? &block->rows[(size_t) indexInBlock] : nullptr;
+}
+
+//==============================================================================
+bool RepositoryState::isSameRow(const History* before, const History* after, int row)
+{
+    if (before == after)
+        return true;
+
+    if (before == nullptr || after == nullptr)
+        return false;
+
+    const GitRepositoryWorker::Commit* oldCommit = before->getCommit(row);
+    const GitRepositoryWorker::Commit* newCommit = after->getCommit(row);
+
+    // Neither has a commit there: both are the "loading" row, or past the end
+    if (oldCommit == nullptr || newCommit == nullptr)
+        return oldCommit == newCommit && (before->getNumRows() > row) == (after->getNumRows() > row);
+
+    if (oldCommit->oid != newCommit->oid || before->graphColumns != after->graphColumns)
+        return false;
+
+    const CommitGraphLayout::Row* oldRow = before->getGraphRow(row);
+    const CommitGraphLayout::Row* newRow = after->getGraphRow(row);
+
+    if (oldRow == nullptr || newRow == nullptr)
+        return oldRow == newRow;
+
+    // A row's generation changes whenever its segments do
+    return oldRow->generation == newRow->generation;
+}
+
+bool RepositoryState::isSameSummary(const GitRepositoryWorker::Summary& a, const GitRepositoryWorker::Summary& b)
+{
+    return a.currentBranch == b.currentBranch && a.headOid == b.headOid && a.detached == b.detached && a.branches == b.branches;
+}
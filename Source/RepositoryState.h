@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    RepositoryState.h
+    One published version of what the editors show about a repository.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include "CommitGraphLayout.h"
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/**
+    The branch summary and the loaded history with its graph, as one value
+    that never changes once it's published.
+
+    RepositoryService builds a new version off the message thread whenever a
+    read moves any of it on, and swaps it in atomically. Every editor on the
+    project holds a pointer to the same version and paints from it without a
+    lock or a copy. An editor that is handed a new version compares it with
+    the one it shows, so only the rows that changed get touched.
+
+    Versions share what didn't change: a new branch summary keeps the
+    history it was published with, and a new history keeps the blocks of
+    commits it has in common with the last one.
+*/
+struct RepositoryState
+{
+    struct History
+    {
+        /** A run of consecutive commits and their rows. Never changed once published, so
+            every version that still holds it shares it: a new version only adds blocks,
+            or replaces the few at either end that changed.
+        */
+        struct Block
+        {
+            juce::Array<GitRepositoryWorker::Commit> commits;   // newest first
+            std::vector<CommitGraphLayout::Row> rows;           // a row per commit
+        };
+
+        static constexpr int blockSize = 256;   // commits a block holds at most
+
+        juce::String tip;
+        std::vector<std::shared_ptr<const Block>> blocks;   // newest first
+        std::vector<int> blockStarts;                       // the index of each block's first commit
+        int numCommits = 0;
+        int graphColumns = 0;
+        bool complete = true;                               // false while there are older commits to load
+
+        /** Rows the list shows: the commits, and one more while older ones are left to load. */
+        int getNumRows() const { return numCommits + (complete ? 0 : 1); }
+        int getNumCommits() const { return numCommits; }
+
+        const GitRepositoryWorker::Commit* getCommit(int index) const;
+        const CommitGraphLayout::Row* getGraphRow(int index) const;
+
+    private:
+        const Block* findBlock(int index, int& indexInBlock) const;
+    };
+
+    juce::uint32 version = 0;                   // goes up with every version published
+    GitRepositoryWorker::Summary summary;       // branches only, without history
+    bool hasSummary = false;
+    std::shared_ptr<const History> history;     // null until the first read
+
+    /** True if row draws the same in both histories: same commit, same lanes, same width of graph. */
+    static bool isSameRow(const History* before, const History* after, int row);
+
+    static bool isSameSummary(const GitRepositoryWorker::Summary& a, const GitRepositoryWorker::Summary& b);
+};
@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    Sha1.cpp
+
+  ==============================================================================
+*/
+
+#include "Sha1.h"
+#include <cstring>
+
+namespace
+{
+    inline uint32_t rotateLeft(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+}
+
+//==============================================================================
+Sha1::Sha1()
+    : state { 0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u, 0xc3d2e1f0u }
+{
+}
+
+void Sha1::update(const void* data, size_t numBytes)
+{
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    totalBytes += numBytes;
+
+    if (bufferUsed > 0)
+    {
+        const size_t toCopy = juce::jmin(numBytes, sizeof(buffer) - bufferUsed);
+        std::memcpy(buffer + bufferUsed, bytes, toCopy);
+        bufferUsed += toCopy;
+        bytes += toCopy;
+        numBytes -= toCopy;
+
+        if (bufferUsed < sizeof(buffer))
+            return;
+
+        processBlock(buffer);
+        bufferUsed = 0;
+    }
+
+    // Whole blocks straight from the caller's memory, no copy
+    for (; numBytes >= sizeof(buffer); bytes += sizeof(buffer), numBytes -= sizeof(buffer))
+        processBlock(bytes);
+
+    std::memcpy(buffer, bytes, numBytes);
+    bufferUsed = numBytes;
+}
+
+Sha1::Digest Sha1::finish()
+{
+    const uint64_t totalBits = totalBytes * 8;
+
+    uint8_t padding[72] = { 0x80 };
+    const size_t paddingSize = (bufferUsed < 56 ? 56 : 120) - bufferUsed;
+    update(padding, paddingSize);
+
+    uint8_t length[8];
+    for (int i = 0; i < 8; ++i)
+        length[i] = (uint8_t) (totalBits >> (56 - 8 * i));
+
+    update(length, sizeof(length));
+    jassert(bufferUsed == 0);
+
+    Digest digest;
+    for (int i = 0; i < 20; ++i)
+        digest[(size_t) i] = (uint8_t) (state[i / 4] >> (24 - 8 * (i % 4)));
+
+    return digest;
+}
+
+Sha1::Digest Sha1::hash(const void* data, size_t numBytes)
+{
+    Sha1 sha;
+    sha.update(data, numBytes);
+    return sha.finish();
+}
+
+juce::String Sha1::toHex(const Digest& digest)
+{
+    return juce::String::toHexString(digest.data(), (int) digest.size(), 0);
+}
+
+//==============================================================================
+void Sha1::processBlock(const uint8_t* block)
+{
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; ++i)
+        w[i] = ((uint32_t) block[i * 4] << 24) | ((uint32_t) block[i * 4 + 1] << 16)
+             | ((uint32_t) block[i * 4 + 2] << 8) | (uint32_t) block[i * 4 + 3];
+
+    for (int i = 16; i < 80; ++i)
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    for (int i = 0; i < 80; ++i)
+    {
+        uint32_t f, k;
+
+        if (i < 20)      { f = (b & c) | (~b & d);           k = 0x5a827999u; }
+        else if (i < 40) { f = b ^ c ^ d;                    k = 0x6ed9eba1u; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8f1bbcdcu; }
+        else             { f = b ^ c ^ d;                    k = 0xca62c1d6u; }
+
+        const uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
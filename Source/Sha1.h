@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    Sha1.h
+    Incremental SHA-1, the hash git names its objects with.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <cstdint>
+
+//==============================================================================
+/**
+    Feed data with update() in as many pieces as you like, then call finish()
+    once. Not a security primitive: it's here to produce names that match
+    git's and to tell content apart.
+*/
+class Sha1
+{
+public:
+    using Digest = std::array<uint8_t, 20>;
+
+    Sha1();
+
+    void update(const void* data, size_t numBytes);
+    Digest finish();
+
+    static Digest hash(const void* data, size_t numBytes);
+    static juce::String toHex(const Digest& digest);
+
+private:
+    void processBlock(const uint8_t* block);
+
+    uint32_t state[5];
+    uint8_t buffer[64];
+    size_t bufferUsed = 0;
+    uint64_t totalBytes = 0;
+};
@@ -0,0 +1,1776 @@
+/*
+  ==============================================================================
+
+    SnapshotBuilder.cpp
+
+  ==============================================================================
+*/
+
+#include "SnapshotBuilder.h"
+#include "ProcessRunner.h"
+#include "GitParser.h"
+#include "Sha1.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <set>
+#include <thread>
+
+#if ! JUCE_WINDOWS
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+struct SnapshotBuilder::Entry
+{
+    std::string path;   // UTF-8, '/' separated, relative to the project
+    uint32_t ctimeSec = 0, ctimeNsec = 0;
+    uint32_t mtimeSec = 0, mtimeNsec = 0;
+    uint32_t dev = 0, ino = 0;
+    uint32_t mode = 0;  // git's: 0100644, 0100755, 0120000 or 0160000
+    uint32_t previousMode = 0;
+    uint32_t uid = 0, gid = 0;
+    uint32_t size = 0;  // truncated to 32 bits, like git's
+    juce::int64 fullSize = 0;
+    uint8_t oid[20] = {};
+
+    bool needsHash = false;
+    bool removed = false;
+    bool blobWritten = false;
+};
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    bool isCancelled(const std::atomic<bool>* cancelFlag)
+    {
+        return cancelFlag != nullptr && cancelFlag->load();
+    }
+
+    constexpr uint32_t modeRegular = 0100644;
+    constexpr uint32_t modeExecutable = 0100755;
+    constexpr uint32_t modeSymlink = 0120000;
+    constexpr uint32_t modeGitlink = 0160000;
+    constexpr uint32_t modeTree = 040000;
+
+    uint32_t readBigEndian32(const uint8_t* p)
+    {
+        return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+    }
+
+    void appendBigEndian32(std::string& out, uint32_t value)
+    {
+        const char bytes[4] = { (char) (value >> 24), (char) (value >> 16), (char) (value >> 8), (char) value };
+        out.append(bytes, 4);
+    }
+
+    void appendBigEndian16(std::string& out, uint16_t value)
+    {
+        const char bytes[2] = { (char) (value >> 8), (char) value };
+        out.append(bytes, 2);
+    }
+
+    std::string toHex(const uint8_t* oid)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(40, '0');
+
+        for (int i = 0; i < 20; ++i)
+        {
+            hex[(size_t) i * 2] = digits[oid[i] >> 4];
+            hex[(size_t) i * 2 + 1] = digits[oid[i] & 15];
+        }
+
+        return hex;
+    }
+
+    bool fromHex(const juce::String& hex, uint8_t* oid)
+    {
+        if (hex.length() != 40)
+            return false;
+
+        for (int i = 0; i < 20; ++i)
+        {
+            const int high = juce::CharacterFunctions::getHexDigitValue(hex[i * 2]);
+            const int low = juce::CharacterFunctions::getHexDigitValue(hex[i * 2 + 1]);
+            if (high < 0 || low < 0)
+                return false;
+            oid[i] = (uint8_t) ((high << 4) | low);
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    struct FileStat
+    {
+        bool exists = false;
+        bool isDirectory = false;
+        bool isSymlink = false;
+        bool isExecutable = false;
+        uint32_t ctimeSec = 0, ctimeNsec = 0, mtimeSec = 0, mtimeNsec = 0;
+        uint32_t dev = 0, ino = 0, uid = 0, gid = 0;
+        juce::int64 size = 0;
+    };
+
+    FileStat statPath(const juce::File& file)
+    {
+        FileStat result;
+
+       #if JUCE_WINDOWS
+        if (file.isDirectory())
+        {
+            result.exists = result.isDirectory = true;
+            return result;
+        }
+
+        if (!file.existsAsFile())
+            return result;
+
+        const juce::int64 modified = file.getLastModificationTime().toMilliseconds();
+        const juce::int64 created = file.getCreationTime().toMilliseconds();
+        result.exists = true;
+        result.size = file.getSize();
+        result.mtimeSec = (uint32_t) (modified / 1000);
+        result.mtimeNsec = (uint32_t) (modified % 1000) * 1000000;
+        result.ctimeSec = (uint32_t) (created / 1000);
+        result.ctimeNsec = (uint32_t) (created % 1000) * 1000000;
+       #else
+        struct stat info;
+        if (::lstat(file.getFullPathName().toRawUTF8(), &info) != 0)
+            return result;
+
+        result.exists = true;
+        result.isDirectory = S_ISDIR(info.st_mode);
+        result.isSymlink = S_ISLNK(info.st_mode);
+        result.isExecutable = (info.st_mode & S_IXUSR) != 0;
+        result.size = (juce::int64) info.st_size;
+        result.dev = (uint32_t) info.st_dev;
+        result.ino = (uint32_t) info.st_ino;
+        result.uid = (uint32_t) info.st_uid;
+        result.gid = (uint32_t) info.st_gid;
+
+        #if JUCE_MAC
+         result.mtimeSec = (uint32_t) info.st_mtimespec.tv_sec;
+         result.mtimeNsec = (uint32_t) info.st_mtimespec.tv_nsec;
+         result.ctimeSec = (uint32_t) info.st_ctimespec.tv_sec;
+         result.ctimeNsec = (uint32_t) info.st_ctimespec.tv_nsec;
+        #else
+         result.mtimeSec = (uint32_t) info.st_mtim.tv_sec;
+         result.mtimeNsec = (uint32_t) info.st_mtim.tv_nsec;
+         result.ctimeSec = (uint32_t) info.st_ctim.tv_sec;
+         result.ctimeNsec = (uint32_t) info.st_ctim.tv_nsec;
+        #endif
+       #endif
+
+        return result;
+    }
+
+    bool statMatches(const SnapshotBuilder::Entry& entry, const FileStat& stat)
+    {
+        return entry.mtimeSec == stat.mtimeSec && entry.mtimeNsec == stat.mtimeNsec
+            && entry.ctimeSec == stat.ctimeSec && entry.ctimeNsec == stat.ctimeNsec
+            && entry.ino == stat.ino && entry.size == (uint32_t) stat.size;
+    }
+
+    void copyStat(SnapshotBuilder::Entry& entry, const FileStat& stat)
+    {
+        entry.ctimeSec = stat.ctimeSec;
+        entry.ctimeNsec = stat.ctimeNsec;
+        entry.mtimeSec = stat.mtimeSec;
+        entry.mtimeNsec = stat.mtimeNsec;
+        entry.dev = stat.dev;
+        entry.ino = stat.ino;
+        entry.uid = stat.uid;
+        entry.gid = stat.gid;
+        entry.size = (uint32_t) stat.size;
+        entry.fullSize = stat.size;
+    }
+
+    // Reads a whole working-tree file into buffer, to its end as it is now, which needn't be the size
+    // it was stat'ed with. False if it can't be opened.
+    bool readWorkingFile(const juce::File& file, juce::int64 expectedSize, std::vector<char>& buffer, size_t& size)
+    {
+        juce::FileInputStream in(file);
+        if (!in.openedOk())
+            return false;
+
+        // One byte more than expected, so a file that grew doesn't need another allocation to notice
+        buffer.resize((size_t) juce::jmax((juce::int64) 0, expectedSize) + 1);
+        size = 0;
+
+        for (;;)
+        {
+            if (size == buffer.size())
+                buffer.resize(buffer.size() + (size_t) SnapshotBuilder::readBlockSize);
+
+            const int read = in.read(buffer.data() + size, (int) juce::jmin(buffer.size() - size, (size_t) SnapshotBuilder::readBlockSize));
+            if (read <= 0)
+                return true;
+
+            size += (size_t) read;
+        }
+    }
+
+    // The blob id a file in the working tree would get, without writing the object.
+    // Empty if it can't be read or changes size while it's read.
+    std::string hashWorkingFile(const juce::File& file, const FileStat& stat)
+    {
+        std::vector<char> buffer;
+        size_t size = 0;
+        Sha1 sha;
+
+       #if ! JUCE_WINDOWS
+        if (stat.isSymlink)
+        {
+            buffer.resize(4096);
+            const ssize_t length = ::readlink(file.getFullPathName().toRawUTF8(), buffer.data(), buffer.size());
+            if (length < 0)
+                return {};
+
+            const std::string header = "blob " + std::to_string(length) + std::string(1, '\0');
+            sha.update(header.data(), header.size());
+            sha.update(buffer.data(), (size_t) length);
+        }
+        else
+       #endif
+        {
+            // Streamed, so a large file doesn't have to fit in memory
+            juce::FileInputStream in(file);
+            if (!in.openedOk())
+                return {};
+
+            const std::string header = "blob " + std::to_string(stat.size) + std::string(1, '\0');
+            sha.update(header.data(), header.size());
+            buffer.resize((size_t) SnapshotBuilder::readBlockSize);
+
+            for (;;)
+            {
+                const int read = in.read(buffer.data(), (int) buffer.size());
+                if (read <= 0)
+                    break;
+
+                sha.update(buffer.data(), (size_t) read);
+                size += (size_t) read;
+            }
+
+            if ((juce::int64) size != stat.size)
+                return {};
+        }
+
+        const Sha1::Digest digest = sha.finish();
+        return std::string((const char*) digest.data(), digest.size());
+    }
+
+    //==============================================================================
+    // Git's wildmatch with WM_PATHNAME: '*' and '?' stop at '/', "**" between slashes spans directories
+    bool wildmatch(const char* pattern, const char* patternStart, const char* text)
+    {
+        for (const char* p = pattern; *p != 0; ++p, ++text)
+        {
+            if (*p == '*')
+            {
+                if (p[1] == '*' && (p == patternStart || p[-1] == '/') && (p[2] == '/' || p[2] == 0))
+                {
+                    if (p[2] == 0)
+                        return true;
+
+                    // "**/" matches zero or more whole directories
+                    for (const char* t = text;; ++t)
+                    {
+                        if (wildmatch(p + 3, patternStart, t))
+                            return true;
+
+                        t = std::strchr(t, '/');
+                        if (t == nullptr)
+                            return false;
+                    }
+                }
+
+                while (p[1] == '*')
+                    ++p;
+
+                for (const char* t = text;; ++t)
+                {
+                    if (wildmatch(p + 1, patternStart, t))
+                        return true;
+                    if (*t == 0 || *t == '/')
+                        return false;
+                }
+            }
+
+            if (*text == 0)
+                return false;
+
+            if (*p == '?')
+            {
+                if (*text == '/')
+                    return false;
+                continue;
+            }
+
+            if (*p == '[')
+            {
+                const char* q = p + 1;
+                const bool negated = *q == '!' || *q == '^';
+                if (negated)
+                    ++q;
+
+                bool matched = false;
+                bool first = true;
+
+                for (; *q != 0 && (*q != ']' || first); ++q, first = false)
+                {
+                    char low = *q;
+                    if (low == '\\' && q[1] != 0)
+                        low = *++q;
+
+                    char high = low;
+                    if (q[1] == '-' && q[2] != 0 && q[2] != ']')
+                    {
+                        q += 2;
+                        if (*q == '\\' && q[1] != 0)
+                            ++q;
+                        high = *q;
+                    }
+
+                    if ((unsigned char) *text >= (unsigned char) low && (unsigned char) *text <= (unsigned char) high)
+                        matched = true;
+                }
+
+                if (*q != ']' || matched == negated || *text == '/')
+                    return false;
+
+                p = q;
+                continue;
+            }
+
+            if (*p == '\\' && p[1] != 0)
+                ++p;
+
+            if (*p != *text)
+                return false;
+        }
+
+        return *text == 0;
+    }
+
+    //==============================================================================
+    bool hasConversionAttributes(const juce::File& attributesFile)
+    {
+        juce::StringArray lines;
+        lines.addLines(attributesFile.loadFileAsString());
+
+        for (const auto& line : lines)
+        {
+            if (line.trimStart().startsWithChar('#'))
+                continue;
+
+            juce::StringArray tokens;
+            tokens.addTokens(line, " \t", "\"");
+
+            for (int i = 1; i < tokens.size(); ++i)
+            {
+                const juce::String& token = tokens[i];
+
+                // Anything that makes "git add" change bytes on the way in
+                if (token == "text" || token.startsWith("text=") || token.startsWith("eol=") || token == "crlf"
+                    || token.startsWith("filter=") || token == "ident" || token.startsWith("working-tree-encoding="))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+//==============================================================================
+struct SnapshotBuilder::IgnoreRules
+{
+    struct Rule
+    {
+        std::string pattern;
+        std::string base;   // directory of the .gitignore it came from, "" for the root
+        bool negated = false;
+        bool directoryOnly = false;
+        bool anchored = false;
+    };
+
+    void addFile(const juce::File& file, const std::string& base)
+    {
+        juce::StringArray lines;
+        lines.addLines(file.loadFileAsString());
+
+        for (auto line : lines)
+        {
+            // Trailing spaces go unless escaped
+            while (line.endsWithChar(' ') && !line.endsWith("\\ "))
+                line = line.dropLastCharacters(1);
+
+            if (line.isEmpty() || line.startsWithChar('#'))
+                continue;
+
+            Rule rule;
+            rule.base = base;
+
+            if (line.startsWithChar('!'))
+            {
+                rule.negated = true;
+                line = line.substring(1);
+            }
+
+            if (line.endsWithChar('/'))
+            {
+                rule.directoryOnly = true;
+                line = line.dropLastCharacters(1);
+            }
+
+            rule.anchored = line.containsChar('/');
+            if (line.startsWithChar('/'))
+                line = line.substring(1);
+
+            rule.pattern = line.toStdString();
+            rules.push_back(std::move(rule));
+        }
+    }
+
+    // Rules are in ascending precedence, so the last one that matches decides
+    bool isIgnored(const std::string& path, bool isDirectory) const
+    {
+        for (auto rule = rules.rbegin(); rule != rules.rend(); ++rule)
+        {
+            if (rule->directoryOnly && !isDirectory)
+                continue;
+
+            std::string relative = path;
+            if (!rule->base.empty())
+            {
+                if (path.compare(0, rule->base.size(), rule->base) != 0 || path.size() <= rule->base.size()
+                    || path[rule->base.size()] != '/')
+                    continue;
+
+                relative = path.substr(rule->base.size() + 1);
+            }
+
+            if (!rule->anchored)
+            {
+                const size_t slash = relative.rfind('/');
+                if (slash != std::string::npos)
+                    relative = relative.substr(slash + 1);
+            }
+
+            if (wildmatch(rule->pattern.c_str(), rule->pattern.c_str(), relative.c_str()))
+                return !rule->negated;
+        }
+
+        return false;
+    }
+
+    std::vector<Rule> rules;
+};
+
+//==============================================================================
+SnapshotBuilder::SnapshotBuilder(const juce::File& project, const juce::File& git, const juce::File& common)
+    : projectDirectory(project),
+      gitDirectory(git),
+      commonDirectory(common),
+      objectsDirectory(common.getChildFile("objects")),
+      privateIndexFile(git.getChildFile("snaptrack").getChildFile("index"))
+{
+}
+
+SnapshotBuilder::~SnapshotBuilder() = default;
+
+bool SnapshotBuilder::readConfiguration()
+{
+    if (configurationRead)
+        return true;
+
+    ProcessRunner::Options options;
+    options.workingDirectory = projectDirectory.getFullPathName().toStdString();
+    options.timeoutMs = 10000;
+    options.lowPriority = true;
+
+    ProcessResult result = ProcessRunner::run({ "git", "config", "-z", "--get-regexp",
+        "^(core\\.(autocrlf|filemode|symlinks|excludesfile|splitindex|sparsecheckout)|index\\.version|feature\\.manyfiles)$" },
+        options);
+
+    // Exit code 1 just means none of them are set
+    if (!result.launched || (result.exitCode != 0 && result.exitCode != 1))
+        return false;
+
+    configurationRead = true;
+    juce::File excludesFile;
+
+    std::vector<GitParser::ConfigEntry> entries;
+    GitParser::parseConfig({ result.output.data(), result.output.size() }, entries);
+
+    for (const auto& entry : entries)
+    {
+        const juce::String key = GitParser::toString(entry.key).toLowerCase();
+        const juce::String value = GitParser::toString(entry.value).trim();
+        const bool isTrue = value.equalsIgnoreCase("true") || value == "1" || value.equalsIgnoreCase("yes") || value.isEmpty();
+
+        if (key == "core.autocrlf" && !value.equalsIgnoreCase("false"))
+            configurationSupported = false;
+        else if ((key == "core.splitindex" || key == "core.sparsecheckout") && isTrue)
+            configurationSupported = false;
+        else if ((key == "index.version" && value.getIntValue() >= 4) || (key == "feature.manyfiles" && isTrue))
+            configurationSupported = false;
+        else if (key == "core.filemode")
+            trustFileMode = isTrue;
+        else if (key == "core.symlinks")
+            useSymlinks = isTrue;
+        else if (key == "core.excludesfile")
+            excludesFile = value.startsWith("~/") ? juce::File::getSpecialLocation(juce::File::userHomeDirectory).getChildFile(value.substring(2))
+                                                  : juce::File(value);
+    }
+
+    if (excludesFile == juce::File())
+    {
+        const juce::String xdg = juce::SystemStats::getEnvironmentVariable("XDG_CONFIG_HOME", {});
+        const juce::File configHome = xdg.isNotEmpty() ? juce::File(xdg)
+                                                       : juce::File::getSpecialLocation(juce::File::userHomeDirectory).getChildFile(".config");
+        excludesFile = configHome.getChildFile("git").getChildFile("ignore");
+    }
+
+    globalExcludesFile = excludesFile;
+
+   #if JUCE_WINDOWS
+    useSymlinks = false;
+   #endif
+
+    if (gitDirectory.getChildFile("info").getChildFile("attributes").existsAsFile()
+        && hasConversionAttributes(gitDirectory.getChildFile("info").getChildFile("attributes")))
+        configurationSupported = false;
+
+    return true;
+}
+
+//==============================================================================
+SnapshotBuilder::Outcome SnapshotBuilder::snapshot(GitRepositoryWorker& worker, const juce::StringArray& changedPaths, const juce::String& message,
+                                                   const std::atomic<bool>* cancelFlag)
+{
+    const auto start = Clock::now();
+    const juce::int64 startSeconds = juce::Time::currentTimeMillis() / 1000;
+    statistics = Statistics();
+
+    if (!readConfiguration() || !configurationSupported)
+        return Outcome::unsupported;
+
+    // Staged in our own index, so a git command holding .git/index.lock doesn't stop us
+    const juce::String headOid = worker.resolveRef("HEAD");
+    const std::string headTree = readCommitTree(worker, headOid);
+
+    std::vector<Entry> entries;
+    std::map<std::string, std::pair<std::string, int>> cacheTree; // directory -> (raw tree id, entry count)
+    bool reseeded = false;
+
+    if (!loadPrivateIndex(worker, headTree, entries, cacheTree, reseeded))
+        return Outcome::unsupported;
+
+    // A fresh copy only has stat data to go by, so every file has to be looked at
+    const bool fullScan = changedPaths.isEmpty() || reseeded;
+
+    statistics.numIndexEntries = (int) entries.size();
+
+    for (const auto& entry : entries)
+    {
+        const bool isAttributes = entry.path == ".gitattributes"
+                               || (entry.path.size() > 15 && entry.path.compare(entry.path.size() - 15, 15, "/.gitattributes") == 0);
+
+        if (isAttributes && hasConversionAttributes(projectDirectory.getChildFile(juce::String::fromUTF8(entry.path.c_str()))))
+            return Outcome::unsupported;
+    }
+
+    //==============================================================================
+    // Find what changed: stat tracked files, look for new ones
+    auto findEntry = [&entries](const std::string& path) -> Entry*
+    {
+        auto it = std::lower_bound(entries.begin(), entries.end(), path,
+                                   [](const Entry& e, const std::string& p) { return e.path < p; });
+        return it != entries.end() && it->path == path ? &*it : nullptr;
+    };
+
+    std::vector<Entry> added;
+    bool foundConversionAttributes = false;
+
+    auto refreshEntry = [this](Entry& entry)
+    {
+        if (entry.mode == modeGitlink)
+            return;
+
+        const FileStat stat = statPath(projectDirectory.getChildFile(juce::String::fromUTF8(entry.path.c_str())));
+        ++statistics.numStatted;
+
+        if (!stat.exists || stat.isDirectory || (stat.isSymlink && !useSymlinks))
+        {
+            entry.removed = true;
+            return;
+        }
+
+        const uint32_t mode = stat.isSymlink ? modeSymlink
+                            : !trustFileMode ? (entry.mode == modeExecutable ? modeExecutable : modeRegular)
+                            : stat.isExecutable ? modeExecutable : modeRegular;
+
+        if (!statMatches(entry, stat) || entry.mode != mode)
+        {
+            copyStat(entry, stat);
+            entry.previousMode = entry.mode;
+            entry.mode = mode;
+            entry.needsHash = true;
+        }
+    };
+
+    auto addNewFile = [&](const std::string& path, const FileStat& stat)
+    {
+        if (stat.isSymlink && !useSymlinks)
+            return;
+
+        Entry entry;
+        entry.path = path;
+        copyStat(entry, stat);
+        entry.mode = stat.isSymlink ? modeSymlink : (trustFileMode && stat.isExecutable) ? modeExecutable : modeRegular;
+        entry.needsHash = true;
+
+        if (juce::File::createFileWithoutCheckingPath(juce::String::fromUTF8(path.c_str())).getFileName() == ".gitattributes"
+            && hasConversionAttributes(projectDirectory.getChildFile(juce::String::fromUTF8(path.c_str()))))
+            foundConversionAttributes = true;
+
+        added.push_back(std::move(entry));
+    };
+
+    IgnoreRules ignoreRules;
+    ignoreRules.addFile(globalExcludesFile, {});
+    ignoreRules.addFile(commonDirectory.getChildFile("info").getChildFile("exclude"), {});
+
+    // Walks a directory for files the index doesn't know, loading .gitignore files on the way down
+    std::function<void(const juce::File&, const std::string&)> walk = [&](const juce::File& directory, const std::string& relativePath)
+    {
+        const size_t numRules = ignoreRules.rules.size();
+        ignoreRules.addFile(directory.getChildFile(".gitignore"), relativePath);
+
+        for (const auto& item : juce::RangedDirectoryIterator(directory, false, "*", juce::File::findFilesAndDirectories))
+        {
+            if (isCancelled(cancelFlag))
+                break;
+
+            const juce::File file = item.getFile();
+            const std::string name = file.getFileName().toStdString();
+            const std::string path = relativePath.empty() ? name : relativePath + "/" + name;
+
+            if (name == ".git")
+                continue;
+
+            const FileStat stat = statPath(file);
+            if (!stat.exists)
+                continue;
+
+            if (stat.isDirectory)
+            {
+                // Submodules stay as they are; ignored directories are never entered
+                Entry* gitlink = findEntry(path);
+                if (gitlink != nullptr || ignoreRules.isIgnored(path, true))
+                    continue;
+
+                walk(file, path);
+            }
+            else if (findEntry(path) == nullptr && !ignoreRules.isIgnored(path, false))
+            {
+                addNewFile(path, stat);
+            }
+        }
+
+        ignoreRules.rules.resize(numRules);
+    };
+
+    // For a single path the watcher reported: are it or any of its parent directories ignored?
+    auto isIgnoredWithParents = [&](const std::string& path, bool isDirectory)
+    {
+        IgnoreRules rules;
+        rules.rules = ignoreRules.rules;
+        rules.addFile(projectDirectory.getChildFile(".gitignore"), {});
+
+        for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+        {
+            const std::string parent = path.substr(0, slash);
+            if (rules.isIgnored(parent, true))
+                return true;
+
+            rules.addFile(projectDirectory.getChildFile(juce::String::fromUTF8(parent.c_str())).getChildFile(".gitignore"), parent);
+        }
+
+        return rules.isIgnored(path, isDirectory);
+    };
+
+    const auto walkStart = Clock::now();
+
+    if (fullScan)
+    {
+        for (auto& entry : entries)
+            refreshEntry(entry);
+
+        walk(projectDirectory, {});
+    }
+    else
+    {
+        for (const auto& changedPath : changedPaths)
+        {
+            const std::string path = changedPath.toStdString();
+            const juce::File file = projectDirectory.getChildFile(changedPath);
+
+            if (Entry* entry = findEntry(path))
+            {
+                refreshEntry(*entry);
+                continue;
+            }
+
+            // A directory that was moved or deleted: everything the index has under it
+            const std::string prefix = path + "/";
+            for (auto it = std::lower_bound(entries.begin(), entries.end(), prefix,
+                                            [](const Entry& e, const std::string& p) { return e.path < p; });
+                 it != entries.end() && it->path.compare(0, prefix.size(), prefix) == 0; ++it)
+                refreshEntry(*it);
+
+            const FileStat stat = statPath(file);
+
+            if (!stat.exists || isIgnoredWithParents(path, stat.isDirectory))
+                continue;
+
+            if (stat.isDirectory)
+            {
+                // Rules of the directories above it, then the walk adds its own
+                IgnoreRules saved = ignoreRules;
+                ignoreRules.addFile(projectDirectory.getChildFile(".gitignore"), {});
+                for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+                    ignoreRules.addFile(projectDirectory.getChildFile(juce::String::fromUTF8(path.substr(0, slash).c_str()))
+                                                        .getChildFile(".gitignore"), path.substr(0, slash));
+                walk(file, path);
+                ignoreRules = saved;
+            }
+            else
+            {
+                addNewFile(path, stat);
+            }
+        }
+    }
+
+    statistics.walkMs = millisecondsSince(walkStart);
+
+    if (isCancelled(cancelFlag))
+        return Outcome::cancelled;
+
+    if (foundConversionAttributes)
+        return Outcome::unsupported;
+
+    //==============================================================================
+    // Hash what changed
+    std::vector<Entry*> dirty;
+    std::vector<std::pair<Entry*, std::string>> previousIds;
+
+    for (auto& entry : entries)
+        if (entry.needsHash && !entry.removed)
+        {
+            dirty.push_back(&entry);
+            previousIds.emplace_back(&entry, std::string((const char*) entry.oid, 20));
+        }
+
+    for (auto& entry : added)
+        dirty.push_back(&entry);
+
+    const auto hashStart = Clock::now();
+
+    if (!hashEntries(dirty, cancelFlag))
+        return isCancelled(cancelFlag) ? Outcome::cancelled : Outcome::failed;
+
+    statistics.hashMs = millisecondsSince(hashStart);
+
+    // Directories whose tree has to be rebuilt: every parent of a real change
+    std::set<std::string> dirtyDirectories;
+    auto markParents = [&dirtyDirectories](const std::string& path)
+    {
+        dirtyDirectories.insert(std::string());
+        for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+            dirtyDirectories.insert(path.substr(0, slash));
+    };
+
+    for (const auto& previous : previousIds)
+        if (std::memcmp(previous.first->oid, previous.second.data(), 20) != 0 || previous.first->mode != previous.first->previousMode)
+            markParents(previous.first->path);
+
+    for (const auto& entry : entries)
+        if (entry.removed)
+            markParents(entry.path);
+
+    for (const auto& entry : added)
+        markParents(entry.path);
+
+    std::vector<Entry> merged;
+    merged.reserve(entries.size() + added.size());
+    for (auto& entry : entries)
+        if (!entry.removed)
+            merged.push_back(std::move(entry));
+    for (auto& entry : added)
+        merged.push_back(std::move(entry));
+
+    std::sort(merged.begin(), merged.end(), [](const Entry& a, const Entry& b) { return a.path < b.path; });
+
+    //==============================================================================
+    // Trees: reuse the cache-tree id of every directory that didn't change
+    const auto treeStart = Clock::now();
+    std::string cacheTreeExtension;
+    const std::string rootTree = writeTrees(merged, cacheTree, dirtyDirectories, cacheTreeExtension);
+    statistics.treeMs = millisecondsSince(treeStart);
+
+    if (rootTree.empty())
+        return Outcome::failed;
+
+    if (!writeIndex(merged, cacheTreeExtension, startSeconds))
+        return Outcome::failed;
+
+    //==============================================================================
+    // Commit, unless the tree is what HEAD already has
+    const juce::String rootTreeHex = toHex((const uint8_t*) rootTree.data());
+
+    if (headOid.isNotEmpty() && rootTree == headTree)
+    {
+        statistics.totalMs = millisecondsSince(start);
+        return Outcome::nothingToCommit;
+    }
+
+    ProcessRunner::Options options;
+    options.workingDirectory = projectDirectory.getFullPathName().toStdString();
+    options.timeoutMs = 10000;
+    options.lowPriority = true;
+    ProcessResult identResult = ProcessRunner::run({ "git", "var", "GIT_COMMITTER_IDENT" }, options);
+    const juce::String ident = juce::String::fromUTF8(identResult.output.data(), (int) identResult.output.size()).trim();
+
+    if (!identResult.succeeded() || ident.isEmpty())
+        return Outcome::unsupported; // no user.name/email: let git explain
+
+    juce::String commit;
+    commit << "tree " << rootTreeHex << "\n";
+    if (headOid.isNotEmpty())
+        commit << "parent " << headOid << "\n";
+    commit << "author " << ident << "\n"
+           << "committer " << ident << "\n\n"
+           << message.trimEnd() << "\n";
+
+    const std::string commitText = commit.toStdString();
+    std::string commitOid;
+    bool commitWritten = false;
+
+    if (!writeLooseObject("commit", commitText.data(), commitText.size(), commitOid, commitWritten))
+        return Outcome::failed;
+
+    // Which ref moves: the checked out branch, or a new one for a detached HEAD
+    const juce::String head = gitDirectory.getChildFile("HEAD").loadFileAsString().trim();
+    juce::String branchRef;
+    bool newBranch = false;
+
+    if (head.startsWith("ref:"))
+    {
+        branchRef = head.fromFirstOccurrenceOf("ref:", false, false).trim();
+    }
+    else
+    {
+        branchRef = "refs/heads/" + headOid.substring(0, 7) + "-branch";
+        newBranch = true;
+
+        if (worker.resolveRef(branchRef).isNotEmpty())
+            return Outcome::unsupported;
+    }
+
+    const juce::String subject = message.upToFirstOccurrenceOf("\n", false, false);
+
+    if (!updateBranch(worker, branchRef, newBranch ? std::string() : headOid.toStdString(), commitOid, ident,
+                      (headOid.isEmpty() ? "commit (initial): " : "commit: ") + subject))
+        return Outcome::failed;
+
+    if (newBranch)
+    {
+        const juce::File headLock = gitDirectory.getChildFile("HEAD.lock");
+        if (!headLock.replaceWithText("ref: " + branchRef + "\n") || !headLock.moveFileTo(gitDirectory.getChildFile("HEAD")))
+            return Outcome::failed;
+    }
+
+    noteCommitted(worker, headTree);
+
+    statistics.totalMs = millisecondsSince(start);
+    return Outcome::committed;
+}
+
+//==============================================================================
+bool SnapshotBuilder::readIndex(const juce::File& indexFile, std::vector<Entry>& entries,
+                                std::map<std::string, std::pair<std::string, int>>& cacheTree)
+{
+    if (!indexFile.existsAsFile())
+        return true; // nothing staged yet
+
+    juce::MemoryBlock data;
+    if (!indexFile.loadFileAsData(data) || data.getSize() < 12 + 20)
+        return false;
+
+    const auto* bytes = static_cast<const uint8_t*>(data.getData());
+    const size_t end = data.getSize() - 20;
+
+    if (std::memcmp(bytes, "DIRC", 4) != 0)
+        return false;
+
+    const uint32_t version = readBigEndian32(bytes + 4);
+    const uint32_t count = readBigEndian32(bytes + 8);
+
+    if (version != 2 && version != 3)
+        return false;
+
+    size_t pos = 12;
+    entries.reserve(count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (pos + 62 > end)
+            return false;
+
+        const uint8_t* p = bytes + pos;
+        Entry entry;
+        entry.ctimeSec = readBigEndian32(p);
+        entry.ctimeNsec = readBigEndian32(p + 4);
+        entry.mtimeSec = readBigEndian32(p + 8);
+        entry.mtimeNsec = readBigEndian32(p + 12);
+        entry.dev = readBigEndian32(p + 16);
+        entry.ino = readBigEndian32(p + 20);
+        entry.mode = readBigEndian32(p + 24);
+        entry.uid = readBigEndian32(p + 28);
+        entry.gid = readBigEndian32(p + 32);
+        entry.size = readBigEndian32(p + 36);
+        entry.fullSize = entry.size;
+        std::memcpy(entry.oid, p + 40, 20);
+
+        const uint16_t flags = (uint16_t) ((p[60] << 8) | p[61]);
+        size_t headerSize = 62;
+
+        // Unmerged entries, or (v3) skip-worktree / intent-to-add: leave those to git
+        if ((flags & 0x3000) != 0)
+            return false;
+
+        if ((flags & 0x4000) != 0)
+        {
+            if (version < 3 || pos + 64 > end)
+                return false;
+
+            const uint16_t extended = (uint16_t) ((p[62] << 8) | p[63]);
+            if (extended != 0)
+                return false;
+
+            headerSize = 64;
+        }
+
+        size_t nameLength = flags & 0x0fff;
+        if (nameLength == 0x0fff)
+        {
+            const void* nul = std::memchr(p + headerSize, 0, end - pos - headerSize);
+            if (nul == nullptr)
+                return false;
+            nameLength = (size_t) (static_cast<const uint8_t*>(nul) - (p + headerSize));
+        }
+
+        if (pos + headerSize + nameLength > end)
+            return false;
+
+        entry.path.assign((const char*) p + headerSize, nameLength);
+        entries.push_back(std::move(entry));
+
+        // Padded with 1-8 NULs to a multiple of 8
+        pos += (headerSize + nameLength + 8) & ~(size_t) 7;
+    }
+
+    // Extensions: keep the cache-tree, drop the optional ones, refuse the ones we can't honour
+    while (pos + 8 <= end)
+    {
+        const uint8_t* p = bytes + pos;
+        const uint32_t size = readBigEndian32(p + 4);
+
+        if (pos + 8 + size > end)
+            return false;
+
+        if (std::memcmp(p, "TREE", 4) == 0)
+        {
+            std::function<bool(size_t&, size_t, const std::string&, bool)> parseNode =
+                [&](size_t& at, size_t limit, const std::string& parent, bool isRoot) -> bool
+            {
+                const void* nul = std::memchr(bytes + at, 0, limit - at);
+                if (nul == nullptr)
+                    return false;
+
+                const std::string name((const char*) bytes + at, (size_t) (static_cast<const uint8_t*>(nul) - (bytes + at)));
+                at += name.size() + 1;
+
+                const std::string path = isRoot ? std::string() : (parent.empty() ? name : parent + "/" + name);
+
+                const uint8_t* newline = static_cast<const uint8_t*>(std::memchr(bytes + at, '\n', limit - at));
+                if (newline == nullptr)
+                    return false;
+
+                const std::string counts((const char*) bytes + at, (size_t) (newline - (bytes + at)));
+                at = (size_t) (newline - bytes) + 1;
+
+                const int entryCount = std::atoi(counts.c_str());
+                const int numSubtrees = std::atoi(counts.substr(counts.find(' ') + 1).c_str());
+
+                if (entryCount >= 0)
+                {
+                    if (at + 20 > limit)
+                        return false;
+
+                    cacheTree[path] = { std::string((const char*) bytes + at, 20), entryCount };
+                    at += 20;
+                }
+
+                for (int i = 0; i < numSubtrees; ++i)
+                    if (!parseNode(at, limit, path, false))
+                        return false;
+
+                return true;
+            };
+
+            size_t at = pos + 8;
+            if (!parseNode(at, pos + 8 + size, {}, true))
+                cacheTree.clear();
+        }
+        else if (p[0] >= 'a' && p[0] <= 'z')
+        {
+            return false; // e.g. "link" (split index) or "sdir" (sparse index)
+        }
+
+        pos += 8 + size;
+    }
+
+    return true;
+}
+
+//==============================================================================
+std::string SnapshotBuilder::writeTrees(const std::vector<Entry>& merged, const std::map<std::string, std::pair<std::string, int>>& cacheTree,
+                                        const std::set<std::string>& dirtyDirectories, std::string& cacheTreeExtension)
+{
+    bool treesOk = true;
+
+    std::function<std::string(size_t, size_t, const std::string&, const std::string&, const std::string&)> buildTree =
+        [&](size_t begin, size_t end, const std::string& directory, const std::string& prefix, const std::string& name) -> std::string
+    {
+        std::string content;
+        std::string childExtensions;
+        int numSubtrees = 0;
+
+        for (size_t i = begin; i < end;)
+        {
+            const std::string rest = merged[i].path.substr(prefix.size());
+            const size_t slash = rest.find('/');
+
+            if (slash == std::string::npos)
+            {
+                char modeText[16];
+                std::snprintf(modeText, sizeof(modeText), "%o ", merged[i].mode);
+                content += modeText;
+                content += rest;
+                content.push_back(0);
+                content.append((const char*) merged[i].oid, 20);
+                ++i;
+                continue;
+            }
+
+            const std::string childName = rest.substr(0, slash);
+            const std::string childPrefix = prefix + childName + "/";
+            size_t childEnd = i;
+            while (childEnd < end && merged[childEnd].path.compare(0, childPrefix.size(), childPrefix) == 0)
+                ++childEnd;
+
+            const std::string childDirectory = prefix + childName;
+            const std::string childId = buildTree(i, childEnd, childDirectory, childPrefix, childName);
+
+            char modeText[16];
+            std::snprintf(modeText, sizeof(modeText), "%o ", modeTree);
+            content += modeText;
+            content += childName;
+            content.push_back(0);
+            content += childId;
+
+            childExtensions += cacheTreeExtension;
+            cacheTreeExtension.clear();
+            ++numSubtrees;
+            i = childEnd;
+        }
+
+        std::string id;
+        auto cached = cacheTree.find(directory);
+
+        if (dirtyDirectories.count(directory) == 0 && cached != cacheTree.end() && cached->second.second == (int) (end - begin))
+        {
+            id = cached->second.first;
+        }
+        else
+        {
+            std::string hex;
+            bool written = false;
+            treesOk = writeLooseObject("tree", content.data(), content.size(), hex, written) && treesOk;
+
+            uint8_t raw[20];
+            fromHex(hex, raw);
+            id.assign((const char*) raw, 20);
+
+            if (written)
+                ++statistics.numTreesWritten;
+        }
+
+        // Cache-tree: name NUL count SP subtrees LF id, then the subtrees, depth first
+        std::string node = name;
+        node.push_back(0);
+        node += std::to_string(end - begin) + " " + std::to_string(numSubtrees) + "\n";
+        node += id;
+        cacheTreeExtension = node + childExtensions;
+        return id;
+    };
+
+    const std::string rootTree = buildTree(0, merged.size(), {}, {}, {});
+    return treesOk ? rootTree : std::string();
+}
+
+bool SnapshotBuilder::writeIndex(const std::vector<Entry>& entries, const std::string& cacheTreeExtension, juce::int64 startSeconds)
+{
+    std::string out;
+    out.reserve(entries.size() * 96 + cacheTreeExtension.size() + 64);
+    out.append("DIRC", 4);
+    appendBigEndian32(out, 2);
+    appendBigEndian32(out, (uint32_t) entries.size());
+
+    for (const auto& entry : entries)
+    {
+        appendBigEndian32(out, entry.ctimeSec);
+        appendBigEndian32(out, entry.ctimeNsec);
+        appendBigEndian32(out, entry.mtimeSec);
+        appendBigEndian32(out, entry.mtimeNsec);
+        appendBigEndian32(out, entry.dev);
+        appendBigEndian32(out, entry.ino);
+        appendBigEndian32(out, entry.mode);
+        appendBigEndian32(out, entry.uid);
+        appendBigEndian32(out, entry.gid);
+
+        // Racy git: a file written in the same second as this index could change again
+        // without its stat data changing, so make sure it gets looked at next time
+        appendBigEndian32(out, (juce::int64) entry.mtimeSec >= startSeconds ? 0 : entry.size);
+
+        out.append((const char*) entry.oid, 20);
+        appendBigEndian16(out, (uint16_t) juce::jmin((size_t) 0x0fff, entry.path.size()));
+        out.append(entry.path);
+
+        const size_t padding = 8 - ((62 + entry.path.size()) % 8);
+        out.append(padding, '\0');
+    }
+
+    if (!cacheTreeExtension.empty())
+    {
+        out.append("TREE", 4);
+        appendBigEndian32(out, (uint32_t) cacheTreeExtension.size());
+        out.append(cacheTreeExtension);
+    }
+
+    const Sha1::Digest checksum = Sha1::hash(out.data(), out.size());
+    out.append((const char*) checksum.data(), checksum.size());
+
+    return replaceLocked(privateIndexFile, out.data(), out.size());
+}
+
+//==============================================================================
+bool SnapshotBuilder::replaceLocked(const juce::File& file, const void* data, size_t size)
+{
+    const juce::File lockFile = file.getSiblingFile(file.getFileName() + ".lock");
+    file.getParentDirectory().createDirectory();
+
+    // Created exclusively, the same lock git takes, so we never race a git command
+   #if JUCE_WINDOWS
+    std::FILE* lock = _wfopen(lockFile.getFullPathName().toWideCharPointer(), L"wx");
+   #else
+    std::FILE* lock = std::fopen(lockFile.getFullPathName().toRawUTF8(), "wx");
+   #endif
+
+    if (lock == nullptr)
+        return false;
+
+    const bool wrote = std::fwrite(data, 1, size, lock) == size;
+    const bool closed = std::fclose(lock) == 0;
+
+    if (!wrote || !closed || !lockFile.moveFileTo(file))
+    {
+        lockFile.deleteFile();
+        return false;
+    }
+
+    return true;
+}
+
+std::string SnapshotBuilder::readCommitTree(GitRepositoryWorker& worker, const juce::String& commitOid)
+{
+    juce::String type;
+    std::string content;
+    uint8_t raw[20];
+
+    if (commitOid.isEmpty() || !worker.readObject(commitOid, type, content) || content.compare(0, 5, "tree ") != 0
+        || content.size() < 45 || !fromHex(juce::String(content.substr(5, 40)), raw))
+        return {};
+
+    return std::string((const char*) raw, 20);
+}
+
+bool SnapshotBuilder::loadPrivateIndex(GitRepositoryWorker& worker, const std::string& headTree, std::vector<Entry>& entries,
+                                       std::map<std::string, std::pair<std::string, int>>& cacheTree, bool& reseeded)
+{
+    reseeded = false;
+
+    if (!readIndex(privateIndexFile, entries, cacheTree))
+        return false;
+
+    // In step with HEAD when its cache-tree says it holds HEAD's tree. Anything else (a commit or
+    // checkout made by hand, a snapshot that failed half way) means starting again from a copy.
+    auto root = cacheTree.find({});
+    if (privateIndexFile.existsAsFile() && (headTree.empty() || (root != cacheTree.end() && root->second.first == headTree)))
+        return true;
+
+    entries.clear();
+    cacheTree.clear();
+    reseeded = true;
+
+    // The shared index has stat data for the whole tree, so only changed files get hashed again.
+    // Whatever the user staged there is just a starting point: the full scan that follows
+    // brings every entry in line with the working tree.
+    const juce::File sharedIndex = gitDirectory.getChildFile("index");
+    juce::MemoryBlock data;
+
+    if (sharedIndex.loadFileAsData(data))
+    {
+        if (!replaceLocked(privateIndexFile, data.getData(), data.getSize()))
+            return false;
+    }
+    else if (!headTree.empty())
+    {
+        ProcessRunner::Options options;
+        options.workingDirectory = projectDirectory.getFullPathName().toStdString();
+        options.lowPriority = true;
+        options.environment = { "GIT_INDEX_FILE=" + privateIndexFile.getFullPathName().toStdString() };
+
+        if (!ProcessRunner::run({ "git", "read-tree", "HEAD" }, options).succeeded())
+            return false;
+    }
+    else
+    {
+        privateIndexFile.deleteFile();
+    }
+
+    return readIndex(privateIndexFile, entries, cacheTree);
+}
+
+bool SnapshotBuilder::preparePrivateIndex(GitRepositoryWorker& worker, bool& needsFullScan)
+{
+    std::vector<Entry> entries;
+    std::map<std::string, std::pair<std::string, int>> cacheTree;
+
+    // An index the builder can't read is still fine for git, it just isn't checked against HEAD
+    if (!loadPrivateIndex(worker, readCommitTree(worker, worker.resolveRef("HEAD")), entries, cacheTree, needsFullScan))
+        needsFullScan = true;
+
+    return privateIndexFile.getParentDirectory().isDirectory();
+}
+
+void SnapshotBuilder::noteCommitted(GitRepositoryWorker& worker, const std::string& previousTree)
+{
+    supersededTrees.insert(previousTree);
+    syncSharedIndex(worker);
+}
+
+void SnapshotBuilder::noteCommitted(GitRepositoryWorker& worker, const juce::String& previousTree)
+{
+    uint8_t raw[20];
+    noteCommitted(worker, fromHex(previousTree, raw) ? std::string((const char*) raw, 20) : std::string());
+}
+
+void SnapshotBuilder::syncSharedIndex(GitRepositoryWorker& worker)
+{
+    if (supersededTrees.empty())
+        return;
+
+    std::vector<Entry> entries;
+    std::map<std::string, std::pair<std::string, int>> privateTree, sharedTree;
+    const std::string headTree = readCommitTree(worker, worker.resolveRef("HEAD"));
+
+    if (!readIndex(privateIndexFile, entries, privateTree) || privateTree.count({}) == 0 || privateTree[{}].first != headTree)
+        return;
+
+    // Only a shared index still holding a tree our snapshots moved HEAD away from is ours to
+    // advance: it has nothing staged. Anything else belongs to the user and stays as it is.
+    const juce::File sharedIndex = gitDirectory.getChildFile("index");
+
+    if (sharedIndex.existsAsFile())
+    {
+        entries.clear();
+        if (!readIndex(sharedIndex, entries, sharedTree) || sharedTree.count({}) == 0)
+            return;
+
+        const std::string sharedRoot = sharedTree[{}].first;
+
+        if (sharedRoot == headTree || supersededTrees.count(sharedRoot) == 0)
+        {
+            if (sharedRoot == headTree)
+                supersededTrees.clear();
+            return;
+        }
+    }
+
+    juce::MemoryBlock data;
+
+    // If git holds the lock right now, the next snapshot or job tries again
+    if (privateIndexFile.loadFileAsData(data) && replaceLocked(sharedIndex, data.getData(), data.getSize()))
+        supersededTrees.clear();
+}
+
+//==============================================================================
+bool SnapshotBuilder::isSharedIndexClean(const std::string& headTree)
+{
+    const juce::File sharedIndex = gitDirectory.getChildFile("index");
+    if (!sharedIndex.existsAsFile())
+        return true;
+
+    std::vector<Entry> entries;
+    std::map<std::string, std::pair<std::string, int>> sharedTree;
+
+    if (!readIndex(sharedIndex, entries, sharedTree) || sharedTree.count({}) == 0)
+        return false;
+
+    const std::string& root = sharedTree[{}].first;
+    return root == headTree || supersededTrees.count(root) != 0;
+}
+
+bool SnapshotBuilder::canCheckout(GitRepositoryWorker& worker, const std::vector<CheckoutChange>& changes,
+                                  const std::string& headTree, const std::atomic<bool>* cancelFlag)
+{
+    if (!readConfiguration() || !configurationSupported || !isSharedIndexClean(headTree))
+        return false;
+
+    std::vector<Entry> entries;
+    std::map<std::string, std::pair<std::string, int>> cacheTree;
+    bool reseeded = false;
+
+    if (!loadPrivateIndex(worker, headTree, entries, cacheTree, reseeded))
+        return false;
+
+    for (const auto& change : changes)
+    {
+        if (isCancelled(cancelFlag))
+            return false;
+
+        const juce::File file = projectDirectory.getChildFile(juce::String::fromUTF8(change.path.c_str()));
+        const FileStat stat = statPath(file);
+
+        if (!stat.exists)
+            continue;
+
+        // A directory can only make way for a new file if it holds nothing but files the
+        // checkout removes, which the caller has made sure of
+        if (stat.isDirectory)
+        {
+            if (change.oldOid.empty())
+                continue;
+
+            return false;
+        }
+
+        // A file the checkout adds may already be there untracked, which is only fine if it's identical
+        const std::string& expected = change.oldOid.empty() ? change.newOid : change.oldOid;
+
+        auto entry = std::lower_bound(entries.begin(), entries.end(), change.path,
+                                      [](const Entry& e, const std::string& p) { return e.path < p; });
+
+        if (!change.oldOid.empty() && entry != entries.end() && entry->path == change.path
+            && statMatches(*entry, stat) && std::memcmp(entry->oid, expected.data(), 20) == 0)
+            continue;
+
+        // Changed since the index last saw it: only the content can tell whether work would be lost
+        if (hashWorkingFile(file, stat) != expected)
+            return false;
+    }
+
+    return true;
+}
+
+bool SnapshotBuilder::recordCheckout(GitRepositoryWorker& worker, const std::vector<CheckoutChange>& changes,
+                                     const std::string& previousTree, const std::string& targetTree)
+{
+    std::vector<Entry> entries;
+    std::map<std::string, std::pair<std::string, int>> cacheTree;
+    bool reseeded = false;
+
+    if (!loadPrivateIndex(worker, previousTree, entries, cacheTree, reseeded))
+        return false;
+
+    std::map<std::string, const CheckoutChange*> byPath;
+    std::set<std::string> dirtyDirectories;
+
+    for (const auto& change : changes)
+    {
+        byPath[change.path] = &change;
+
+        dirtyDirectories.insert(std::string());
+        for (size_t slash = change.path.find('/'); slash != std::string::npos; slash = change.path.find('/', slash + 1))
+            dirtyDirectories.insert(change.path.substr(0, slash));
+    }
+
+    // Every entry the checkout touched gets the target's blob and the stat data of the file just written
+    auto apply = [this](Entry& entry, const CheckoutChange& change)
+    {
+        std::memcpy(entry.oid, change.newOid.data(), 20);
+        entry.mode = change.newMode;
+        copyStat(entry, statPath(projectDirectory.getChildFile(juce::String::fromUTF8(entry.path.c_str()))));
+    };
+
+    std::vector<Entry> merged;
+    merged.reserve(entries.size() + changes.size());
+
+    for (auto& entry : entries)
+    {
+        auto change = byPath.find(entry.path);
+        if (change == byPath.end())
+        {
+            merged.push_back(std::move(entry));
+            continue;
+        }
+
+        if (!change->second->newOid.empty())
+        {
+            apply(entry, *change->second);
+            merged.push_back(std::move(entry));
+        }
+
+        byPath.erase(change);
+    }
+
+    for (const auto& added : byPath)
+    {
+        if (added.second->newOid.empty())
+            continue;
+
+        Entry entry;
+        entry.path = added.first;
+        apply(entry, *added.second);
+        merged.push_back(std::move(entry));
+    }
+
+    std::sort(merged.begin(), merged.end(), [](const Entry& a, const Entry& b) { return a.path < b.path; });
+
+    // The trees exist already; building them again is how the cache-tree gets filled in
+    std::string cacheTreeExtension;
+    if (writeTrees(merged, cacheTree, dirtyDirectories, cacheTreeExtension) != targetTree
+        || !writeIndex(merged, cacheTreeExtension, juce::Time::currentTimeMillis() / 1000))
+        return false;
+
+    // The shared index was checked clean before anything was written, so it follows too
+    juce::MemoryBlock data;
+    if (isSharedIndexClean(previousTree) && privateIndexFile.loadFileAsData(data)
+        && replaceLocked(gitDirectory.getChildFile("index"), data.getData(), data.getSize()))
+        supersededTrees.clear();
+
+    return true;
+}
+
+//==============================================================================
+bool SnapshotBuilder::hashEntries(std::vector<Entry*>& dirty, const std::atomic<bool>* cancelFlag)
+{
+    std::atomic<size_t> next { 0 };
+    std::atomic<bool> failed { false };
+    std::atomic<int> numBlobsWritten { 0 };
+    std::atomic<juce::int64> bytesHashed { 0 };
+
+    auto work = [&]
+    {
+        std::vector<char> buffer;
+
+        for (;;)
+        {
+            const size_t index = next++;
+            if (index >= dirty.size() || failed || isCancelled(cancelFlag))
+                return;
+
+            Entry& entry = *dirty[index];
+            const juce::File file = projectDirectory.getChildFile(juce::String::fromUTF8(entry.path.c_str()));
+            size_t size = 0;
+            std::string hex;
+            bool written = false;
+
+            if (entry.mode != modeSymlink && entry.fullSize > streamThreshold)
+            {
+                juce::int64 streamedSize = entry.fullSize;
+                bool changed = false;
+
+                if (!writeLooseBlob(file, streamedSize, changed, hex, written))
+                {
+                    failed = true;
+                    return;
+                }
+
+                // Written to while we read it, as below
+                if (changed)
+                {
+                    entry.size = (uint32_t) streamedSize;
+                    entry.fullSize = streamedSize;
+                    entry.mtimeSec = entry.mtimeNsec = 0;
+                }
+
+                fromHex(hex, entry.oid);
+                entry.blobWritten = written;
+                bytesHashed += streamedSize;
+                if (written)
+                    ++numBlobsWritten;
+
+                continue;
+            }
+
+           #if ! JUCE_WINDOWS
+            if (entry.mode == modeSymlink)
+            {
+                // A symlink's blob is its target path
+                buffer.resize(4096);
+                const ssize_t length = ::readlink(file.getFullPathName().toRawUTF8(), buffer.data(), buffer.size());
+                if (length < 0)
+                {
+                    failed = true;
+                    return;
+                }
+
+                size = (size_t) length;
+            }
+            else
+           #endif
+            if (!readWorkingFile(file, entry.fullSize, buffer, size))
+            {
+                failed = true;
+                return;
+            }
+            else if ((juce::int64) size != entry.fullSize)
+            {
+                // Written to while we read it: keep what we got, but with stat data that can't match,
+                // so the next snapshot hashes it again (git does the same with racily clean entries)
+                entry.size = (uint32_t) size;
+                entry.fullSize = (juce::int64) size;
+                entry.mtimeSec = entry.mtimeNsec = 0;
+            }
+
+            if (!writeLooseObject("blob", buffer.data(), size, hex, written))
+            {
+                failed = true;
+                return;
+            }
+
+            fromHex(hex, entry.oid);
+            entry.blobWritten = written;
+            bytesHashed += (juce::int64) size;
+            if (written)
+                ++numBlobsWritten;
+        }
+    };
+
+    const int numThreads = (int) juce::jmin((size_t) juce::jlimit(1, 16, juce::SystemStats::getNumCpus()), dirty.size());
+    std::vector<std::thread> threads;
+
+    for (int i = 1; i < numThreads; ++i)
+        threads.emplace_back(work);
+
+    work();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    statistics.numHashed = (int) dirty.size();
+    statistics.numBlobsWritten = numBlobsWritten;
+    statistics.bytesHashed = bytesHashed;
+
+    return !failed && !isCancelled(cancelFlag);
+}
+
+bool SnapshotBuilder::writeLooseObject(const char* type, const void* data, size_t size, std::string& oid, bool& written)
+{
+    const std::string header = std::string(type) + " " + std::to_string(size) + std::string(1, '\0');
+
+    Sha1 sha;
+    sha.update(header.data(), header.size());
+    sha.update(data, size);
+    const Sha1::Digest digest = sha.finish();
+    oid = toHex(digest.data());
+    written = false;
+
+    const juce::File objectFile = objectsDirectory.getChildFile(oid.substr(0, 2)).getChildFile(oid.substr(2));
+
+    // Loose copies only: an object that is already packed just gets a duplicate, which git tolerates
+    if (objectFile.existsAsFile())
+        return true;
+
+    objectFile.getParentDirectory().createDirectory();
+    const juce::File temp = objectFile.getParentDirectory().getNonexistentChildFile("tmp_obj_", {}, false);
+
+    {
+        juce::FileOutputStream out(temp);
+        if (!out.openedOk())
+            return false;
+
+        {
+            // Loose objects are zlib streams; git's own default for them is the fastest level
+            juce::GZIPCompressorOutputStream zlib(out, 1);
+            if (!zlib.write(header.data(), header.size()) || !zlib.write(data, size))
+                return false;
+            zlib.flush();
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+        {
+            temp.deleteFile();
+            return false;
+        }
+    }
+
+    if (objectFile.existsAsFile() || !temp.moveFileTo(objectFile))
+        temp.deleteFile();
+
+    written = true;
+    return objectFile.existsAsFile();
+}
+
+bool SnapshotBuilder::writeLooseBlob(const juce::File& file, juce::int64& size, bool& changed, std::string& oid, bool& written)
+{
+    std::vector<char> buffer((size_t) readBlockSize);
+    changed = false;
+    written = false;
+
+    // The header holds the size, before the content. A file that turns out shorter than that is
+    // read again at its new size; one that grew keeps what was read and counts as changed.
+    for (int attempt = 0; attempt < 3; ++attempt)
+    {
+        juce::FileInputStream in(file);
+        if (!in.openedOk())
+            return false;
+
+        // Named when it's complete, like git's own tmp_obj_ files
+        objectsDirectory.createDirectory();
+        const juce::File temp = objectsDirectory.getNonexistentChildFile("tmp_obj_", {}, false);
+        const std::string header = "blob " + std::to_string(size) + std::string(1, '\0');
+
+        Sha1 sha;
+        sha.update(header.data(), header.size());
+        juce::int64 done = 0;
+        bool ok = true;
+
+        {
+            juce::FileOutputStream out(temp);
+            if (!out.openedOk())
+                return false;
+
+            {
+                juce::GZIPCompressorOutputStream zlib(out, 1);
+                ok = zlib.write(header.data(), header.size());
+
+                while (ok && done < size)
+                {
+                    const int read = in.read(buffer.data(), (int) juce::jmin((juce::int64) buffer.size(), size - done));
+                    if (read <= 0)
+                        break;
+
+                    sha.update(buffer.data(), (size_t) read);
+                    ok = zlib.write(buffer.data(), (size_t) read);
+                    done += read;
+                }
+
+                zlib.flush();
+            }
+
+            out.flush();
+            ok = ok && !out.getStatus().failed();
+        }
+
+        if (!ok || done < size)
+        {
+            temp.deleteFile();
+
+            if (!ok)
+                return false;
+
+            size = done;
+            changed = true;
+            continue;
+        }
+
+        char next = 0;
+        if (in.read(&next, 1) > 0)
+            changed = true;
+
+        const Sha1::Digest digest = sha.finish();
+        oid = toHex(digest.data());
+
+        const juce::File objectFile = objectsDirectory.getChildFile(oid.substr(0, 2)).getChildFile(oid.substr(2));
+        objectFile.getParentDirectory().createDirectory();
+
+        if (objectFile.existsAsFile() || !temp.moveFileTo(objectFile))
+            temp.deleteFile();
+        else
+            written = true;
+
+        return objectFile.existsAsFile();
+    }
+
+    return false;
+}
+
+bool SnapshotBuilder::updateBranch(GitRepositoryWorker& worker, const juce::String& refName, const std::string& expectedOid, const std::string& newOid,
+                                   const juce::String& ident, const juce::String& message)
+{
+    const juce::File refFile = commonDirectory.getChildFile(refName);
+    const juce::File lockFile = refFile.getSiblingFile(refFile.getFileName() + ".lock");
+    refFile.getParentDirectory().createDirectory();
+
+    // Created exclusively, the same lock git takes, so we never race a git command
+   #if JUCE_WINDOWS
+    std::FILE* lock = _wfopen(lockFile.getFullPathName().toWideCharPointer(), L"wx");
+   #else
+    std::FILE* lock = std::fopen(lockFile.getFullPathName().toRawUTF8(), "wx");
+   #endif
+
+    if (lock == nullptr)
+        return false;
+
+    const bool unchanged = worker.resolveRef(refName).toStdString() == expectedOid;
+    const std::string line = newOid + "\n";
+    const bool wrote = unchanged && std::fwrite(line.data(), 1, line.size(), lock) == line.size();
+    const bool closed = std::fclose(lock) == 0;
+
+    if (!unchanged || !wrote || !closed || !lockFile.moveFileTo(refFile))
+    {
+        lockFile.deleteFile();
+        return false;
+    }
+
+    // Reflogs, so "git reflog" can still find snapshots made here
+    const std::string previous = expectedOid.empty() ? std::string(40, '0') : expectedOid;
+    const juce::String entry = juce::String(previous) + " " + juce::String(newOid) + " " + ident + "\t" + message + "\n";
+
+    for (const auto& log : { commonDirectory.getChildFile("logs").getChildFile(refName),
+                             gitDirectory.getChildFile("logs").getChildFile("HEAD") })
+    {
+        log.getParentDirectory().createDirectory();
+        log.appendText(entry, false, false, "\n");
+    }
+
+    return true;
+}
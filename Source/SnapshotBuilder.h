@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+    SnapshotBuilder.h
+    Makes a snapshot without "git add" and "git commit": hashes changed files
+    on a worker pool and writes the blobs, trees, commit and index itself.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitRepositoryWorker.h"
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+//==============================================================================
+/**
+    A native replacement for "git add -A && git commit".
+
+    Git's own index is the stat cache: files whose size, times and inode match
+    their index entry keep their blob id, so only changed files are read. Those
+    are read and hashed in parallel. Blobs and trees go straight into
+    .git/objects as loose objects. Untouched directories
+    keep their tree ids from the index's cache-tree extension, so building the
+    trees costs as much as the change, not the project. Then the new index,
+    with fresh stat data and cache-tree, is written. The commit goes in
+    last, and the branch moves with a compare-and-swap on its ref file.
+
+    All of this happens in a private index, so whatever the user has staged
+    in .git/index is left alone and a git command holding index.lock doesn't
+    block a snapshot. The shared index is only brought up to the new HEAD when
+    it still holds the tree a snapshot replaced, i.e. when nothing is staged.
+
+    With a list of changed paths (from the ProjectWatcher) only those are
+    looked at, otherwise the whole tree is walked and stat'ed. New files are
+    checked against .gitignore, .git/info/exclude and core.excludesFile.
+
+    Anything the builder doesn't model is reported as unsupported, and the
+    caller falls back to git: line-ending conversion (core.autocrlf,
+    .gitattributes), split or sparse indexes, index v4, unmerged entries.
+
+    Not thread safe: use it from the job queue.
+*/
+class SnapshotBuilder
+{
+public:
+    enum class Outcome
+    {
+        committed,
+        nothingToCommit,
+        unsupported,    // the caller should use git instead
+        failed,
+        cancelled
+    };
+
+    struct Statistics
+    {
+        int numIndexEntries = 0;
+        int numStatted = 0;
+        int numHashed = 0;
+        int numBlobsWritten = 0;
+        int numTreesWritten = 0;
+        juce::int64 bytesHashed = 0;
+        double walkMs = 0.0;
+        double hashMs = 0.0;
+        double treeMs = 0.0;
+        double totalMs = 0.0;
+    };
+
+    SnapshotBuilder(const juce::File& projectDirectory, const juce::File& gitDirectory, const juce::File& commonDirectory);
+    ~SnapshotBuilder();
+
+    /** Stages changedPaths (everything if empty) and commits them on top of HEAD.
+        A detached HEAD first gets a "<short id>-branch" branch, like the git path does.
+    */
+    Outcome snapshot(GitRepositoryWorker& worker, const juce::StringArray& changedPaths, const juce::String& message, const std::atomic<bool>* cancelFlag);
+
+    const Statistics& getLastStatistics() const { return statistics; }
+
+    /** The index snapshots are staged in (.git/snaptrack/index). The shared .git/index, the
+        user's staging area, is never read back and only advanced when it has nothing staged.
+    */
+    const juce::File& getPrivateIndexFile() const { return privateIndexFile; }
+
+    /** For staging with git itself (GIT_INDEX_FILE): reseeds the private index if it has fallen
+        out of step with HEAD, in which case needsFullScan is set and paths alone won't do.
+    */
+    bool preparePrivateIndex(GitRepositoryWorker& worker, bool& needsFullScan);
+
+    /** Tells the builder a snapshot commit was made (by git) on top of previousTree. */
+    void noteCommitted(GitRepositoryWorker& worker, const juce::String& previousTree);
+
+    /** Moves the shared index up to HEAD if a snapshot left it behind and nothing is staged in it.
+        Does nothing while git holds .git/index.lock; call it again later.
+    */
+    void syncSharedIndex(GitRepositoryWorker& worker);
+
+    /** A file a checkout changes. Ids are raw 20-byte SHA-1s, empty for a file that is added or removed. */
+    struct CheckoutChange
+    {
+        std::string path;
+        std::string oldOid, newOid;
+        uint32_t oldMode = 0, newMode = 0;
+    };
+
+    /** Before a checkout from headTree writes anything: true if both indexes can follow it and every
+        file it replaces still has HEAD's content (or, for a new file, the target's), so nothing that
+        wasn't snapshotted gets overwritten.
+    */
+    bool canCheckout(GitRepositoryWorker& worker, const std::vector<CheckoutChange>& changes,
+                     const std::string& headTree, const std::atomic<bool>* cancelFlag);
+
+    /** After the checkout has written the working tree: moves the indexes from previousTree to
+        targetTree, with the stat data of the files as they are now.
+    */
+    bool recordCheckout(GitRepositoryWorker& worker, const std::vector<CheckoutChange>& changes,
+                        const std::string& previousTree, const std::string& targetTree);
+
+    // Working-tree files are read, never mapped: the DAW may truncate one while we hash it,
+    // and a mapped read past the new end raises SIGBUS in the host
+    static constexpr int readBlockSize = 256 * 1024;
+
+    // Bigger files are hashed and compressed a block at a time on their way into the object store,
+    // so hashing twenty long stems holds a block per thread, not the stems
+    static constexpr juce::int64 streamThreshold = 4 * readBlockSize;
+
+    struct Entry;
+    struct IgnoreRules;
+
+private:
+    bool readConfiguration();
+    bool readIndex(const juce::File& indexFile, std::vector<Entry>& entries, std::map<std::string, std::pair<std::string, int>>& cacheTree);
+    bool loadPrivateIndex(GitRepositoryWorker& worker, const std::string& headTree, std::vector<Entry>& entries,
+                          std::map<std::string, std::pair<std::string, int>>& cacheTree, bool& reseeded);
+    bool replaceLocked(const juce::File& file, const void* data, size_t size);
+    std::string readCommitTree(GitRepositoryWorker& worker, const juce::String& commitOid);
+    void noteCommitted(GitRepositoryWorker& worker, const std::string& previousTree);
+    bool isSharedIndexClean(const std::string& headTree);
+    std::string writeTrees(const std::vector<Entry>& entries, const std::map<std::string, std::pair<std::string, int>>& cacheTree,
+                           const std::set<std::string>& dirtyDirectories, std::string& cacheTreeExtension);
+    bool writeIndex(const std::vector<Entry>& entries, const std::string& cacheTreeExtension, juce::int64 startSeconds);
+    bool hashEntries(std::vector<Entry*>& dirty, const std::atomic<bool>* cancelFlag);
+    bool writeLooseObject(const char* type, const void* data, size_t size, std::string& oid, bool& written);
+    bool writeLooseBlob(const juce::File& file, juce::int64& size, bool& changed, std::string& oid, bool& written);
+    bool updateBranch(GitRepositoryWorker& worker, const juce::String& refName, const std::string& expectedOid, const std::string& newOid,
+                      const juce::String& ident, const juce::String& message);
+
+    juce::File projectDirectory;
+    juce::File gitDirectory;
+    juce::File commonDirectory;
+    juce::File objectsDirectory;
+    juce::File privateIndexFile;
+
+    bool configurationRead = false;
+    bool configurationSupported = true;
+    bool trustFileMode = true;
+    bool useSymlinks = true;
+    juce::File globalExcludesFile;
+    std::set<std::string> supersededTrees; // HEAD trees our snapshots replaced, see syncSharedIndex()
+
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SnapshotBuilder)
+};
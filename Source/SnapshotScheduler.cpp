@@ -0,0 +1,290 @@
+/*
+  ==============================================================================
+
+    SnapshotScheduler.cpp
+
+  ==============================================================================
+*/
+
+#include "SnapshotScheduler.h"
+
+//==============================================================================
+SnapshotScheduler::SnapshotScheduler(GitJobQueue& jobQueue, const HostTransportState& transport, Tracer& t)
+    : juce::Thread("SnapTrack snapshot scheduler"),
+      queue(jobQueue),
+      transportState(transport),
+      tracer(t)
+{
+    lastCheckTime = juce::Time::getMillisecondCounter();
+    startThread();
+}
+
+SnapshotScheduler::~SnapshotScheduler()
+{
+    *alive = false;
+    signalThreadShouldExit();
+    wakeUp.signal();
+    stopThread(5000);
+}
+
+void SnapshotScheduler::schedule(const juce::String& description, GitJobQueue::Work work, GitJobQueue::Completion onComplete)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        Request request;
+        request.description = description;
+        request.work = std::move(work);
+        request.onComplete = std::move(onComplete);
+        request.requestTime = juce::Time::getMillisecondCounter();
+        waiting.push_back(std::move(request));
+        ++statistics.numScheduled;
+    }
+
+    wakeUp.signal();
+    sendChangeMessage();
+}
+
+void SnapshotScheduler::flush()
+{
+    std::deque<Request> ready;
+
+    {
+        const juce::ScopedLock sl(lock);
+        ready.swap(waiting);
+        statistics.numFlushed += (int) ready.size();
+        currentReason = WaitReason::none;
+    }
+
+    if (ready.empty())
+        return;
+
+    release(ready, juce::Time::getMillisecondCounter());
+    sendChangeMessage();
+}
+
+void SnapshotScheduler::cancelAll()
+{
+    std::deque<Request> removed;
+
+    {
+        const juce::ScopedLock sl(lock);
+        removed.swap(waiting);
+        currentReason = WaitReason::none;
+    }
+
+    GitJobQueue::Result result;
+    result.cancelled = true;
+
+    for (auto& request : removed)
+    {
+        if (request.onComplete)
+        {
+            GitJobQueue::Completion onComplete = request.onComplete;
+            std::shared_ptr<bool> stillAlive = alive;
+            juce::MessageManager::callAsync([onComplete, result, stillAlive]
+            {
+                if (*stillAlive)
+                    onComplete(result);
+            });
+        }
+    }
+
+    sendChangeMessage();
+}
+
+//==============================================================================
+int SnapshotScheduler::getNumWaiting() const
+{
+    const juce::ScopedLock sl(lock);
+    return (int) waiting.size();
+}
+
+SnapshotScheduler::WaitReason SnapshotScheduler::getWaitReason() const
+{
+    const juce::ScopedLock sl(lock);
+    return waiting.empty() ? WaitReason::none : currentReason;
+}
+
+juce::int64 SnapshotScheduler::getLongestWaitMs() const
+{
+    const juce::ScopedLock sl(lock);
+
+    if (waiting.empty())
+        return 0;
+
+    return (juce::int64) (juce::Time::getMillisecondCounter() - waiting.front().requestTime);
+}
+
+SnapshotScheduler::Statistics SnapshotScheduler::getStatistics() const
+{
+    const juce::ScopedLock sl(lock);
+    return statistics;
+}
+
+juce::String SnapshotScheduler::describe(WaitReason reason)
+{
+    switch (reason)
+    {
+        case WaitReason::playing:   return "playback";
+        case WaitReason::recording: return "recording";
+        case WaitReason::none:      break;
+    }
+
+    return {};
+}
+
+juce::String SnapshotScheduler::describe(const Statistics& s)
+{
+    if (s.numScheduled == 0)
+        return "No snapshots scheduled yet";
+
+    juce::String text;
+    text << s.numDeferred << " of " << s.numScheduled << " snapshots waited";
+
+    if (s.numDeferred > 0)
+        text << ", " << juce::String((double) s.totalDeferredMs / (1000.0 * s.numDeferred), 1) << " s on average, "
+             << juce::String((double) s.longestDeferredMs / 1000.0, 1) << " s at most";
+
+    text << ". Held for playback " << juce::String((double) s.waitedForPlaybackMs / 1000.0, 1) << " s, recording "
+         << juce::String((double) s.waitedForRecordingMs / 1000.0, 1) << " s";
+
+    if (s.numForced > 0)
+        text << ", " << s.numForced << " forced";
+
+    if (s.numFlushed > 0)
+        text << ", " << s.numFlushed << " released early";
+
+    return text;
+}
+
+//==============================================================================
+SnapshotScheduler::WaitReason SnapshotScheduler::readTransport(juce::uint32 now) const
+{
+    // No blocks for a while: the host is idle or has bypassed us, whatever the flags last said
+    if (now - transportState.lastBlockTime.load(std::memory_order_relaxed) > (juce::uint32) staleStateMs)
+        return WaitReason::none;
+
+    if (transportState.recording.load(std::memory_order_relaxed))
+        return WaitReason::recording;
+
+    if (transportState.playing.load(std::memory_order_relaxed))
+        return WaitReason::playing;
+
+    return WaitReason::none;
+}
+
+void SnapshotScheduler::run()
+{
+    while (!threadShouldExit())
+    {
+        wakeUp.wait(checkIntervalMs);
+
+        if (threadShouldExit())
+            break;
+
+        const juce::uint32 now = juce::Time::getMillisecondCounter();
+        std::deque<Request> ready;
+        bool reasonChanged = false;
+
+        {
+            const juce::ScopedLock sl(lock);
+
+            const WaitReason reason = readTransport(now);
+            const juce::uint32 elapsed = now - lastCheckTime;
+            lastCheckTime = now;
+
+            if (reason != WaitReason::none)
+                lastBusyTime = now;
+
+            // Hold on a little after a stop too: people tend to stop, tweak something and play again
+            const bool hold = reason != WaitReason::none
+                           || (lastBusyTime != 0 && now - lastBusyTime < (juce::uint32) settleTimeMs);
+
+            const WaitReason previousReason = currentReason;
+
+            if (hold)
+            {
+                if (reason != WaitReason::none)
+                    currentReason = reason;
+
+                if (!waiting.empty())
+                {
+                    if (currentReason == WaitReason::recording)
+                        statistics.waitedForRecordingMs += elapsed;
+                    else
+                        statistics.waitedForPlaybackMs += elapsed;
+                }
+
+                for (auto it = waiting.begin(); it != waiting.end();)
+                {
+                    it->deferred = true;
+                    it->reason = currentReason;
+
+                    if (now - it->requestTime >= (juce::uint32) maxDeferralMs)
+                    {
+                        ++statistics.numForced;
+                        ready.push_back(std::move(*it));
+                        it = waiting.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            }
+            else
+            {
+                currentReason = WaitReason::none;
+                ready.swap(waiting);
+            }
+
+            reasonChanged = previousReason != currentReason;
+        }
+
+        if (!ready.empty())
+            release(ready, now);
+
+        if (reasonChanged || !ready.empty())
+            sendChangeMessage();
+    }
+}
+
+void SnapshotScheduler::release(std::deque<Request>& requests, juce::uint32 now)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        for (const auto& request : requests)
+        {
+            if (!request.deferred)
+                continue;
+
+            const juce::int64 waitedMs = (juce::int64) (now - request.requestTime);
+            ++statistics.numDeferred;
+            statistics.totalDeferredMs += waitedMs;
+            statistics.longestDeferredMs = juce::jmax(statistics.longestDeferredMs, waitedMs);
+        }
+    }
+
+    // Recorded after the fact: the span covers the wait, from when the snapshot was asked for
+    const juce::int64 nowMicros = (juce::int64) (juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks()) * 1.0e6);
+
+    for (const auto& request : requests)
+    {
+        if (!request.deferred)
+            continue;
+
+        Tracer::Span span;
+        span.category = "deferral";
+        span.name = request.description;
+        span.detail = "waited for " + describe(request.reason);
+        span.durationMs = (double) (now - request.requestTime);
+        span.startMicros = nowMicros - (juce::int64) (span.durationMs * 1000.0);
+        span.threadId = (juce::uint64) (juce::pointer_sized_uint) juce::Thread::getCurrentThreadId();
+        tracer.record(std::move(span));
+    }
+
+    for (auto& request : requests)
+        queue.submit(request.description, std::move(request.work), std::move(request.onComplete));
+}
@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    SnapshotScheduler.h
+    Holds snapshots back while the host is playing or recording, so git's
+    disk and CPU load never lands in the middle of a take.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GitJobQueue.h"
+#include "Tracer.h"
+#include <atomic>
+#include <deque>
+
+//==============================================================================
+/**
+    Host transport state, written by the audio thread and read by the scheduler.
+
+    Everything is a relaxed atomic store, so publishing from processBlock never
+    locks or allocates.
+*/
+struct HostTransportState
+{
+    /** Call once per processBlock. */
+    void publish(bool isPlaying, bool isRecording) noexcept
+    {
+        playing.store(isPlaying, std::memory_order_relaxed);
+        recording.store(isRecording, std::memory_order_relaxed);
+        lastBlockTime.store(juce::Time::getMillisecondCounter(), std::memory_order_relaxed);
+    }
+
+    std::atomic<bool> playing { false };
+    std::atomic<bool> recording { false };
+    std::atomic<juce::uint32> lastBlockTime { 0 };
+};
+
+//==============================================================================
+/**
+    Decides when snapshots may run, then hands them to a GitJobQueue.
+
+    A scheduled snapshot waits while the transport is running and is released
+    once it has been stopped for settleTimeMs. Hosts stop calling processBlock
+    when they go idle or bypass us, so a transport state that hasn't been
+    refreshed for staleStateMs counts as stopped. Nothing waits longer than
+    maxDeferralMs, so an hour-long session still gets snapshotted.
+
+    Listeners are told (on the message thread) when snapshots start or stop
+    waiting. The editor shows the running totals of getStatistics() as the
+    status line's tooltip. Every snapshot that had to wait is also recorded
+    in the tracer as a "deferral" span, named after the snapshot, so the
+    timings panel shows how long and why.
+*/
+class SnapshotScheduler : public juce::ChangeBroadcaster,
+                          private juce::Thread
+{
+public:
+    enum class WaitReason
+    {
+        none,
+        playing,
+        recording
+    };
+
+    /** Why and for how long snapshots were held back, since the scheduler was created. */
+    struct Statistics
+    {
+        int numScheduled = 0;
+        int numDeferred = 0;            // had to wait at all
+        int numForced = 0;              // ran after maxDeferralMs with the transport still running
+        int numFlushed = 0;             // released early because another git operation needed the repository
+        juce::int64 totalDeferredMs = 0;
+        juce::int64 longestDeferredMs = 0;
+        juce::int64 waitedForPlaybackMs = 0;  // wall time with at least one snapshot waiting
+        juce::int64 waitedForRecordingMs = 0;
+    };
+
+    SnapshotScheduler(GitJobQueue& jobQueue, const HostTransportState& transport, Tracer& tracer);
+    ~SnapshotScheduler() override;
+
+    /** Queues a snapshot to run once the host is idle. onComplete is called on the
+        message thread, also if the snapshot is cancelled before it runs.
+    */
+    void schedule(const juce::String& description, GitJobQueue::Work work, GitJobQueue::Completion onComplete = nullptr);
+
+    /** Hands everything waiting to the job queue now, e.g. before a checkout that
+        would otherwise run ahead of the snapshot that should precede it.
+    */
+    void flush();
+
+    /** Drops everything that is still waiting. */
+    void cancelAll();
+
+    int getNumWaiting() const;
+    WaitReason getWaitReason() const;
+    juce::int64 getLongestWaitMs() const;
+    Statistics getStatistics() const;
+
+    static juce::String describe(WaitReason reason);
+
+    /** "3 of 12 snapshots waited, 4.2 s on average, ..." for the status line's tooltip. */
+    static juce::String describe(const Statistics& statistics);
+
+    static constexpr int checkIntervalMs = 250;
+    static constexpr int settleTimeMs = 1000;
+    static constexpr int staleStateMs = 1000;
+    static constexpr int maxDeferralMs = 10 * 60 * 1000;
+
+private:
+    struct Request
+    {
+        juce::String description;
+        GitJobQueue::Work work;
+        GitJobQueue::Completion onComplete;
+        juce::uint32 requestTime = 0;
+        bool deferred = false;
+        WaitReason reason = WaitReason::none;   // the last thing it waited for
+    };
+
+    void run() override;
+    WaitReason readTransport(juce::uint32 now) const;
+    void release(std::deque<Request>& requests, juce::uint32 now);
+
+    GitJobQueue& queue;
+    const HostTransportState& transportState;
+    Tracer& tracer;
+
+    mutable juce::CriticalSection lock;
+    std::deque<Request> waiting;
+    WaitReason currentReason = WaitReason::none;
+    juce::uint32 lastBusyTime = 0;
+    juce::uint32 lastCheckTime = 0;
+    Statistics statistics;
+    juce::WaitableEvent wakeUp;
+
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SnapshotScheduler)
+};
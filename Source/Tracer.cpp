@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    Tracer.cpp
+
+  ==============================================================================
+*/
+
+#include "Tracer.h"
+#include <algorithm>
+#include <map>
+
+namespace
+{
+    juce::int64 ticksToMicros(juce::int64 ticks)
+    {
+        return (juce::int64) (juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6);
+    }
+}
+
+//==============================================================================
+Tracer::ScopedSpan::ScopedSpan(Tracer& tracer, const juce::String& category, const juce::String& name)
+    : owner(tracer), startTicks(juce::Time::getHighResolutionTicks())
+{
+    span.category = category;
+    span.name = name;
+}
+
+Tracer::ScopedSpan::~ScopedSpan()
+{
+    const juce::int64 endTicks = juce::Time::getHighResolutionTicks();
+    span.startMicros = ticksToMicros(startTicks);
+    span.durationMs = juce::Time::highResolutionTicksToSeconds(endTicks - startTicks) * 1000.0;
+    span.threadId = (juce::uint64) (juce::pointer_sized_uint) juce::Thread::getCurrentThreadId();
+    owner.record(std::move(span));
+}
+
+//==============================================================================
+Tracer::Tracer(int capacity)
+{
+    ring.resize((size_t) juce::jmax(1, capacity));
+}
+
+void Tracer::record(Span span)
+{
+    const juce::ScopedLock sl(lock);
+    ring[nextIndex] = std::move(span);
+    nextIndex = (nextIndex + 1) % ring.size();
+    ++numRecorded;
+}
+
+void Tracer::clear()
+{
+    const juce::ScopedLock sl(lock);
+    std::fill(ring.begin(), ring.end(), Span());
+    nextIndex = 0;
+    numRecorded = 0;
+}
+
+std::vector<Tracer::Span> Tracer::getSpans() const
+{
+    const juce::ScopedLock sl(lock);
+    std::vector<Span> spans;
+
+    // Before the ring has wrapped, everything from nextIndex on is still empty
+    const size_t count = (size_t) juce::jmin(numRecorded, (juce::int64) ring.size());
+    const size_t first = count < ring.size() ? 0 : nextIndex;
+    spans.reserve(count);
+
+    for (size_t i = 0; i < count; ++i)
+        spans.push_back(ring[(first + i) % ring.size()]);
+
+    return spans;
+}
+
+juce::int64 Tracer::getNumRecorded() const
+{
+    const juce::ScopedLock sl(lock);
+    return numRecorded;
+}
+
+Tracer::Histogram Tracer::getHistogram(const juce::String& category) const
+{
+    Histogram histogram;
+    std::vector<double> durations;
+
+    for (const auto& span : getSpans())
+    {
+        if (category.isNotEmpty() && span.category != category)
+            continue;
+
+        const auto bucket = std::lower_bound(bucketLimitsMs.begin(), bucketLimitsMs.end(), span.durationMs);
+        ++histogram.counts[(size_t) (bucket - bucketLimitsMs.begin())];
+        durations.push_back(span.durationMs);
+    }
+
+    if (durations.empty())
+        return histogram;
+
+    std::sort(durations.begin(), durations.end());
+    histogram.total = (int) durations.size();
+    histogram.medianMs = durations[durations.size() / 2];
+    histogram.p95Ms = durations[juce::jmin(durations.size() - 1, (size_t) ((double) durations.size() * 0.95))];
+    histogram.maxMs = durations.back();
+    return histogram;
+}
+
+juce::StringArray Tracer::getSlowestNames(const juce::String& category, int maxNames) const
+{
+    std::map<juce::String, std::pair<double, int>> totals; // name -> (total ms, count)
+
+    for (const auto& span : getSpans())
+    {
+        if (category.isEmpty() || span.category == category)
+        {
+            auto& total = totals[span.name];
+            total.first += span.durationMs;
+            ++total.second;
+        }
+    }
+
+    std::vector<std::pair<double, juce::String>> sorted;
+    for (const auto& total : totals)
+        sorted.emplace_back(total.second.first, total.first + "  " + juce::String(total.second.second) + "x, "
+                                                  + juce::String(total.second.first / total.second.second, 1) + " ms avg");
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    juce::StringArray names;
+    for (size_t i = 0; i < sorted.size() && names.size() < maxNames; ++i)
+        names.add(sorted[i].second);
+
+    return names;
+}
+
+juce::String Tracer::toChromeTrace() const
+{
+    juce::Array<juce::var> events;
+
+    for (const auto& span : getSpans())
+    {
+        juce::DynamicObject::Ptr args = new juce::DynamicObject();
+        if (span.detail.isNotEmpty())
+            args->setProperty("command", span.detail);
+        if (span.outputBytes >= 0)
+            args->setProperty("outputBytes", span.outputBytes);
+        args->setProperty("exitCode", span.exitCode);
+
+        juce::DynamicObject::Ptr event = new juce::DynamicObject();
+        event->setProperty("name", span.name);
+        event->setProperty("cat", span.category);
+        event->setProperty("ph", "X");
+        event->setProperty("ts", span.startMicros);
+        event->setProperty("dur", (juce::int64) (span.durationMs * 1000.0));
+        event->setProperty("pid", 1);
+        event->setProperty("tid", (juce::int64) span.threadId);
+        event->setProperty("args", args.get());
+        events.add(event.get());
+    }
+
+    juce::DynamicObject::Ptr trace = new juce::DynamicObject();
+    trace->setProperty("traceEvents", events);
+    trace->setProperty("displayTimeUnit", "ms");
+    return juce::JSON::toString(trace.get(), true);
+}
+
+bool Tracer::writeChromeTrace(const juce::File& file) const
+{
+    return file.replaceWithText(toChromeTrace());
+}
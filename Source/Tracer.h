@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    Tracer.h
+    Timing spans for git commands and editor refreshes, kept in memory so
+    they are there in release builds too.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+//==============================================================================
+/**
+    A bounded ring of the most recent spans.
+
+    A span is one timed piece of work: a git command with its output size and
+    exit status, or an editor refresh. Record them with a ScopedSpan. The ring
+    can be written out as a Chrome trace (chrome://tracing, Perfetto) or
+    summed up into latency histograms for the editor's timings panel.
+
+    Thread safe. Never record from the audio thread.
+*/
+class Tracer
+{
+public:
+    struct Span
+    {
+        juce::String category;      // "git", "command", "editor", ...
+        juce::String name;          // e.g. "git log", "refreshCommitListBox"
+        juce::String detail;        // the full command line, if any
+        juce::int64 startMicros = 0;
+        double durationMs = 0.0;
+        juce::int64 outputBytes = -1;   // -1 if it doesn't apply
+        int exitCode = 0;
+        juce::uint64 threadId = 0;
+    };
+
+    /** Latency buckets, with upper bounds in bucketLimitsMs and one more for anything slower. */
+    static constexpr std::array<double, 10> bucketLimitsMs { 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0 };
+
+    struct Histogram
+    {
+        std::array<int, bucketLimitsMs.size() + 1> counts {};
+        int total = 0;
+        double medianMs = 0.0;
+        double p95Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+    //==============================================================================
+    /** Times its own lifetime and records the span when it goes out of scope. */
+    class ScopedSpan
+    {
+    public:
+        ScopedSpan(Tracer& tracer, const juce::String& category, const juce::String& name);
+        ~ScopedSpan();
+
+        void setDetail(const juce::String& detail)      { span.detail = detail; }
+        void setOutputBytes(juce::int64 numBytes)       { span.outputBytes = numBytes; }
+        void setExitCode(int exitCode)                  { span.exitCode = exitCode; }
+
+    private:
+        Tracer& owner;
+        Span span;
+        juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedSpan)
+    };
+
+    //==============================================================================
+    explicit Tracer(int capacity = defaultCapacity);
+
+    void record(Span span);
+    void clear();
+
+    /** Oldest first. */
+    std::vector<Span> getSpans() const;
+
+    /** Every span recorded so far, including the ones the ring has since dropped. */
+    juce::int64 getNumRecorded() const;
+
+    /** Spans whose category matches (all of them if category is empty). */
+    Histogram getHistogram(const juce::String& category) const;
+
+    /** The slowest names in a category, by total time, e.g. to find which git call regressed. */
+    juce::StringArray getSlowestNames(const juce::String& category, int maxNames) const;
+
+    /** Trace Event Format: an object with a "traceEvents" array of complete ("X") events. */
+    juce::String toChromeTrace() const;
+    bool writeChromeTrace(const juce::File& file) const;
+
+    static constexpr int defaultCapacity = 4096;
+
+private:
+    mutable juce::CriticalSection lock;
+    std::vector<Span> ring;
+    size_t nextIndex = 0;
+    juce::int64 numRecorded = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Tracer)
+};